@@ -5,7 +5,7 @@
  *      Author: Dan
  */
 
-#include "Adjustable.h"
+#include "adjustable.h"
 
 
 #include <stdlib.h>
@@ -0,0 +1,192 @@
+#ifndef DJV_AFFINE_H_
+#define DJV_AFFINE_H_
+/*
+	Affine transforms
+
+	The top three rows of a mat4 whose bottom row is (0, 0, 0, 1), which
+	is what every Translate, Scale and Rotate chain of the game makes.
+	Appending a translation, scale or rotation to it only works on the
+	columns that change (3 to 12 multiplies, not the 64 of a mat4 product),
+	and it becomes a full mat4 once, when the projection is put in front:
+
+		mat4 m = projView * affine::translation(pos).scaled(0.3).rotatedY(a);
+
+	is projView * Translate(pos) * Scale(0.3) * RotateY(a), give or take
+	the rounding of the different order.
+*/
+
+#include "vec.h"
+#include "mat.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class affine
+{
+public:
+	// the identity
+	constexpr affine()
+		: r{ vec4(1,0,0,0), vec4(0,1,0,0), vec4(0,0,1,0) } {}
+
+	constexpr affine(const vec4& r0, const vec4& r1, const vec4& r2)
+		: r{ r0, r1, r2 } {}
+
+	// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+	// Translate, Scale and Rotate on their own
+
+	static constexpr affine translation(GLfloat x, GLfloat y, GLfloat z)
+	{
+		return affine(vec4(1,0,0,x), vec4(0,1,0,y), vec4(0,0,1,z));
+	}
+
+	static constexpr affine translation(const vec4& v) { return translation(v.x, v.y, v.z); }
+
+	static constexpr affine scaling(GLfloat x, GLfloat y, GLfloat z)
+	{
+		return affine(vec4(x,0,0,0), vec4(0,y,0,0), vec4(0,0,z,0));
+	}
+
+	static affine rotationX(GLfloat theta) { return affine().rotatedX(theta); }
+	static affine rotationY(GLfloat theta) { return affine().rotatedY(theta); }
+	static affine rotationZ(GLfloat theta) { return affine().rotatedZ(theta); }
+
+	// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+	// this * Translate(..), this * Scale(..), this * Rotate?(degrees)
+
+	constexpr affine translated(GLfloat x, GLfloat y, GLfloat z) const
+	{
+		return affine(translateRow(r[0], x, y, z), translateRow(r[1], x, y, z), translateRow(r[2], x, y, z));
+	}
+
+	constexpr affine translated(const vec4& v) const { return translated(v.x, v.y, v.z); }
+
+	constexpr affine scaled(GLfloat x, GLfloat y, GLfloat z) const
+	{
+		return affine(scaleRow(r[0], x, y, z), scaleRow(r[1], x, y, z), scaleRow(r[2], x, y, z));
+	}
+
+	constexpr affine scaled(GLfloat s) const { return scaled(s, s, s); }
+
+	// the angle and its cosine and sine exactly as RotateX/Y/Z make them;
+	// each row is mixed with itself with two of its columns swapped
+	affine rotatedX(GLfloat theta) const
+	{
+		GLfloat angle = DegreesToRadians * theta;
+		GLfloat c = cos(angle), s = sin(angle);
+		return rotated(c, s, 0);
+	}
+
+	affine rotatedY(GLfloat theta) const
+	{
+		GLfloat angle = DegreesToRadians * theta;
+		GLfloat c = cos(angle), s = sin(angle);
+		return rotated(c, s, 1);
+	}
+
+	affine rotatedZ(GLfloat theta) const
+	{
+		GLfloat angle = DegreesToRadians * theta;
+		GLfloat c = cos(angle), s = sin(angle);
+		return rotated(c, s, 2);
+	}
+
+	// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+	// this * b: the implied bottom rows make it 36 multiplies
+	affine operator * (const affine& b) const
+	{
+		return affine(multiplyRow(r[0], b), multiplyRow(r[1], b), multiplyRow(r[2], b));
+	}
+
+	// m * a, a full matrix again (the projection and view in front)
+	friend mat4 operator * (const mat4& m, const affine& a)
+	{
+		return mat4(multiplyRow(m[0], a), multiplyRow(m[1], a), multiplyRow(m[2], a), multiplyRow(m[3], a));
+	}
+
+	// a * m, for the HUD which puts its projection on the right
+	friend mat4 operator * (const affine& a, const mat4& m)
+	{
+		return mat4(a.r[0].x*m[0] + a.r[0].y*m[1] + a.r[0].z*m[2] + a.r[0].w*m[3],
+					a.r[1].x*m[0] + a.r[1].y*m[1] + a.r[1].z*m[2] + a.r[1].w*m[3],
+					a.r[2].x*m[0] + a.r[2].y*m[1] + a.r[2].z*m[2] + a.r[2].w*m[3],
+					m[3]);
+	}
+
+	constexpr const vec4& operator [] (int i) const { return r[i]; }
+
+	constexpr mat4 toMat4() const { return mat4(r[0], r[1], r[2], vec4(0,0,0,1)); }
+
+private:
+	static constexpr vec4 translateRow(const vec4& v, GLfloat x, GLfloat y, GLfloat z)
+	{
+		return vec4(v.x, v.y, v.z, v.x*x + v.y*y + v.z*z + v.w);
+	}
+
+	static constexpr vec4 scaleRow(const vec4& v, GLfloat x, GLfloat y, GLfloat z)
+	{
+		return vec4(v.x*x, v.y*y, v.z*z, v.w);
+	}
+
+	// the rows of b weighted by v, the implied (0, 0, 0, 1) last
+	static vec4 multiplyRow(const vec4& v, const affine& b)
+	{
+#ifdef DJV_SIMD_SSE
+		__m128 x = simdLoad(v);
+		__m128 s = _mm_mul_ps(_mm_shuffle_ps(x, x, 0x00), simdLoad(b.r[0]));
+		s = _mm_add_ps(s, _mm_mul_ps(_mm_shuffle_ps(x, x, 0x55), simdLoad(b.r[1])));
+		s = _mm_add_ps(s, _mm_mul_ps(_mm_shuffle_ps(x, x, 0xaa), simdLoad(b.r[2])));
+		return simdStore(_mm_add_ps(s, _mm_setr_ps(0, 0, 0, v.w)));
+#else
+		return b.r[0]*v.x + b.r[1]*v.y + b.r[2]*v.z + vec4(0, 0, 0, v.w);
+#endif
+	}
+
+	// each row times 'keep' plus the row with the two rotated columns
+	// swapped times 'mix': the y z columns for X (0), x z for Y (1), x y
+	// for Z (2)
+	affine rotated(GLfloat c, GLfloat s, int axis) const
+	{
+		affine a;
+#ifdef DJV_SIMD_SSE
+		// the factors go straight into registers, building them in memory
+		// first stalls the loads
+		__m128 keep = (axis == 0) ? _mm_setr_ps(1, c, c, 1) :
+					  (axis == 1) ? _mm_setr_ps(c, 1, c, 1) : _mm_setr_ps(c, c, 1, 1);
+		__m128 mix = (axis == 0) ? _mm_setr_ps(0, s, -s, 0) :
+					 (axis == 1) ? _mm_setr_ps(-s, 0, s, 0) : _mm_setr_ps(s, -s, 0, 0);
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 v = simdLoad(r[i]), swapped;
+			if (axis == 0)
+				swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 2, 0));
+			else if (axis == 1)
+				swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+			else
+				swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 2, 0, 1));
+			_mm_store_ps(&a.r[i].x, _mm_add_ps(_mm_mul_ps(v, keep), _mm_mul_ps(swapped, mix)));
+		}
+#else
+		vec4 keep = (axis == 0) ? vec4(1, c, c, 1) : (axis == 1) ? vec4(c, 1, c, 1) : vec4(c, c, 1, 1);
+		vec4 mix = (axis == 0) ? vec4(0, s, -s, 0) : (axis == 1) ? vec4(-s, 0, s, 0) : vec4(s, -s, 0, 0);
+		for (int i = 0; i < 3; i++)
+		{
+			const vec4& v = r[i];
+			vec4 swapped = (axis == 0) ? vec4(v.x, v.z, v.y, v.w) :
+						   (axis == 1) ? vec4(v.z, v.y, v.x, v.w) : vec4(v.y, v.x, v.z, v.w);
+			a.r[i] = vec4(v.x*keep.x + swapped.x*mix.x, v.y*keep.y + swapped.y*mix.y,
+						  v.z*keep.z + swapped.z*mix.z, v.w*keep.w + swapped.w*mix.w);
+		}
+#endif
+		return a;
+	}
+
+	vec4 r[3];
+};
+
+static_assert(std::is_trivially_copyable< affine >::value, "affine must stay trivially copyable");
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include "arena.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// every overflow chunk starts with this, the data follows
+struct OverflowChunk
+{
+	char* next;
+	size_t size;
+};
+
+static const size_t chunkHeader = 16;
+
+static size_t alignUp(size_t n, size_t align)
+{
+	return (n + align - 1) & ~(align - 1);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+FrameArena::FrameArena(size_t capacity)
+	: block(new char[capacity]), size(capacity), top(0),
+	  overflow(0), overflowBytes(0), high(0), grown(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	reset();
+	delete[] block;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void* FrameArena::allocate(size_t bytes, size_t align)
+{
+	// align the address, not the offset (new[] only promises 16 bytes)
+	uintptr_t base = (uintptr_t)block;
+	size_t start = alignUp(base + top, align) - base;
+	if (start + bytes <= size)
+	{
+		top = start + bytes;
+		high = std::max(high, used());
+		return block + start;
+	}
+
+	// does not fit: a heap chunk of its own until the next reset
+	size_t chunkSize = chunkHeader + bytes + align;
+	char* chunk = new char[chunkSize];
+	OverflowChunk* header = (OverflowChunk*)chunk;
+	header->next = overflow;
+	header->size = chunkSize;
+	overflow = chunk;
+	overflowBytes += chunkSize;
+	high = std::max(high, used());
+
+	uintptr_t data = (uintptr_t)(chunk + chunkHeader);
+	return (void*)alignUp(data, align);
+}
+
+void FrameArena::release(void* p, size_t bytes)
+{
+	// only the latest allocation in the block can be taken back
+	if ((char*)p + bytes == block + top)
+		top -= bytes;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void FrameArena::reset()
+{
+	bool overflowed = overflow != 0;
+	while (overflow)
+	{
+		char* next = ((OverflowChunk*)overflow)->next;
+		delete[] overflow;
+		overflow = next;
+	}
+	overflowBytes = 0;
+	top = 0;
+
+	// make room for the biggest frame so far, with some slack
+	if (overflowed && high > size)
+	{
+		delete[] block;
+		size = alignUp(high + high / 4, 4096);
+		block = new char[size];
+		grown++;
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+FrameArena& frameArena()
+{
+	static FrameArena arena;
+	return arena;
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef DJV_ARENA_H_
+#define DJV_ARENA_H_
+/*
+	Per frame arena
+
+	A linear (bump) allocator for data that only lives until the end of
+	the frame: allocating moves a pointer forward, nothing is freed one
+	by one, reset() at the end of the frame takes everything back at once.
+
+	When a frame needs more than the block holds the rest comes from the
+	heap, and the next reset() grows the block to that frame's peak, so
+	after a few frames the arena settles and never touches the heap again.
+
+	ArenaAllocator lets standard containers live in an arena:
+
+		ArenaVector< vec3 >::type vertices(frameArena());
+
+	Such containers must not outlive the arena's next reset().
+*/
+
+#include <stddef.h>
+
+#include <new>
+#include <vector>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity = 64 * 1024);
+	~FrameArena();
+
+	// 'align' must be a power of two
+	void* allocate(size_t bytes, size_t align = 16);
+
+	template< class T >
+	T* allocate(size_t n) { return (T*)allocate(n * sizeof(T), alignof(T)); }
+
+	// give back the latest allocation early (anything else waits for reset)
+	void release(void* p, size_t bytes);
+
+	// end of the frame: everything allocated since the last reset is gone
+	void reset();
+
+	size_t used() const { return top + overflowBytes; }
+	size_t capacity() const { return size; }
+	size_t peak() const { return high; }    // most used in any one frame
+	int growths() const { return grown; }   // times a frame did not fit
+
+private:
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+	char* block;
+	size_t size;
+	size_t top;
+
+	// heap chunks for what did not fit, chained through their first bytes
+	char* overflow;
+	size_t overflowBytes;
+
+	size_t high;
+	int grown;
+};
+
+// the main thread's arena, reset by the game at the end of every frame
+FrameArena& frameArena();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template< class T >
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+	template< class U >
+	ArenaAllocator(const ArenaAllocator< U >& other) : arena(other.arena) {}
+
+	T* allocate(size_t n) { return arena->allocate< T >(n); }
+	void deallocate(T* p, size_t n) { arena->release(p, n * sizeof(T)); }
+
+	template< class U >
+	bool operator==(const ArenaAllocator< U >& other) const { return arena == other.arena; }
+	template< class U >
+	bool operator!=(const ArenaAllocator< U >& other) const { return arena != other.arena; }
+
+	FrameArena* arena;
+};
+
+template< class T >
+struct ArenaVector
+{
+	typedef std::vector< T, ArenaAllocator< T > > type;
+};
+
+}
+
+#endif
@@ -0,0 +1,290 @@
+#include "background.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "gl_utilities.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// one triangle over the whole of clip space, in x and y
+static const GLfloat screenTriangle[] = { -1, -1, 3, -1, -1, 3 };
+
+static bool sameColour(const vec4& a, const vec4& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+// how much wider than the view the cache is drawn, so the camera can turn
+// a little before the texture runs out
+static const float cacheMargin = 1.25f;
+
+Background::Background()
+	: showGrid(false), gridHeight(-5), gridSpacing(10), gridColour(0.2f, 0.35f, 0.6f, 0.6f)
+	, refreshDistance(0.5f), refreshInterval(4)
+	, program(0), buffer(0), positionLoc(-1)
+	, cacheScale(0), cacheProgram(0), framebuffer(0), texture(0)
+	, cachePositionLoc(-1), textureWidth(0), textureHeight(0)
+	, cacheGrid(false), cacheAge(0), refreshes(0)
+{
+}
+
+Background::~Background()
+{
+	release();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Background::init()
+{
+	release();
+	program = loadAndInitializeShaders("vshader_background.glsl", "fshader_background.glsl");
+	positionLoc = glGetAttribLocation(program, "in_Position");
+	inverseProjView_loc = glGetUniformLocation(program, "inverseProjView");
+	starColour_loc = glGetUniformLocation(program, "starColour");
+	gridColour_loc = glGetUniformLocation(program, "gridColour");
+	gridHeight_loc = glGetUniformLocation(program, "gridHeight");
+	gridSpacing_loc = glGetUniformLocation(program, "gridSpacing");
+
+	buffer = trackedGenBuffer("Background");
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	trackedBufferData(GL_ARRAY_BUFFER, buffer, sizeof(screenTriangle), screenTriangle, GL_STATIC_DRAW);
+}
+
+void Background::release()
+{
+	releaseCache();
+	if (cacheProgram)
+		glDeleteProgram(cacheProgram);
+	cacheProgram = 0;
+	if (buffer)
+		trackedDeleteBuffer(buffer);
+	buffer = 0;
+	if (program)
+		glDeleteProgram(program);
+	program = 0;
+}
+
+size_t Background::bufferBytes() const
+{
+	return buffer ? sizeof(screenTriangle) : 0;
+}
+
+size_t Background::textureBytes() const
+{
+	return texture ? (size_t)textureWidth * textureHeight * 4 : 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Background::draw(const mat4& projView, const vec4& starColour)
+{
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint width = std::max(1, (int)(viewport[2] * cacheScale * cacheMargin));
+	GLint height = std::max(1, (int)(viewport[3] * cacheScale * cacheMargin));
+
+	if (!cached())
+	{
+		drawLayers(projView, starColour);
+	}
+	else
+	{
+		cacheAge++;
+		if (stale(projView, width, height) || !sameColour(starColour, cacheStarColour) || showGrid != cacheGrid)
+			refresh(projView, starColour, width, height);
+
+		// each pixel's view direction as the cached view saw it
+		glUseProgram(cacheProgram);
+		glUniformMatrix4fv(cacheInverseProjView_loc, 1, GL_TRUE, inverse(projView));
+		glUniformMatrix4fv(cacheProjView_loc, 1, GL_TRUE, cacheProjView);
+		glUniform1i(cacheTexture_loc, 0);
+		GLint activeTexture = GL_TEXTURE0, boundTexture = 0;
+		glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+		glActiveTexture(GL_TEXTURE0);
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		drawTriangle(cachePositionLoc);
+		glBindTexture(GL_TEXTURE_2D, boundTexture);
+		glActiveTexture(activeTexture);
+	}
+
+	glUseProgram(previous);
+}
+
+void Background::drawLayers(const mat4& projView, const vec4& starColour)
+{
+	glUseProgram(program);
+
+	// the shader turns each pixel back into its view ray
+	glUniformMatrix4fv(inverseProjView_loc, 1, GL_TRUE, inverse(projView));
+	glUniform4fv(starColour_loc, 1, starColour);
+	glUniform4fv(gridColour_loc, 1, showGrid ? gridColour : vec4(0, 0, 0, 0));
+	glUniform1f(gridHeight_loc, gridHeight);
+	glUniform1f(gridSpacing_loc, gridSpacing);
+	drawTriangle(positionLoc);
+}
+
+void Background::drawTriangle(GLint position)
+{
+	// the main program keeps its position attribute enabled, leave it that way
+	GLint positionWasEnabled = 0;
+	glGetVertexAttribiv(position, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &positionWasEnabled);
+	glEnableVertexAttribArray(position);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+
+	// behind everything, whatever order it is drawn in
+	GLboolean depthMask = GL_TRUE;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	glDepthMask(GL_FALSE);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDepthMask(depthMask);
+
+	if (!positionWasEnabled)
+		glDisableVertexAttribArray(position);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+bool Background::cacheSupported()
+{
+#ifdef GL_FRAMEBUFFER
+	// stays 0 in contexts older than 3.0, which do not know the name
+	GLint major = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	while (glGetError() != GL_NO_ERROR)
+		;
+	return major >= 3;
+#else
+	return false;
+#endif
+}
+
+void Background::useCache(float scale)
+{
+	cacheScale = cacheSupported() ? std::max(0.0f, scale) : 0;
+	if (!cached())
+		releaseCache();
+}
+
+bool Background::stale(const mat4& projView, GLint width, GLint height) const
+{
+	if (!texture || width != textureWidth || height != textureHeight)
+		return true;
+
+	// every corner of the view still inside the cached one, or its edge
+	// would show
+	mat4 unproject = inverse(projView);
+	for (int i = 0; i < 4; i++)
+	{
+		float x = (i & 1) ? 1.0f : -1.0f, y = (i & 2) ? 1.0f : -1.0f;
+		vec4 nearPoint = unproject * vec4(x, y, -1, 1), farPoint = unproject * vec4(x, y, 1, 1);
+		vec4 direction = farPoint / farPoint.w - nearPoint / nearPoint.w;
+		direction.w = 0;
+		vec4 clip = cacheProjView * direction;
+		if (clip.w <= 0 || std::fabs(clip.x) > clip.w || std::fabs(clip.y) > clip.w)
+			return true;
+	}
+
+	// the nearer planes have slid against the cached picture
+	vec4 eye = eyePoint(projView);
+	if (eye.w == 0 || cacheEye.w == 0)
+		return true;
+	vec4 moved = eye - cacheEye;
+	moved.w = 0;
+	return cacheAge >= refreshInterval && length(moved) > refreshDistance;
+}
+
+void Background::refresh(const mat4& projView, const vec4& starColour, GLint width, GLint height)
+{
+#ifdef GL_FRAMEBUFFER
+	if (!cacheProgram)
+	{
+		cacheProgram = loadAndInitializeShaders("vshader_background.glsl", "fshader_background_cache.glsl");
+		cachePositionLoc = glGetAttribLocation(cacheProgram, "in_Position");
+		cacheInverseProjView_loc = glGetUniformLocation(cacheProgram, "inverseProjView");
+		cacheProjView_loc = glGetUniformLocation(cacheProgram, "cacheProjView");
+		cacheTexture_loc = glGetUniformLocation(cacheProgram, "cache");
+	}
+
+	GLint boundFramebuffer = 0, boundTexture = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &boundFramebuffer);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+	if (!texture || width != textureWidth || height != textureHeight)
+	{
+		releaseCache();
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		textureWidth = width;
+		textureHeight = height;
+	}
+	glBindTexture(GL_TEXTURE_2D, boundTexture);
+
+	// the same view, shrunk on screen to leave the margin round it
+	cacheProjView = Scale(1 / cacheMargin, 1 / cacheMargin, 1) * projView;
+	cacheEye = eyePoint(projView);
+	cacheStarColour = starColour;
+	cacheGrid = showGrid;
+	cacheAge = 0;
+	refreshes++;
+
+	GLint viewport[4];
+	GLfloat clearColour[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColour);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	GLint srcRGB, dstRGB, srcAlpha, dstAlpha;
+	glGetIntegerv(GL_BLEND_SRC_RGB, &srcRGB);
+	glGetIntegerv(GL_BLEND_DST_RGB, &dstRGB);
+	glGetIntegerv(GL_BLEND_SRC_ALPHA, &srcAlpha);
+	glGetIntegerv(GL_BLEND_DST_ALPHA, &dstAlpha);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// kept with the colour multiplied by coverage, so the texture filters
+	// without darkening the edges
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ZERO, GL_ONE, GL_ZERO);
+	drawLayers(cacheProjView, starColour);
+
+	glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+	if (!blend)
+		glDisable(GL_BLEND);
+	glClearColor(clearColour[0], clearColour[1], clearColour[2], clearColour[3]);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBindFramebuffer(GL_FRAMEBUFFER, boundFramebuffer);
+#endif
+}
+
+void Background::releaseCache()
+{
+#ifdef GL_FRAMEBUFFER
+	if (framebuffer)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (texture)
+		glDeleteTextures(1, &texture);
+#endif
+	framebuffer = 0;
+	texture = 0;
+	textureWidth = textureHeight = 0;
+}
+
+}
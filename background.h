@@ -0,0 +1,119 @@
+#ifndef DJV_BACKGROUND_H_
+#define DJV_BACKGROUND_H_
+/*
+	Procedural background
+
+	The stars and the grid, worked out per pixel instead of kept as
+	points and lines: one triangle covers the screen, and its fragments
+	follow their view ray out to a few planes. On each star plane the
+	ray lands in a cell, and a hash of the cell says whether it has a
+	star and where. The nearer planes shift more as the camera moves,
+	so the layers have parallax. The grid is the distance to the nearest
+	line on its own plane. Nothing is bounded, so there is always sky
+	wherever the ship flies. It needs no vertex memory past the triangle
+	and costs the same per pixel whatever the view.
+
+	Drawn at the far plane without writing depth, so it can go before or
+	after the rest of the frame and still stays behind it.
+
+	With the cache on (useCache()) the layers go into a texture instead,
+	at a fraction of the screen's resolution and a little wider than the
+	view, and each frame only looks the texture up by each pixel's view
+	direction: a turn of the camera costs nothing until it turns past the
+	margin. Moving the camera shifts the nearer planes against the cached
+	picture, so it is drawn again once the camera has moved farther than
+	refreshDistance, no more often than every refreshInterval frames.
+	That suits the stars, which are far; the grid is near and shows it.
+*/
+
+#include <stddef.h>
+
+#include "gl_include.h"
+#include "vec.h"
+#include "mat.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class Background
+{
+public:
+	Background();
+	~Background();
+
+	// load the shaders and create the triangle (needs a GL context)
+	void init();
+	void release();
+
+	// the background the camera projView looks through sees, leaves the
+	// current program as it was
+	void draw(const mat4& projView, const vec4& starColour);
+
+	// the grid lines, every gridSpacing on the plane y = gridHeight
+	// (off unless showGrid)
+	bool showGrid;
+	float gridHeight;
+	float gridSpacing;
+	vec4 gridColour;
+
+	// draw through the cache, 'scale' of the viewport's resolution (0 turns
+	// it off, and so does a context without framebuffers); the texture is
+	// made on the first draw() that needs it
+	void useCache(float scale);
+	bool cached() const { return cacheScale > 0; }
+
+	// whether the current context has the framebuffers the cache needs
+	static bool cacheSupported();
+
+	// how far the camera moves before the cache is drawn again, and the
+	// fewest frames between two draws for that reason
+	float refreshDistance;
+	int refreshInterval;
+
+	// times the cache has been drawn
+	unsigned long long cacheRefreshes() const { return refreshes; }
+
+	// bytes of vertex memory it uses, and of the cache's texture
+	size_t bufferBytes() const;
+	size_t textureBytes() const;
+
+private:
+	Background(const Background&);
+	Background& operator=(const Background&);
+
+	// the layers themselves, into whatever framebuffer is bound
+	void drawLayers(const mat4& projView, const vec4& starColour);
+
+	// the triangle drawn with 'program' at the far plane, attribute
+	// 'position'
+	void drawTriangle(GLint position);
+
+	// whether the cache has to be drawn again for projView, and drawing it
+	bool stale(const mat4& projView, GLint width, GLint height) const;
+	void refresh(const mat4& projView, const vec4& starColour, GLint width, GLint height);
+	void releaseCache();
+
+	GLuint program;
+	GLuint buffer;
+	GLint positionLoc;
+	GLint inverseProjView_loc, starColour_loc, gridColour_loc, gridHeight_loc, gridSpacing_loc;
+
+	float cacheScale;
+	GLuint cacheProgram, framebuffer, texture;
+	GLint cachePositionLoc, cacheInverseProjView_loc, cacheProjView_loc, cacheTexture_loc;
+	GLint textureWidth, textureHeight;
+
+	// the view the texture holds (wider than the one it was drawn for),
+	// where it was seen from, and the frames since
+	mat4 cacheProjView;
+	vec4 cacheEye;
+	vec4 cacheStarColour;
+	bool cacheGrid;
+	int cacheAge;
+	unsigned long long refreshes;
+};
+
+}
+
+#endif
@@ -0,0 +1,1406 @@
+/*
+	Headless benchmark harness
+
+	Runs the game world without a window through scripted stress
+	scenarios and reports the time per tick of each phase (spawn,
+	integrate, collide, cull, build draws) as JSON. A saved report can
+	be used as a baseline, --compare flags phases that got significantly
+	slower. Every scenario is repeated from the same seed, so the only
+	thing that differs between repetitions is timing noise; the
+	repetition means are what gets compared.
+
+	bench --list
+	bench --scenario swarm-10k --out base.json
+	bench --scenario swarm-10k --compare base.json
+	bench --current new.json --compare base.json
+
+	Games recorded with asteroids --record (or a scenario captured with
+	--record) can be replayed as a workload, or checked against their
+	keyframes to catch anything that broke determinism.
+
+	bench --scenario bullet-storm --record storm.rec
+	bench --replay game.rec --out game.json
+	bench --verify game.rec
+
+	bench --rng compares the random number streams with libc's rand().
+	bench --math checks the SIMD vector and matrix code against the plain
+	versions and times both, bench --transforms the batched transforms,
+	bench --draws building the draws on one thread and recorded by jobs.
+
+	The batched kernels run at the best instruction set level the machine
+	has, DJV_ISA=scalar|sse2|avx2|avx512 picks a lower one; reports record
+	the level that ran.
+
+	bench --jobs N runs a scenario on 1 to N threads of the job system
+	(jobs.h) and shows how each phase scales, checking that every thread
+	count ends with the same world.
+
+	bench --batch N steps N independent games the way automated agents
+	drive them (world_batch.h) and reports the aggregate steps per second.
+
+	bench --sim-thread SECONDS runs a scenario the way the game does, the
+	world ticking on its own thread while the main thread draws the
+	snapshots it publishes (sim_thread.h), and reports the tick jitter and
+	the frame times separately.
+
+	With --telemetry NAME the tick counts are published to shared memory
+	as they run, for telemetry_tail --name NAME to follow.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "world.h"
+#include "replay.h"
+#include "rng.h"
+#include "telemetry.h"
+#include "memory_tracker.h"
+#include "bench_math.h"
+#include "jobs.h"
+#include "sim_thread.h"
+#include "world_batch.h"
+
+using namespace djv;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// a scripted workload
+struct Scenario
+{
+	std::string name;
+	int asteroids;   // asteroids kept in play
+	int ticks;       // measured ticks
+	int warmup;      // ticks run before measuring
+	int bulletEvery; // fire a bullet every n ticks (0 = never)
+	int salvoEvery;  // rearm and fire both missiles every n ticks (0 = never)
+};
+
+static const Scenario scenarios[] = {
+	// name             asteroids  ticks  warmup  bullets  salvo
+	{ "default",               60,  2000,    200,       0,     0 },
+	{ "bullet-storm",          60,  2000,    200,       1,     0 },
+	{ "missile-salvo",       1000,  1000,    100,       0,    25 },
+	{ "swarm-10k",          10000,   300,     30,       4,    50 },
+	{ "swarm-100k",        100000,    60,      6,       4,    20 },
+	{ "swarm-1m",         1000000,    12,      2,       4,     6 },
+};
+
+static const int numScenarios = sizeof(scenarios) / sizeof(scenarios[0]);
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+enum Phase { PHASE_SPAWN, PHASE_INTEGRATE, PHASE_COLLIDE, PHASE_CULL, PHASE_DRAWS, PHASE_TOTAL, NUM_PHASES };
+
+static const char* phaseNames[NUM_PHASES] = { "spawn", "integrate", "collide", "cull", "build_draws", "total" };
+
+// summary of the per tick samples of one phase
+struct Stats
+{
+	double mean;
+	double stddev;
+	double min;
+	double median;
+	double p95;
+	int samples;
+};
+
+static Stats summarize(std::vector< double > v)
+{
+	Stats s = { 0, 0, 0, 0, 0, (int)v.size() };
+	if (v.empty())
+		return s;
+
+	std::sort(v.begin(), v.end());
+
+	double sum = 0;
+	for (unsigned int i = 0; i < v.size(); i++)
+		sum += v[i];
+	s.mean = sum / v.size();
+
+	double sq = 0;
+	for (unsigned int i = 0; i < v.size(); i++)
+		sq += (v[i] - s.mean) * (v[i] - s.mean);
+	s.stddev = v.size() > 1 ? sqrt(sq / (v.size() - 1)) : 0;
+
+	s.min = v.front();
+	s.median = v[v.size() / 2];
+	s.p95 = v[std::min(v.size() - 1, (size_t)(v.size() * 0.95))];
+	return s;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+struct RunResult
+{
+	Scenario scenario;
+	unsigned seed;
+	int reps;
+	Stats phases[NUM_PHASES];                  // over every measured tick
+	std::vector< double > repMeans[NUM_PHASES]; // mean ns/tick of each repetition
+	double asteroids;  // mean live asteroids per tick
+	double bullets;    // mean live bullets per tick
+	double draws;      // mean draw commands per tick
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double nanoseconds(Clock::time_point a, Clock::time_point b)
+{
+	return (double)std::chrono::duration_cast< std::chrono::nanoseconds >(b - a).count();
+}
+
+// feed the scripted input for this tick, through the recorder so it can
+// be captured (it only passes the input on when it is not recording)
+static void script(World& world, Recorder& recorder, const Scenario& sc, int tick)
+{
+	if (tick == 0)
+		recorder.keyboard(world, 'a'); // get the ship moving
+
+	if (sc.bulletEvery > 0 && tick % sc.bulletEvery == 0)
+	{
+		// never run dry, the point is the bullet load
+		recorder.command(world, COMMAND_REFILL_BULLETS);
+		recorder.keyboard(world, ' ');
+	}
+
+	if (sc.salvoEvery > 0 && tick % sc.salvoEvery == 0)
+	{
+		recorder.command(world, COMMAND_REARM_MISSILES);
+		recorder.keyboard(world, 'z');
+		recorder.keyboard(world, 'x');
+	}
+
+	// fly in a wide circle
+	if (tick % 20 == 0)
+	{
+		recorder.specialKeyboard(world, KEY_LEFT);
+		recorder.specialKeyboard(world, KEY_UP);
+	}
+}
+
+// published every tick when --telemetry is given (outside the timed part)
+static Telemetry telemetry;
+static int telemetryTicks = telemetry.counter("ticks");
+static int telemetryAsteroids = telemetry.gauge("asteroids_live");
+static int telemetryBullets = telemetry.gauge("bullets_live");
+static int telemetryCollisionTests = telemetry.counter("collision_tests");
+static int telemetryDraws = telemetry.gauge("draws");
+static int telemetryTickNs = telemetry.gauge("tick_ns");
+
+// where the input of a run comes from
+struct Input
+{
+	Input() : replay(NULL), record(NULL) {}
+
+	const Recording* replay; // play this back instead of the script
+	Recording* record;       // capture the scripted input into this
+};
+
+static const Recording noRecording;
+
+// drives a world with a scenario's script, or with a recording
+class Driver
+{
+public:
+	Driver(const Scenario& sc, unsigned seed, Input& input)
+		: sc(sc), in(input), replayer(input.replay ? *input.replay : noRecording)
+	{
+		if (in.replay)
+		{
+			replayer.start(world);
+		}
+		else
+		{
+			world.reset(seed);
+			world.num_spheres = sc.asteroids;
+			if (in.record)
+				recorder.start(world, seed);
+		}
+	}
+
+	// feed the input due before the phases of this tick
+	void input(int tick)
+	{
+		if (in.replay)
+			replayer.applyInput(world);
+		else
+			script(world, recorder, sc, tick);
+	}
+
+	// after the phases of every tick
+	void endTick()
+	{
+		replayer.advance();
+		recorder.tick(world);
+	}
+
+	// hand over what was recorded (if anything)
+	void finish()
+	{
+		if (in.record)
+			*in.record = recorder.stop();
+	}
+
+	World world;
+
+private:
+	const Scenario& sc;
+	Input& in;
+	Recorder recorder;
+	Replayer replayer;
+};
+
+static mat4 benchProjection()
+{
+	return Perspective(40.0f, 1.0f, 1.0f, 250.0f);
+}
+
+// a fixed camera following the ship, like the game's
+static mat4 benchView(const World& world)
+{
+	mat4 Camera = LookAt(vec4(-4.5f, 1.5f, -4.5f, 1), vec4(0, 0, 0, 1), vec4(0, 1, 0, 0));
+	return Camera * world.cameraView();
+}
+
+// one repetition of a scenario, appends the per tick samples
+static void runOnce(const Scenario& sc, unsigned seed, Input& input, std::vector< double >* samples,
+					double& asteroids, double& bullets, double& numDraws, unsigned long long* finalState = NULL)
+{
+	Driver driver(sc, seed, input);
+	World& world = driver.world;
+
+	mat4 Projection = benchProjection();
+	DrawList draws;
+	DrawRecorder drawRecorder;
+
+	asteroids = bullets = numDraws = 0;
+
+	for (int tick = 0; tick < sc.warmup + sc.ticks; tick++)
+	{
+		driver.input(tick);
+
+		Clock::time_point t0 = Clock::now();
+		world.spawn();
+		Clock::time_point t1 = Clock::now();
+		world.integrate();
+		Clock::time_point t2 = Clock::now();
+		world.collide();
+		Clock::time_point t3 = Clock::now();
+		world.cull();
+		Clock::time_point t4 = Clock::now();
+		draws.clear();
+		world.recordDraws(drawRecorder, draws, Projection * benchView(world), Projection);
+		Clock::time_point t5 = Clock::now();
+
+		driver.endTick();
+
+		if (telemetry.isOpen())
+		{
+			telemetry.add(telemetryTicks);
+			telemetry.set(telemetryAsteroids, world.spheres.size());
+			telemetry.set(telemetryBullets, world.bullet_positions.size());
+			telemetry.add(telemetryCollisionTests, world.collision_tests);
+			telemetry.set(telemetryDraws, draws.size());
+			telemetry.set(telemetryTickNs, (long long)nanoseconds(t0, t5));
+			telemetry.publish();
+		}
+
+		if (tick < sc.warmup)
+			continue;
+
+		samples[PHASE_SPAWN].push_back(nanoseconds(t0, t1));
+		samples[PHASE_INTEGRATE].push_back(nanoseconds(t1, t2));
+		samples[PHASE_COLLIDE].push_back(nanoseconds(t2, t3));
+		samples[PHASE_CULL].push_back(nanoseconds(t3, t4));
+		samples[PHASE_DRAWS].push_back(nanoseconds(t4, t5));
+		samples[PHASE_TOTAL].push_back(nanoseconds(t0, t5));
+
+		asteroids += world.spheres.size();
+		bullets += world.bullet_positions.size();
+		numDraws += draws.size();
+	}
+
+	asteroids /= sc.ticks;
+	bullets /= sc.ticks;
+	numDraws /= sc.ticks;
+
+	if (finalState)
+		*finalState = hashWorld(world);
+	driver.finish();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// run a scenario untimed, following the live heap; after the warm-up it
+// should level off, returns 1 if it kept growing
+static int soak(const Scenario& sc, unsigned seed, Input& input)
+{
+	const double tolerance = 64 * 1024;
+	GrowthWatch watch(sc.warmup, tolerance);
+
+	Driver driver(sc, seed, input);
+	World& world = driver.world;
+
+	mat4 Projection = benchProjection();
+	DrawList draws;
+	DrawRecorder drawRecorder;
+	AllocationCounter steady;
+
+	for (int tick = 0; tick < sc.warmup + sc.ticks; tick++)
+	{
+		if (tick == sc.warmup)
+			steady = AllocationCounter("record");
+
+		driver.input(tick);
+		{ HeapScope scope("spawn"); world.spawn(); }
+		{ HeapScope scope("integrate"); world.integrate(); }
+		{ HeapScope scope("collide"); world.collide(); }
+		{ HeapScope scope("cull"); world.cull(); }
+		{
+			HeapScope scope("build_draws");
+			draws.clear();
+			world.recordDraws(drawRecorder, draws, Projection * benchView(world), Projection);
+		}
+		{ HeapScope scope("record"); driver.endTick(); }
+
+		watch.sample((double)heapStats().liveBytes);
+	}
+	driver.finish();
+
+	reportHeap(std::cout);
+	bool leaking = watch.growing();
+	std::cout << sc.name << ": live heap " << (leaking ? "KEEPS GROWING" : "levels off")
+			  << " after " << sc.warmup << " warm-up ticks ("
+			  << watch.slope() << " bytes/tick over " << sc.ticks << " ticks), "
+			  << steady.count() << " allocations after it" << std::endl;
+	return leaking ? 1 : 0;
+}
+
+static RunResult runScenario(const Scenario& sc, unsigned seed, int reps, Input& input)
+{
+	RunResult r;
+	r.scenario = sc;
+	r.seed = seed;
+	r.reps = reps;
+
+	std::vector< double > samples[NUM_PHASES];
+
+	for (int i = 0; i < reps; i++)
+	{
+		std::vector< double > rep[NUM_PHASES];
+		runOnce(sc, seed, input, rep, r.asteroids, r.bullets, r.draws);
+		input.record = NULL; // the first repetition is enough
+
+		for (int p = 0; p < NUM_PHASES; p++)
+		{
+			r.repMeans[p].push_back(summarize(rep[p]).mean);
+			samples[p].insert(samples[p].end(), rep[p].begin(), rep[p].end());
+		}
+	}
+
+	for (int p = 0; p < NUM_PHASES; p++)
+		r.phases[p] = summarize(samples[p]);
+	return r;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static void writeJson(std::ostream& os, const std::vector< RunResult >& runs)
+{
+	os << "{\n  \"isa\": \"" << isaName(batchIsa()) << "\",\n  \"runs\": [\n";
+	for (unsigned int i = 0; i < runs.size(); i++)
+	{
+		const RunResult& r = runs[i];
+		const Scenario& sc = r.scenario;
+		os << "    {\n";
+		os << "      \"scenario\": \"" << sc.name << "\",\n";
+		os << "      \"config\": { \"asteroids\": " << sc.asteroids
+		   << ", \"ticks\": " << sc.ticks
+		   << ", \"warmup\": " << sc.warmup
+		   << ", \"bullet_every\": " << sc.bulletEvery
+		   << ", \"salvo_every\": " << sc.salvoEvery
+		   << ", \"seed\": " << r.seed
+		   << ", \"reps\": " << r.reps << " },\n";
+		os << "      \"phases\": {\n";
+		for (int p = 0; p < NUM_PHASES; p++)
+		{
+			const Stats& s = r.phases[p];
+			os << "        \"" << phaseNames[p] << "\": { \"mean_ns\": " << s.mean
+			   << ", \"stddev_ns\": " << s.stddev
+			   << ", \"min_ns\": " << s.min
+			   << ", \"median_ns\": " << s.median
+			   << ", \"p95_ns\": " << s.p95
+			   << ", \"samples\": " << s.samples
+			   << ", \"rep_means_ns\": [";
+			for (unsigned int k = 0; k < r.repMeans[p].size(); k++)
+				os << (k ? ", " : "") << r.repMeans[p][k];
+			os << "] }"
+			   << (p + 1 < NUM_PHASES ? ",\n" : "\n");
+		}
+		os << "      },\n";
+		os << "      \"counts\": { \"asteroids\": " << r.asteroids
+		   << ", \"bullets\": " << r.bullets
+		   << ", \"draws\": " << r.draws << " }\n";
+		os << "    }" << (i + 1 < runs.size() ? ",\n" : "\n");
+	}
+	os << "  ]\n}\n";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// just enough JSON to read a saved report back
+struct JsonValue
+{
+	enum Type { NUL, NUMBER, STRING, ARRAY, OBJECT } type;
+	double number;
+	std::string str;
+	std::vector< JsonValue > items;
+	std::vector< std::string > keys; // for objects, parallel to items
+
+	JsonValue() : type(NUL), number(0) {}
+
+	const JsonValue* get(const std::string& key) const
+	{
+		for (unsigned int i = 0; i < keys.size(); i++)
+			if (keys[i] == key)
+				return &items[i];
+		return NULL;
+	}
+
+	double num(const std::string& key) const
+	{
+		const JsonValue* v = get(key);
+		return v ? v->number : 0;
+	}
+};
+
+class JsonParser
+{
+public:
+	JsonParser(const std::string& text) : s(text), pos(0) {}
+
+	bool parse(JsonValue& out)
+	{
+		return value(out);
+	}
+
+private:
+	std::string s;
+	size_t pos;
+
+	void skip()
+	{
+		while (pos < s.size() && isspace((unsigned char)s[pos]))
+			pos++;
+	}
+
+	bool string(std::string& out)
+	{
+		if (s[pos] != '"')
+			return false;
+		pos++;
+		while (pos < s.size() && s[pos] != '"')
+		{
+			if (s[pos] == '\\')
+				pos++;
+			out += s[pos++];
+		}
+		pos++;
+		return pos <= s.size();
+	}
+
+	bool value(JsonValue& v)
+	{
+		skip();
+		if (pos >= s.size())
+			return false;
+
+		char c = s[pos];
+		if (c == '{')
+		{
+			v.type = JsonValue::OBJECT;
+			pos++;
+			skip();
+			if (s[pos] == '}') { pos++; return true; }
+			while (true)
+			{
+				skip();
+				std::string key;
+				if (!string(key))
+					return false;
+				skip();
+				if (s[pos++] != ':')
+					return false;
+				v.keys.push_back(key);
+				v.items.push_back(JsonValue());
+				if (!value(v.items.back()))
+					return false;
+				skip();
+				if (s[pos] == ',') { pos++; continue; }
+				if (s[pos] == '}') { pos++; return true; }
+				return false;
+			}
+		}
+		else if (c == '[')
+		{
+			v.type = JsonValue::ARRAY;
+			pos++;
+			skip();
+			if (s[pos] == ']') { pos++; return true; }
+			while (true)
+			{
+				v.items.push_back(JsonValue());
+				if (!value(v.items.back()))
+					return false;
+				skip();
+				if (s[pos] == ',') { pos++; continue; }
+				if (s[pos] == ']') { pos++; return true; }
+				return false;
+			}
+		}
+		else if (c == '"')
+		{
+			v.type = JsonValue::STRING;
+			return string(v.str);
+		}
+		else if (s.compare(pos, 4, "null") == 0)
+		{
+			pos += 4;
+			return true;
+		}
+		else
+		{
+			const char* start = s.c_str() + pos;
+			char* end;
+			v.type = JsonValue::NUMBER;
+			v.number = strtod(start, &end);
+			if (end == start)
+				return false;
+			pos += end - start;
+			return true;
+		}
+	}
+};
+
+static bool loadJson(const std::string& file, JsonValue& out)
+{
+	std::ifstream in(file.c_str());
+	if (!in)
+	{
+		std::cerr << "cannot open '" << file << "'" << std::endl;
+		return false;
+	}
+	std::stringstream ss;
+	ss << in.rdbuf();
+	std::string text = ss.str();
+	JsonParser parser(text);
+	if (!parser.parse(out) || !out.get("runs"))
+	{
+		std::cerr << "'" << file << "' is not a bench report" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static const JsonValue* findRun(const JsonValue& report, const std::string& scenario)
+{
+	const JsonValue* runs = report.get("runs");
+	for (unsigned int i = 0; i < runs->items.size(); i++)
+	{
+		const JsonValue* name = runs->items[i].get("scenario");
+		if (name && name->str == scenario)
+			return &runs->items[i];
+	}
+	return NULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// one sided 99% critical values of Student's t
+static double tCritical(double df)
+{
+	static const double table[][2] = {
+		{ 1, 31.82 }, { 2, 6.965 }, { 3, 4.541 }, { 4, 3.747 }, { 5, 3.365 },
+		{ 6, 3.143 }, { 7, 2.998 }, { 8, 2.896 }, { 9, 2.821 }, { 10, 2.764 },
+		{ 15, 2.602 }, { 20, 2.528 }, { 30, 2.457 }, { 60, 2.390 }, { 120, 2.358 }
+	};
+	const int n = sizeof(table) / sizeof(table[0]);
+
+	// round df down, which errs on the conservative side
+	for (int i = n - 1; i >= 0; i--)
+		if (df >= table[i][0])
+			return table[i][1];
+	return table[0][1];
+}
+
+// mean, sample variance and count of a phase's repetition means
+static void repStats(const JsonValue& phase, double& mean, double& var, double& n)
+{
+	const JsonValue* reps = phase.get("rep_means_ns");
+	mean = var = n = 0;
+	if (!reps)
+		return;
+
+	n = reps->items.size();
+	for (unsigned int i = 0; i < reps->items.size(); i++)
+		mean += reps->items[i].number;
+	if (n > 0)
+		mean /= n;
+	for (unsigned int i = 0; i < reps->items.size(); i++)
+		var += (reps->items[i].number - mean) * (reps->items[i].number - mean);
+	if (n > 1)
+		var /= n - 1;
+}
+
+// Welch's t-test on the repetition means; a phase regresses when it is
+// both significantly slower and slower by more than the relative threshold
+static int compareReports(const JsonValue& baseline, const JsonValue& current, double threshold)
+{
+	int regressions = 0;
+
+	// reports from before the ISA was recorded have no "isa"
+	const JsonValue* baseIsa = baseline.get("isa");
+	const JsonValue* curIsa = current.get("isa");
+	if (baseIsa && curIsa && baseIsa->str != curIsa->str)
+		std::cout << "note: baseline ran the " << baseIsa->str << " kernels, this run the " << curIsa->str << std::endl;
+
+	const JsonValue* runs = current.get("runs");
+	for (unsigned int i = 0; i < runs->items.size(); i++)
+	{
+		const JsonValue& cur = runs->items[i];
+		std::string name = cur.get("scenario")->str;
+		const JsonValue* base = findRun(baseline, name);
+		if (!base)
+		{
+			std::cout << name << ": not in baseline, skipped" << std::endl;
+			continue;
+		}
+
+		for (int p = 0; p < NUM_PHASES; p++)
+		{
+			const JsonValue* b = base->get("phases")->get(phaseNames[p]);
+			const JsonValue* c = cur.get("phases")->get(phaseNames[p]);
+			if (!b || !c)
+				continue;
+
+			double bm, bv, bn, cm, cv, cn;
+			repStats(*b, bm, bv, bn);
+			repStats(*c, cm, cv, cn);
+			if (bn < 2 || cn < 2 || bm <= 0)
+			{
+				std::cout << name << " " << phaseNames[p] << ": needs at least 2 repetitions on both sides" << std::endl;
+				continue;
+			}
+
+			double bse = bv / bn, cse = cv / cn;
+			double se = sqrt(bse + cse);
+			double t = se > 0 ? (cm - bm) / se : 0;
+			// Welch-Satterthwaite degrees of freedom
+			double df = se > 0 ? (bse + cse) * (bse + cse) / (bse * bse / (bn - 1) + cse * cse / (cn - 1)) : 1;
+			double change = (cm - bm) / bm;
+			double critical = tCritical(df);
+
+			const char* verdict = "ok";
+			if (t > critical && change > threshold)
+			{
+				verdict = "REGRESSION";
+				regressions++;
+			}
+			else if (t < -critical && -change > threshold)
+			{
+				verdict = "improved";
+			}
+
+			std::cout << name << " " << phaseNames[p]
+					  << ": " << bm << " -> " << cm << " ns/tick ("
+					  << (change >= 0 ? "+" : "") << change * 100 << "%, t = " << t << ") "
+					  << verdict << std::endl;
+		}
+	}
+
+	std::cout << regressions << " regression(s)" << std::endl;
+	return regressions;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// jobs chained by their counters have to run one after the other, and a
+// parallelFor has to cover every index once; returns false if not
+static bool checkJobOrder()
+{
+	const int chain = 64;
+	std::vector< int > order(chain, -1);
+	std::atomic< int > next(0);
+	JobCounter links[chain];
+	for (int i = 0; i < chain; i++)
+		jobs().run([&order, &next, i] { order[i] = next++; }, links[i], i > 0 ? &links[i - 1] : NULL);
+	jobs().wait(links[chain - 1]);
+
+	const size_t n = 100000;
+	std::vector< int > covered(n, 0);
+	jobs().parallelFor(n, 1000, [&covered](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			covered[i]++;
+	});
+
+	for (int i = 0; i < chain; i++)
+		if (order[i] != i)
+			return false;
+	return std::count(covered.begin(), covered.end(), 1) == (std::ptrdiff_t)n;
+}
+
+// a scenario on 1 to maxThreads threads (the caller and maxThreads - 1 job
+// workers): the mean tick phases and the speed-up of the total at each
+// count; returns 1 if the final world differs from the one thread run's
+static int scaleJobs(const Scenario& sc, unsigned seed, int reps, unsigned int maxThreads)
+{
+	std::cout << sc.name << " (" << sc.asteroids << " asteroids, " << sc.ticks << " ticks), "
+			  << "mean ns per tick, " << reps << " repetitions\n"
+			  << "threads";
+	for (int p = 0; p < NUM_PHASES; p++)
+		std::cout << "  " << phaseNames[p];
+	std::cout << "  speed-up  state" << std::endl;
+
+	int failures = 0;
+	double serialTotal = 0;
+	unsigned long long serialState = 0;
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		setJobWorkers(threads - 1);
+		setBatchThreads(threads, 64 * 1024);
+		if (!checkJobOrder())
+		{
+			std::cout << threads << ": jobs ran out of order" << std::endl;
+			failures++;
+		}
+
+		Input input;
+		std::vector< double > samples[NUM_PHASES];
+		unsigned long long state = 0;
+		for (int r = 0; r < reps; r++)
+		{
+			double asteroids, bullets, draws;
+			runOnce(sc, seed, input, samples, asteroids, bullets, draws, &state);
+		}
+
+		double means[NUM_PHASES];
+		for (int p = 0; p < NUM_PHASES; p++)
+			means[p] = summarize(samples[p]).mean;
+		if (threads == 1)
+		{
+			serialTotal = means[PHASE_TOTAL];
+			serialState = state;
+		}
+
+		bool same = state == serialState;
+		if (!same)
+			failures++;
+
+		std::cout << threads;
+		for (int p = 0; p < NUM_PHASES; p++)
+			std::cout << "  " << (long long)means[p];
+		std::cout << "  " << serialTotal / means[PHASE_TOTAL] << "x  "
+				  << (same ? "same" : "DIFFERS") << std::endl;
+	}
+
+	std::cout << "machine has " << std::thread::hardware_concurrency() << " core(s); "
+			  << failures << " failure(s)" << std::endl;
+	return failures > 0 ? 1 : 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// a scenario ticking at 60 Hz on the simulation thread while this thread
+// draws at 'fps' (interpolating the newest snapshot and building its
+// draws), each side timed on its own; returns 1 if the world that came
+// out differs from the same number of ticks run in lock-step
+static int simThreadRun(const Scenario& sc, unsigned seed, double seconds, double fps)
+{
+	Input input;
+	Driver driver(sc, seed, input);
+	int tick = 0;
+	SimThread sim(driver.world, [&](World& w) {
+		driver.input(tick++);
+		w.tick();
+		driver.endTick();
+	}, SimThread::InputFunction(), 60);
+
+	mat4 Projection = benchProjection();
+	World view;
+	view.reserve(driver.world.num_spheres);
+	DrawList draws;
+	draws.reserve(driver.world.num_spheres + 1024);
+	DrawRecorder drawRecorder;
+	std::vector< double > frames;
+	frames.reserve((size_t)(seconds * fps) + 1);
+
+	// after the first second the frames must not allocate on this thread,
+	// as display() in the game
+	const size_t warmupFrames = (size_t)fps;
+	AllocationCounter steady(NULL, true);
+
+	Clock::duration framePeriod = std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(1.0 / fps));
+	Clock::time_point next = Clock::now();
+	Clock::time_point end = next + std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(seconds));
+
+	sim.start();
+	while (next < end)
+	{
+		Clock::time_point t0 = Clock::now();
+		sim.acquire();
+		interpolateSnapshot(sim.snapshot(), sim.alpha(t0), view);
+		draws.clear();
+		view.recordDraws(drawRecorder, draws, Projection * benchView(view), Projection);
+		frames.push_back(nanoseconds(t0, Clock::now()));
+		if (frames.size() == warmupFrames)
+			steady = AllocationCounter(NULL, true);
+
+		next += framePeriod;
+		std::this_thread::sleep_until(next);
+	}
+	unsigned long long allocations = frames.size() > warmupFrames ? steady.count() : 0;
+	sim.stop();
+
+	Input again;
+	Driver serial(sc, seed, again);
+	for (int t = 0; t < tick; t++)
+	{
+		serial.input(t);
+		serial.world.tick();
+		serial.endTick();
+	}
+	bool same = hashWorld(serial.world) == hashWorld(driver.world);
+
+	const SimTimings& timings = sim.timings();
+	Stats frame = summarize(frames);
+	std::cout << sc.name << " (" << sc.asteroids << " asteroids), " << seconds << " s\n"
+			  << "  simulation: " << timings.ticks << " ticks at 60 Hz, tick "
+			  << timings.tickSum / std::max(1u, timings.ticks) << " ms mean, " << timings.tickMax << " ms max; "
+			  << "late " << timings.lateSum / std::max(1u, timings.ticks) << " ms mean, " << timings.lateMax << " ms max, "
+			  << timings.skipped << " skipped\n"
+			  << "  render:     " << frame.samples << " frames at " << fps << " Hz, interpolate + build draws "
+			  << frame.mean / 1e6 << " ms mean, " << frame.p95 / 1e6 << " ms p95, " << frame.median / 1e6 << " ms median\n"
+			  << "  render thread: " << allocations << " heap allocations after the first " << warmupFrames << " frames\n"
+			  << "  world after " << tick << " ticks " << (same ? "matches" : "DIFFERS FROM") << " the lock-step run" << std::endl;
+	return same && allocations == 0 ? 0 : 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static bool sameDraws(const DrawList& a, const DrawList& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].mesh != b[i].mesh || a[i].index != b[i].index
+			|| memcmp(&a[i].transform, &b[i].transform, sizeof(mat4)) != 0
+			|| memcmp(&a[i].colour, &b[i].colour, sizeof(vec4)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// time building a frame's draws against the number of asteroids: on this
+// thread alone (buildDraws) and recorded by jobs on 1 to maxThreads
+// threads and merged (recordDraws); returns 1 if a recorded list differs
+static int benchDraws(unsigned int maxThreads)
+{
+	static const int counts[] = { 1000, 10000, 100000, 1000000 };
+	mat4 Projection = benchProjection();
+	int failures = 0;
+
+	std::cout << "ms per frame of draws (ns per draw), merged lists checked against buildDraws()\n"
+			  << "asteroids  draws  serial";
+	for (unsigned int t = 1; t <= maxThreads; t++)
+		std::cout << "  " << t << " thread" << (t > 1 ? "s" : "");
+	std::cout << std::endl;
+
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+	{
+		World base;
+		base.num_spheres = counts[c];
+		for (int t = 0; t < 20; t++)
+		{
+			if (t % 2 == 0)
+				base.keyboard(' ');
+			base.tick();
+		}
+		mat4 projView = Projection * benchView(base);
+		int reps = std::max(3, 2000000 / counts[c]);
+
+		World serialWorld = base;
+		DrawList serial;
+		serialWorld.buildDraws(serial, projView, Projection);
+
+		DrawList draws;
+		draws.reserve(serial.size());
+		Clock::time_point t0 = Clock::now();
+		for (int r = 0; r < reps; r++)
+		{
+			draws.clear();
+			serialWorld.buildDraws(draws, projView, Projection);
+		}
+		double serialNs = nanoseconds(t0, Clock::now()) / reps;
+		std::cout << counts[c] << "  " << serial.size() << "  " << serialNs / 1e6
+				  << " (" << serialNs / serial.size() << ")";
+
+		for (unsigned int threads = 1; threads <= maxThreads; threads++)
+		{
+			setJobWorkers(threads - 1);
+			DrawRecorder recorder;
+
+			World recordedWorld = base;
+			draws.clear();
+			recordedWorld.recordDraws(recorder, draws, projView, Projection);
+			bool same = sameDraws(serial, draws);
+			if (!same)
+				failures++;
+
+			Clock::time_point t1 = Clock::now();
+			for (int r = 0; r < reps; r++)
+			{
+				draws.clear();
+				recordedWorld.recordDraws(recorder, draws, projView, Projection);
+			}
+			double ns = nanoseconds(t1, Clock::now()) / reps;
+			std::cout << "  " << ns / 1e6 << " (" << ns / draws.size() << ")" << (same ? "" : " DIFFERS");
+		}
+		std::cout << std::endl;
+	}
+
+	std::cout << "machine has " << std::thread::hardware_concurrency() << " core(s); "
+			  << failures << " failure(s)" << std::endl;
+	return failures > 0 ? 1 : 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// a random agent for every world: turns, thrusts and shoots now and then
+static void randomActions(std::vector< Rng >& agents, std::vector< Action >& actions)
+{
+	for (size_t i = 0; i < actions.size(); i++)
+	{
+		Rng& rng = agents[i];
+		Action& a = actions[i];
+		a.turn = rng.below(3) - 1;
+		a.accelerate = rng.below(8) == 0 ? 1 : 0;
+		a.thrust = rng.below(4) == 0;
+		a.fire = rng.below(3) == 0;
+		a.missileA = rng.below(100) == 0;
+		a.missileB = rng.below(100) == 0;
+	}
+}
+
+// 'worlds' games stepped 'steps' times by random agents, on this thread
+// alone and on every core: aggregate steps per second, and whether the
+// batch stays off the heap; returns 1 if the games differ between them
+static int benchBatch(size_t worlds, int steps, int asteroids, unsigned seed)
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	unsigned int threadCounts[2] = { 1, std::max(2u, cores) };
+	unsigned long long states[2] = { 0, 0 };
+
+	std::cout << worlds << " worlds of " << asteroids << " asteroids, " << steps << " steps" << std::endl;
+	for (int run = 0; run < 2; run++)
+	{
+		setJobWorkers(threadCounts[run] - 1);
+		WorldBatch batch(worlds, asteroids, seed);
+		std::vector< Action > actions(worlds);
+		std::vector< Observation > observations(worlds);
+		std::vector< Rng > agents(worlds);
+		for (size_t i = 0; i < worlds; i++)
+			agents[i].seed(seed + i, RNG_WORKERS);
+
+		// the first steps fill the asteroids up and the job pool's free list
+		const int warmup = std::min(steps - 1, 10);
+		AllocationCounter allocations;
+		double stepNs = 0;
+		for (int s = 0; s < steps; s++)
+		{
+			if (s == warmup)
+				allocations = AllocationCounter();
+			randomActions(agents, actions);
+			Clock::time_point t0 = Clock::now();
+			batch.step(&actions[0], &observations[0]);
+			if (s >= warmup)
+				stepNs += nanoseconds(t0, Clock::now());
+		}
+		unsigned long long allocated = allocations.count();
+
+		unsigned long long state = 0;
+		for (size_t i = 0; i < worlds; i++)
+			state = state * 1099511628211ull ^ hashWorld(batch.world(i));
+		states[run] = state;
+
+		double perSecond = (double)(steps - warmup) * worlds / (stepNs / 1e9);
+		std::cout << threadCounts[run] << " thread" << (threadCounts[run] > 1 ? "s" : " ")
+				  << ": " << perSecond << " world steps/s (" << stepNs / (steps - warmup) / 1e6 << " ms per batch step), "
+				  << batch.episodes() << " episodes finished, "
+				  << allocated << " allocations while stepping" << std::endl;
+	}
+
+	bool same = states[0] == states[1];
+	std::cout << "machine has " << cores << " core(s); the games "
+			  << (same ? "match" : "DIFFER") << " between thread counts" << std::endl;
+	return same ? 0 : 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// replay a recording and check it against every keyframe,
+// returns the tick of the first mismatch or -1 if it all matched
+static int verifyRecording(const Recording& rec)
+{
+	World world;
+	Replayer replayer(rec);
+	replayer.start(world);
+
+	while (true)
+	{
+		if (!replayer.verify(world))
+			return replayer.currentTick();
+		if (replayer.finished())
+			return -1;
+		replayer.tick(world);
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// time n calls of f, returns ns per number
+template < class F >
+static double timeGenerator(F f, int n)
+{
+	volatile float sink = 0;
+	Clock::time_point t0 = Clock::now();
+	for (int i = 0; i < n; i++)
+		sink = sink + f();
+	Clock::time_point t1 = Clock::now();
+	return nanoseconds(t0, t1) / n;
+}
+
+struct LibcRange { float operator()() { return ((260.0f) * (float)rand() / RAND_MAX) - 130.0f; } };
+struct RngRange
+{
+	RngRange() : rng(1, RNG_WORKERS) {}
+	float operator()() { return rng.range(-130.0f, 130.0f); }
+	Rng rng;
+};
+struct LibcInt { float operator()() { return (float)(rand() % 4); } };
+struct RngInt
+{
+	RngInt() : rng(1, RNG_WORKERS) {}
+	float operator()() { return (float)rng.below(4); }
+	Rng rng;
+};
+
+// ns per uniform float: rand() against the streams, one at a time and batched
+static void benchGenerators()
+{
+	const int n = 1 << 24;
+	srand(1);
+
+	double libcRange = timeGenerator(LibcRange(), n);
+	double rngRange = timeGenerator(RngRange(), n);
+	double libcInt = timeGenerator(LibcInt(), n);
+	double rngInt = timeGenerator(RngInt(), n);
+
+	std::vector< float > buffer(4096);
+	Rng rng(1, RNG_WORKERS);
+	volatile float sink = 0;
+	Clock::time_point t0 = Clock::now();
+	for (int i = 0; i < n; i += (int)buffer.size())
+	{
+		rng.fill(&buffer[0], buffer.size(), -130.0f, 130.0f);
+		sink = sink + buffer[i % buffer.size()];
+	}
+	double fill = nanoseconds(t0, Clock::now()) / n;
+
+	std::cout << "ns per number (" << n << " numbers)\n"
+			  << "  float in range   rand(): " << libcRange << "  Rng::range(): " << rngRange
+			  << "  Rng::fill(): " << fill << "\n"
+			  << "  integer 0..3     rand(): " << libcInt << "  Rng::below(): " << rngInt << std::endl;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static void usage()
+{
+	std::cerr <<
+		"usage: bench [options]\n"
+		"  --list               list the scenarios\n"
+		"  --scenario NAME      scenario to run, or 'all' (default: default)\n"
+		"  --asteroids N        override the asteroid count\n"
+		"  --ticks N            override the measured ticks\n"
+		"  --warmup N           override the warm-up ticks\n"
+		"  --bullet-every N     override the bullet rate (0 = none)\n"
+		"  --salvo-every N      override the missile salvo rate (0 = none)\n"
+		"  --seed N             random seed (default: 1)\n"
+		"  --reps N             repetitions of each scenario (default: 5)\n"
+		"  --out FILE           write the JSON report to FILE instead of stdout\n"
+		"  --compare BASELINE   compare against a saved report, exit 1 on regressions\n"
+		"  --current FILE       with --compare, use a saved report instead of running\n"
+		"  --threshold PCT      minimum slowdown to flag (default: 5)\n"
+		"  --record FILE        save the scenario's input as a recording\n"
+		"  --replay FILE        run a recording instead of a scenario\n"
+		"  --verify FILE        replay a recording against its keyframes, exit 1 on a mismatch\n"
+		"  --rng                compare the random number streams with rand()\n"
+		"  --math               check the SIMD vec4/mat4 code against the scalar code,\n"
+		"                       exit 1 if it is off by more than its ULP bound\n"
+		"  --transforms         time the batched transforms from 1K to 10M points,\n"
+		"                       exit 1 if they differ from one point at a time\n"
+		"  --batch N            step N independent games with random agents (--ticks steps,\n"
+		"                       --asteroids each) on one thread and on all cores: steps/s;\n"
+		"                       exit 1 if the games differ\n"
+		"  --draws              time building a frame's draws, 1K to 1M asteroids, alone and\n"
+		"                       recorded by jobs on 1 to 4+ threads; exit 1 if the lists differ\n"
+		"  --telemetry NAME     publish counters to shared memory NAME (like /bench)\n"
+		"  --soak               run the scenario untimed and check the heap stops growing\n"
+		"                       after the warm-up, exit 1 if it does not\n"
+		"  --sim-thread SECS    tick the scenario on its own thread at 60 Hz while drawing at\n"
+		"                       --fps (default: 144), timing both sides; exit 1 if the world\n"
+		"                       differs from a lock-step run\n"
+		"  --jobs N             run the scenario on 1 to N threads (0 = the cores, at least 4),\n"
+		"                       exit 1 if the final world differs from one thread's\n"
+		"DJV_ISA=scalar|sse2|avx2|avx512 in the environment caps the kernels' instruction set\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string scenarioName = "default";
+	int asteroids = -1, ticks = -1, warmup = -1, bulletEvery = -1, salvoEvery = -1;
+	unsigned seed = 1;
+	int reps = 5;
+	std::string outFile, baselineFile, currentFile;
+	std::string recordFile, replayFile, verifyFile;
+	bool soakTest = false;
+	int scaleThreads = -1;
+	int batchWorlds = 0;
+	double simSeconds = 0, fps = 144;
+	double threshold = 0.05;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--list")
+		{
+			for (int s = 0; s < numScenarios; s++)
+				std::cout << scenarios[s].name << "  asteroids " << scenarios[s].asteroids
+						  << ", ticks " << scenarios[s].ticks << std::endl;
+			return 0;
+		}
+		else if (arg == "--rng")
+		{
+			benchGenerators();
+			return 0;
+		}
+		else if (arg == "--math")
+		{
+			return benchMath();
+		}
+		else if (arg == "--transforms")
+		{
+			return benchTransforms();
+		}
+		else if (arg == "--batch" && hasValue) batchWorlds = atoi(argv[++i]);
+		else if (arg == "--draws")
+		{
+			return benchDraws(std::max(4u, std::thread::hardware_concurrency()));
+		}
+		else if (arg == "--scenario" && hasValue) scenarioName = argv[++i];
+		else if (arg == "--asteroids" && hasValue) asteroids = atoi(argv[++i]);
+		else if (arg == "--ticks" && hasValue) ticks = atoi(argv[++i]);
+		else if (arg == "--warmup" && hasValue) warmup = atoi(argv[++i]);
+		else if (arg == "--bullet-every" && hasValue) bulletEvery = atoi(argv[++i]);
+		else if (arg == "--salvo-every" && hasValue) salvoEvery = atoi(argv[++i]);
+		else if (arg == "--seed" && hasValue) seed = (unsigned)strtoul(argv[++i], NULL, 10);
+		else if (arg == "--reps" && hasValue) reps = std::max(1, atoi(argv[++i]));
+		else if (arg == "--out" && hasValue) outFile = argv[++i];
+		else if (arg == "--compare" && hasValue) baselineFile = argv[++i];
+		else if (arg == "--current" && hasValue) currentFile = argv[++i];
+		else if (arg == "--threshold" && hasValue) threshold = atof(argv[++i]) / 100.0;
+		else if (arg == "--record" && hasValue) recordFile = argv[++i];
+		else if (arg == "--replay" && hasValue) replayFile = argv[++i];
+		else if (arg == "--verify" && hasValue) verifyFile = argv[++i];
+		else if (arg == "--soak") soakTest = true;
+		else if (arg == "--sim-thread" && hasValue) simSeconds = atof(argv[++i]);
+		else if (arg == "--fps" && hasValue) fps = std::max(1.0, atof(argv[++i]));
+		else if (arg == "--jobs" && hasValue) scaleThreads = std::max(0, atoi(argv[++i]));
+		else if (arg == "--telemetry" && hasValue)
+		{
+			if (!telemetry.open(argv[++i]))
+			{
+				std::cerr << "cannot open telemetry '" << argv[i] << "'" << std::endl;
+				return 2;
+			}
+		}
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	if (batchWorlds > 0)
+	{
+		return benchBatch(batchWorlds, ticks > 0 ? ticks : 600, asteroids >= 0 ? asteroids : 60, seed);
+	}
+
+	if (!verifyFile.empty())
+	{
+		Recording rec;
+		if (!rec.load(verifyFile))
+		{
+			std::cerr << "cannot read recording '" << verifyFile << "'" << std::endl;
+			return 2;
+		}
+		int mismatch = verifyRecording(rec);
+		if (mismatch >= 0)
+		{
+			std::cout << verifyFile << ": mismatch at tick " << mismatch << std::endl;
+			return 1;
+		}
+		std::cout << verifyFile << ": " << rec.ticks << " ticks, "
+				  << rec.keyframes.size() << " keyframes match" << std::endl;
+		return 0;
+	}
+
+	if (!recordFile.empty() && (scenarioName == "all" || !replayFile.empty()))
+	{
+		std::cerr << "--record needs a single scenario" << std::endl;
+		return 2;
+	}
+
+	if (soakTest && (scenarioName == "all" || !recordFile.empty()))
+	{
+		std::cerr << "--soak needs a single scenario and no --record" << std::endl;
+		return 2;
+	}
+
+	if ((scaleThreads >= 0 || simSeconds > 0) && (scenarioName == "all" || !recordFile.empty() || !replayFile.empty()))
+	{
+		std::cerr << "--jobs and --sim-thread need a single scenario and no --record or --replay" << std::endl;
+		return 2;
+	}
+
+	JsonValue current;
+
+	if (currentFile.empty())
+	{
+		std::vector< RunResult > runs;
+		Recording recorded, replay;
+		Input input;
+		if (!recordFile.empty())
+			input.record = &recorded;
+
+		if (!replayFile.empty())
+		{
+			if (!replay.load(replayFile))
+			{
+				std::cerr << "cannot read recording '" << replayFile << "'" << std::endl;
+				return 2;
+			}
+			input.replay = &replay;
+
+			// the whole recording is the workload, only the warm-up is adjustable
+			Scenario sc = { "replay:" + replayFile, replay.num_spheres, 0, 0, 0, 0 };
+			sc.warmup = std::min((int)replay.ticks - 1, std::max(0, warmup));
+			sc.ticks = replay.ticks - sc.warmup;
+			if (sc.ticks <= 0)
+			{
+				std::cerr << "'" << replayFile << "' is empty" << std::endl;
+				return 2;
+			}
+
+			std::cerr << "replaying " << replayFile << " (" << sc.asteroids << " asteroids, "
+					  << sc.ticks << " ticks)" << std::endl;
+			if (soakTest)
+				return soak(sc, seed, input);
+			runs.push_back(runScenario(sc, seed, reps, input));
+		}
+
+		for (int s = 0; s < numScenarios && replayFile.empty(); s++)
+		{
+			if (scenarioName != "all" && scenarioName != scenarios[s].name)
+				continue;
+
+			Scenario sc = scenarios[s];
+			if (asteroids >= 0) sc.asteroids = asteroids;
+			if (ticks > 0) sc.ticks = ticks;
+			if (warmup >= 0) sc.warmup = warmup;
+			if (bulletEvery >= 0) sc.bulletEvery = bulletEvery;
+			if (salvoEvery >= 0) sc.salvoEvery = salvoEvery;
+
+			std::cerr << "running " << sc.name << " (" << sc.asteroids << " asteroids, "
+					  << sc.ticks << " ticks)" << std::endl;
+			if (soakTest)
+				return soak(sc, seed, input);
+			if (simSeconds > 0)
+				return simThreadRun(sc, seed, simSeconds, fps);
+			if (scaleThreads >= 0)
+			{
+				unsigned int cores = std::thread::hardware_concurrency();
+				return scaleJobs(sc, seed, reps, scaleThreads > 0 ? scaleThreads : std::max(4u, cores));
+			}
+			runs.push_back(runScenario(sc, seed, reps, input));
+		}
+
+		if (runs.empty())
+		{
+			std::cerr << "unknown scenario '" << scenarioName << "', see --list" << std::endl;
+			return 2;
+		}
+
+		if (!recordFile.empty() && !recorded.save(recordFile))
+		{
+			std::cerr << "cannot write recording '" << recordFile << "'" << std::endl;
+			return 2;
+		}
+
+		std::ostringstream report;
+		writeJson(report, runs);
+
+		if (!outFile.empty())
+		{
+			std::ofstream out(outFile.c_str());
+			out << report.str();
+		}
+		else if (baselineFile.empty())
+		{
+			std::cout << report.str();
+		}
+
+		JsonParser parser(report.str());
+		parser.parse(current);
+	}
+	else if (!loadJson(currentFile, current))
+	{
+		return 2;
+	}
+
+	if (!baselineFile.empty())
+	{
+		JsonValue baseline;
+		if (!loadJson(baselineFile, baseline))
+			return 2;
+		return compareReports(baseline, current, threshold) > 0 ? 1 : 0;
+	}
+
+	return 0;
+}
@@ -0,0 +1,601 @@
+#include "bench_math.h"
+
+#include <math.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "affine.h"
+#include "object_transform.h"
+#include "rng.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+typedef std::chrono::steady_clock Clock;
+
+static const int mathInputs = 4096; // small enough to stay in cache
+static const int mathReps = 200;
+
+// how far apart two results are, in units in the last place of 'scale'
+// (the size of the terms they were summed from, so cancellation is fair)
+static double ulps(float a, float b, float scale)
+{
+	if (a == b)
+		return 0;
+	float s = fabsf(scale);
+	float unit = nextafterf(s, HUGE_VALF) - s;
+	return fabs((double)a - (double)b) / unit;
+}
+
+// makes the compiler forget what it knows about memory, so calls are not
+// merged or skipped; the game makes them one at a time as well
+static inline void barrier()
+{
+#if defined(__GNUC__)
+	asm volatile("" : : : "memory");
+#elif defined(_MSC_VER)
+	_ReadWriteBarrier();
+#endif
+}
+
+// ns per call of f(i), over all the inputs a number of times
+template < class F >
+static double timeLoop(F f)
+{
+	Clock::time_point t0 = Clock::now();
+	for (int r = 0; r < mathReps; r++)
+		for (int i = 0; i < mathInputs; i++)
+		{
+			f(i);
+			barrier();
+		}
+	Clock::time_point t1 = Clock::now();
+	return std::chrono::duration< double, std::nano >(t1 - t0).count() / ((double)mathReps * mathInputs);
+}
+
+struct MathResult
+{
+	const char* name;
+	double worst;  // ulps
+	double bound;
+	double simdNs;
+	double scalarNs;
+};
+
+static void printResult(const MathResult& r)
+{
+	std::cout << "  " << std::left << std::setw(14) << r.name << std::right
+			  << std::setw(10) << r.worst << std::setw(8) << r.bound
+			  << std::setw(10) << r.simdNs << std::setw(12) << r.scalarNs
+			  << (r.worst > r.bound ? "   FAILED" : "") << "\n";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the translations and scales are constant expressions now
+static constexpr mat4 translateScale = scalar::multiply(Translate(1,2,3), Scale(2,2,2));
+static_assert(translateScale[0].w == 1 && translateScale[1].y == 2, "Translate * Scale folds");
+
+// the missile draws of World::buildDraws: the whole mat4 chain every
+// time, as it used to be, the same with the constant parts multiplied
+// once, and composed as an affine as it is now
+static void benchChains()
+{
+	Rng rng(2, RNG_WORKERS);
+	std::vector< vec4 > pos(mathInputs);
+	std::vector< float > turn(mathInputs), rot(mathInputs);
+	std::vector< mat4 > body(mathInputs), tip(mathInputs);
+	for (int i = 0; i < mathInputs; i++)
+	{
+		pos[i] = vec4(rng.range(-100.0f, 100.0f), 0, rng.range(-100.0f, 100.0f), 1);
+		turn[i] = rng.range(-30.0f, 30.0f);
+		rot[i] = rng.range(0.0f, 360.0f);
+	}
+	mat4 projView = Perspective(40.0f, 1.0f, 1.0f, 250.0f) *
+					LookAt(vec4(-4.5f, 1.5f, -4.5f, 1), vec4(0, 0, 0, 1), vec4(0, 1, 0, 0));
+
+	double full = timeLoop([&](int i)
+	{
+		mat4 loc = projView * (Translate(pos[i]) * Translate(0,-2,0) * Scale(0.3,0.3,0.3) *
+							   RotateY(rot[i]-45) * RotateX(turn[i]) * RotateZ(90));
+		body[i] = loc * Translate(vec4(0,0,2,1)) * Scale(0.5,1.0,0.5);
+		tip[i] = loc * Translate(vec4(0,-0.5,2,1)) * Scale(0.25,0.25,0.25);
+	});
+
+	static constexpr mat4 shipOffset = scalar::multiply(Translate(0,-2,0), Scale(0.3,0.3,0.3));
+	static constexpr mat4 missileBody = scalar::multiply(Translate(0,0,2), Scale(0.5,1.0,0.5));
+	static constexpr mat4 missileTip = scalar::multiply(Translate(0,-0.5,2), Scale(0.25,0.25,0.25));
+	const mat4 missileTurn = RotateZ(90);
+
+	double folded = timeLoop([&](int i)
+	{
+		mat4 loc = projView * (Translate(pos[i]) * shipOffset * RotateY(rot[i]-45) * RotateX(turn[i]) * missileTurn);
+		body[i] = loc * missileBody;
+		tip[i] = loc * missileTip;
+	});
+
+	const affine affineTurn = affine::rotationZ(90);
+
+	double composed = timeLoop([&](int i)
+	{
+		affine loc = affine::translation(pos[i]).translated(0,-2,0).scaled(0.3).rotatedY(rot[i]-45).rotatedX(turn[i]) * affineTurn;
+		body[i] = projView * loc.translated(0,0,2).scaled(0.5,1.0,0.5);
+		tip[i] = projView * loc.translated(0,-0.5,2).scaled(0.25);
+	});
+
+	// two matrices per missile
+	std::cout << "missile transforms       ns per missile   M matrices/s\n";
+	const char* names[3] = { "whole chain", "folded", "affine" };
+	double times[3] = { full, folded, composed };
+	for (int k = 0; k < 3; k++)
+		std::cout << "  " << std::left << std::setw(14) << names[k] << std::right
+				  << std::setw(19) << times[k] << std::setw(15) << 2000.0 / times[k] << "\n";
+
+	volatile float sink = body[0][0][0] + tip[0][0][0];
+	(void)sink;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+int benchMath()
+{
+	Rng rng(1, RNG_WORKERS);
+	std::vector< mat4 > a(mathInputs), b(mathInputs), outM(mathInputs);
+	std::vector< vec4 > u(mathInputs), v(mathInputs), outV(mathInputs);
+	std::vector< float > outF(mathInputs);
+
+	for (int i = 0; i < mathInputs; i++)
+	{
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+			{
+				a[i][r][c] = rng.range(-10.0f, 10.0f);
+				b[i][r][c] = rng.range(-10.0f, 10.0f);
+			}
+		for (int c = 0; c < 4; c++)
+		{
+			u[i][c] = rng.range(-10.0f, 10.0f);
+			v[i][c] = rng.range(-10.0f, 10.0f);
+		}
+	}
+
+	std::vector< MathResult > results;
+
+	// mat4 * mat4, each element against the magnitude of its four products
+	{
+		MathResult r = { "mat4 * mat4", 0, 0, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+		{
+			mat4 fast = a[i] * b[i], plain = scalar::multiply(a[i], b[i]);
+			for (int row = 0; row < 4; row++)
+				for (int col = 0; col < 4; col++)
+				{
+					float scale = 0;
+					for (int k = 0; k < 4; k++)
+						scale += fabsf(a[i][row][k] * b[i][k][col]);
+					r.worst = std::max(r.worst, ulps(fast[row][col], plain[row][col], scale));
+				}
+		}
+		r.simdNs = timeLoop([&](int i) { outM[i] = a[i] * b[i]; });
+		r.scalarNs = timeLoop([&](int i) { outM[i] = scalar::multiply(a[i], b[i]); });
+		results.push_back(r);
+	}
+
+	// mat4 * vec4
+	{
+		MathResult r = { "mat4 * vec4", 0, 0, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+		{
+			vec4 fast = a[i] * u[i], plain = scalar::multiply(a[i], u[i]);
+			for (int row = 0; row < 4; row++)
+			{
+				float scale = 0;
+				for (int k = 0; k < 4; k++)
+					scale += fabsf(a[i][row][k] * u[i][k]);
+				r.worst = std::max(r.worst, ulps(fast[row], plain[row], scale));
+			}
+		}
+		r.simdNs = timeLoop([&](int i) { outV[i] = a[i] * u[i]; });
+		r.scalarNs = timeLoop([&](int i) { outV[i] = scalar::multiply(a[i], u[i]); });
+		results.push_back(r);
+	}
+
+	// transpose only moves numbers around, it has to be exact
+	{
+		MathResult r = { "transpose", 0, 0, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+		{
+			mat4 fast = transpose(a[i]), plain = scalar::transpose(a[i]);
+			for (int row = 0; row < 4; row++)
+				for (int col = 0; col < 4; col++)
+					r.worst = std::max(r.worst, ulps(fast[row][col], plain[row][col], plain[row][col]));
+		}
+		r.simdNs = timeLoop([&](int i) { outM[i] = transpose(a[i]); });
+		r.scalarNs = timeLoop([&](int i) { outM[i] = scalar::transpose(a[i]); });
+		results.push_back(r);
+	}
+
+	// inverse, against the scalar Laplace expansion: a different method,
+	// so measured against the largest entry, on well conditioned inputs
+	{
+		MathResult r = { "inverse", 0, 8, 0, 0 };
+		std::vector< mat4 > wellConditioned(a);
+		for (int i = 0; i < mathInputs; i++)
+			for (int k = 0; k < 4; k++)
+				wellConditioned[i][k][k] += 40;
+		for (int i = 0; i < mathInputs; i++)
+		{
+			mat4 fast = inverse(wellConditioned[i]), plain = scalar::inverse(wellConditioned[i]);
+			float scale = 0;
+			for (int row = 0; row < 4; row++)
+				for (int col = 0; col < 4; col++)
+					scale = std::max(scale, fabsf(plain[row][col]));
+			for (int row = 0; row < 4; row++)
+				for (int col = 0; col < 4; col++)
+					r.worst = std::max(r.worst, ulps(fast[row][col], plain[row][col], scale));
+		}
+		r.simdNs = timeLoop([&](int i) { outM[i] = inverse(wellConditioned[i]); });
+		r.scalarNs = timeLoop([&](int i) { outM[i] = scalar::inverse(wellConditioned[i]); });
+		results.push_back(r);
+	}
+
+	// the special inverses, each times its matrix against the identity,
+	// measured like a product but never against less than 1, the
+	// identity's own size (float rotations are not quite orthonormal, which
+	// no inverse can fix); their ns against the general scalar one
+	std::vector< mat4 > trs(mathInputs), rt(mathInputs);
+	for (int i = 0; i < mathInputs; i++)
+	{
+		mat4 turn = RotateY(rng.range(0.0f, 360.0f)) * RotateX(rng.range(0.0f, 360.0f));
+		mat4 move = Translate(rng.range(-50.0f, 50.0f), rng.range(-50.0f, 50.0f), rng.range(-50.0f, 50.0f));
+		trs[i] = move * turn * Scale(rng.range(0.25f, 4.0f), rng.range(0.25f, 4.0f), rng.range(0.25f, 4.0f));
+		rt[i] = move * turn * RotateZ(rng.range(0.0f, 360.0f));
+	}
+	auto identityUlps = [](const mat4& inv, const mat4& m)
+	{
+		double worst = 0;
+		mat4 product = scalar::multiply(inv, m);
+		for (int row = 0; row < 4; row++)
+			for (int col = 0; col < 4; col++)
+			{
+				float scale = 0;
+				for (int k = 0; k < 4; k++)
+					scale += fabsf(inv[row][k] * m[k][col]);
+				worst = std::max(worst, ulps(product[row][col], row == col ? 1.0f : 0.0f, std::max(scale, 1.0f)));
+			}
+		return worst;
+	};
+
+	{
+		MathResult r = { "affineInverse", 0, 8, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+			r.worst = std::max(r.worst, identityUlps(affineInverse(trs[i]), trs[i]));
+		r.simdNs = timeLoop([&](int i) { outM[i] = affineInverse(trs[i]); });
+		r.scalarNs = timeLoop([&](int i) { outM[i] = scalar::inverse(trs[i]); });
+		results.push_back(r);
+	}
+
+	{
+		MathResult r = { "rigidInverse", 0, 8, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+			r.worst = std::max(r.worst, identityUlps(rigidInverse(rt[i]), rt[i]));
+		r.simdNs = timeLoop([&](int i) { outM[i] = rigidInverse(rt[i]); });
+		r.scalarNs = timeLoop([&](int i) { outM[i] = scalar::inverse(rt[i]); });
+		results.push_back(r);
+	}
+
+	// the normal matrix, against the transposed upper 3x3 of the scalar
+	// inverse, measured against its largest entry
+	{
+		MathResult r = { "normalMatrix", 0, 8, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+		{
+			mat3 fast = normalMatrix(trs[i]);
+			mat4 plain = scalar::inverse(trs[i]);
+			float scale = 0;
+			for (int row = 0; row < 3; row++)
+				for (int col = 0; col < 3; col++)
+					scale = std::max(scale, fabsf(plain[row][col]));
+			for (int row = 0; row < 3; row++)
+				for (int col = 0; col < 3; col++)
+					r.worst = std::max(r.worst, ulps(fast[row][col], plain[col][row], scale));
+		}
+		std::vector< mat3 > outN(mathInputs);
+		r.simdNs = timeLoop([&](int i) { outN[i] = normalMatrix(trs[i]); });
+		r.scalarNs = timeLoop([&](int i) { outM[i] = scalar::inverse(trs[i]); });
+		results.push_back(r);
+	}
+
+	// dot adds in a different order, allow a few units
+	{
+		MathResult r = { "dot", 0, 4, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+		{
+			float scale = 0;
+			for (int k = 0; k < 4; k++)
+				scale += fabsf(u[i][k] * v[i][k]);
+			r.worst = std::max(r.worst, ulps(dot(u[i], v[i]), scalar::dot(u[i], v[i]), scale));
+		}
+		r.simdNs = timeLoop([&](int i) { outF[i] = dot(u[i], v[i]); });
+		r.scalarNs = timeLoop([&](int i) { outF[i] = scalar::dot(u[i], v[i]); });
+		results.push_back(r);
+	}
+
+	// normalize, against the unit length of the result
+	{
+		MathResult r = { "normalize", 0, 3, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+		{
+			vec4 fast = normalize(u[i]), plain = scalar::normalize(u[i]);
+			for (int k = 0; k < 4; k++)
+				r.worst = std::max(r.worst, ulps(fast[k], plain[k], 1.0f));
+		}
+		r.simdNs = timeLoop([&](int i) { outV[i] = normalize(u[i]); });
+		r.scalarNs = timeLoop([&](int i) { outV[i] = scalar::normalize(u[i]); });
+		results.push_back(r);
+	}
+
+	// cross makes the same products and differences as the scalar code
+	{
+		MathResult r = { "cross", 0, 0, 0, 0 };
+		for (int i = 0; i < mathInputs; i++)
+		{
+			vec4 fast = cross(u[i], v[i]), plain = scalar::cross(u[i], v[i]);
+			for (int k = 0; k < 4; k++)
+				r.worst = std::max(r.worst, ulps(fast[k], plain[k], plain[k]));
+		}
+		r.simdNs = timeLoop([&](int i) { outV[i] = cross(u[i], v[i]); });
+		r.scalarNs = timeLoop([&](int i) { outV[i] = scalar::cross(u[i], v[i]); });
+		results.push_back(r);
+	}
+
+#if defined(DJV_SIMD_AVX)
+	const char* path = "SSE, AVX for mat4 * mat4";
+#elif defined(DJV_SIMD_SSE)
+	const char* path = "SSE";
+#else
+	const char* path = "none, the plain code against itself";
+#endif
+
+	std::cout << "SIMD: " << path << " (" << mathInputs << " random inputs)\n"
+			  << "  operation      max ulps   bound   simd ns   scalar ns\n"
+			  << std::fixed << std::setprecision(2);
+
+	int failed = 0;
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		printResult(results[i]);
+		if (results[i].worst > results[i].bound)
+			failed = 1;
+	}
+
+	// the object cache only works the normal matrix out again for a new model
+	{
+		ObjectTransform object;
+		object.setModel(trs[0]);
+		object.getNormalMatrix();
+		unsigned int first = ObjectTransform::recomputed();
+		object.setModel(trs[0]);
+		object.getNormalMatrix();
+		unsigned int same = ObjectTransform::recomputed();
+		object.setModel(trs[1]);
+		mat3 normal = object.getNormalMatrix(), expected = normalMatrix(trs[1]);
+		unsigned int changed = ObjectTransform::recomputed();
+		bool matches = memcmp(&normal, &expected, sizeof(mat3)) == 0;
+		bool ok = same == first && changed == first + 1 && matches;
+		std::cout << "  normal matrix cache: " << same - first << " recomputed for the same model, "
+				  << changed - same << " for a new one" << (ok ? "" : "   FAILED") << "\n";
+		if (!ok)
+			failed = 1;
+	}
+
+	benchChains();
+	std::cout.unsetf(std::ios::floatfield);
+
+	// keep the timed results alive
+	volatile float sink = outM[0][0][0] + outV[0][0] + outF[0];
+	(void)sink;
+	return failed;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// ns per point of f(n), repeated until about 20M points went through it
+template < class F >
+static double timePoints(size_t n, F f)
+{
+	size_t reps = std::max((size_t)1, (size_t)20000000 / n);
+	Clock::time_point t0 = Clock::now();
+	for (size_t r = 0; r < reps; r++)
+	{
+		f(n);
+		barrier();
+	}
+	Clock::time_point t1 = Clock::now();
+	return std::chrono::duration< double, std::nano >(t1 - t0).count() / ((double)reps * n);
+}
+
+// the collision and cull tests against plain loops over n points,
+// returns 1 if a count or a flag differs
+static int checkTests(const std::vector< vec4 >& points, size_t n)
+{
+	const vec4 centre(10, -5, 20, 1);
+	const GLfloat distance = 60, extent = 70;
+
+	size_t expected = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		GLfloat dx = centre.x - points[i].x, dy = centre.y - points[i].y, dz = centre.z - points[i].z;
+		expected += (std::sqrt(dx*dx + dy*dy + dz*dz) < distance) ? 1 : 0;
+	}
+	size_t count = 0;
+	double within = timePoints(n, [&](size_t k) { count = countWithin(points.data(), k, centre, distance); });
+
+	std::vector< unsigned char > inside(n);
+	double square = timePoints(n, [&](size_t k) { insideSquare(points.data(), k, extent, inside.data()); });
+
+	std::cout << "  countWithin " << within << " ns, insideSquare " << square << " ns per point\n";
+	if (count != expected)
+	{
+		std::cout << "  countWithin found " << count << " of " << expected << " points\n";
+		return 1;
+	}
+	for (size_t i = 0; i < n; i++)
+	{
+		const vec4& p = points[i];
+		unsigned char in = (p.x > extent || p.z > extent || p.x < -extent || p.z < -extent) ? 0 : 1;
+		if (inside[i] != in)
+		{
+			std::cout << "  insideSquare: point " << i << " differs\n";
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// the asteroids' integrate step over n asteroids against a plain loop, and
+// timed against the rotate-every-tick step it replaced; returns 1 if a
+// position, size or flag differs
+static int checkAdvanceGrowing(size_t n)
+{
+	Rng rng(5, RNG_WORKERS);
+	std::vector< vec4 > pos(n), vel(n), dir(n);
+	std::vector< GLfloat > size(n), angle(n), speed(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		pos[i] = vec4(rng.range(-101.0f, 101.0f), -1, rng.range(-101.0f, 101.0f), 0);
+		dir[i] = vec4(1, 0, 0, 0);
+		angle[i] = rng.range(-50.0f, 50.0f);
+		speed[i] = rng.range(0.05f, 0.15f);
+		vel[i] = RotateY(angle[i]) * speed[i] * dir[i];
+		size[i] = (rng.below(4) == 0) ? rng.range(1.0f, 2.0f) : 1;
+	}
+
+	std::vector< vec4 > expectedPos(pos), gotPos(pos);
+	std::vector< GLfloat > expectedSize(size), gotSize(size);
+	std::vector< unsigned char > expectedOut(n), gotOut(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		vec4& p = expectedPos[i];
+		p = vec4(p.x + vel[i].x, p.y + vel[i].y, p.z + vel[i].z, p.w + vel[i].w);
+		if (expectedSize[i] > 1)
+			expectedSize[i] += 0.1;
+		expectedOut[i] = (p.x > 100 || p.z > 100 || p.x < -100 || p.z < -100) ? 1 : 0;
+	}
+	advanceGrowing(gotPos.data(), vel.data(), gotSize.data(), gotOut.data(), n, 100);
+	int failed = 0;
+	for (size_t i = 0; i < n; i++)
+		if (memcmp(&gotPos[i], &expectedPos[i], sizeof(vec4)) != 0 || gotSize[i] != expectedSize[i] ||
+			gotOut[i] != expectedOut[i])
+		{
+			std::cout << "  advanceGrowing: asteroid " << i << " differs\n";
+			failed = 1;
+			break;
+		}
+
+	double fused = timePoints(n, [&](size_t k) { advanceGrowing(gotPos.data(), vel.data(), gotSize.data(), gotOut.data(), k, 100); });
+	double rotated = timePoints(n, [&](size_t k)
+	{
+		advanceRotatedY(pos.data(), dir.data(), angle.data(), speed.data(), k);
+		for (size_t i = 0; i < k; i++)
+			if (size[i] > 1)
+				size[i] += 0.1;
+	});
+	std::cout << "  " << n << " asteroids: advanceGrowing " << fused << " ns, advanceRotatedY and a growth loop "
+			  << rotated << " ns per asteroid\n";
+	return failed;
+}
+
+int benchTransforms()
+{
+	static const size_t maxPoints = 10000000;
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+
+	Rng rng(3, RNG_WORKERS);
+	std::vector< vec4 > in(maxPoints), out(maxPoints), expected(maxPoints);
+	std::vector< GLfloat > x(maxPoints), y(maxPoints), z(maxPoints);
+	std::vector< GLfloat > outX(maxPoints), outY(maxPoints), outZ(maxPoints);
+	for (size_t i = 0; i < maxPoints; i++)
+	{
+		in[i] = vec4(rng.range(-100.0f, 100.0f), rng.range(-100.0f, 100.0f), rng.range(-100.0f, 100.0f), 1);
+		x[i] = in[i].x;
+		y[i] = in[i].y;
+		z[i] = in[i].z;
+	}
+	const mat4 m = Perspective(40.0f, 1.0f, 1.0f, 250.0f) *
+				   LookAt(vec4(-4.5f, 1.5f, -4.5f, 1), vec4(0, 0, 0, 1), vec4(0, 1, 0, 0)) *
+				   Translate(1, 2, 3) * RotateY(30);
+
+	std::cout << std::fixed << std::setprecision(3);
+
+	// every level this machine has, each has to give the bits of one at a time
+	IsaLevel requested = batchIsa();
+	int failed = 0;
+	for (int level = ISA_SCALAR; level <= detectIsa(); level++)
+	{
+		setBatchIsa((IsaLevel)level);
+		std::cout << isaName((IsaLevel)level) << " kernels: points through one mat4 (ns per point, "
+				  << cores << " threads above 64K points)\n"
+				  << "     points     one at a time    batch vec4    batch SoA    threaded vec4\n";
+
+		for (size_t n = 1000; n <= maxPoints; n *= 10)
+		{
+			double single = timePoints(n, [&](size_t count)
+			{
+				for (size_t i = 0; i < count; i++)
+					expected[i] = m * in[i];
+			});
+
+			setBatchThreads(1, 0);
+			double batch = timePoints(n, [&](size_t count) { transform(m, in.data(), out.data(), count); });
+			double soa = timePoints(n, [&](size_t count)
+			{
+				transform(m, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+			});
+
+			for (size_t i = 0; i < n; i++)
+				if (memcmp(&out[i], &expected[i], sizeof(vec4)) != 0 ||
+					outX[i] != expected[i].x || outY[i] != expected[i].y || outZ[i] != expected[i].z)
+				{
+					std::cout << "  " << n << " points: point " << i << " differs from m * v\n";
+					failed = 1;
+					break;
+				}
+
+			setBatchThreads(cores, 0);
+			double threaded = timePoints(n, [&](size_t count) { transform(m, in.data(), out.data(), count); });
+			if (memcmp(out.data(), expected.data(), n * sizeof(vec4)) != 0)
+			{
+				std::cout << "  " << n << " points: the threaded batch differs from m * v\n";
+				failed = 1;
+			}
+
+			std::cout << std::setw(11) << n << std::setw(18) << single << std::setw(14) << batch
+					  << std::setw(13) << soa << std::setw(17) << threaded << "\n";
+		}
+
+		setBatchThreads(1, 0);
+		failed |= checkTests(in, 100003);
+		failed |= checkAdvanceGrowing(1000000);
+		setBatchThreads(cores, 0);
+		failed |= checkAdvanceGrowing(1000000);
+	}
+
+	setBatchIsa(requested);
+	setBatchThreads(cores, 64 * 1024);
+	std::cout.unsetf(std::ios::floatfield);
+	return failed;
+}
+}
@@ -0,0 +1,24 @@
+#ifndef DJV_BENCH_MATH_H_
+#define DJV_BENCH_MATH_H_
+/*
+	Math checks for the benchmark harness
+
+	Runs the vec4/mat4 operations that have SIMD versions over random
+	inputs, measures how far each lands from the plain C++ version in
+	namespace scalar (in ULPs of the magnitudes involved), and times both.
+*/
+
+namespace djv {
+
+// prints a table, returns 1 if an operation went past its ULP bound
+int benchMath();
+
+// times the batched transforms of mat.h from 1K to 10M points against one
+// point at a time and checks the collision and cull tests, at every
+// instruction set level the machine has; returns 1 if anything came out
+// different
+int benchTransforms();
+
+}
+
+#endif
@@ -0,0 +1,33 @@
+#version 430
+
+// Writes new asteroids into their slots before a tick (gpu_asteroids.h)
+
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) writeonly buffer Positions { vec4 positions[]; };
+layout(std430, binding = 1) writeonly buffer Velocities { vec4 velocities[]; };
+layout(std430, binding = 2) writeonly buffer Sizes { float sizes[]; };
+
+struct Spawn
+{
+	vec4 position;
+	vec4 velocity;
+	uint slot;
+	float size;
+};
+
+layout(std430, binding = 5) readonly buffer Spawns { Spawn spawns[]; };
+
+uniform uint count;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= count)
+		return;
+
+	Spawn s = spawns[i];
+	positions[s.slot] = s.position;
+	velocities[s.slot] = s.velocity;
+	sizes[s.slot] = s.size;
+}
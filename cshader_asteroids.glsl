@@ -0,0 +1,87 @@
+#version 430
+
+// One tick of the GPU asteroids (gpu_asteroids.h), an invocation per slot:
+// the rules World applies to its asteroids, the same arithmetic in the same
+// order (the sizes grow in double, as the C++ does), then the slots that
+// left the grid or blew up are emptied and listed
+
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) buffer Positions { vec4 positions[]; };
+layout(std430, binding = 1) readonly buffer Velocities { vec4 velocities[]; };
+layout(std430, binding = 2) buffer Sizes { float sizes[]; };
+layout(std430, binding = 3) readonly buffer Bullets { vec4 bullets[]; };
+
+// the hits (slot, bullets) from reports[0], the despawns from reports[2 * maxHits]
+layout(std430, binding = 4) buffer Reports
+{
+	uint hitCount;
+	uint despawnCount;
+	uint reports[];
+};
+
+uniform uint count;
+uniform float grid;
+uniform uint numBullets;
+uniform vec4 explosions[2];
+uniform uint numExplosions;
+uniform uint maxHits;
+uniform uint maxDespawns;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= count || !(sizes[i] > 0.0))
+		return;
+
+	// integrate, as advanceGrowing (mat.h); the shot ones keep growing
+	vec4 p = positions[i] + velocities[i];
+	positions[i] = p;
+	float size = sizes[i];
+	if (size > 1.0)
+		size = float(double(size) + 0.1lf);
+	bool outside = p.x > grid || p.z > grid || p.x < -grid || p.z < -grid;
+
+	// within 15 of an explosion, measured in x-z as vec_length (world.h)
+	for (uint k = 0u; k < numExplosions; k++)
+	{
+		precise vec4 d = p - explosions[k];
+		precise float dd = d.x * d.x + d.z * d.z;
+		if (sqrt(dd) < 15.0)
+			size = float(double(size) + 0.1lf);
+	}
+
+	// bullets within 1.8, as countWithin (mat.h)
+	uint hits = 0u;
+	for (uint k = 0u; k < numBullets; k++)
+	{
+		precise vec4 d = p - bullets[k];
+		precise float dd = d.x * d.x + d.y * d.y + d.z * d.z;
+		if (sqrt(dd) < 1.8)
+			hits++;
+	}
+	for (uint k = 0u; k < hits; k++)
+		size = float(double(size) + 0.05lf);
+
+	if (hits > 0u)
+	{
+		uint h = atomicAdd(hitCount, 1u);
+		if (h < maxHits)
+		{
+			reports[2u * h] = i;
+			reports[2u * h + 1u] = hits;
+		}
+	}
+
+	// a slot only empties once it is on the list, so none is ever lost
+	if (outside || size > 2.0)
+	{
+		uint d = atomicAdd(despawnCount, 1u);
+		if (d < maxDespawns)
+		{
+			reports[2u * maxHits + d] = i;
+			size = 0.0;
+		}
+	}
+	sizes[i] = size;
+}
@@ -0,0 +1,59 @@
+#version 430
+
+// Frustum culls the scene's objects (gpu_scene.h): each one whose bounding
+// sphere is not wholly behind one of the planes is counted into its mesh's
+// draw command and listed where that command's instances are read from.
+// Far enough from the eye, the impostor mesh's go to the command after the
+// meshes' instead
+
+layout(local_size_x = 256) in;
+
+struct SceneObject
+{
+	mat4 model;
+	vec4 colour;
+	uint mesh;
+};
+
+layout(std430, row_major, binding = 3) readonly buffer Objects { SceneObject objects[]; };
+layout(std430, binding = 4) buffer Commands { uint commands[]; }; // 5 words a mesh
+layout(std430, binding = 5) writeonly buffer Visible { uint visible[]; };
+
+uniform uint count;
+uniform vec4 planes[6];  // pointing in, normalized
+uniform vec4 bounds[16]; // per mesh: centre, radius
+uniform uint numMeshes;
+uniform uint capacity;   // objects listed per mesh
+uniform uint impostorMesh; // 0xFFFFFFFF for none
+uniform float impostorDistance;
+uniform vec3 eye;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= count)
+		return;
+
+	uint mesh = objects[i].mesh;
+	if (mesh >= numMeshes)
+		return;
+
+	// the sphere goes where the model puts it, as big as its longest axis
+	mat4 model = objects[i].model;
+	vec4 b = bounds[mesh];
+	vec3 centre = (model * vec4(b.xyz, 1.0)).xyz;
+	float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+	float radius = b.w * scale;
+	for (int p = 0; p < 6; p++)
+	{
+		if (dot(planes[p].xyz, centre) + planes[p].w < -radius)
+			return;
+	}
+
+	uint command = mesh;
+	if (mesh == impostorMesh && distance(centre, eye) > impostorDistance)
+		command = numMeshes;
+
+	uint n = atomicAdd(commands[command * 5u + 1u], 1u);
+	visible[command * capacity + n] = i;
+}
@@ -0,0 +1,42 @@
+#version 430
+
+// The scene objects (gpu_scene.h) for a field of GPU asteroids
+// (gpu_asteroids.h), one per slot, placed as vshader_asteroids.glsl does
+
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) readonly buffer Positions { vec4 positions[]; };
+layout(std430, binding = 1) readonly buffer Velocities { vec4 velocities[]; };
+layout(std430, binding = 2) readonly buffer Sizes { float sizes[]; };
+
+struct SceneObject
+{
+	mat4 model;
+	vec4 colour;
+	uint mesh;
+};
+
+layout(std430, row_major, binding = 3) writeonly buffer Objects { SceneObject objects[]; };
+
+uniform uint count;
+uniform uint first;
+uniform uint mesh;
+uniform vec4 colour;
+uniform float back; // alpha - 1
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= count)
+		return;
+
+	// empty slots have size 0 and are left out
+	float s = sizes[i];
+	vec3 centre = positions[i].xyz + velocities[i].xyz * back;
+
+	SceneObject o;
+	o.model = mat4(vec4(s, 0.0, 0.0, 0.0), vec4(0.0, 0.5 * s, 0.0, 0.0), vec4(0.0, 0.0, s, 0.0), vec4(centre, 1.0));
+	o.colour = colour;
+	o.mesh = s > 0.0 ? mesh : 0xFFFFFFFFu;
+	objects[first + i] = o;
+}
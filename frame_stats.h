@@ -0,0 +1,88 @@
+#ifndef DJV_FRAME_STATS_H_
+#define DJV_FRAME_STATS_H_
+/*
+	Per frame performance samples
+
+	A fixed size ring of the last few seconds of frames, written once
+	per frame and read by the performance overlay. Nothing is allocated
+	after construction.
+*/
+
+#include <stddef.h>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// what one frame cost and what it drew
+struct FrameSample
+{
+	float frameMs;   // from the start of the previous frame to the start of this one
+	float simMs;     // the newest world tick (on the simulation thread)
+	float simLateMs; // how late that tick started against the fixed rate
+	float renderMs;  // interpolating, building and submitting the draws (CPU side)
+
+	int asteroids;
+	int bullets;
+	int drawCalls;
+	unsigned int collisionTests; // of the tick first drawn in this frame, else 0
+	size_t bufferBytes; // GL buffer memory alive
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class FrameHistory
+{
+public:
+	static const int capacity = 120;
+
+	FrameHistory() : next(0), count(0) {}
+
+	void push(const FrameSample& s)
+	{
+		samples[next] = s;
+		next = (next + 1) % capacity;
+		if (count < capacity)
+			count++;
+	}
+
+	int size() const { return count; }
+
+	// 0 is the oldest sample kept, size() - 1 the latest
+	const FrameSample& operator[](int i) const
+	{
+		return samples[(next - count + i + capacity) % capacity];
+	}
+
+	const FrameSample& latest() const { return (*this)[count - 1]; }
+
+	// mean of the times over the kept samples
+	FrameSample average() const
+	{
+		FrameSample a = FrameSample();
+		for (int i = 0; i < count; i++)
+		{
+			a.frameMs += samples[i].frameMs;
+			a.simMs += samples[i].simMs;
+			a.simLateMs += samples[i].simLateMs;
+			a.renderMs += samples[i].renderMs;
+		}
+		if (count > 0)
+		{
+			a.frameMs /= count;
+			a.simMs /= count;
+			a.simLateMs /= count;
+			a.renderMs /= count;
+		}
+		return a;
+	}
+
+private:
+	FrameSample samples[capacity];
+	int next;
+	int count;
+};
+
+}
+
+#endif
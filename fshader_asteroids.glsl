@@ -0,0 +1,9 @@
+#version 330
+
+in vec4 v_Colour;
+out vec4 out_Colour;
+
+void main()
+{
+	out_Colour = v_Colour;
+}
@@ -0,0 +1,81 @@
+#version 120
+
+// The background's pixels (background.h): stars on three planes above and
+// below the play area at different heights, the nearer ones sliding faster
+// as the camera moves, and the grid's lines on a plane of their own. Every
+// plane is endless, and each pixel costs the same: a ray-plane hit and one
+// cell each.
+
+uniform vec4 starColour;
+uniform vec4 gridColour; // alpha 0 for no grid
+uniform float gridHeight;
+uniform float gridSpacing;
+
+varying vec4 v_Near;
+varying vec4 v_Far;
+
+// a number in 0..1 for a cell, always the same for the same cell
+float hash(vec2 cell)
+{
+	return fract(sin(dot(cell, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+// where the ray meets the plane y = height, scaled to cells of 'size';
+// 'ahead' is 0 if the plane is behind the ray
+vec2 onPlane(vec3 origin, vec3 direction, float height, float size, out float ahead)
+{
+	float t = (height - origin.y) / direction.y;
+	ahead = step(0.0, t);
+	return (origin.xz + t * direction.xz) / size;
+}
+
+// how bright the star in the pixel's cell is here, one cell in 'density'
+// has one; they fade out as the cells shrink towards a pixel, rather than
+// flicker
+float stars(vec3 origin, vec3 direction, float height, float size, float density)
+{
+	float ahead;
+	vec2 uv = onPlane(origin, direction, height, size, ahead);
+	vec2 pixel = max(fwidth(uv), vec2(1e-6));
+	vec2 cell = floor(uv);
+
+	float present = step(1.0 - density, hash(cell));
+	vec2 star = cell + 0.25 + 0.5 * vec2(hash(cell + 17.0), hash(cell + 31.0));
+	float light = clamp(1.5 - length((uv - star) / pixel), 0.0, 1.0);
+	float fade = clamp(2.0 - 8.0 * max(pixel.x, pixel.y), 0.0, 1.0);
+	return ahead * present * light * fade * (0.4 + 0.6 * hash(cell + 53.0));
+}
+
+// how much of a grid line the pixel covers, fading with the lines'
+// density on screen
+float grid(vec3 origin, vec3 direction)
+{
+	float ahead;
+	vec2 uv = onPlane(origin, direction, gridHeight, gridSpacing, ahead);
+	vec2 pixel = max(fwidth(uv), vec2(1e-6));
+	vec2 lines = abs(fract(uv - 0.5) - 0.5) / pixel;
+	float fade = clamp(1.0 - 4.0 * max(pixel.x, pixel.y), 0.0, 1.0);
+	return ahead * fade * (1.0 - min(min(lines.x, lines.y), 1.0));
+}
+
+void main()
+{
+	vec3 origin = v_Near.xyz / v_Near.w;
+	vec3 direction = v_Far.xyz / v_Far.w - origin;
+
+	// never exactly level, the planes are met far away instead
+	direction.y = direction.y < 0.0 ? min(direction.y, -1e-6) : max(direction.y, 1e-6);
+
+	// the layer on the side the ray goes to, near to far
+	float side = sign(direction.y);
+	float s = stars(origin, direction, 60.0 * side, 4.0, 0.25)
+		+ stars(origin, direction, 150.0 * side, 10.0, 0.25)
+		+ stars(origin, direction, 400.0 * side, 25.0, 0.25);
+	float g = grid(origin, direction) * gridColour.a;
+
+	float a = clamp(max(s, g), 0.0, 1.0);
+	if (a <= 0.0)
+		discard;
+	vec3 colour = (starColour.rgb * s + gridColour.rgb * g) / (s + g);
+	gl_FragColor = vec4(colour, a * starColour.a);
+}
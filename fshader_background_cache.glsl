@@ -0,0 +1,25 @@
+#version 120
+
+// The background through its cache (background.h): each pixel's view
+// direction, as a point at infinity, projected with the view the cache was
+// drawn with, and the texture read there. The cache holds colour times
+// coverage, undone here for the usual blending.
+
+uniform mat4 cacheProjView;
+uniform sampler2D cache;
+
+varying vec4 v_Near;
+varying vec4 v_Far;
+
+void main()
+{
+	vec3 direction = v_Far.xyz / v_Far.w - v_Near.xyz / v_Near.w;
+	vec4 clip = cacheProjView * vec4(direction, 0.0);
+	if (clip.w <= 0.0)
+		discard;
+
+	vec4 texel = texture2D(cache, clip.xy / clip.w * 0.5 + 0.5);
+	if (texel.a < 1.0 / 255.0)
+		discard;
+	gl_FragColor = vec4(min(texel.rgb / texel.a, vec3(1.0)), texel.a);
+}
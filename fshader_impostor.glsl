@@ -0,0 +1,30 @@
+#version 430
+
+// An impostor's pixel (gpu_scene.h): where the ray from the eye first
+// meets the unit sphere in object space, at that point's own depth
+
+uniform mat4 projView;
+uniform vec3 eye;
+
+in vec3 v_World;
+in vec3 v_Direction;
+flat in vec3 v_Origin;
+flat in vec4 v_Colour;
+
+out vec4 out_Colour;
+
+void main()
+{
+	// |origin + t direction| = 1, the nearer root
+	float a = dot(v_Direction, v_Direction);
+	float b = dot(v_Origin, v_Direction);
+	float c = dot(v_Origin, v_Origin) - 1.0;
+	float disc = b * b - a * c;
+	if (disc < 0.0)
+		discard;
+	float t = (-b - sqrt(disc)) / a;
+
+	vec4 clip = projView * vec4(eye + t * (v_World - eye), 1.0);
+	gl_FragDepth = 0.5 * (gl_DepthRange.diff * (clip.z / clip.w) + gl_DepthRange.near + gl_DepthRange.far);
+	out_Colour = v_Colour;
+}
@@ -11,7 +11,26 @@
 */
 
 // Include OpenGL header files 
-#ifdef __APPLE__  // include Mac OS X versions of headers
+#if defined(DJV_HEADLESS) // no window or GL context (benchmarks, soak runs)
+   // only the GL scalar types are needed by the math and game code
+   typedef float          GLfloat;
+   typedef double         GLdouble;
+   typedef int            GLint;
+   typedef unsigned int   GLuint;
+   typedef unsigned int   GLenum;
+   typedef int            GLsizei;
+   typedef unsigned char  GLubyte;
+   typedef unsigned short GLushort;
+   typedef unsigned char  GLboolean;
+   typedef char           GLchar;
+   typedef void           GLvoid;
+#elif defined(DJV_EGL) // a GL context from EGL without a window (gpu_check)
+   // GL 4.3 entry points straight from libOpenGL, no GLEW or GLUT
+#  define GL_GLEXT_PROTOTYPES 1
+#  include <GL/gl.h>
+#  include <GL/glext.h>
+#  include <GL/glu.h>
+#elif defined(__APPLE__)  // include Mac OS X versions of headers
 #  include <OpenGL/OpenGL.h>
 #  include <GLUT/glut.h>
 #else // non-Mac OS X operating systems
@@ -32,6 +32,7 @@
 */
 
 #include "gl_utilities.h"
+#include "rng.h"
 
 namespace djv {
 
@@ -39,9 +40,16 @@ namespace djv {
 	
 // returns a random float number between max and min
 // negative values are permitted, as long as min < max
+static Rng randRangeStream(1, RNG_MESHES);
+
 float randRange(float min, float max)
 {
-	return ((max - min) * (float)rand()/RAND_MAX) + min;
+	return randRangeStream.range(min, max);
+}
+
+void randRangeSeed(unsigned long long seed)
+{
+	randRangeStream.seed(seed, RNG_MESHES);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -125,6 +133,8 @@ vec4 hsv2rgb(float hue, float sat, float val, float alpha)
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+#ifndef DJV_HEADLESS
+
 // Create a NULL-terminated string by reading the provided file
 // Note: this seems to expect a unix text file
 static char* readShaderSource(const char* shaderFile)
@@ -149,65 +159,52 @@ static char* readShaderSource(const char* shaderFile)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 
-// Create a GLSL program object from vertex and fragment shader files
-GLuint loadAndInitializeShaders(const char* vShaderFile, const char* fShaderFile)
+// Compile one shader stage from a file, exits if it does not compile
+static GLuint compileShaderFile(const char* filename, GLenum type)
 {
-	struct Shader {
-			const char*  filename;
-			GLenum       type;
-			GLchar*      source;
-		};  
-		
-	Shader shaders[2] = {
-			{ vShaderFile, GL_VERTEX_SHADER, NULL },
-			{ fShaderFile, GL_FRAGMENT_SHADER, NULL }
-		};
-
-	GLuint program = glCreateProgram();
-
-
-	for ( int i = 0; i < 2; ++i ) {
-		Shader& s = shaders[i];
-
-		std::cout << "loading shader '" << s.filename << "'" << std::endl;
+	std::cout << "loading shader '" << filename << "'" << std::endl;
 
-		s.source = readShaderSource( s.filename );
-		if ( shaders[i].source == NULL ) {
-			std::cerr << "Failed to read " << s.filename << std::endl;
-			exit( EXIT_FAILURE );
-		}
+	GLchar* source = readShaderSource( filename );
+	if ( source == NULL ) {
+		std::cerr << "Failed to read " << filename << std::endl;
+		exit( EXIT_FAILURE );
+	}
 
-		// output the shader
-		std::cout << std::endl;
-		std::cout << s.source << std::endl;
-		std::cout << std::endl;
+	// output the shader
+	std::cout << std::endl;
+	std::cout << source << std::endl;
+	std::cout << std::endl;
 
-		GLuint shader = glCreateShader( s.type );
-		glShaderSource( shader, 1, (const GLchar**) &s.source, NULL );
+	GLuint shader = glCreateShader( type );
+	glShaderSource( shader, 1, (const GLchar**) &source, NULL );
 
-		std::cout << "compiling shader" << std::endl;
+	std::cout << "compiling shader" << std::endl;
 
-		glCompileShader( shader );
+	glCompileShader( shader );
 
-		GLint  compiled;
-		glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
-		if ( !compiled ) {
-			std::cerr << s.filename << " failed to compile:" << std::endl;
-			GLint  logSize;
-			glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logSize );
-			char* logMsg = new char[logSize];
-			glGetShaderInfoLog( shader, logSize, NULL, logMsg );
-			std::cerr << logMsg << std::endl;
-			delete [] logMsg;
+	GLint  compiled;
+	glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+	if ( !compiled ) {
+		std::cerr << filename << " failed to compile:" << std::endl;
+		GLint  logSize;
+		glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logSize );
+		char* logMsg = new char[logSize];
+		glGetShaderInfoLog( shader, logSize, NULL, logMsg );
+		std::cerr << logMsg << std::endl;
+		delete [] logMsg;
 
-			exit( EXIT_FAILURE );
-		}
+		exit( EXIT_FAILURE );
+	}
 
-		delete [] s.source;
+	delete [] source;
+	return shader;
+}
 
-		glAttachShader( program, shader );
-	}
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+// Link the attached shaders, exits if they do not link
+static void linkProgram(GLuint program)
+{
 	/* link  and error check */
 	std::cout << "linking shaders" << std::endl;
 	glLinkProgram(program);
@@ -225,10 +222,33 @@ GLuint loadAndInitializeShaders(const char* vShaderFile, const char* fShaderFile
 
 		exit( EXIT_FAILURE );
 	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Create a GLSL program object from vertex and fragment shader files
+GLuint loadAndInitializeShaders(const char* vShaderFile, const char* fShaderFile)
+{
+	GLuint program = glCreateProgram();
+	glAttachShader( program, compileShaderFile( vShaderFile, GL_VERTEX_SHADER ) );
+	glAttachShader( program, compileShaderFile( fShaderFile, GL_FRAGMENT_SHADER ) );
+	linkProgram( program );
+	return program;
+}
 
+#ifdef GL_COMPUTE_SHADER
+
+// Create a GLSL program object from a compute shader file
+GLuint loadComputeShader(const char* cShaderFile)
+{
+	GLuint program = glCreateProgram();
+	glAttachShader( program, compileShaderFile( cShaderFile, GL_COMPUTE_SHADER ) );
+	linkProgram( program );
 	return program;
 }
 
+#endif
+
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
@@ -267,7 +287,60 @@ int glGetUniformLocationHelper(GLuint program, char* name, bool exitOnError)
 	return loc;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static unsigned long long bytesUploaded = 0;
+
+ResourceTracker& glBuffers()
+{
+	static ResourceTracker tracker;
+	return tracker;
+}
+
+GLuint trackedGenBuffer(const char* owner)
+{
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBuffers().created(buffer, owner);
+	return buffer;
+}
+
+void trackedBufferData(GLenum target, GLuint buffer, GLsizeiptr size, const GLvoid* data, GLenum usage)
+{
+	glBufferData(target, size, data, usage);
+
+	glBuffers().resized(buffer, size);
+	if (data)
+		bytesUploaded += size;
+}
+
+void trackedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data)
+{
+	glBufferSubData(target, offset, size, data);
+	bytesUploaded += size;
+}
+
+void trackedDeleteBuffer(GLuint buffer)
+{
+	glBuffers().destroyed(buffer);
+	glDeleteBuffers(1, &buffer);
+}
+
+size_t trackedBufferBytes()
+{
+	return glBuffers().liveBytes();
+}
+
+int trackedBufferCount()
+{
+	return glBuffers().liveCount();
+}
 
+unsigned long long trackedBytesUploaded()
+{
+	return bytesUploaded;
+}
 
+#endif // DJV_HEADLESS
 
 }
\ No newline at end of file
@@ -43,6 +43,7 @@
 
 
 #include "vec.h"
+#include "memory_tracker.h"
 
 
 // Define a helpful macro for handling offsets into buffer objects
@@ -61,8 +62,13 @@ const GLfloat  DivideByZeroTolerance = GLfloat(1.0e-07);
 
 // returns a random float number between max and min
 // negative values are permitted, as long as min < max
+// (draws from its own RNG_MESHES stream, not thread safe; threads and
+//  subsystems that need their own numbers should own an Rng)
 float randRange(float min = 0, float max = 1.0);
 
+// restart the randRange() stream
+void randRangeSeed(unsigned long long seed);
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 // convert an HSV (Hue, Saturation, and Value) colour to vec3 RGB 
@@ -80,8 +86,17 @@ inline float clamp(float val, float min, float max)
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+// everything below needs a GL context
+#ifndef DJV_HEADLESS
+
 GLuint loadAndInitializeShaders(const char* vShaderFile, const char* fShaderFile);
 
+// a program from one compute shader file (needs a GL 4.3 context; the
+// headers of older GL versions, such as Mac OS X's, leave it out)
+#ifdef GL_COMPUTE_SHADER
+GLuint loadComputeShader(const char* cShaderFile);
+#endif
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 // get attribute location with an error check
@@ -151,6 +166,37 @@ static void checkGlError(const char* msg)
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+// glGenBuffers for one buffer, recorded with an owner tag (a string literal)
+// and the frame it was made in
+GLuint trackedGenBuffer(const char* owner);
+
+// glBufferData on the buffer bound to 'target' (which must be 'buffer'),
+// remembering its size so the GL buffer memory in use can be reported
+void trackedBufferData(GLenum target, GLuint buffer, GLsizeiptr size, const GLvoid* data, GLenum usage);
+
+// glBufferSubData, counted in the bytes uploaded
+void trackedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data);
+
+// glDeleteBuffers for one buffer, forgetting its size
+void trackedDeleteBuffer(GLuint buffer);
+
+// bytes held by, and number of, the buffers created through the above
+size_t trackedBufferBytes();
+int trackedBufferCount();
+
+// every live buffer (owners, sizes, creation frames); call
+// glBuffers().advanceFrame() once per frame to stamp new ones
+ResourceTracker& glBuffers();
+
+// bytes sent to buffers through the above since the start
+unsigned long long trackedBytesUploaded();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif // DJV_HEADLESS
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,438 @@
+#include "gpu_asteroids.h"
+
+#ifdef GL_COMPUTE_SHADER
+
+#include <algorithm>
+
+#include "gl_utilities.h"
+#include "meshes.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// invocations per work group, as the shaders declare them
+static const GLuint tickGroup = 256;
+static const GLuint spawnGroup = 64;
+
+// the buffer bindings the shaders declare
+enum
+{
+	BIND_POSITIONS,
+	BIND_VELOCITIES,
+	BIND_SIZES,
+	BIND_BULLETS,
+	BIND_REPORTS,
+	BIND_SPAWNS
+};
+
+// how long a blocking wait for a fence waits at a time
+static const GLuint64 fenceTimeout = 1000000000ull;
+
+static GLuint groups(size_t n, GLuint group)
+{
+	return (GLuint)((n + group - 1) / group);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+GpuAsteroids::GpuAsteroids()
+	: numSlots(0), numLive(0), maxDespawns(0), reportBytes(0), grid(100), tickCount(0)
+	, tickProgram(0), spawnProgram(0), drawProgram(0), vao(0)
+	, positionBuffer(0), velocityBuffer(0), sizeBuffer(0)
+	, bulletBuffer(0), reportBuffer(0), spawnBuffer(0), bulletCapacity(0)
+	, oldest(0), inFlight(0), finishedHead(0), finishedCount(0)
+{
+	for (int i = 0; i < numReadbacks; i++)
+	{
+		readbacks[i].buffer = 0;
+		readbacks[i].fence = 0;
+		readbacks[i].tick = 0;
+	}
+}
+
+GpuAsteroids::~GpuAsteroids()
+{
+	release();
+}
+
+bool GpuAsteroids::supported()
+{
+	// both stay 0 in contexts older than 3.0, which do not know the names
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	while (glGetError() != GL_NO_ERROR)
+		;
+	return major > 4 || (major == 4 && minor >= 3);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static GLuint storageBuffer(const char* owner, size_t bytes, GLenum usage)
+{
+	GLuint buffer = trackedGenBuffer(owner);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	trackedBufferData(GL_SHADER_STORAGE_BUFFER, buffer, bytes, NULL, usage);
+	return buffer;
+}
+
+void GpuAsteroids::init(size_t capacity, float grid, size_t maxDespawns)
+{
+	release();
+	numSlots = capacity;
+	numLive = 0;
+
+	// the report buffer: the two counts, the hits (two each), then the despawns
+	this->maxDespawns = (maxDespawns == 0 || maxDespawns > capacity) ? capacity : maxDespawns;
+	reportBytes = (2 + 2 * maxHits + this->maxDespawns) * sizeof(GLuint);
+	this->grid = grid;
+	tickCount = 0;
+
+	tickProgram = loadComputeShader("cshader_asteroids.glsl");
+	tickCount_loc = glGetUniformLocation(tickProgram, "count");
+	tickGrid_loc = glGetUniformLocation(tickProgram, "grid");
+	tickBullets_loc = glGetUniformLocation(tickProgram, "numBullets");
+	tickExplosions_loc = glGetUniformLocation(tickProgram, "explosions");
+	tickExplosionCount_loc = glGetUniformLocation(tickProgram, "numExplosions");
+	tickMaxHits_loc = glGetUniformLocation(tickProgram, "maxHits");
+	tickMaxDespawns_loc = glGetUniformLocation(tickProgram, "maxDespawns");
+
+	spawnProgram = loadComputeShader("cshader_asteroid_spawn.glsl");
+	spawnCount_loc = glGetUniformLocation(spawnProgram, "count");
+
+	drawProgram = loadAndInitializeShaders("vshader_asteroids.glsl", "fshader_asteroids.glsl");
+	drawProjView_loc = glGetUniformLocation(drawProgram, "projView");
+	drawColour_loc = glGetUniformLocation(drawProgram, "in_Colour");
+	drawBack_loc = glGetUniformLocation(drawProgram, "back");
+	drawPosition_loc = glGetAttribLocation(drawProgram, "in_Position");
+	drawCentre_loc = glGetAttribLocation(drawProgram, "in_Centre");
+	drawVelocity_loc = glGetAttribLocation(drawProgram, "in_Velocity");
+	drawSize_loc = glGetAttribLocation(drawProgram, "in_Size");
+
+	// every slot starts empty (size 0)
+	positionBuffer = storageBuffer("GpuAsteroids positions", numSlots * sizeof(vec4), GL_DYNAMIC_DRAW);
+	velocityBuffer = storageBuffer("GpuAsteroids velocities", numSlots * sizeof(vec4), GL_DYNAMIC_DRAW);
+	sizeBuffer = storageBuffer("GpuAsteroids sizes", numSlots * sizeof(GLfloat), GL_DYNAMIC_DRAW);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, NULL);
+
+	bulletCapacity = 128;
+	bulletBuffer = storageBuffer("GpuAsteroids bullets", bulletCapacity * sizeof(vec4), GL_STREAM_DRAW);
+	reportBuffer = storageBuffer("GpuAsteroids reports", reportBytes, GL_DYNAMIC_COPY);
+	spawnBuffer = storageBuffer("GpuAsteroids spawns", spawnChunk * sizeof(Spawn), GL_STREAM_DRAW);
+	for (int i = 0; i < numReadbacks; i++)
+	{
+		readbacks[i].buffer = trackedGenBuffer("GpuAsteroids readback");
+		glBindBuffer(GL_COPY_WRITE_BUFFER, readbacks[i].buffer);
+		trackedBufferData(GL_COPY_WRITE_BUFFER, readbacks[i].buffer, reportBytes, NULL, GL_STREAM_READ);
+		readbacks[i].fence = 0;
+	}
+	oldest = 0;
+	inFlight = 0;
+
+	// the instances read the simulation's own buffers, a slot each; the
+	// sphere's vertices are pointed at when drawing
+	GLint previous = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glEnableVertexAttribArray(drawPosition_loc);
+	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+	glVertexAttribPointer(drawCentre_loc, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), BUFFER_OFFSET(0));
+	glVertexAttribDivisor(drawCentre_loc, 1);
+	glEnableVertexAttribArray(drawCentre_loc);
+	glBindBuffer(GL_ARRAY_BUFFER, velocityBuffer);
+	glVertexAttribPointer(drawVelocity_loc, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), BUFFER_OFFSET(0));
+	glVertexAttribDivisor(drawVelocity_loc, 1);
+	glEnableVertexAttribArray(drawVelocity_loc);
+	glBindBuffer(GL_ARRAY_BUFFER, sizeBuffer);
+	glVertexAttribPointer(drawSize_loc, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), BUFFER_OFFSET(0));
+	glVertexAttribDivisor(drawSize_loc, 1);
+	glEnableVertexAttribArray(drawSize_loc);
+	glBindVertexArray(previous);
+
+	// the first spawns take the lowest slots. The reports keep their
+	// memory from tick to tick, so they only grow past the busiest tick yet
+	freeSlots.resize(numSlots);
+	for (size_t i = 0; i < numSlots; i++)
+		freeSlots[i] = (unsigned int)(numSlots - 1 - i);
+	pending.reserve(spawnChunk);
+
+	finished.resize(numReadbacks + 1);
+	for (size_t i = 0; i < finished.size(); i++)
+	{
+		finished[i].hits.reserve(maxHits);
+		finished[i].despawns.reserve(std::min(this->maxDespawns, (size_t)spawnChunk));
+	}
+	finishedHead = 0;
+	finishedCount = 0;
+}
+
+void GpuAsteroids::release()
+{
+	for (int i = 0; i < numReadbacks; i++)
+	{
+		if (readbacks[i].fence)
+			glDeleteSync(readbacks[i].fence);
+		if (readbacks[i].buffer)
+			trackedDeleteBuffer(readbacks[i].buffer);
+		readbacks[i].fence = 0;
+		readbacks[i].buffer = 0;
+	}
+
+	GLuint* buffers[] = { &positionBuffer, &velocityBuffer, &sizeBuffer, &bulletBuffer, &reportBuffer, &spawnBuffer };
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+	{
+		if (*buffers[i])
+			trackedDeleteBuffer(*buffers[i]);
+		*buffers[i] = 0;
+	}
+
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	vao = 0;
+	GLuint* programs[] = { &tickProgram, &spawnProgram, &drawProgram };
+	for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+	{
+		if (*programs[i])
+			glDeleteProgram(*programs[i]);
+		*programs[i] = 0;
+	}
+
+	numSlots = 0;
+	numLive = 0;
+	inFlight = 0;
+	finishedCount = 0;
+	freeSlots.clear();
+	pending.clear();
+}
+
+size_t GpuAsteroids::bufferBytes() const
+{
+	return numSlots * (2 * sizeof(vec4) + sizeof(GLfloat)) + bulletCapacity * sizeof(vec4)
+		+ (1 + numReadbacks) * reportBytes + spawnChunk * sizeof(Spawn);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+size_t GpuAsteroids::spawn(const vec4* positions, const vec4* velocities, size_t n, unsigned int* slots)
+{
+	size_t i = 0;
+	for (; i < n && !freeSlots.empty(); i++)
+	{
+		Spawn s;
+		s.position = positions[i];
+		s.velocity = velocities[i];
+		s.slot = freeSlots.back();
+		s.size = 1;
+		s.padding[0] = s.padding[1] = 0;
+		freeSlots.pop_back();
+
+		if (slots)
+			slots[i] = s.slot;
+		pending.push_back(s);
+		if (pending.size() == spawnChunk)
+			flushSpawns();
+	}
+	numLive += i;
+	return i;
+}
+
+// a dispatch writes the waiting spawns into their slots
+void GpuAsteroids::flushSpawns()
+{
+	if (pending.empty())
+		return;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, spawnBuffer);
+	trackedBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, pending.size() * sizeof(Spawn), &pending[0]);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_POSITIONS, positionBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_VELOCITIES, velocityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_SIZES, sizeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_SPAWNS, spawnBuffer);
+
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(spawnProgram);
+	glUniform1ui(spawnCount_loc, (GLuint)pending.size());
+	glDispatchCompute(groups(pending.size(), spawnGroup), 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	glUseProgram(previous);
+
+	pending.clear();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void GpuAsteroids::tick(const vec4* bullets, size_t numBullets, const vec4* explosions, size_t numExplosions)
+{
+	// every readback still on its way back, the oldest has to land first
+	if (inFlight == numReadbacks)
+		collect(true);
+
+	flushSpawns();
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, bulletBuffer);
+	if (numBullets > bulletCapacity)
+	{
+		bulletCapacity = std::max(numBullets, 2 * bulletCapacity);
+		trackedBufferData(GL_SHADER_STORAGE_BUFFER, bulletBuffer, bulletCapacity * sizeof(vec4), NULL, GL_STREAM_DRAW);
+	}
+	if (numBullets > 0)
+		trackedBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numBullets * sizeof(vec4), bullets);
+
+	const GLuint counts[2] = { 0, 0 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, reportBuffer);
+	trackedBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), counts);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_POSITIONS, positionBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_VELOCITIES, velocityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_SIZES, sizeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_BULLETS, bulletBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_REPORTS, reportBuffer);
+
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(tickProgram);
+	glUniform1ui(tickCount_loc, (GLuint)numSlots);
+	glUniform1f(tickGrid_loc, grid);
+	glUniform1ui(tickBullets_loc, (GLuint)numBullets);
+	numExplosions = std::min(numExplosions, (size_t)maxExplosions);
+	if (numExplosions > 0)
+		glUniform4fv(tickExplosions_loc, (GLsizei)numExplosions, &explosions[0].x);
+	glUniform1ui(tickExplosionCount_loc, (GLuint)numExplosions);
+	glUniform1ui(tickMaxHits_loc, maxHits);
+	glUniform1ui(tickMaxDespawns_loc, (GLuint)maxDespawns);
+	glDispatchCompute(groups(numSlots, tickGroup), 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	glUseProgram(previous);
+
+	// the lists go back by a copy the GPU makes when it gets there, and
+	// a fence that says when it has
+	Readback& r = readbacks[(oldest + inFlight) % numReadbacks];
+	glBindBuffer(GL_COPY_READ_BUFFER, reportBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, r.buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, reportBytes);
+	r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	r.tick = tickCount;
+	inFlight++;
+	tickCount++;
+	glFlush();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// moves the oldest readback into the finished reports if the GPU is done
+// with it (or once it is, with wait), freeing the slots it emptied
+bool GpuAsteroids::collect(bool wait)
+{
+	if (inFlight == 0)
+		return false;
+
+	Readback& r = readbacks[oldest];
+	GLenum status = glClientWaitSync(r.fence, 0, 0);
+	while (wait && status == GL_TIMEOUT_EXPIRED)
+		status = glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+	glDeleteSync(r.fence);
+	r.fence = 0;
+
+	// room for one more, in order (only if nobody polls for a while)
+	if (finishedCount == finished.size())
+	{
+		std::rotate(finished.begin(), finished.begin() + finishedHead, finished.end());
+		finishedHead = 0;
+		finished.resize(finished.size() + 1);
+	}
+	GpuAsteroidReport& report = finished[(finishedHead + finishedCount) % finished.size()];
+	finishedCount++;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, r.buffer);
+	const GLuint* words = (const GLuint*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, reportBytes, GL_MAP_READ_BIT);
+	GLuint numHits = std::min(words[0], (GLuint)maxHits);
+	GLuint numDespawns = std::min(words[1], (GLuint)maxDespawns);
+	const GLuint* hits = words + 2;
+	const GLuint* despawns = hits + 2 * maxHits;
+
+	report.tick = r.tick;
+	report.droppedHits = words[0] - numHits;
+	report.hits.resize(numHits);
+	for (GLuint i = 0; i < numHits; i++)
+	{
+		report.hits[i].asteroid = hits[2 * i];
+		report.hits[i].bullets = hits[2 * i + 1];
+	}
+	report.despawns.assign(despawns, despawns + numDespawns);
+	glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+	freeSlots.insert(freeSlots.end(), report.despawns.begin(), report.despawns.end());
+	numLive -= numDespawns;
+
+	oldest = (oldest + 1) % numReadbacks;
+	inFlight--;
+	return true;
+}
+
+bool GpuAsteroids::poll(GpuAsteroidReport& report, bool wait)
+{
+	while (collect(false))
+		;
+	if (finishedCount == 0 && wait)
+		collect(true);
+	if (finishedCount == 0)
+		return false;
+
+	// the vectors change hands, so neither side gives up its memory
+	GpuAsteroidReport& f = finished[finishedHead];
+	report.tick = f.tick;
+	report.droppedHits = f.droppedHits;
+	report.hits.swap(f.hits);
+	report.despawns.swap(f.despawns);
+	finishedHead = (finishedHead + 1) % finished.size();
+	finishedCount--;
+	return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void GpuAsteroids::draw(SphereMesh& mesh, const mat4& projView, const vec4& colour, float alpha)
+{
+	if (numLive == 0)
+		return;
+
+	GLint previousProgram = 0, previousVao = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVao);
+
+	glUseProgram(drawProgram);
+	glUniformMatrix4fv(drawProjView_loc, 1, GL_TRUE, projView);
+	glUniform4fv(drawColour_loc, 1, colour);
+	glUniform1f(drawBack_loc, alpha - 1);
+
+	// as displayWireSphere draws the game's own
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(5,5);
+	glBindVertexArray(vao);
+	mesh.drawInstanced(drawPosition_loc, (GLsizei)numSlots);
+
+	glBindVertexArray(previousVao);
+	glUseProgram(previousProgram);
+}
+
+void GpuAsteroids::readState(vec4* positions, vec4* velocities, float* sizes)
+{
+	flushSpawns();
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, positionBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numSlots * sizeof(vec4), positions);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, velocityBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numSlots * sizeof(vec4), velocities);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, sizeBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numSlots * sizeof(GLfloat), sizes);
+}
+
+}
+
+#endif // GL_COMPUTE_SHADER
@@ -0,0 +1,185 @@
+#ifndef DJV_GPU_ASTEROIDS_H_
+#define DJV_GPU_ASTEROIDS_H_
+/*
+	Asteroids simulated on the GPU
+
+	For fields far bigger than the game's own: the positions, velocities
+	and sizes of up to capacity() asteroids live in GPU buffers and never
+	come back to the CPU. Each tick() is one compute dispatch with the
+	rules World applies to its asteroids (integrate, explosions, bullets),
+	after which the asteroids that left the grid or blew up are emptied.
+	draw() feeds the same buffers to one instanced draw of a sphere.
+
+	What the CPU does get is a report per tick: the asteroids bullets hit
+	and the ones emptied, as two lists compacted on the GPU. They are
+	copied out behind a fence and handed over by poll() a frame or two
+	later, so the CPU never waits on the GPU for them.
+
+		GpuAsteroids field;
+		field.init(1000000);
+		...                                  (spawn() them)
+		for (;;)
+		{
+			field.tick(bullets, numBullets, explosions, numExplosions);
+			while (field.poll(report))
+				...                          (spawn() as many again)
+			field.draw(sphere, projView, colour, alpha);
+		}
+
+	The emptied slots are reused by later spawns once their report has
+	been polled. Needs a GL 4.3 context (compute shaders and shader
+	storage buffers), so it is left out where the GL headers are older.
+*/
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "gl_include.h"
+#include "vec.h"
+#include "mat.h"
+
+#ifdef GL_COMPUTE_SHADER
+
+namespace djv {
+
+class SphereMesh;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// an asteroid bullets hit during a tick, and how many of them
+struct GpuHit
+{
+	unsigned int asteroid;
+	unsigned int bullets;
+};
+
+// what one tick did, in no particular order
+struct GpuAsteroidReport
+{
+	unsigned long long tick; // tick() calls before this one
+	std::vector< GpuHit > hits;
+	std::vector< unsigned int > despawns; // slots emptied (and free again)
+	unsigned int droppedHits; // hits past the end of the list
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class GpuAsteroids
+{
+public:
+	// entries in the per-tick hit list, hits past it are only counted
+	static const unsigned int maxHits = 4096;
+	static const size_t maxExplosions = 2;
+
+	GpuAsteroids();
+	~GpuAsteroids();
+
+	// whether the current context can run it (GL 4.3 or newer)
+	static bool supported();
+
+	// loads the shaders and creates the buffers, every slot empty (needs
+	// a GL context; 'grid' is the half width asteroids leave at). The
+	// despawn list holds maxDespawns (0 = capacity, so it never fills up);
+	// an asteroid that does not fit stays and is listed by a later tick,
+	// which saves copying the whole list back for very large fields
+	void init(size_t capacity, float grid = 100, size_t maxDespawns = 0);
+	void release();
+
+	size_t capacity() const { return numSlots; }
+	size_t live() const { return numLive; }
+	unsigned long long ticks() const { return tickCount; }
+
+	// puts up to n asteroids in free slots before the next tick, returns
+	// how many fitted; slots[i] is set to where asteroid i went if given
+	size_t spawn(const vec4* positions, const vec4* velocities, size_t n, unsigned int* slots = NULL);
+
+	// one tick: every asteroid moves, grows by 0.1 within 15 of an
+	// explosion and by 0.05 for each bullet within 1.8 (as World does)
+	void tick(const vec4* bullets, size_t numBullets, const vec4* explosions, size_t numExplosions);
+
+	// the oldest tick whose report has not been polled yet; false if none
+	// has finished (or with wait, false only if every one was polled)
+	bool poll(GpuAsteroidReport& report, bool wait = false);
+
+	// every live asteroid as a sphere scaled by its size, placed
+	// (alpha - 1) of a tick back along its velocity
+	void draw(SphereMesh& mesh, const mat4& projView, const vec4& colour, float alpha = 1);
+
+	// copies the whole state back, waiting for the GPU (checks only);
+	// empty slots have size 0
+	void readState(vec4* positions, vec4* velocities, float* sizes);
+
+	// bytes of GPU memory in the buffers
+	size_t bufferBytes() const;
+
+	// the simulation's buffers, a slot each (vec4, vec4, float), for
+	// drawing the field some other way (gpu_scene.h)
+	GLuint positions() const { return positionBuffer; }
+	GLuint velocities() const { return velocityBuffer; }
+	GLuint sizes() const { return sizeBuffer; }
+
+private:
+	// a spawn as the spawn shader reads it (std430)
+	struct Spawn
+	{
+		vec4 position;
+		vec4 velocity;
+		unsigned int slot;
+		float size;
+		float padding[2];
+	};
+
+	// a copy of one tick's lists on its way back
+	struct Readback
+	{
+		GLuint buffer;
+		GLsync fence;
+		unsigned long long tick;
+	};
+
+	static const int numReadbacks = 3;
+	static const size_t spawnChunk = 16384;
+
+	void flushSpawns();
+	bool collect(bool wait);
+
+	GpuAsteroids(const GpuAsteroids&);
+	GpuAsteroids& operator=(const GpuAsteroids&);
+
+	size_t numSlots;
+	size_t numLive;
+	size_t maxDespawns;
+	size_t reportBytes;
+	float grid;
+	unsigned long long tickCount;
+
+	GLuint tickProgram, spawnProgram, drawProgram;
+	GLint tickCount_loc, tickGrid_loc, tickBullets_loc, tickExplosions_loc, tickExplosionCount_loc;
+	GLint tickMaxHits_loc, tickMaxDespawns_loc;
+	GLint spawnCount_loc;
+	GLint drawProjView_loc, drawColour_loc, drawBack_loc;
+	GLint drawPosition_loc, drawCentre_loc, drawVelocity_loc, drawSize_loc;
+	GLuint vao;
+
+	// positions, velocities, sizes, bullets, reports, spawns
+	GLuint positionBuffer, velocityBuffer, sizeBuffer;
+	GLuint bulletBuffer, reportBuffer, spawnBuffer;
+	size_t bulletCapacity;
+
+	std::vector< Spawn > pending;
+	std::vector< unsigned int > freeSlots;
+
+	Readback readbacks[numReadbacks];
+	int oldest, inFlight;
+
+	// reports collected but not polled yet, a ring
+	std::vector< GpuAsteroidReport > finished;
+	size_t finishedHead, finishedCount;
+};
+
+}
+
+#endif // GL_COMPUTE_SHADER
+
+#endif
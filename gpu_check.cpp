@@ -0,0 +1,1001 @@
+/*
+	GPU path check
+
+	Runs the GPU asteroids (gpu_asteroids.h) without a window, in a GL
+	context EGL makes on the default device (Mesa's llvmpipe where there
+	is no GPU), next to the same rules on the CPU: World's kernels
+	(advanceGrowing, countWithin) over the same slots, spawns, bullets and
+	explosions. Every tick's hit and despawn lists and the final state
+	must match exactly; then the field is drawn once into an offscreen
+	framebuffer, which must show asteroids, and once more through a
+	GpuScene, which must cover (within rounding) as much.
+
+	Then the GPU scene (gpu_scene.h): objects of three meshes at random
+	are culled on the GPU, the objects each draw command lists must be the
+	ones inside the frustum on the CPU, and the one indirect draw must
+	give the same image as a draw call per object.
+
+	Last the procedural background (background.h): it has to show stars
+	and grid lines from a camera near the origin and from one far away
+	(it has no edge), move with parallax, and stay behind anything
+	already in the depth buffer.
+
+	Last of all a soak of the GL buffers: for a few hundred frames the
+	ship's particle fields are scattered anew and meshes made and thrown
+	away, the way the game does it; the tracked buffer memory has to
+	level off after a warm-up.
+
+	gpu_check [--asteroids N] [--objects N] [--ticks N] [--seed N]
+
+	Run it from a directory with the shaders (the build directory has
+	copies). Exits 1 on a mismatch, 2 without a GL 4.3 context.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "gl_utilities.h"
+#include "gpu_asteroids.h"
+#include "gpu_scene.h"
+#include "background.h"
+#include "hud.h"
+#include "meshes.h"
+#include "world.h"
+#include "arena.h"
+#include "rng.h"
+
+using namespace djv;
+
+typedef std::chrono::steady_clock Clock;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// a GL 4.3 compatibility context with no surface, current on this thread
+// (the game's own kind, so its GLSL 1.20 shaders build too)
+static bool makeContext()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = getPlatformDisplay
+		? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)
+		: eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		std::cerr << "no EGL display" << std::endl;
+		return false;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	const EGLint attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		std::cerr << "no GL 4.3 context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return false;
+	}
+
+	std::cout << glGetString(GL_RENDERER) << ", OpenGL " << glGetString(GL_VERSION) << std::endl;
+	return true;
+}
+
+static double milliseconds(Clock::time_point a, Clock::time_point b)
+{
+	return std::chrono::duration< double, std::milli >(b - a).count();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// The same field on the CPU, slot for slot, stepped the way World steps
+// its own asteroids
+struct ReferenceField
+{
+	std::vector< vec4 > positions, velocities;
+	std::vector< float > sizes; // 0 for an empty slot
+	std::vector< unsigned char > outside;
+
+	explicit ReferenceField(size_t n) : positions(n), velocities(n), sizes(n, 0), outside(n) {}
+
+	void tick(const vec4* bullets, size_t numBullets, const vec4* explosions, size_t numExplosions,
+			  std::vector< GpuHit >& hits, std::vector< unsigned int >& despawns)
+	{
+		advanceGrowing(&positions[0], &velocities[0], &sizes[0], &outside[0], positions.size(), 100);
+
+		hits.clear();
+		despawns.clear();
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			if (!(sizes[i] > 0))
+				continue;
+
+			for (size_t k = 0; k < numExplosions; k++)
+			{
+				if (vec_length(positions[i] - explosions[k]) < 15)
+					sizes[i] += 0.1;
+			}
+			size_t n = countWithin(bullets, numBullets, positions[i], 1.8f);
+			for (size_t k = 0; k < n; k++)
+				sizes[i] += 0.05;
+			if (n > 0)
+			{
+				GpuHit hit = { (unsigned int)i, (unsigned int)n };
+				hits.push_back(hit);
+			}
+
+			if (outside[i] || sizes[i] > 2)
+			{
+				despawns.push_back((unsigned int)i);
+				sizes[i] = 0;
+			}
+		}
+	}
+};
+
+// (with GpuHit, so the standard algorithms find them)
+namespace djv {
+static bool operator<(const GpuHit& a, const GpuHit& b) { return a.asteroid < b.asteroid; }
+static bool operator==(const GpuHit& a, const GpuHit& b) { return a.asteroid == b.asteroid && a.bullets == b.bullets; }
+}
+
+static bool sameBits(const vec4& a, const vec4& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// n new asteroids from the stream into both fields
+static void spawnBoth(size_t n, Rng& random, GpuAsteroids& field, ReferenceField& reference)
+{
+	std::vector< vec4 > positions(n), velocities(n);
+	std::vector< unsigned int > slots(n);
+	std::vector< float > u(4 * n);
+	random.fill(u.data(), u.size());
+	for (size_t i = 0; i < n; i++)
+		asteroidSpawn(&u[4 * i], positions[i], velocities[i]);
+
+	n = field.spawn(positions.data(), velocities.data(), n, slots.data());
+	for (size_t i = 0; i < n; i++)
+	{
+		reference.positions[slots[i]] = positions[i];
+		reference.velocities[slots[i]] = velocities[i];
+		reference.sizes[slots[i]] = 1;
+	}
+}
+
+// Bullets flying across the field, a fresh one where one leaves it
+struct Bullets
+{
+	std::vector< vec4 > positions, directions;
+
+	void fire(size_t i, Rng& random)
+	{
+		float u[4];
+		random.fill(u, 4);
+		positions[i] = vec4(-90 + 180 * u[0], -1, -90 + 180 * u[1], 0);
+		float angle = 360 * u[2] * DegreesToRadians;
+		directions[i] = vec4(cos(angle), 0, sin(angle), 0);
+	}
+
+	Bullets(size_t n, Rng& random) : positions(n), directions(n)
+	{
+		for (size_t i = 0; i < n; i++)
+			fire(i, random);
+	}
+
+	void tick(Rng& random)
+	{
+		advance(positions.data(), directions.data(), World::bullet_speed, positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			if (abs(positions[i].x) > 100 || abs(positions[i].z) > 100)
+				fire(i, random);
+		}
+	}
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// an offscreen framebuffer to draw into, bound while it lives
+struct Target
+{
+	static const int size = 256;
+	GLuint framebuffer, colour, depth;
+
+	Target()
+	{
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glGenRenderbuffers(1, &colour);
+		glBindRenderbuffer(GL_RENDERBUFFER, colour);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour);
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+		glViewport(0, 0, size, size);
+		clear();
+	}
+
+	~Target()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteRenderbuffers(1, &colour);
+		glDeleteRenderbuffers(1, &depth);
+		glDeleteFramebuffers(1, &framebuffer);
+	}
+
+	void clear()
+	{
+		glClearColor(0, 0, 0, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glEnable(GL_DEPTH_TEST);
+	}
+
+	void read(std::vector< unsigned char >& pixels)
+	{
+		pixels.resize(4 * size * size);
+		glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	}
+};
+
+// the field from above into an offscreen framebuffer, the pixels covered
+// (through a GpuScene, culled and drawn indirectly, if given one)
+static size_t drawnPixels(GpuAsteroids& field, bool throughScene = false)
+{
+	Target target;
+	SphereMesh sphere;
+	sphere.init(2);
+	mat4 projView = Ortho(-100, 100, -100, 100, -10, 10) * RotateX(90);
+	vec4 colour(0.545f, 0.275f, 0.08f, 1);
+	if (throughScene)
+	{
+		GpuScene scene;
+		GLuint mesh = scene.addMesh(sphere);
+		scene.init(field.capacity());
+		scene.setObjects(0, field, mesh, colour, 0.5f);
+		scene.cull(projView);
+		scene.draw(projView);
+	}
+	else
+		field.draw(sphere, projView, colour, 0.5f);
+
+	std::vector< unsigned char > pixels;
+	target.read(pixels);
+	size_t covered = 0;
+	for (size_t i = 0; i < pixels.size(); i += 4)
+		covered += pixels[i] != 0 ? 1 : 0;
+	return covered;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static int checkAsteroids(size_t asteroids, int ticks, unsigned int seed)
+{
+	GpuAsteroids field;
+	field.init(asteroids);
+	ReferenceField reference(asteroids);
+	Rng spawns(seed, RNG_ASTEROIDS), effects(seed, RNG_EFFECTS);
+	spawnBoth(asteroids, spawns, field, reference);
+	Bullets bullets(64, effects);
+
+	std::vector< std::vector< GpuHit > > expectedHits(ticks);
+	std::vector< std::vector< unsigned int > > expectedDespawns(ticks);
+	GpuAsteroidReport report;
+	int reports = 0, mismatches = 0;
+	size_t totalHits = 0, totalDespawns = 0;
+	double gpuMs = 0, cpuMs = 0;
+
+	// compares a report with what the CPU found, then refills its slots
+	auto check = [&](GpuAsteroidReport& report)
+	{
+		std::vector< GpuHit >& hits = expectedHits[report.tick];
+		std::vector< unsigned int >& despawns = expectedDespawns[report.tick];
+		std::sort(report.hits.begin(), report.hits.end());
+		std::sort(report.despawns.begin(), report.despawns.end());
+		std::sort(hits.begin(), hits.end());
+		std::sort(despawns.begin(), despawns.end());
+		// with the hit list full, the ones that fit are any of them
+		bool sameHits = report.droppedHits > 0
+			? report.hits.size() + report.droppedHits == hits.size() && std::includes(hits.begin(), hits.end(), report.hits.begin(), report.hits.end())
+			: report.hits == hits;
+		if (!sameHits || report.despawns != despawns)
+		{
+			if (mismatches++ < 5)
+				std::cerr << "tick " << report.tick << ": " << report.hits.size() << " hits, "
+						  << report.despawns.size() << " despawns on the GPU, " << hits.size()
+						  << " and " << despawns.size() << " on the CPU" << std::endl;
+		}
+		totalHits += report.hits.size();
+		totalDespawns += report.despawns.size();
+		reports++;
+		spawnBoth(report.despawns.size(), spawns, field, reference);
+	};
+
+	for (int t = 0; t < ticks; t++)
+	{
+		bullets.tick(effects);
+		vec4 explosions[2] = { vec4(-40, 0, 30, 0), vec4(55, 0, -20, 0) };
+		size_t numExplosions = (t % 120) < 40 ? 2 : 0;
+
+		Clock::time_point start = Clock::now();
+		field.tick(bullets.positions.data(), bullets.positions.size(), explosions, numExplosions);
+		Clock::time_point gpuEnd = Clock::now();
+		reference.tick(bullets.positions.data(), bullets.positions.size(), explosions, numExplosions,
+					   expectedHits[t], expectedDespawns[t]);
+		cpuMs += milliseconds(gpuEnd, Clock::now());
+		gpuMs += milliseconds(start, gpuEnd);
+
+		while (field.poll(report))
+			check(report);
+	}
+	while (field.poll(report, true))
+		check(report);
+
+	// the whole state, slot for slot
+	std::vector< vec4 > positions(asteroids), velocities(asteroids);
+	std::vector< float > sizes(asteroids);
+	field.readState(positions.data(), velocities.data(), sizes.data());
+	size_t live = 0, stateMismatches = 0;
+	for (size_t i = 0; i < asteroids; i++)
+	{
+		bool same = sizes[i] == reference.sizes[i];
+		if (sizes[i] > 0)
+		{
+			live++;
+			same = same && sameBits(positions[i], reference.positions[i]) && sameBits(velocities[i], reference.velocities[i]);
+		}
+		if (!same && stateMismatches++ < 5)
+			std::cerr << "slot " << i << ": size " << sizes[i] << " on the GPU, " << reference.sizes[i] << " on the CPU" << std::endl;
+	}
+
+	size_t covered = drawnPixels(field);
+	size_t sceneCovered = GpuScene::supported() ? drawnPixels(field, true) : covered;
+	GLenum error = glGetError();
+
+	std::cout << asteroids << " asteroids, " << ticks << " ticks: " << reports << " reports, "
+			  << totalHits << " hits, " << totalDespawns << " despawns, " << live << " live at the end\n"
+			  << "  tick dispatch " << gpuMs / ticks << " ms, CPU rules " << cpuMs / ticks << " ms a tick\n"
+			  << "  " << mismatches << " reports and " << stateMismatches << " slots differ, "
+			  << covered << " pixels drawn (" << sceneCovered << " through a GpuScene)" << std::endl;
+	if (error != GL_NO_ERROR)
+		std::cerr << "GL error " << ErrorString(error) << std::endl;
+
+	bool ok = reports == ticks && mismatches == 0 && stateMismatches == 0 && live == field.live()
+		&& covered > 0 && abs((double)sceneCovered - covered) <= 0.01 * covered && error == GL_NO_ERROR;
+	std::cout << (ok ? "GPU asteroids match" : "GPU asteroids differ") << std::endl;
+	return ok ? 0 : 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// one object at a time, the way the game draws its own: a transform
+// uniform and the mesh's own buffers
+static const char* referenceVertex =
+	"#version 330\n"
+	"uniform mat4 projView;\n"
+	"uniform mat4 model;\n"
+	"uniform vec4 in_Colour;\n"
+	"in vec4 in_Position;\n"
+	"out vec4 v_Colour;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = projView * (model * vec4(in_Position.xyz, 1.0));\n"
+	"	v_Colour = in_Colour;\n"
+	"}\n";
+
+static const char* referenceFragment =
+	"#version 330\n"
+	"in vec4 v_Colour;\n"
+	"out vec4 out_Colour;\n"
+	"void main()\n"
+	"{\n"
+	"	out_Colour = v_Colour;\n"
+	"}\n";
+
+static GLuint referenceProgram()
+{
+	GLuint program = glCreateProgram();
+	const char* sources[] = { referenceVertex, referenceFragment };
+	GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	for (int i = 0; i < 2; i++)
+	{
+		GLuint shader = glCreateShader(types[i]);
+		glShaderSource(shader, 1, &sources[i], NULL);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	glLinkProgram(program);
+	return program;
+}
+
+// which objects are inside projView's frustum, as GpuScene::cull() tests
+// them: 1 in, 0 out, -1 too close to a plane to tell (the GPU rounds its
+// own way)
+static void referenceCull(const std::vector< SceneObject >& objects, const GpuScene& scene, const mat4& projView,
+						  std::vector< int >& inside)
+{
+	vec4 planes[6];
+	for (int i = 0; i < 3; i++)
+	{
+		planes[2 * i] = projView[3] + projView[i];
+		planes[2 * i + 1] = projView[3] - projView[i];
+	}
+	for (int i = 0; i < 6; i++)
+		planes[i] = planes[i] / sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+
+	inside.resize(objects.size());
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		const mat4& m = objects[i].model;
+		vec4 b = scene.bounds(objects[i].mesh);
+		vec4 centre = m * vec4(b.x, b.y, b.z, 1);
+		float scale = 0;
+		for (int c = 0; c < 3; c++)
+			scale = std::max(scale, sqrtf(m[0][c] * m[0][c] + m[1][c] * m[1][c] + m[2][c] * m[2][c]));
+		float radius = b.w * scale;
+
+		inside[i] = 1;
+		for (int p = 0; p < 6; p++)
+		{
+			float d = planes[p].x * centre.x + planes[p].y * centre.y + planes[p].z * centre.z + planes[p].w + radius;
+			if (abs(d) < 0.01f)
+				inside[i] = -1;
+			else if (d < 0)
+			{
+				inside[i] = 0;
+				break;
+			}
+		}
+	}
+}
+
+static int checkScene(size_t numObjects, unsigned int seed)
+{
+	SphereMesh sphere;
+	CubeMesh cube;
+	CylinderMesh cylinder;
+	sphere.init(4);
+	cube.init();
+	cylinder.init();
+	Mesh* meshes[] = { &sphere, &cube, &cylinder };
+	const size_t numMeshes = sizeof(meshes) / sizeof(meshes[0]);
+
+	GpuScene scene;
+	for (size_t m = 0; m < numMeshes; m++)
+		scene.addMesh(*meshes[m]);
+	scene.init(numObjects);
+
+	// turned, stretched and coloured at random all round the camera
+	Rng random(seed, RNG_EFFECTS);
+	std::vector< SceneObject > objects(numObjects);
+	for (size_t i = 0; i < numObjects; i++)
+	{
+		float u[10];
+		random.fill(u, 10);
+		SceneObject& o = objects[i];
+		o.model = Translate(-200 + 400 * u[0], -200 + 400 * u[1], -200 + 400 * u[2])
+			* RotateY(360 * u[3]) * RotateX(360 * u[4]) * Scale(1 + 5 * u[5], 1 + 5 * u[6], 1 + 5 * u[7]);
+		o.colour = hsv2rgb(u[8], 0.5f + 0.5f * u[9], 1, 1);
+		o.mesh = (GLuint)(i % numMeshes);
+		o.padding[0] = o.padding[1] = o.padding[2] = 0;
+	}
+	Clock::time_point uploadStart = Clock::now();
+	scene.setObjects(0, objects.data(), objects.size());
+	glFinish();
+	double uploadMs = milliseconds(uploadStart, Clock::now());
+
+	const vec4 camera(0, 30, 250, 1);
+	mat4 projView = Perspective(45, 1, 1, 400) * LookAt(camera, vec4(0, 0, 0, 1), vec4(0, 1, 0, 0));
+
+	// the lists the cull pass made against the CPU's
+	std::vector< int > inside;
+	referenceCull(objects, scene, projView, inside);
+	scene.cull(projView);
+	size_t visible = 0, expected = 0, cullMismatches = 0;
+	std::vector< unsigned char > listed(numObjects, 0);
+	for (GLuint m = 0; m < numMeshes; m++)
+	{
+		std::vector< GLuint > ids;
+		scene.visibleObjects(m, ids);
+		visible += ids.size();
+		for (size_t k = 0; k < ids.size(); k++)
+		{
+			GLuint i = ids[k];
+			if (i >= numObjects || objects[i].mesh != m || listed[i] || inside[i] == 0)
+				cullMismatches++;
+			else
+				listed[i] = 1;
+		}
+	}
+	for (size_t i = 0; i < numObjects; i++)
+	{
+		expected += inside[i] != 0 ? 1 : 0;
+		if (inside[i] == 1 && !listed[i])
+			cullMismatches++;
+	}
+
+	// the far spheres as impostors: the same spheres, split by distance
+	// from the eye (0.01 either way is too close to tell). Perspective
+	// keeps the identity's 1 in [3][3], which puts the eye the projection
+	// draws from a unit behind the camera
+	const float impostorDistance = 250;
+	const vec4 eye = camera + normalize(camera - vec4(0, 0, 0, 1));
+	std::vector< GLuint > spheres, impostors, near;
+	scene.visibleObjects(0, spheres);
+	scene.setImpostors(0, impostorDistance);
+	scene.cull(projView);
+	scene.visibleObjects(0, near);
+	scene.visibleObjects((GLuint)numMeshes, impostors);
+	size_t impostorMismatches = near.size() + impostors.size() == spheres.size() ? 0 : 1;
+	std::vector< GLuint > split(near);
+	split.insert(split.end(), impostors.begin(), impostors.end());
+	std::sort(split.begin(), split.end());
+	std::sort(spheres.begin(), spheres.end());
+	std::sort(impostors.begin(), impostors.end());
+	impostorMismatches += split == spheres ? 0 : 1;
+	for (size_t k = 0; k < split.size(); k++)
+	{
+		GLuint i = split[k];
+		vec4 b = scene.bounds(0);
+		vec4 d = objects[i].model * vec4(b.x, b.y, b.z, 1) - eye;
+		float distance = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z) - impostorDistance;
+		bool isImpostor = std::binary_search(impostors.begin(), impostors.end(), i);
+		if ((isImpostor && distance < -0.01f) || (!isImpostor && distance > 0.01f))
+			impostorMismatches++;
+	}
+
+	// one indirect draw against a draw call per object
+	Target target;
+	std::vector< unsigned char > indirectPixels, impostorPixels, referencePixels;
+	const int frames = 3;
+
+	// a frame of the scene into pixels, how long to submit and to finish
+	auto drawIndirect = [&](std::vector< unsigned char >& pixels, double& submitMs, double& doneMs)
+	{
+		Clock::time_point start = Clock::now();
+		for (int f = 0; f < frames; f++)
+		{
+			target.clear();
+			scene.cull(projView);
+			scene.draw(projView);
+		}
+		Clock::time_point submitted = Clock::now();
+		glFinish();
+		submitMs = milliseconds(start, submitted) / frames;
+		doneMs = milliseconds(start, Clock::now()) / frames;
+		target.read(pixels);
+	};
+	double impostorSubmitMs, impostorMs, indirectSubmitMs, indirectMs;
+	drawIndirect(impostorPixels, impostorSubmitMs, impostorMs);
+	scene.setImpostors(GpuScene::noMesh, 0);
+	drawIndirect(indirectPixels, indirectSubmitMs, indirectMs);
+
+	GLuint program = referenceProgram();
+	GLint model_loc = glGetUniformLocation(program, "model");
+	GLint colour_loc = glGetUniformLocation(program, "in_Colour");
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "projView"), 1, GL_TRUE, projView);
+	Mesh::in_position_loc = glGetAttribLocation(program, "in_Position");
+	glEnableVertexAttribArray(Mesh::in_position_loc);
+
+	Clock::time_point start = Clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		target.clear();
+		for (size_t i = 0; i < numObjects; i++)
+		{
+			glUniformMatrix4fv(model_loc, 1, GL_TRUE, objects[i].model);
+			glUniform4fv(colour_loc, 1, objects[i].colour);
+			meshes[objects[i].mesh]->draw(true);
+		}
+	}
+	Clock::time_point submitted = Clock::now();
+	glFinish();
+	double referenceSubmitMs = milliseconds(start, submitted) / frames;
+	double referenceMs = milliseconds(start, Clock::now()) / frames;
+	target.read(referencePixels);
+
+	glUseProgram(0);
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteProgram(program);
+
+	// the impostors are the true ellipsoids, the meshes only close to
+	// them, so their edges may differ by a pixel
+	size_t differ = 0, impostorDiffer = 0, covered = 0;
+	for (size_t i = 0; i < indirectPixels.size(); i += 4)
+	{
+		differ += std::equal(&indirectPixels[i], &indirectPixels[i] + 4, &referencePixels[i]) ? 0 : 1;
+		impostorDiffer += std::equal(&impostorPixels[i], &impostorPixels[i] + 4, &referencePixels[i]) ? 0 : 1;
+		covered += indirectPixels[i] | indirectPixels[i + 1] | indirectPixels[i + 2] ? 1 : 0;
+	}
+	GLenum error = glGetError();
+
+	std::cout << numObjects << " scene objects (" << numMeshes << " meshes): " << visible << " visible, "
+			  << expected << " on the CPU, " << cullMismatches << " differ\n"
+			  << "  upload " << uploadMs << " ms; a frame: 1 dispatch and 1 indirect draw " << indirectSubmitMs
+			  << " ms to submit, " << indirectMs << " ms done; " << numObjects << " draws " << referenceSubmitMs
+			  << " ms to submit, " << referenceMs << " ms done\n"
+			  << "  " << covered << " pixels drawn, " << differ << " differ\n"
+			  << "  " << impostors.size() << " of " << spheres.size() << " spheres past " << impostorDistance
+			  << " as impostors, " << impostorMismatches << " misplaced: " << impostorSubmitMs << " ms to submit, "
+			  << impostorMs << " ms done, " << impostorDiffer << " pixels differ" << std::endl;
+	if (error != GL_NO_ERROR)
+		std::cerr << "GL error " << ErrorString(error) << std::endl;
+
+	bool ok = cullMismatches == 0 && differ == 0 && covered > 0 && impostorMismatches == 0
+		&& !impostors.empty() && impostorDiffer <= covered / 50 && error == GL_NO_ERROR;
+	std::cout << (ok ? "GPU scene matches" : "GPU scene differs") << std::endl;
+	return ok ? 0 : 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the pixels that are not black
+static size_t litPixels(const std::vector< unsigned char >& pixels)
+{
+	size_t lit = 0;
+	for (size_t i = 0; i < pixels.size(); i += 4)
+		lit += pixels[i] | pixels[i + 1] | pixels[i + 2] ? 1 : 0;
+	return lit;
+}
+
+static int checkBackground()
+{
+	Background background;
+	background.init();
+	background.showGrid = true;
+	Target target;
+	const vec4 white(1, 1, 1, 1);
+
+	// the background a camera at 'position' sees, looking ahead and down
+	auto view = [&](const vec4& position, std::vector< unsigned char >& pixels)
+	{
+		mat4 projView = Perspective(45, 1, 1, 400)
+			* LookAt(position, position + vec4(0, -60, -100, 0), vec4(0, 1, 0, 0));
+		target.clear();
+		background.draw(projView, white);
+		target.read(pixels);
+	};
+
+	std::vector< unsigned char > home, moved, far;
+	const int frames = 10;
+	Clock::time_point start = Clock::now();
+	for (int f = 0; f < frames; f++)
+		view(vec4(0, 30, 0, 1), home);
+	double ms = milliseconds(start, Clock::now()) / frames;
+	view(vec4(5, 30, 0, 1), moved);
+	view(vec4(100000, 30, -250000, 1), far);
+
+	size_t changed = 0;
+	for (size_t i = 0; i < home.size(); i += 4)
+		changed += std::equal(&home[i], &home[i] + 4, &moved[i]) ? 0 : 1;
+
+	// nothing gets in front of what is already there
+	glClearDepth(0.5);
+	target.clear();
+	glClearDepth(1);
+	mat4 projView = Perspective(45, 1, 1, 400) * LookAt(vec4(0, 30, 0, 1), vec4(0, -30, -100, 1), vec4(0, 1, 0, 0));
+	background.draw(projView, white);
+	std::vector< unsigned char > hidden;
+	target.read(hidden);
+	GLenum error = glGetError();
+
+	size_t lit = litPixels(home), farLit = litPixels(far), hiddenLit = litPixels(hidden);
+	std::cout << "background: " << lit << " pixels lit, " << farLit << " from far away, " << changed
+			  << " change 5 to the side, " << hiddenLit << " in front of the depth buffer\n"
+			  << "  " << ms << " ms a frame, " << background.bufferBytes() << " bytes of vertices" << std::endl;
+	if (error != GL_NO_ERROR)
+		std::cerr << "GL error " << ErrorString(error) << std::endl;
+
+	bool ok = lit > 0 && farLit > lit / 2 && farLit < 2 * lit && changed > 0 && hiddenLit == 0 && error == GL_NO_ERROR;
+	std::cout << (ok ? "background draws" : "background is wrong") << std::endl;
+	return ok ? 0 : 1;
+}
+
+// the lit pixels of 'a' with no lit pixel in 'b' within one pixel of them
+static size_t unmatchedPixels(const std::vector< unsigned char >& a, const std::vector< unsigned char >& b, int size)
+{
+	size_t unmatched = 0;
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			const unsigned char* p = &a[4 * (y * size + x)];
+			if (!(p[0] | p[1] | p[2]))
+				continue;
+			bool found = false;
+			for (int dy = -1; dy <= 1 && !found; dy++)
+			{
+				for (int dx = -1; dx <= 1 && !found; dx++)
+				{
+					int u = std::min(size - 1, std::max(0, x + dx)), v = std::min(size - 1, std::max(0, y + dy));
+					const unsigned char* q = &b[4 * (v * size + u)];
+					found = (q[0] | q[1] | q[2]) != 0;
+				}
+			}
+			unmatched += found ? 0 : 1;
+		}
+	}
+	return unmatched;
+}
+
+static int checkBackgroundCache()
+{
+	if (!Background::cacheSupported())
+	{
+		std::cout << "no framebuffers, background cache left out" << std::endl;
+		return 0;
+	}
+
+	Background direct, cached;
+	direct.init();
+	cached.init();
+	cached.useCache(1);
+	Target target;
+	const vec4 white(1, 1, 1, 1);
+
+	// the camera at 'position' looking ahead and down, turned 'turn'
+	// degrees to the left
+	auto camera = [](const vec4& position, float turn)
+	{
+		return Perspective(45, 1, 1, 400) * RotateY(-turn)
+			* LookAt(position, position + vec4(0, -60, -100, 0), vec4(0, 1, 0, 0));
+	};
+	auto view = [&](Background& background, const mat4& projView, std::vector< unsigned char >& pixels)
+	{
+		target.clear();
+		background.draw(projView, white);
+		target.read(pixels);
+	};
+
+	// the same picture, from the cache
+	const vec4 home(0, 30, 0, 1);
+	std::vector< unsigned char > fresh, reprojected;
+	view(direct, camera(home, 0), fresh);
+	view(cached, camera(home, 0), reprojected);
+	size_t lit = litPixels(fresh), cachedLit = litPixels(reprojected);
+	size_t missing = unmatchedPixels(fresh, reprojected, Target::size);
+	size_t extra = unmatchedPixels(reprojected, fresh, Target::size);
+
+	// a turn inside the margin and a short move reuse it, a longer move or a
+	// wide turn draw it again
+	const int frames = 10;
+	unsigned long long refreshes[5];
+	refreshes[0] = cached.cacheRefreshes();
+	Clock::time_point start = Clock::now();
+	for (int f = 0; f < frames; f++)
+		view(cached, camera(home, 0), reprojected);
+	double cachedMs = milliseconds(start, Clock::now()) / frames;
+	refreshes[1] = cached.cacheRefreshes();
+	view(cached, camera(home, 3), reprojected);
+	view(cached, camera(home + vec4(0.2f, 0, 0, 0), 0), reprojected);
+	refreshes[2] = cached.cacheRefreshes();
+
+	// and the turned picture still matches a fresh one
+	view(direct, camera(home, 3), fresh);
+	view(cached, camera(home, 3), reprojected);
+	size_t turnedMissing = unmatchedPixels(fresh, reprojected, Target::size);
+	size_t turnedLit = litPixels(fresh);
+
+	view(cached, camera(home + vec4(2, 0, 0, 0), 0), reprojected);
+	refreshes[3] = cached.cacheRefreshes();
+	view(cached, camera(home + vec4(2, 0, 0, 0), 30), reprojected);
+	refreshes[4] = cached.cacheRefreshes();
+
+	start = Clock::now();
+	for (int f = 0; f < frames; f++)
+		view(direct, camera(home, 0), fresh);
+	double directMs = milliseconds(start, Clock::now()) / frames;
+	GLenum error = glGetError();
+
+	std::cout << "background cache: " << cachedLit << " pixels lit against " << lit << " drawn fresh, "
+			  << missing << " missing and " << extra << " extra; " << turnedMissing << " of " << turnedLit
+			  << " missing turned 3 degrees\n"
+			  << "  drawn " << refreshes[0] << ", " << refreshes[1] << ", " << refreshes[2] << ", "
+			  << refreshes[3] << ", " << refreshes[4] << " times: still, turned a little, moved 2, turned 30\n"
+			  << "  " << cachedMs << " ms a frame from the cache, " << directMs << " ms drawn fresh, "
+			  << cached.textureBytes() << " bytes of texture" << std::endl;
+	if (error != GL_NO_ERROR)
+		std::cerr << "GL error " << ErrorString(error) << std::endl;
+
+	bool ok = lit > 0 && missing <= lit / 10 && extra <= lit / 10 && turnedMissing <= turnedLit / 10
+		&& refreshes[0] == 1 && refreshes[1] == 1 && refreshes[2] == 1 && refreshes[3] == 2 && refreshes[4] == 3
+		&& error == GL_NO_ERROR;
+	std::cout << (ok ? "background cache matches" : "background cache differs") << std::endl;
+	return ok ? 0 : 1;
+}
+
+// the lives and bullets from the HUD's one buffer, against the projected
+// cubes the game used to draw for them one at a time
+static int checkHud()
+{
+	const mat4 projection = Perspective(40, 1, 1, 250);
+	const vec4 red(1, 0, 0, 1);
+	const int lives = 4, bullets = 60;
+	Target target;
+	glDisable(GL_DEPTH_TEST);
+
+	Hud hud;
+	hud.init();
+	std::vector< unsigned char > batched, reference;
+	const int frames = 10;
+	Clock::time_point start = Clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		target.clear();
+		hud.draw(projection, lives, bullets, red);
+	}
+	glFinish();
+	double batchedMs = milliseconds(start, Clock::now()) / frames;
+	target.read(batched);
+	unsigned long long steadyRebuilds = hud.rebuilds();
+	hud.draw(projection, lives, bullets - 1, red);
+	hud.draw(projection, lives - 1, bullets - 1, red);
+	unsigned long long changedRebuilds = hud.rebuilds();
+
+	CubeMesh cube;
+	cube.init();
+	GLuint program = loadAndInitializeShaders("vshader7.glsl", "fshader2.glsl");
+	GLint modelView_loc = glGetUniformLocation(program, "modelView");
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glUseProgram(program);
+	glUniform4fv(glGetUniformLocation(program, "in_Colour"), 1, red);
+	Mesh::in_position_loc = glGetAttribLocation(program, "in_Position");
+	glEnableVertexAttribArray(Mesh::in_position_loc);
+
+	start = Clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		target.clear();
+		glDisable(GL_DEPTH_TEST);
+		for (int i = 0; i < lives; i++)
+		{
+			mat4 place = Translate(-0.9f + i * 0.1f, -0.9f, 0);
+			glUniformMatrix4fv(modelView_loc, 1, GL_TRUE, place * Scale(0.003f, 0.01f, 0) * projection);
+			cube.draw(true);
+			glUniformMatrix4fv(modelView_loc, 1, GL_TRUE, place * RotateZ(90) * Scale(0.003f, 0.01f, 0) * projection);
+			cube.draw(true);
+		}
+		for (int i = 0; i < bullets; i++)
+		{
+			glUniformMatrix4fv(modelView_loc, 1, GL_TRUE, Translate(-0.9f + i * 0.03f, 0.9f, 0) * Scale(0.002f, 0.01f, 0) * projection);
+			cube.draw(true);
+		}
+	}
+	glFinish();
+	double referenceMs = milliseconds(start, Clock::now()) / frames;
+	target.read(reference);
+
+	glUseProgram(0);
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteProgram(program);
+	GLenum error = glGetError();
+
+	size_t lit = litPixels(reference), differ = 0;
+	for (size_t i = 0; i < reference.size(); i += 4)
+		differ += std::equal(&reference[i], &reference[i] + 4, &batched[i]) ? 0 : 1;
+
+	std::cout << "HUD: " << litPixels(batched) << " pixels lit against " << lit << " from the cubes, " << differ << " differ\n"
+			  << "  built " << steadyRebuilds << " times in " << frames << " frames, " << changedRebuilds
+			  << " after two changes; " << batchedMs << " ms a frame in 1 draw, " << referenceMs << " ms in "
+			  << 2 * lives + bullets << ", " << hud.bufferBytes() << " bytes of vertices" << std::endl;
+	if (error != GL_NO_ERROR)
+		std::cerr << "GL error " << ErrorString(error) << std::endl;
+
+	bool ok = lit > 0 && differ <= lit / 50 && steadyRebuilds == 1 && changedRebuilds == 3 && error == GL_NO_ERROR;
+	std::cout << (ok ? "HUD matches" : "HUD differs") << std::endl;
+	return ok ? 0 : 1;
+}
+
+// particle fields refilled in a ring and meshes made and destroyed each
+// frame, following the tracked GL buffer bytes; returns 1 if they keep
+// growing after the warm-up
+static int checkBufferSoak()
+{
+	const unsigned int warmup = 60, frames = 600;
+	const double tolerance = 64 * 1024;
+	GrowthWatch watch(warmup, tolerance);
+
+	size_t startBytes = trackedBufferBytes();
+	int startCount = trackedBufferCount();
+	int peakCount = startCount;
+	{
+		shipParticles fields[World::max_particle_fields];
+		int newest = -1;
+		for (unsigned int f = 0; f < warmup + frames; f++)
+		{
+			frameArena().reset();
+			newest = (newest + 1) % World::max_particle_fields;
+			fields[newest].init();
+
+			Ship ship;
+			ship.init();
+			CubeMesh cube;
+			cube.init();
+			CylinderMesh cylinder;
+			cylinder.init();
+			peakCount = std::max(peakCount, trackedBufferCount());
+
+			watch.sample((double)trackedBufferBytes());
+		}
+	}
+	size_t endBytes = trackedBufferBytes();
+	int endCount = trackedBufferCount();
+	GLenum error = glGetError();
+
+	bool leaking = watch.growing();
+	std::cout << "GL buffers: " << (leaking ? "KEEP GROWING" : "level off") << " over " << frames
+			  << " frames after " << warmup << " (" << watch.slope() << " bytes/frame), peak "
+			  << peakCount - startCount << " buffers, " << endCount - startCount << " and "
+			  << (long long)endBytes - (long long)startBytes << " bytes left after" << std::endl;
+	if (error != GL_NO_ERROR)
+		std::cerr << "GL error " << ErrorString(error) << std::endl;
+
+	bool ok = !leaking && endCount == startCount && endBytes == startBytes && error == GL_NO_ERROR;
+	std::cout << (ok ? "GL buffers level off" : "GL buffers leak") << std::endl;
+	return ok ? 0 : 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+int main(int argc, char** argv)
+{
+	size_t asteroids = 100000, objects = 10000;
+	int ticks = 600;
+	unsigned int seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--asteroids" && hasValue) asteroids = (size_t)std::max(1, atoi(argv[++i]));
+		else if (arg == "--objects" && hasValue) objects = (size_t)std::max(1, atoi(argv[++i]));
+		else if (arg == "--ticks" && hasValue) ticks = std::max(1, atoi(argv[++i]));
+		else if (arg == "--seed" && hasValue) seed = (unsigned)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			std::cerr << "usage: gpu_check [--asteroids N] [--objects N] [--ticks N] [--seed N]" << std::endl;
+			return 2;
+		}
+	}
+
+	if (!makeContext() || !GpuAsteroids::supported())
+		return 2;
+
+	int result = checkAsteroids(asteroids, ticks, seed);
+	if (GpuScene::supported())
+		result |= checkScene(objects, seed);
+	else
+		std::cout << "no storage buffers in vertex shaders, GPU scene left out" << std::endl;
+	result |= checkBackground();
+	result |= checkBackgroundCache();
+	result |= checkHud();
+	result |= checkBufferSoak();
+	return result;
+}
@@ -0,0 +1,382 @@
+#include "gpu_scene.h"
+
+#ifdef GL_COMPUTE_SHADER
+
+#include <algorithm>
+
+#include "gl_utilities.h"
+#include "meshes.h"
+#include "gpu_asteroids.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// invocations per work group, as the shaders declare them
+static const GLuint sceneGroup = 256;
+
+// the buffer bindings the shaders declare (the field's as in gpu_asteroids.cpp)
+enum
+{
+	BIND_FIELD_POSITIONS,
+	BIND_FIELD_VELOCITIES,
+	BIND_FIELD_SIZES,
+	BIND_OBJECTS,
+	BIND_COMMANDS,
+	BIND_VISIBLE
+};
+
+static GLuint groups(size_t n, GLuint group)
+{
+	return (GLuint)((n + group - 1) / group);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+GpuScene::GpuScene()
+	: numObjects(0), impostorMesh(noMesh), impostorDistance(0), eye(0, 0, 0, 0)
+	, vertexBytes(0), indexBytes(0)
+	, cullProgram(0), fieldProgram(0), drawProgram(0), impostorProgram(0), vao(0)
+	, objectBuffer(0), commandBuffer(0), templateBuffer(0), visibleBuffer(0)
+	, vertexBuffer(0), indexBuffer(0)
+{
+}
+
+GpuScene::~GpuScene()
+{
+	release();
+}
+
+bool GpuScene::supported()
+{
+	// both stay 0 in contexts older than 3.0, which do not know the names
+	GLint major = 0, minor = 0, vertexBlocks = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 3))
+		glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+	while (glGetError() != GL_NO_ERROR)
+		;
+	return vertexBlocks > 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+GLuint GpuScene::addMesh(const Mesh& mesh)
+{
+	if (meshInfo.size() == maxMeshes)
+		return noMesh;
+
+	std::vector< vec4 > v;
+	std::vector< GLuint > i;
+	mesh.triangles(v, i);
+
+	MeshInfo info;
+	info.firstIndex = (GLuint)indices.size();
+	info.count = (GLuint)i.size();
+	info.baseVertex = (GLint)vertices.size();
+
+	// a sphere round the middle of the box the vertices fit in
+	vec4 low = v[0], high = v[0];
+	for (size_t k = 1; k < v.size(); k++)
+	{
+		low = vec4(std::min(low.x, v[k].x), std::min(low.y, v[k].y), std::min(low.z, v[k].z), 1);
+		high = vec4(std::max(high.x, v[k].x), std::max(high.y, v[k].y), std::max(high.z, v[k].z), 1);
+	}
+	vec4 centre = (low + high) * 0.5f;
+	float radius = 0;
+	for (size_t k = 0; k < v.size(); k++)
+	{
+		vec4 d = v[k] - centre;
+		radius = std::max(radius, d.x * d.x + d.y * d.y + d.z * d.z);
+	}
+	info.bounds = vec4(centre.x, centre.y, centre.z, sqrtf(radius));
+
+	vertices.insert(vertices.end(), v.begin(), v.end());
+	indices.insert(indices.end(), i.begin(), i.end());
+	meshInfo.push_back(info);
+	return (GLuint)(meshInfo.size() - 1);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static GLuint sceneBuffer(GLenum target, const char* owner, size_t bytes, const GLvoid* data, GLenum usage)
+{
+	GLuint buffer = trackedGenBuffer(owner);
+	glBindBuffer(target, buffer);
+	trackedBufferData(target, buffer, bytes, data, usage);
+	return buffer;
+}
+
+void GpuScene::init(size_t capacity)
+{
+	// the geometry is uploaded once
+	if (meshInfo.empty() || vertices.empty())
+		return;
+	numObjects = capacity;
+
+	cullProgram = loadComputeShader("cshader_cull.glsl");
+	cullCount_loc = glGetUniformLocation(cullProgram, "count");
+	cullPlanes_loc = glGetUniformLocation(cullProgram, "planes");
+	cullBounds_loc = glGetUniformLocation(cullProgram, "bounds");
+	cullMeshes_loc = glGetUniformLocation(cullProgram, "numMeshes");
+	cullCapacity_loc = glGetUniformLocation(cullProgram, "capacity");
+	cullImpostorMesh_loc = glGetUniformLocation(cullProgram, "impostorMesh");
+	cullImpostorDistance_loc = glGetUniformLocation(cullProgram, "impostorDistance");
+	cullEye_loc = glGetUniformLocation(cullProgram, "eye");
+
+	fieldProgram = loadComputeShader("cshader_scene_field.glsl");
+	fieldCount_loc = glGetUniformLocation(fieldProgram, "count");
+	fieldFirst_loc = glGetUniformLocation(fieldProgram, "first");
+	fieldMesh_loc = glGetUniformLocation(fieldProgram, "mesh");
+	fieldColour_loc = glGetUniformLocation(fieldProgram, "colour");
+	fieldBack_loc = glGetUniformLocation(fieldProgram, "back");
+
+	drawProgram = loadAndInitializeShaders("vshader_scene.glsl", "fshader_asteroids.glsl");
+	drawProjView_loc = glGetUniformLocation(drawProgram, "projView");
+	drawPosition_loc = glGetAttribLocation(drawProgram, "in_Position");
+	drawObject_loc = glGetAttribLocation(drawProgram, "in_Object");
+
+	// (its attributes are at the same locations as drawProgram's)
+	impostorProgram = loadAndInitializeShaders("vshader_impostor.glsl", "fshader_impostor.glsl");
+	impostorProjView_loc = glGetUniformLocation(impostorProgram, "projView");
+	impostorEye_loc = glGetUniformLocation(impostorProgram, "eye");
+
+	// the impostors' quad, after the meshes
+	const vec4 corners[] = { vec4(-1, -1, 0, 1), vec4(1, -1, 0, 1), vec4(1, 1, 0, 1), vec4(-1, 1, 0, 1) };
+	const GLuint corner[] = { 0, 1, 2, 0, 2, 3 };
+	quad.firstIndex = (GLuint)indices.size();
+	quad.count = 6;
+	quad.baseVertex = (GLint)vertices.size();
+	quad.bounds = vec4(0, 0, 0, 1);
+	vertices.insert(vertices.end(), corners, corners + 4);
+	indices.insert(indices.end(), corner, corner + 6);
+
+	// every object starts empty (all ones, so noMesh)
+	objectBuffer = sceneBuffer(GL_SHADER_STORAGE_BUFFER, "GpuScene objects", numObjects * sizeof(SceneObject), NULL, GL_DYNAMIC_DRAW);
+	const GLuint ones = noMesh;
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &ones);
+
+	// a command per mesh and the impostors', each listing its objects in
+	// its own capacity long part of the visible buffer (what baseInstance
+	// points at)
+	std::vector< DrawCommand > commands(meshInfo.size() + 1);
+	for (size_t m = 0; m < commands.size(); m++)
+	{
+		const MeshInfo& info = m < meshInfo.size() ? meshInfo[m] : quad;
+		commands[m].count = info.count;
+		commands[m].instanceCount = 0;
+		commands[m].firstIndex = info.firstIndex;
+		commands[m].baseVertex = info.baseVertex;
+		commands[m].baseInstance = (GLuint)(m * numObjects);
+	}
+	size_t commandBytes = commands.size() * sizeof(DrawCommand);
+	templateBuffer = sceneBuffer(GL_COPY_READ_BUFFER, "GpuScene command template", commandBytes, &commands[0], GL_STATIC_DRAW);
+	commandBuffer = sceneBuffer(GL_DRAW_INDIRECT_BUFFER, "GpuScene commands", commandBytes, &commands[0], GL_DYNAMIC_COPY);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	visibleBuffer = sceneBuffer(GL_ARRAY_BUFFER, "GpuScene visible", commands.size() * numObjects * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+
+	// the geometry stays on the GPU only
+	vertexBytes = vertices.size() * sizeof(vec4);
+	indexBytes = indices.size() * sizeof(GLuint);
+	vertexBuffer = sceneBuffer(GL_ARRAY_BUFFER, "GpuScene vertices", vertexBytes, &vertices[0], GL_STATIC_DRAW);
+	std::vector< vec4 >().swap(vertices);
+
+	GLint previous = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	indexBuffer = sceneBuffer(GL_ELEMENT_ARRAY_BUFFER, "GpuScene indices", indexBytes, &indices[0], GL_STATIC_DRAW);
+	std::vector< GLuint >().swap(indices);
+	glVertexAttribPointer(drawPosition_loc, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), BUFFER_OFFSET(0));
+	glEnableVertexAttribArray(drawPosition_loc);
+	glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+	glVertexAttribIPointer(drawObject_loc, 1, GL_UNSIGNED_INT, sizeof(GLuint), BUFFER_OFFSET(0));
+	glVertexAttribDivisor(drawObject_loc, 1);
+	glEnableVertexAttribArray(drawObject_loc);
+	glBindVertexArray(previous);
+}
+
+void GpuScene::release()
+{
+	GLuint* buffers[] = { &objectBuffer, &commandBuffer, &templateBuffer, &visibleBuffer, &vertexBuffer, &indexBuffer };
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+	{
+		if (*buffers[i])
+			trackedDeleteBuffer(*buffers[i]);
+		*buffers[i] = 0;
+	}
+
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	vao = 0;
+	GLuint* programs[] = { &cullProgram, &fieldProgram, &drawProgram, &impostorProgram };
+	for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+	{
+		if (*programs[i])
+			glDeleteProgram(*programs[i]);
+		*programs[i] = 0;
+	}
+
+	numObjects = 0;
+	impostorMesh = noMesh;
+	vertexBytes = indexBytes = 0;
+	meshInfo.clear();
+	vertices.clear();
+	indices.clear();
+}
+
+size_t GpuScene::bufferBytes() const
+{
+	return numObjects * (sizeof(SceneObject) + (meshInfo.size() + 1) * sizeof(GLuint))
+		+ 2 * (meshInfo.size() + 1) * sizeof(DrawCommand) + vertexBytes + indexBytes;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void GpuScene::setObjects(size_t first, const SceneObject* objects, size_t n)
+{
+	n = std::min(n, numObjects - std::min(first, numObjects));
+	if (n == 0)
+		return;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+	trackedBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(SceneObject), n * sizeof(SceneObject), objects);
+}
+
+void GpuScene::setObjects(size_t first, const GpuAsteroids& field, GLuint mesh, const vec4& colour, float alpha)
+{
+	size_t n = std::min(field.capacity(), numObjects - std::min(first, numObjects));
+	if (n == 0)
+		return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_FIELD_POSITIONS, field.positions());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_FIELD_VELOCITIES, field.velocities());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_FIELD_SIZES, field.sizes());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_OBJECTS, objectBuffer);
+
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(fieldProgram);
+	glUniform1ui(fieldCount_loc, (GLuint)n);
+	glUniform1ui(fieldFirst_loc, (GLuint)first);
+	glUniform1ui(fieldMesh_loc, mesh);
+	glUniform4fv(fieldColour_loc, 1, colour);
+	glUniform1f(fieldBack_loc, alpha - 1);
+	glDispatchCompute(groups(n, sceneGroup), 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	glUseProgram(previous);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void GpuScene::setImpostors(GLuint mesh, float distance)
+{
+	impostorMesh = mesh < meshInfo.size() ? mesh : noMesh;
+	impostorDistance = distance;
+}
+
+void GpuScene::cull(const mat4& projView)
+{
+	if (numObjects == 0)
+		return;
+
+	// the frustum's planes (pointing in) from the rows of projView:
+	// left, right, bottom, top, near, far
+	vec4 planes[6];
+	for (int i = 0; i < 3; i++)
+	{
+		planes[2 * i] = projView[3] + projView[i];
+		planes[2 * i + 1] = projView[3] - projView[i];
+	}
+	for (int i = 0; i < 6; i++)
+	{
+		vec4& p = planes[i];
+		p = p / sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+	}
+	vec4 bounds[maxMeshes];
+	for (size_t m = 0; m < meshInfo.size(); m++)
+		bounds[m] = meshInfo[m].bounds;
+
+	eye = eyePoint(projView);
+	GLuint impostors = eye.w != 0 ? impostorMesh : noMesh;
+
+	// every instance count back to 0
+	glBindBuffer(GL_COPY_READ_BUFFER, templateBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (meshInfo.size() + 1) * sizeof(DrawCommand));
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_OBJECTS, objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_COMMANDS, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_VISIBLE, visibleBuffer);
+
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(cullProgram);
+	glUniform1ui(cullCount_loc, (GLuint)numObjects);
+	glUniform4fv(cullPlanes_loc, 6, &planes[0].x);
+	glUniform4fv(cullBounds_loc, (GLsizei)meshInfo.size(), &bounds[0].x);
+	glUniform1ui(cullMeshes_loc, (GLuint)meshInfo.size());
+	glUniform1ui(cullCapacity_loc, (GLuint)numObjects);
+	glUniform1ui(cullImpostorMesh_loc, impostors);
+	glUniform1f(cullImpostorDistance_loc, impostorDistance);
+	glUniform3f(cullEye_loc, eye.x, eye.y, eye.z);
+	glDispatchCompute(groups(numObjects, sceneGroup), 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	glUseProgram(previous);
+}
+
+void GpuScene::draw(const mat4& projView)
+{
+	if (numObjects == 0)
+		return;
+
+	GLint previousProgram = 0, previousVao = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVao);
+
+	glUseProgram(drawProgram);
+	glUniformMatrix4fv(drawProjView_loc, 1, GL_TRUE, projView);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BIND_OBJECTS, objectBuffer);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, BUFFER_OFFSET(0), (GLsizei)meshInfo.size(), sizeof(DrawCommand));
+
+	// the impostors' command comes after the meshes'
+	if (impostorMesh != noMesh && eye.w != 0)
+	{
+		glUseProgram(impostorProgram);
+		glUniformMatrix4fv(impostorProjView_loc, 1, GL_TRUE, projView);
+		glUniform3f(impostorEye_loc, eye.x, eye.y, eye.z);
+		glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, BUFFER_OFFSET(meshInfo.size() * sizeof(DrawCommand)));
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindVertexArray(previousVao);
+	glUseProgram(previousProgram);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void GpuScene::visibleCounts(GLuint* counts)
+{
+	std::vector< DrawCommand > commands(meshInfo.size() + 1);
+	glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, commands.size() * sizeof(DrawCommand), &commands[0]);
+	for (size_t m = 0; m < commands.size(); m++)
+		counts[m] = commands[m].instanceCount;
+}
+
+void GpuScene::visibleObjects(GLuint mesh, std::vector< GLuint >& objects)
+{
+	std::vector< GLuint > counts(meshInfo.size() + 1);
+	visibleCounts(&counts[0]);
+	objects.resize(counts[mesh]);
+	if (objects.empty())
+		return;
+	glBindBuffer(GL_COPY_READ_BUFFER, visibleBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, mesh * numObjects * sizeof(GLuint), objects.size() * sizeof(GLuint), &objects[0]);
+}
+
+}
+
+#endif // GL_COMPUTE_SHADER
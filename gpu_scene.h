@@ -0,0 +1,168 @@
+#ifndef DJV_GPU_SCENE_H_
+#define DJV_GPU_SCENE_H_
+/*
+	Objects culled and drawn by the GPU
+
+	Every object (a transform, a colour and which mesh) lives in a GPU
+	buffer. cull() is one compute dispatch that tests each object's
+	bounding sphere against the frustum and counts the ones left into a
+	DrawElementsIndirectCommand per mesh; draw() is then a single
+	glMultiDrawElementsIndirect over one geometry buffer all the meshes
+	share. Neither reads anything back, so what the CPU does per frame
+	stays the same however many objects there are.
+
+		GpuScene scene;
+		GLuint sphereId = scene.addMesh(sphere);
+		GLuint cubeId = scene.addMesh(cube);
+		scene.init(100000);
+		scene.setObjects(0, objects, numObjects);   (or from a GpuAsteroids)
+		for (;;)
+		{
+			scene.cull(projView);
+			scene.draw(projView);
+		}
+
+	Objects of one sphere mesh can be drawn as impostors once they are far
+	enough away (setImpostors()): the cull pass lists them for one more
+	command, a camera-facing quad each, and the quad's fragments ray cast
+	the ellipsoid the object's model makes of the sphere, depth included.
+	That is two triangles an asteroid instead of the sphere's hundreds.
+
+	Meshes filled with triangles only (sphere, cube, cylinder). Needs a
+	GL 4.3 context that lets vertex shaders read storage buffers.
+*/
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "gl_include.h"
+#include "vec.h"
+#include "mat.h"
+
+#ifdef GL_COMPUTE_SHADER
+
+namespace djv {
+
+class Mesh;
+class GpuAsteroids;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// one object as the shaders read it (std430, model row by row)
+struct SceneObject
+{
+	mat4 model;
+	vec4 colour;
+	GLuint mesh; // from addMesh(), or GpuScene::noMesh for an empty slot
+	GLuint padding[3];
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class GpuScene
+{
+public:
+	static const GLuint noMesh = 0xFFFFFFFFu;
+	static const size_t maxMeshes = 16;
+
+	GpuScene();
+	~GpuScene();
+
+	// whether the current context can run it
+	static bool supported();
+
+	// copies a mesh's triangles into the shared geometry, before init();
+	// returns the id objects refer to it by
+	GLuint addMesh(const Mesh& mesh);
+
+	// loads the shaders and creates the buffers, every object empty (once,
+	// after at least one addMesh()); release() forgets the meshes as well
+	void init(size_t capacity);
+	void release();
+
+	size_t capacity() const { return numObjects; }
+	size_t meshes() const { return meshInfo.size(); }
+
+	// objects [first, first + n)
+	void setObjects(size_t first, const SceneObject* objects, size_t n);
+
+	// objects [first, first + field.capacity()) made on the GPU from the
+	// asteroids' own buffers, as GpuAsteroids::draw() places them
+	void setObjects(size_t first, const GpuAsteroids& field, GLuint mesh, const vec4& colour, float alpha = 1);
+
+	// objects of 'mesh', which has to be a unit sphere about the origin
+	// (SphereMesh), are drawn as impostors when they are farther than
+	// 'distance' from the eye; noMesh draws every object as its mesh
+	void setImpostors(GLuint mesh, float distance);
+
+	// fills the draw commands with the objects inside projView's frustum
+	// (and the impostors, when projView has an eye: a perspective)
+	void cull(const mat4& projView);
+
+	// every object the last cull() left, in one draw call (and one more
+	// for the impostors)
+	void draw(const mat4& projView);
+
+	// the objects the last cull() left of each mesh, and which they are,
+	// the impostors last, as mesh meshes() (waits for the GPU; checks only)
+	void visibleCounts(GLuint* counts);
+	void visibleObjects(GLuint mesh, std::vector< GLuint >& objects);
+
+	// a mesh's bounding sphere (x, y, z, radius) in its own space
+	vec4 bounds(GLuint mesh) const { return meshInfo[mesh].bounds; }
+
+	// bytes of GPU memory in the buffers
+	size_t bufferBytes() const;
+
+private:
+	// as glMultiDrawElementsIndirect reads them
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct MeshInfo
+	{
+		GLuint firstIndex, count;
+		GLint baseVertex;
+		vec4 bounds;
+	};
+
+	GpuScene(const GpuScene&);
+	GpuScene& operator=(const GpuScene&);
+
+	size_t numObjects;
+	std::vector< MeshInfo > meshInfo;
+	MeshInfo quad; // the impostors' geometry
+	GLuint impostorMesh;
+	float impostorDistance;
+	vec4 eye; // as the last cull() found it, w = 0 if there was none
+	std::vector< vec4 > vertices; // until init()
+	std::vector< GLuint > indices;
+	size_t vertexBytes, indexBytes;
+
+	GLuint cullProgram, fieldProgram, drawProgram, impostorProgram;
+	GLint cullCount_loc, cullPlanes_loc, cullBounds_loc, cullMeshes_loc, cullCapacity_loc;
+	GLint cullImpostorMesh_loc, cullImpostorDistance_loc, cullEye_loc;
+	GLint fieldCount_loc, fieldFirst_loc, fieldMesh_loc, fieldColour_loc, fieldBack_loc;
+	GLint drawProjView_loc, drawPosition_loc, drawObject_loc;
+	GLint impostorProjView_loc, impostorEye_loc;
+	GLuint vao;
+
+	// objects, draw commands (a mesh each, then the impostors', and the
+	// empty ones they start from), which objects each command draws, the
+	// shared geometry
+	GLuint objectBuffer, commandBuffer, templateBuffer, visibleBuffer;
+	GLuint vertexBuffer, indexBuffer;
+};
+
+}
+
+#endif // GL_COMPUTE_SHADER
+
+#endif
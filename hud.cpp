@@ -0,0 +1,164 @@
+#include "hud.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "gl_utilities.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the layout, as the bars were placed when they were cubes: the unit cube
+// through the projection, shrunk and moved into place in clip space
+static const float livesX = -0.9f, livesY = -0.9f, livesSpacing = 0.1f;
+static const float bulletsX = -0.9f, bulletsY = 0.9f, bulletsSpacing = 0.03f;
+
+// enough for the counts a game starts with, so the vector never grows
+static const int usualQuads = 2 * 8 + 64;
+
+Hud::Hud()
+	: program(0), buffer(0), positionLoc(-1), colourLoc(-1), capacity(0), count(0)
+	, built(false), builtLives(0), builtBullets(0), rebuildCount(0)
+{
+}
+
+Hud::~Hud()
+{
+	release();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Hud::init()
+{
+	release();
+	program = loadAndInitializeShaders("vshader_overlay.glsl", "fshader2.glsl");
+	positionLoc = glGetAttribLocation(program, "in_Position");
+	colourLoc = glGetAttribLocation(program, "in_Colour");
+	buffer = trackedGenBuffer("Hud");
+	vertices.reserve(6 * usualQuads);
+}
+
+void Hud::release()
+{
+	if (buffer)
+		trackedDeleteBuffer(buffer);
+	buffer = 0;
+	if (program)
+		glDeleteProgram(program);
+	program = 0;
+	capacity = 0;
+	count = 0;
+	built = false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Hud::bar(const mat4& transform, const vec4& c)
+{
+	float x0 = 1e30f, y0 = 1e30f, x1 = -1e30f, y1 = -1e30f;
+	for (int i = 0; i < 8; i++)
+	{
+		vec4 corner((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f, 1);
+		vec4 p = transform * corner;
+		x0 = std::min(x0, p.x / p.w);
+		x1 = std::max(x1, p.x / p.w);
+		y0 = std::min(y0, p.y / p.w);
+		y1 = std::max(y1, p.y / p.w);
+	}
+
+	Vertex v[4] = {
+		{ x0, y0, c.x, c.y, c.z, c.w },
+		{ x1, y0, c.x, c.y, c.z, c.w },
+		{ x1, y1, c.x, c.y, c.z, c.w },
+		{ x0, y1, c.x, c.y, c.z, c.w }
+	};
+	vertices.push_back(v[0]);
+	vertices.push_back(v[1]);
+	vertices.push_back(v[2]);
+	vertices.push_back(v[0]);
+	vertices.push_back(v[2]);
+	vertices.push_back(v[3]);
+}
+
+void Hud::rebuild(const mat4& projection, int lives, int bullets, const vec4& colour)
+{
+	vertices.clear();
+
+	// each life an upright bar and the same turned a quarter, a cross
+	const mat4 upright = Scale(0.003f, 0.01f, 0) * projection;
+	const mat4 across = RotateZ(90) * upright;
+	for (int i = 0; i < lives; i++)
+	{
+		mat4 place = Translate(livesX + i * livesSpacing, livesY, 0);
+		bar(place * upright, colour);
+		bar(place * across, colour);
+	}
+
+	const mat4 bullet = Scale(0.002f, 0.01f, 0) * projection;
+	for (int i = 0; i < bullets; i++)
+		bar(Translate(bulletsX + i * bulletsSpacing, bulletsY, 0) * bullet, colour);
+
+	// the buffer stays; it is only specified again when it has to grow
+	size_t bytes = vertices.size() * sizeof(Vertex);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (bytes > capacity)
+	{
+		capacity = std::max(bytes, 6 * usualQuads * sizeof(Vertex));
+		trackedBufferData(GL_ARRAY_BUFFER, buffer, capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (bytes > 0)
+		trackedBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &vertices.front());
+	count = (GLsizei)vertices.size();
+
+	built = true;
+	builtProjection = projection;
+	builtColour = colour;
+	builtLives = lives;
+	builtBullets = bullets;
+	rebuildCount++;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Hud::draw(const mat4& projection, int lives, int bullets, const vec4& colour)
+{
+	lives = std::max(0, lives);
+	bullets = std::max(0, bullets);
+	if (!built || lives != builtLives || bullets != builtBullets
+		|| memcmp(&projection, &builtProjection, sizeof(mat4)) != 0
+		|| memcmp(&colour, &builtColour, sizeof(vec4)) != 0)
+		rebuild(projection, lives, bullets, colour);
+	if (count == 0)
+		return;
+
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(program);
+
+	// the main program keeps its position attribute enabled, leave it that way
+	GLint colourWasEnabled = 0, positionWasEnabled = 0;
+	glGetVertexAttribiv(colourLoc, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &colourWasEnabled);
+	glGetVertexAttribiv(positionLoc, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &positionWasEnabled);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableVertexAttribArray(positionLoc);
+	glEnableVertexAttribArray(colourLoc);
+	glVertexAttribPointer(positionLoc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(0));
+	glVertexAttribPointer(colourLoc, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(2 * sizeof(GLfloat)));
+
+	glDisable(GL_DEPTH_TEST);
+	glDrawArrays(GL_TRIANGLES, 0, count);
+	glEnable(GL_DEPTH_TEST);
+
+	if (!colourWasEnabled)
+		glDisableVertexAttribArray(colourLoc);
+	if (!positionWasEnabled)
+		glDisableVertexAttribArray(positionLoc);
+
+	glUseProgram(previous);
+}
+
+}
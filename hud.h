@@ -0,0 +1,82 @@
+#ifndef DJV_HUD_H_
+#define DJV_HUD_H_
+/*
+	The heads-up display
+
+	A red bar and a cross for every life left along the bottom of the
+	screen, and a bar for every bullet along the top. They used to be a
+	projected cube each, a draw call and a matrix upload apiece, up to
+	sixty-odd a frame. Now every bar is a quad in normalized device
+	coordinates, all of them in one vertex buffer that is kept from frame
+	to frame and only written again when the counts (or the projection
+	they are laid out with) change. The frame then costs one draw call,
+	over everything else and without depth.
+*/
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "gl_include.h"
+#include "vec.h"
+#include "mat.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class Hud
+{
+public:
+	Hud();
+	~Hud();
+
+	// load the overlay shaders and create the buffer (needs a GL context)
+	void init();
+	void release();
+
+	// the lives and bullets left, laid out with the game's projection, in
+	// 'colour'; leaves the current program as it was
+	void draw(const mat4& projection, int lives, int bullets, const vec4& colour);
+
+	// times the quads have been built and uploaded
+	unsigned long long rebuilds() const { return rebuildCount; }
+
+	// bytes of vertex memory it uses
+	size_t bufferBytes() const { return capacity; }
+
+private:
+	// position in normalized device coordinates, colour per vertex
+	struct Vertex
+	{
+		GLfloat x, y;
+		GLfloat r, g, b, a;
+	};
+
+	Hud(const Hud&);
+	Hud& operator=(const Hud&);
+
+	// the quad the unit cube covers on screen through 'transform'
+	void bar(const mat4& transform, const vec4& colour);
+	void rebuild(const mat4& projection, int lives, int bullets, const vec4& colour);
+
+	std::vector< Vertex > vertices;
+
+	GLuint program;
+	GLuint buffer;
+	GLint positionLoc;
+	GLint colourLoc;
+	size_t capacity;
+	GLsizei count;
+
+	// what the buffer holds
+	bool built;
+	mat4 builtProjection;
+	vec4 builtColour;
+	int builtLives, builtBullets;
+	unsigned long long rebuildCount;
+};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "isa.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#if defined(DJV_ISA_DISPATCH) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(DJV_ISA_DISPATCH)
+#include <cpuid.h>
+#endif
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static const char* const isaNames[] = { "scalar", "sse2", "avx2", "avx512" };
+
+const char* isaName(IsaLevel level)
+{
+	return isaNames[level];
+}
+
+bool parseIsa(const char* name, IsaLevel& level)
+{
+	for (int i = ISA_SCALAR; i <= ISA_AVX512; i++)
+	{
+		if (strcmp(name, isaNames[i]) == 0)
+		{
+			level = (IsaLevel)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#ifdef DJV_ISA_DISPATCH
+
+// eax, ebx, ecx, edx of cpuid leaf 'leaf', sub-leaf 'sub'
+static void cpuid(unsigned int leaf, unsigned int sub, unsigned int r[4])
+{
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuidex(regs, (int)leaf, (int)sub);
+	for (int i = 0; i < 4; i++)
+		r[i] = (unsigned int)regs[i];
+#else
+	__cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// the register state the OS saves on a context switch (XCR0)
+static unsigned long long enabledState()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static IsaLevel probe()
+{
+	unsigned int r[4];
+	cpuid(0, 0, r);
+	unsigned int maxLeaf = r[0];
+
+	cpuid(1, 0, r);
+	if (!(r[3] & (1u << 26))) // SSE2
+		return ISA_SCALAR;
+
+	// AVX registers need the CPU and the OS (OSXSAVE, then XMM and YMM
+	// state in XCR0); AVX-512 also needs the opmask and ZMM state
+	bool osxsave = (r[2] & (1u << 27)) != 0;
+	bool avx = (r[2] & (1u << 28)) != 0;
+	if (!osxsave || !avx || maxLeaf < 7)
+		return ISA_SSE2;
+	unsigned long long state = enabledState();
+	if ((state & 0x06) != 0x06)
+		return ISA_SSE2;
+
+	cpuid(7, 0, r);
+	if (!(r[1] & (1u << 5))) // AVX2
+		return ISA_SSE2;
+	if (!(r[1] & (1u << 16)) || (state & 0xe6) != 0xe6) // AVX512F
+		return ISA_AVX2;
+	return ISA_AVX512;
+}
+
+#else
+
+static IsaLevel probe()
+{
+#ifdef DJV_SIMD_SSE
+	return ISA_SSE2;
+#else
+	return ISA_SCALAR;
+#endif
+}
+
+#endif
+
+IsaLevel detectIsa()
+{
+	static const IsaLevel detected = probe();
+	return detected;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IsaLevel requestedIsa()
+{
+	IsaLevel level = detectIsa();
+	const char* name = getenv("DJV_ISA");
+	if (!name || !*name)
+		return level;
+
+	IsaLevel asked;
+	if (!parseIsa(name, asked))
+	{
+		std::cerr << "DJV_ISA: unknown level '" << name << "', using " << isaName(level) << std::endl;
+		return level;
+	}
+	return asked < level ? asked : level;
+}
+
+}
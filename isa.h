@@ -0,0 +1,64 @@
+#ifndef DJV_ISA_H_
+#define DJV_ISA_H_
+/*
+	Instruction set levels
+
+	The batched kernels (mat.cpp) come in one version per level below and
+	are bound once, at startup, to the best one the CPU and the OS support.
+	So one binary runs on all x86-64 machines and still uses their widest
+	vectors. DJV_ISA=scalar, sse2, avx2 or avx512 in the environment asks
+	for a lower level (for benchmarking); asking for a level the machine
+	does not have gets the best one it has.
+
+	The versions take the same steps in the same order, only more elements
+	at a time (no FMA), so every level gives the same bits.
+*/
+
+#include "vec.h"
+
+// the AVX2 and AVX-512 versions are compiled into every x86 build, with
+// the instruction set enabled for those functions only
+#if defined(DJV_SIMD_SSE) && (defined(__GNUC__) || defined(_MSC_VER))
+#define DJV_ISA_DISPATCH 1
+#include <immintrin.h>
+#if defined(__clang__)
+#define DJV_TARGET_AVX2 __attribute__((target("avx2")))
+#define DJV_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(__GNUC__)
+// GCC's AVX-512 includes FMA and would fuse the multiplies and adds
+#define DJV_TARGET_AVX2 __attribute__((target("avx2")))
+#define DJV_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define DJV_TARGET_AVX2
+#define DJV_TARGET_AVX512
+#endif
+#endif
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+enum IsaLevel
+{
+	ISA_SCALAR,
+	ISA_SSE2,
+	ISA_AVX2,
+	ISA_AVX512
+};
+
+// the best level this machine supports and this build has versions for,
+// found on the first call
+IsaLevel detectIsa();
+
+// the level DJV_ISA asks for, clamped to detectIsa() (detectIsa() if unset)
+IsaLevel requestedIsa();
+
+// "scalar", "sse2", "avx2" or "avx512"
+const char* isaName(IsaLevel level);
+
+// the level for one of the names above, false if it is none of them
+bool parseIsa(const char* name, IsaLevel& level);
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+#include "jobs.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the pool and the queue the current thread works from (NULL and the
+// queue for other threads outside of a pool)
+static thread_local JobSystem* currentSystem = NULL;
+static thread_local unsigned int currentQueue = 0;
+
+JobSystem::JobSystem(unsigned int workers)
+	: queued(0)
+	, quit(false)
+{
+	for (unsigned int i = 0; i <= workers; i++)
+		queues.push_back(new Queue());
+	for (unsigned int i = 0; i < workers; i++)
+		threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard< std::mutex > hold(sleepLock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	for (size_t i = 0; i < queues.size(); i++)
+		delete queues[i];
+	for (size_t i = 0; i < freeJobs.size(); i++)
+		delete freeJobs[i];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+Job* JobSystem::allocate()
+{
+	{
+		std::lock_guard< std::mutex > hold(freeLock);
+		if (!freeJobs.empty())
+		{
+			Job* job = freeJobs.back();
+			freeJobs.pop_back();
+			return job;
+		}
+	}
+	return new Job();
+}
+
+void JobSystem::schedule(Job* job, JobCounter* after)
+{
+	job->done->pending.fetch_add(1, std::memory_order_relaxed);
+
+	// the counter's lock orders this against its last job finishing
+	if (after)
+	{
+		std::lock_guard< std::mutex > hold(after->lock);
+		if (after->pending.load(std::memory_order_acquire) > 0)
+		{
+			after->waiting.push_back(job);
+			return;
+		}
+	}
+	push(job);
+}
+
+void JobSystem::push(Job* job)
+{
+	unsigned int index = (currentSystem == this) ? currentQueue : (unsigned int)threads.size();
+	Queue& queue = *queues[index];
+	{
+		std::lock_guard< std::mutex > hold(queue.lock);
+		queue.jobs.push_back(job);
+	}
+
+	// taking the lock keeps a worker from missing this between testing
+	// 'queued' and going to sleep
+	queued.fetch_add(1, std::memory_order_release);
+	{
+		std::lock_guard< std::mutex > hold(sleepLock);
+	}
+	wake.notify_one();
+}
+
+Job* JobSystem::take()
+{
+	if (queued.load(std::memory_order_acquire) <= 0)
+		return NULL;
+
+	// the newest job of our own queue, then the oldest of the others'
+	unsigned int count = (unsigned int)queues.size();
+	unsigned int own = (currentSystem == this) ? currentQueue : count - 1;
+	for (unsigned int k = 0; k < count; k++)
+	{
+		Queue& queue = *queues[(own + k) % count];
+		std::lock_guard< std::mutex > hold(queue.lock);
+		if (queue.head == queue.jobs.size())
+			continue;
+
+		Job* job;
+		if (k == 0)
+		{
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		else
+			job = queue.jobs[queue.head++];
+		if (queue.head == queue.jobs.size())
+		{
+			queue.jobs.clear();
+			queue.head = 0;
+		}
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		return job;
+	}
+	return NULL;
+}
+
+void JobSystem::execute(Job* job)
+{
+	job->call(job);
+
+	// waiters are taken under the lock, after which the counter (which
+	// may be on a waiting thread's stack) is not touched again
+	JobCounter& done = *job->done;
+	std::vector< Job* > ready;
+	{
+		std::lock_guard< std::mutex > hold(done.lock);
+		if (done.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			ready.swap(done.waiting);
+	}
+	for (size_t i = 0; i < ready.size(); i++)
+		push(ready[i]);
+
+	std::lock_guard< std::mutex > hold(freeLock);
+	freeJobs.push_back(job);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	while (!counter.done())
+	{
+		Job* job = take();
+		if (job)
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+
+	// the job that finished last may still hold the lock
+	std::lock_guard< std::mutex > hold(counter.lock);
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+	currentSystem = this;
+	currentQueue = index;
+	for (;;)
+	{
+		Job* job = take();
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock< std::mutex > hold(sleepLock);
+		while (!quit && queued.load(std::memory_order_acquire) <= 0)
+			wake.wait(hold);
+		if (quit)
+			return;
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static std::mutex sharedLock;
+static std::atomic< JobSystem* > shared(NULL);
+
+static unsigned int defaultWorkers()
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 0;
+}
+
+JobSystem& jobs()
+{
+	JobSystem* system = shared.load(std::memory_order_acquire);
+	if (system)
+		return *system;
+
+	std::lock_guard< std::mutex > hold(sharedLock);
+	system = shared.load(std::memory_order_relaxed);
+	if (!system)
+	{
+		system = new JobSystem(defaultWorkers());
+		shared.store(system, std::memory_order_release);
+	}
+	return *system;
+}
+
+void setJobWorkers(unsigned int workers)
+{
+	std::lock_guard< std::mutex > hold(sharedLock);
+	JobSystem* old = shared.load(std::memory_order_relaxed);
+	shared.store(new JobSystem(workers), std::memory_order_release);
+	delete old;
+}
+
+}
@@ -0,0 +1,169 @@
+#ifndef DJV_JOBS_H_
+#define DJV_JOBS_H_
+/*
+	Job system
+
+	A pool of worker threads with a deque of jobs each. A worker runs the
+	newest job of its own deque and, once that is empty, steals the oldest
+	of another worker's. A thread waiting for jobs runs jobs itself until
+	they are done, so waiting inside a job does not deadlock and the
+	calling thread is one more worker.
+
+		JobCounter done;
+		jobs().run([&] { a(); }, done);
+		jobs().run([&] { b(); }, done, &earlier); // once 'earlier' is done
+		jobs().wait(done);
+
+		jobs().parallelFor(n, 4096, [&](size_t begin, size_t end) { ... });
+
+	The game only hands it work where every element is written by exactly
+	one piece, so the results do not depend on how many threads ran it.
+	Jobs are recycled and the queues keep their memory, so a steady
+	workload makes no allocations.
+*/
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// a task with its captures stored inline
+struct Job
+{
+	static const size_t capacity = 64;
+
+	void (*call)(Job* job);
+	class JobCounter* done;
+	alignas(16) unsigned char storage[capacity];
+};
+
+// counts the unfinished jobs run with it, other jobs can wait for it
+class JobCounter
+{
+public:
+	JobCounter() : pending(0) {}
+
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	JobCounter(const JobCounter&);
+	JobCounter& operator=(const JobCounter&);
+
+	std::atomic< int > pending;
+	std::mutex lock;
+	std::vector< Job* > waiting; // started once pending gets to 0
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class JobSystem
+{
+public:
+	// 'workers' threads besides the ones that wait
+	explicit JobSystem(unsigned int workers);
+	~JobSystem();
+
+	unsigned int workerCount() const { return (unsigned int)threads.size(); }
+
+	// runs task() on the pool, counted by 'done' until it returns; with
+	// 'after' it starts once that has no unfinished jobs left
+	template < class Task >
+	void run(const Task& task, JobCounter& done, JobCounter* after = NULL)
+	{
+		static_assert(sizeof(Task) <= Job::capacity, "the task's captures do not fit in a Job");
+		Job* job = allocate();
+		new (job->storage) Task(task);
+		job->call = &invoke< Task >;
+		job->done = &done;
+		schedule(job, after);
+	}
+
+	// runs jobs until 'counter' has no unfinished ones
+	void wait(JobCounter& counter);
+
+	// body(begin, end) over [0, n) in pieces of 'grain' elements, the first
+	// on the calling thread; returns when all of them are done
+	template < class Body >
+	void parallelFor(size_t n, size_t grain, const Body& body)
+	{
+		if (grain == 0)
+			grain = 1;
+		if (n <= grain || threads.empty())
+		{
+			body(0, n);
+			return;
+		}
+
+		JobCounter done;
+		for (size_t begin = grain; begin < n; begin += grain)
+		{
+			size_t end = (n - begin > grain) ? begin + grain : n;
+			run([&body, begin, end] { body(begin, end); }, done);
+		}
+		body(0, grain);
+		wait(done);
+	}
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	// jobs are taken from the back by their owner and from the front by
+	// thieves; emptied queues start over at the front of their memory
+	struct Queue
+	{
+		Queue() : head(0) {}
+		std::mutex lock;
+		std::vector< Job* > jobs;
+		size_t head;
+	};
+
+	template < class Task >
+	static void invoke(Job* job)
+	{
+		Task* task = reinterpret_cast< Task* >(job->storage);
+		(*task)();
+		task->~Task();
+	}
+
+	Job* allocate();
+	void schedule(Job* job, JobCounter* after);
+	void push(Job* job);
+	Job* take();
+	void execute(Job* job);
+	void workerLoop(unsigned int index);
+
+	std::vector< std::thread > threads;
+	std::vector< Queue* > queues; // one per worker, the last for other threads
+
+	std::mutex freeLock;
+	std::vector< Job* > freeJobs;
+
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::atomic< int > queued;
+	bool quit;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the pool the game and the batch functions share; one worker less than
+// the machine has cores, the thread that waits is the last one
+JobSystem& jobs();
+
+// replaces the shared pool with one of 'workers' threads (benchmarks),
+// nothing may be running on the old one
+void setJobWorkers(unsigned int workers);
+
+}
+
+#endif
@@ -62,4 +62,26 @@ GLint Material::id_specular;
 GLint Material::id_specularExp;
 
 
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+
+// where objects are
+
+void ObjectTransform::initUniformLocations(GLuint program)
+{
+	id_modelView = glGetUniformLocationHelper(program, "modelView");
+	id_normalMatrix = glGetUniformLocationHelper(program, "normalMatrix");
+}
+
+void ObjectTransform::sendUniforms(const mat4& View, const mat3& viewNormal)
+{
+	// the inverse transpose of a product is the product of those
+	glUniformMatrix4fv(id_modelView, 1, GL_TRUE, View * model);
+	glUniformMatrix3fv(id_normalMatrix, 1, GL_TRUE, viewNormal * getNormalMatrix());
+}
+
+// C++ likes to define static types again
+GLint ObjectTransform::id_modelView;
+GLint ObjectTransform::id_normalMatrix;
+
+
 }
\ No newline at end of file
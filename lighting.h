@@ -4,6 +4,7 @@
 
 #include "vec.h"
 #include "mat.h"
+#include "object_transform.h"
 
 
 namespace djv {
@@ -105,6 +106,7 @@ private:
 };
 
 
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,730 @@
+#include "vec.h"
+#include "mat.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#ifdef DJV_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static const unsigned int maxBatchThreads = 16;
+
+static unsigned int batchThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), maxBatchThreads));
+static size_t batchThreshold = 64 * 1024;
+
+void setBatchThreads(unsigned int threads, size_t threshold)
+{
+	batchThreads = std::max(1u, std::min(threads, maxBatchThreads));
+	batchThreshold = threshold;
+}
+
+// runs kernel(begin, end) over [0, n), in one piece or split into 'threads'
+// jobs (jobs.h); the pieces are multiples of 16 so every job starts on a
+// full SIMD group
+template < class Kernel >
+static void chunked(size_t n, const Kernel& kernel)
+{
+	unsigned int threads = batchThreads;
+	if (threads < 2 || n <= batchThreshold)
+	{
+		kernel(0, n);
+		return;
+	}
+
+	size_t piece = ((n + threads - 1) / threads + 15) & ~(size_t)15;
+	jobs().parallelFor(n, piece, kernel);
+}
+
+static unsigned int countBits(unsigned int bits)
+{
+	unsigned int count = 0;
+	for (; bits; bits &= bits - 1)
+		count++;
+	return count;
+}
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+// The kernels, one version per instruction set, each over [begin, end).
+// They add the columns of m weighted by the coordinates in the order of
+// mat4::operator*(vec4), so every version gives each element the same
+// bits; the wider ones hand their last few elements to the narrower ones.
+
+static void transform4Scalar(const mat4& m, const vec4* in, vec4* out, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+		out[i] = scalar::multiply(m, in[i]);
+}
+
+static void transform3Scalar(const mat4& m, const vec3* in, vec3* out, size_t begin, size_t end, GLfloat w)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		vec4 r = scalar::multiply(m, vec4(in[i], w));
+		out[i] = vec3(r.x, r.y, r.z);
+	}
+}
+
+static void transformSoAScalar(const mat4& m, const GLfloat* x, const GLfloat* y, const GLfloat* z,
+							   GLfloat* outX, GLfloat* outY, GLfloat* outZ, size_t begin, size_t end, GLfloat w)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		vec4 r = scalar::multiply(m, vec4(x[i], y[i], z[i], w));
+		outX[i] = r.x;
+		outY[i] = r.y;
+		outZ[i] = r.z;
+	}
+}
+
+static void advanceScalar(vec4* pos, const vec4* dir, GLfloat s, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+		pos[i] = vec4(pos[i].x + dir[i].x*s, pos[i].y + dir[i].y*s, pos[i].z + dir[i].z*s, pos[i].w + dir[i].w*s);
+}
+
+static void advanceRotatedYScalar(vec4* pos, const vec4* dir, const GLfloat* angle,
+								  const GLfloat* speed, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		vec4 d = scalar::multiply(RotateY(angle[i]) * speed[i], dir[i]);
+		pos[i] = vec4(pos[i].x + d.x, pos[i].y + d.y, pos[i].z + d.z, pos[i].w + d.w);
+	}
+}
+
+static void advanceGrowingScalar(vec4* pos, const vec4* vel, GLfloat* size, unsigned char* outside,
+								 size_t begin, size_t end, GLfloat extent)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		vec4 p = vec4(pos[i].x + vel[i].x, pos[i].y + vel[i].y, pos[i].z + vel[i].z, pos[i].w + vel[i].w);
+		pos[i] = p;
+		if (size[i] > 1)
+			size[i] = (GLfloat)(size[i] + 0.1);
+		outside[i] = (p.x > extent || p.z > extent || p.x < -extent || p.z < -extent) ? 1 : 0;
+	}
+}
+
+// as detect_collision (world.cpp) tests it
+static bool within(const vec4& p, const vec4& centre, GLfloat distance)
+{
+	GLfloat dx = centre.x - p.x, dy = centre.y - p.y, dz = centre.z - p.z;
+	return std::sqrt(dx*dx + dy*dy + dz*dz) < distance;
+}
+
+static size_t countWithinScalar(const vec4* points, size_t begin, size_t end, const vec4& centre, GLfloat distance)
+{
+	size_t count = 0;
+	for (size_t i = begin; i < end; i++)
+		count += within(points[i], centre, distance) ? 1 : 0;
+	return count;
+}
+
+// the comparisons are the other way round so a NaN coordinate counts as inside
+static void insideSquareScalar(const vec4* points, size_t begin, size_t end, GLfloat extent, unsigned char* inside)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		const vec4& p = points[i];
+		inside[i] = (p.x > extent || p.z > extent || p.x < -extent || p.z < -extent) ? 0 : 1;
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#ifdef DJV_SIMD_SSE
+
+struct Columns
+{
+	__m128 c0, c1, c2, c3;
+
+	Columns(__m128 c0, __m128 c1, __m128 c2, __m128 c3) : c0(c0), c1(c1), c2(c2), c3(c3) {}
+
+	explicit Columns(const mat4& m)
+		: c0(simdLoad(m[0])), c1(simdLoad(m[1])), c2(simdLoad(m[2])), c3(simdLoad(m[3]))
+	{
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	}
+
+	__m128 apply(__m128 x, __m128 y, __m128 z, __m128 w) const
+	{
+		__m128 s = _mm_mul_ps(c0, x);
+		s = _mm_add_ps(s, _mm_mul_ps(c1, y));
+		s = _mm_add_ps(s, _mm_mul_ps(c2, z));
+		return _mm_add_ps(s, _mm_mul_ps(c3, w));
+	}
+
+	__m128 apply(__m128 v) const
+	{
+		return apply(_mm_shuffle_ps(v, v, 0x00), _mm_shuffle_ps(v, v, 0x55),
+					 _mm_shuffle_ps(v, v, 0xaa), _mm_shuffle_ps(v, v, 0xff));
+	}
+};
+
+static void transform4Sse2(const mat4& m, const vec4* in, vec4* out, size_t begin, size_t end)
+{
+	Columns cols(m);
+	for (size_t i = begin; i < end; i++)
+		_mm_store_ps(&out[i].x, cols.apply(simdLoad(in[i])));
+}
+
+static void transform3Sse2(const mat4& m, const vec3* in, vec3* out, size_t begin, size_t end, GLfloat w)
+{
+	Columns cols(m);
+	__m128 ww = _mm_set1_ps(w);
+	for (size_t i = begin; i < end; i++)
+	{
+		vec3 v = in[i];
+		vec4 r = simdStore(cols.apply(_mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z), ww));
+		out[i] = vec3(r.x, r.y, r.z);
+	}
+}
+
+// one coordinate of several points per register, each row of m broadcast
+static void transformSoASse2(const mat4& m, const GLfloat* x, const GLfloat* y, const GLfloat* z,
+							 GLfloat* outX, GLfloat* outY, GLfloat* outZ, size_t begin, size_t end, GLfloat w)
+{
+	size_t i = begin;
+	GLfloat* outs[3] = { outX, outY, outZ };
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+		__m128 pz = _mm_loadu_ps(z + i), pw = _mm_set1_ps(w);
+		for (int r = 0; r < 3; r++)
+		{
+			__m128 s = _mm_mul_ps(_mm_set1_ps(m[r].x), px);
+			s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(m[r].y), py));
+			s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(m[r].z), pz));
+			s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(m[r].w), pw));
+			_mm_storeu_ps(outs[r] + i, s);
+		}
+	}
+	transformSoAScalar(m, x, y, z, outX, outY, outZ, i, end, w);
+}
+
+static void advanceSse2(vec4* pos, const vec4* dir, GLfloat s, size_t begin, size_t end)
+{
+	__m128 ss = _mm_set1_ps(s);
+	for (size_t i = begin; i < end; i++)
+		_mm_store_ps(&pos[i].x, _mm_add_ps(simdLoad(pos[i]), _mm_mul_ps(simdLoad(dir[i]), ss)));
+}
+
+static void advanceRotatedYSse2(vec4* pos, const vec4* dir, const GLfloat* angle,
+								const GLfloat* speed, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		// the cosine and sine as RotateY makes them; the columns of
+		// RotateY * speed are built directly instead of transposed
+		mat4 r = RotateY(angle[i]);
+		GLfloat c = r[0][0], s = r[0][2];
+		__m128 k = _mm_set1_ps(speed[i]);
+		Columns cols(_mm_mul_ps(k, _mm_setr_ps(c, 0, -s, 0)), _mm_mul_ps(k, _mm_setr_ps(0, 1, 0, 0)),
+					 _mm_mul_ps(k, _mm_setr_ps(s, 0, c, 0)), _mm_mul_ps(k, _mm_setr_ps(0, 0, 0, 1)));
+		_mm_store_ps(&pos[i].x, _mm_add_ps(simdLoad(pos[i]), cols.apply(simdLoad(dir[i]))));
+	}
+}
+
+// the size grows in double, as size += 0.1 rounds, and is kept where it
+// is not over 1; a point is outside when its x or z (mask bits 0 and 2)
+// is beyond +-extent
+static void advanceGrowingSse2(vec4* pos, const vec4* vel, GLfloat* size, unsigned char* outside,
+							   size_t begin, size_t end, GLfloat extent)
+{
+	__m128 e = _mm_set1_ps(extent), ne = _mm_set1_ps(-extent), one = _mm_set1_ps(1);
+	__m128d tenth = _mm_set1_pd(0.1);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		for (int k = 0; k < 4; k++)
+		{
+			__m128 p = _mm_add_ps(simdLoad(pos[i + k]), simdLoad(vel[i + k]));
+			_mm_store_ps(&pos[i + k].x, p);
+			int bits = _mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(p, e), _mm_cmplt_ps(p, ne)));
+			outside[i + k] = (bits & 0x5) ? 1 : 0;
+		}
+		__m128 s = _mm_loadu_ps(size + i);
+		__m128 lo = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(s), tenth));
+		__m128 hi = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(s, s)), tenth));
+		__m128 shot = _mm_cmpgt_ps(s, one);
+		_mm_storeu_ps(size + i, _mm_or_ps(_mm_and_ps(shot, _mm_movelh_ps(lo, hi)), _mm_andnot_ps(shot, s)));
+	}
+	advanceGrowingScalar(pos, vel, size, outside, i, end, extent);
+}
+
+// four points at a time, transposed to one coordinate per register;
+// element k of each is points[i + k]
+static size_t countWithinSse2(const vec4* points, size_t begin, size_t end, const vec4& centre, GLfloat distance)
+{
+	__m128 cx = _mm_set1_ps(centre.x), cy = _mm_set1_ps(centre.y), cz = _mm_set1_ps(centre.z);
+	__m128 d = _mm_set1_ps(distance);
+	size_t count = 0, i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = simdLoad(points[i]), y = simdLoad(points[i + 1]);
+		__m128 z = simdLoad(points[i + 2]), w = simdLoad(points[i + 3]);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		__m128 dx = _mm_sub_ps(cx, x), dy = _mm_sub_ps(cy, y), dz = _mm_sub_ps(cz, z);
+		__m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		count += countBits(_mm_movemask_ps(_mm_cmplt_ps(_mm_sqrt_ps(s), d)));
+	}
+	return count + countWithinScalar(points, i, end, centre, distance);
+}
+
+static void insideSquareSse2(const vec4* points, size_t begin, size_t end, GLfloat extent, unsigned char* inside)
+{
+	__m128 e = _mm_set1_ps(extent), ne = _mm_set1_ps(-extent);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = simdLoad(points[i]), y = simdLoad(points[i + 1]);
+		__m128 z = simdLoad(points[i + 2]), w = simdLoad(points[i + 3]);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		__m128 out = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(x, e), _mm_cmpgt_ps(z, e)),
+							   _mm_or_ps(_mm_cmplt_ps(x, ne), _mm_cmplt_ps(z, ne)));
+		int bits = _mm_movemask_ps(out);
+		for (int k = 0; k < 4; k++)
+			inside[i + k] = (bits >> k) & 1 ? 0 : 1;
+	}
+	insideSquareScalar(points, i, end, extent, inside);
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#ifdef DJV_ISA_DISPATCH
+
+// two points per AVX register, each 128 bit half a point. The AVX2
+// versions clear the upper halves before handing the rest to the SSE2
+// ones, which would otherwise stall on them (the compiler leaves that out
+// of tail calls)
+DJV_TARGET_AVX2
+static void transform4Avx2(const mat4& m, const vec4* in, vec4* out, size_t begin, size_t end)
+{
+	Columns cols(m);
+	__m256 c0 = _mm256_insertf128_ps(_mm256_castps128_ps256(cols.c0), cols.c0, 1);
+	__m256 c1 = _mm256_insertf128_ps(_mm256_castps128_ps256(cols.c1), cols.c1, 1);
+	__m256 c2 = _mm256_insertf128_ps(_mm256_castps128_ps256(cols.c2), cols.c2, 1);
+	__m256 c3 = _mm256_insertf128_ps(_mm256_castps128_ps256(cols.c3), cols.c3, 1);
+	size_t i = begin;
+	for (; i + 2 <= end; i += 2)
+	{
+		__m256 v = _mm256_loadu_ps(&in[i].x);
+		__m256 s = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+		s = _mm256_add_ps(s, _mm256_mul_ps(c1, _mm256_permute_ps(v, 0x55)));
+		s = _mm256_add_ps(s, _mm256_mul_ps(c2, _mm256_permute_ps(v, 0xaa)));
+		s = _mm256_add_ps(s, _mm256_mul_ps(c3, _mm256_permute_ps(v, 0xff)));
+		_mm256_storeu_ps(&out[i].x, s);
+	}
+	_mm256_zeroupper();
+	transform4Sse2(m, in, out, i, end);
+}
+
+DJV_TARGET_AVX2
+static void transformSoAAvx2(const mat4& m, const GLfloat* x, const GLfloat* y, const GLfloat* z,
+							 GLfloat* outX, GLfloat* outY, GLfloat* outZ, size_t begin, size_t end, GLfloat w)
+{
+	size_t i = begin;
+	GLfloat* outs[3] = { outX, outY, outZ };
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+		__m256 pz = _mm256_loadu_ps(z + i), pw = _mm256_set1_ps(w);
+		for (int r = 0; r < 3; r++)
+		{
+			__m256 s = _mm256_mul_ps(_mm256_set1_ps(m[r].x), px);
+			s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_set1_ps(m[r].y), py));
+			s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_set1_ps(m[r].z), pz));
+			s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_set1_ps(m[r].w), pw));
+			_mm256_storeu_ps(outs[r] + i, s);
+		}
+	}
+	_mm256_zeroupper();
+	transformSoASse2(m, x, y, z, outX, outY, outZ, i, end, w);
+}
+
+DJV_TARGET_AVX2
+static void advanceAvx2(vec4* pos, const vec4* dir, GLfloat s, size_t begin, size_t end)
+{
+	__m256 ss = _mm256_set1_ps(s);
+	size_t i = begin;
+	for (; i + 2 <= end; i += 2)
+		_mm256_storeu_ps(&pos[i].x, _mm256_add_ps(_mm256_loadu_ps(&pos[i].x), _mm256_mul_ps(_mm256_loadu_ps(&dir[i].x), ss)));
+	_mm256_zeroupper();
+	advanceSse2(pos, dir, s, i, end);
+}
+
+// two points per register, mask bits 0 and 2 for the first, 4 and 6 for
+// the second
+DJV_TARGET_AVX2
+static void advanceGrowingAvx2(vec4* pos, const vec4* vel, GLfloat* size, unsigned char* outside,
+							   size_t begin, size_t end, GLfloat extent)
+{
+	__m256 e = _mm256_set1_ps(extent), ne = _mm256_set1_ps(-extent), one = _mm256_set1_ps(1);
+	__m256d tenth = _mm256_set1_pd(0.1);
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		for (int k = 0; k < 8; k += 2)
+		{
+			__m256 p = _mm256_add_ps(_mm256_loadu_ps(&pos[i + k].x), _mm256_loadu_ps(&vel[i + k].x));
+			_mm256_storeu_ps(&pos[i + k].x, p);
+			int bits = _mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(p, e, _CMP_GT_OQ), _mm256_cmp_ps(p, ne, _CMP_LT_OQ)));
+			outside[i + k] = (bits & 0x05) ? 1 : 0;
+			outside[i + k + 1] = (bits & 0x50) ? 1 : 0;
+		}
+		__m256 s = _mm256_loadu_ps(size + i);
+		__m128 lo = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(s)), tenth));
+		__m128 hi = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(s, 1)), tenth));
+		__m256 grown = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+		_mm256_storeu_ps(size + i, _mm256_blendv_ps(s, grown, _mm256_cmp_ps(s, one, _CMP_GT_OQ)));
+	}
+	_mm256_zeroupper();
+	advanceGrowingSse2(pos, vel, size, outside, i, end, extent);
+}
+
+// eight points: four registers of two points each, transposed within the
+// halves, so element k of the low half is points[i + 2k] and of the high
+// half points[i + 2k + 1]
+DJV_TARGET_AVX2
+static void transposeAvx2(const vec4* p, __m256& x, __m256& y, __m256& z)
+{
+	__m256 r0 = _mm256_loadu_ps(&p[0].x), r1 = _mm256_loadu_ps(&p[2].x);
+	__m256 r2 = _mm256_loadu_ps(&p[4].x), r3 = _mm256_loadu_ps(&p[6].x);
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t2 = _mm256_unpackhi_ps(r0, r1), t3 = _mm256_unpackhi_ps(r2, r3);
+	x = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	y = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	z = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+}
+
+DJV_TARGET_AVX2
+static size_t countWithinAvx2(const vec4* points, size_t begin, size_t end, const vec4& centre, GLfloat distance)
+{
+	__m256 cx = _mm256_set1_ps(centre.x), cy = _mm256_set1_ps(centre.y), cz = _mm256_set1_ps(centre.z);
+	__m256 d = _mm256_set1_ps(distance);
+	size_t count = 0, i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 x, y, z;
+		transposeAvx2(points + i, x, y, z);
+		__m256 dx = _mm256_sub_ps(cx, x), dy = _mm256_sub_ps(cy, y), dz = _mm256_sub_ps(cz, z);
+		__m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		count += countBits(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_sqrt_ps(s), d, _CMP_LT_OQ)));
+	}
+	_mm256_zeroupper();
+	return count + countWithinSse2(points, i, end, centre, distance);
+}
+
+DJV_TARGET_AVX2
+static void insideSquareAvx2(const vec4* points, size_t begin, size_t end, GLfloat extent, unsigned char* inside)
+{
+	__m256 e = _mm256_set1_ps(extent), ne = _mm256_set1_ps(-extent);
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 x, y, z;
+		transposeAvx2(points + i, x, y, z);
+		__m256 out = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(x, e, _CMP_GT_OQ), _mm256_cmp_ps(z, e, _CMP_GT_OQ)),
+								  _mm256_or_ps(_mm256_cmp_ps(x, ne, _CMP_LT_OQ), _mm256_cmp_ps(z, ne, _CMP_LT_OQ)));
+		int bits = _mm256_movemask_ps(out);
+		for (int k = 0; k < 4; k++)
+		{
+			inside[i + 2 * k] = (bits >> k) & 1 ? 0 : 1;
+			inside[i + 2 * k + 1] = (bits >> (4 + k)) & 1 ? 0 : 1;
+		}
+	}
+	_mm256_zeroupper();
+	insideSquareSse2(points, i, end, extent, inside);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// four points per AVX-512 register, one per 128 bit lane
+DJV_TARGET_AVX512
+static void transform4Avx512(const mat4& m, const vec4* in, vec4* out, size_t begin, size_t end)
+{
+	Columns cols(m);
+	__m512 c0 = _mm512_broadcast_f32x4(cols.c0), c1 = _mm512_broadcast_f32x4(cols.c1);
+	__m512 c2 = _mm512_broadcast_f32x4(cols.c2), c3 = _mm512_broadcast_f32x4(cols.c3);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m512 v = _mm512_loadu_ps(&in[i].x);
+		__m512 s = _mm512_mul_ps(c0, _mm512_permute_ps(v, 0x00));
+		s = _mm512_add_ps(s, _mm512_mul_ps(c1, _mm512_permute_ps(v, 0x55)));
+		s = _mm512_add_ps(s, _mm512_mul_ps(c2, _mm512_permute_ps(v, 0xaa)));
+		s = _mm512_add_ps(s, _mm512_mul_ps(c3, _mm512_permute_ps(v, 0xff)));
+		_mm512_storeu_ps(&out[i].x, s);
+	}
+	transform4Avx2(m, in, out, i, end);
+}
+
+DJV_TARGET_AVX512
+static void transformSoAAvx512(const mat4& m, const GLfloat* x, const GLfloat* y, const GLfloat* z,
+							   GLfloat* outX, GLfloat* outY, GLfloat* outZ, size_t begin, size_t end, GLfloat w)
+{
+	size_t i = begin;
+	GLfloat* outs[3] = { outX, outY, outZ };
+	for (; i + 16 <= end; i += 16)
+	{
+		__m512 px = _mm512_loadu_ps(x + i), py = _mm512_loadu_ps(y + i);
+		__m512 pz = _mm512_loadu_ps(z + i), pw = _mm512_set1_ps(w);
+		for (int r = 0; r < 3; r++)
+		{
+			__m512 s = _mm512_mul_ps(_mm512_set1_ps(m[r].x), px);
+			s = _mm512_add_ps(s, _mm512_mul_ps(_mm512_set1_ps(m[r].y), py));
+			s = _mm512_add_ps(s, _mm512_mul_ps(_mm512_set1_ps(m[r].z), pz));
+			s = _mm512_add_ps(s, _mm512_mul_ps(_mm512_set1_ps(m[r].w), pw));
+			_mm512_storeu_ps(outs[r] + i, s);
+		}
+	}
+	transformSoAAvx2(m, x, y, z, outX, outY, outZ, i, end, w);
+}
+
+DJV_TARGET_AVX512
+static void advanceAvx512(vec4* pos, const vec4* dir, GLfloat s, size_t begin, size_t end)
+{
+	__m512 ss = _mm512_set1_ps(s);
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+		_mm512_storeu_ps(&pos[i].x, _mm512_add_ps(_mm512_loadu_ps(&pos[i].x), _mm512_mul_ps(_mm512_loadu_ps(&dir[i].x), ss)));
+	advanceAvx2(pos, dir, s, i, end);
+}
+
+// four points per register, mask bits 4j and 4j + 2 for point j
+DJV_TARGET_AVX512
+static void advanceGrowingAvx512(vec4* pos, const vec4* vel, GLfloat* size, unsigned char* outside,
+								 size_t begin, size_t end, GLfloat extent)
+{
+	__m512 e = _mm512_set1_ps(extent), ne = _mm512_set1_ps(-extent), one = _mm512_set1_ps(1);
+	__m512d tenth = _mm512_set1_pd(0.1);
+	size_t i = begin;
+	for (; i + 16 <= end; i += 16)
+	{
+		for (int k = 0; k < 16; k += 4)
+		{
+			__m512 p = _mm512_add_ps(_mm512_loadu_ps(&pos[i + k].x), _mm512_loadu_ps(&vel[i + k].x));
+			_mm512_storeu_ps(&pos[i + k].x, p);
+			unsigned int bits = _mm512_cmp_ps_mask(p, e, _CMP_GT_OQ) | _mm512_cmp_ps_mask(p, ne, _CMP_LT_OQ);
+			for (int j = 0; j < 4; j++)
+				outside[i + k + j] = ((bits >> (4 * j)) & 0x5) ? 1 : 0;
+		}
+		__m512 s = _mm512_loadu_ps(size + i);
+		__m256 lo = _mm512_cvtpd_ps(_mm512_add_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(s)), tenth));
+		__m256 hi = _mm512_cvtpd_ps(_mm512_add_pd(_mm512_cvtps_pd(
+						_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(s), 1))), tenth));
+		__m512 grown = _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)),
+														   _mm256_castps_pd(hi), 1));
+		_mm512_storeu_ps(size + i, _mm512_mask_blend_ps(_mm512_cmp_ps_mask(s, one, _CMP_GT_OQ), s, grown));
+	}
+	advanceGrowingAvx2(pos, vel, size, outside, i, end, extent);
+}
+
+// sixteen points: four registers of four points each, transposed within
+// the lanes, so element k of lane l is points[i + 4k + l] (mask bit 4l + k)
+DJV_TARGET_AVX512
+static void transposeAvx512(const vec4* p, __m512& x, __m512& y, __m512& z)
+{
+	__m512 r0 = _mm512_loadu_ps(&p[0].x), r1 = _mm512_loadu_ps(&p[4].x);
+	__m512 r2 = _mm512_loadu_ps(&p[8].x), r3 = _mm512_loadu_ps(&p[12].x);
+	__m512 t0 = _mm512_unpacklo_ps(r0, r1), t1 = _mm512_unpacklo_ps(r2, r3);
+	__m512 t2 = _mm512_unpackhi_ps(r0, r1), t3 = _mm512_unpackhi_ps(r2, r3);
+	x = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	y = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	z = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+}
+
+DJV_TARGET_AVX512
+static size_t countWithinAvx512(const vec4* points, size_t begin, size_t end, const vec4& centre, GLfloat distance)
+{
+	__m512 cx = _mm512_set1_ps(centre.x), cy = _mm512_set1_ps(centre.y), cz = _mm512_set1_ps(centre.z);
+	__m512 d = _mm512_set1_ps(distance);
+	size_t count = 0, i = begin;
+	for (; i + 16 <= end; i += 16)
+	{
+		__m512 x, y, z;
+		transposeAvx512(points + i, x, y, z);
+		__m512 dx = _mm512_sub_ps(cx, x), dy = _mm512_sub_ps(cy, y), dz = _mm512_sub_ps(cz, z);
+		__m512 s = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+		count += countBits(_mm512_cmp_ps_mask(_mm512_sqrt_ps(s), d, _CMP_LT_OQ));
+	}
+	return count + countWithinAvx2(points, i, end, centre, distance);
+}
+
+DJV_TARGET_AVX512
+static void insideSquareAvx512(const vec4* points, size_t begin, size_t end, GLfloat extent, unsigned char* inside)
+{
+	__m512 e = _mm512_set1_ps(extent), ne = _mm512_set1_ps(-extent);
+	size_t i = begin;
+	for (; i + 16 <= end; i += 16)
+	{
+		__m512 x, y, z;
+		transposeAvx512(points + i, x, y, z);
+		unsigned int bits = _mm512_cmp_ps_mask(x, e, _CMP_GT_OQ) | _mm512_cmp_ps_mask(z, e, _CMP_GT_OQ) |
+							_mm512_cmp_ps_mask(x, ne, _CMP_LT_OQ) | _mm512_cmp_ps_mask(z, ne, _CMP_LT_OQ);
+		for (int l = 0; l < 4; l++)
+			for (int k = 0; k < 4; k++)
+				inside[i + 4 * k + l] = (bits >> (4 * l + k)) & 1 ? 0 : 1;
+	}
+	insideSquareAvx2(points, i, end, extent, inside);
+}
+
+#endif
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+// Binding the kernels
+
+struct BatchKernels
+{
+	void (*transform4)(const mat4& m, const vec4* in, vec4* out, size_t begin, size_t end);
+	void (*transform3)(const mat4& m, const vec3* in, vec3* out, size_t begin, size_t end, GLfloat w);
+	void (*transformSoA)(const mat4& m, const GLfloat* x, const GLfloat* y, const GLfloat* z,
+						 GLfloat* outX, GLfloat* outY, GLfloat* outZ, size_t begin, size_t end, GLfloat w);
+	void (*advance)(vec4* pos, const vec4* dir, GLfloat s, size_t begin, size_t end);
+	void (*advanceRotatedY)(vec4* pos, const vec4* dir, const GLfloat* angle,
+							const GLfloat* speed, size_t begin, size_t end);
+	void (*advanceGrowing)(vec4* pos, const vec4* vel, GLfloat* size, unsigned char* outside,
+						   size_t begin, size_t end, GLfloat extent);
+	size_t (*countWithin)(const vec4* points, size_t begin, size_t end, const vec4& centre, GLfloat distance);
+	void (*insideSquare)(const vec4* points, size_t begin, size_t end, GLfloat extent, unsigned char* inside);
+};
+
+// the vec3 transform and advanceRotatedY (which is mostly the sine and
+// cosine) have nothing wider than SSE2
+static const BatchKernels kernelsFor[] =
+{
+	{ transform4Scalar, transform3Scalar, transformSoAScalar, advanceScalar, advanceRotatedYScalar,
+	  advanceGrowingScalar, countWithinScalar, insideSquareScalar },
+#ifdef DJV_SIMD_SSE
+	{ transform4Sse2, transform3Sse2, transformSoASse2, advanceSse2, advanceRotatedYSse2,
+	  advanceGrowingSse2, countWithinSse2, insideSquareSse2 },
+#endif
+#ifdef DJV_ISA_DISPATCH
+	{ transform4Avx2, transform3Sse2, transformSoAAvx2, advanceAvx2, advanceRotatedYSse2,
+	  advanceGrowingAvx2, countWithinAvx2, insideSquareAvx2 },
+	{ transform4Avx512, transform3Sse2, transformSoAAvx512, advanceAvx512, advanceRotatedYSse2,
+	  advanceGrowingAvx512, countWithinAvx512, insideSquareAvx512 },
+#endif
+};
+
+// anything run before the static initializers gets the scalar kernels
+static IsaLevel boundIsa = ISA_SCALAR;
+static const BatchKernels* kernels = &kernelsFor[ISA_SCALAR];
+
+IsaLevel setBatchIsa(IsaLevel level)
+{
+	boundIsa = std::min(level, detectIsa());
+	kernels = &kernelsFor[boundIsa];
+	return boundIsa;
+}
+
+IsaLevel batchIsa()
+{
+	return boundIsa;
+}
+
+static const IsaLevel startupIsa = setBatchIsa(requestedIsa());
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void transform(const mat4& m, const vec4* in, vec4* out, size_t n)
+{
+	const BatchKernels* k = kernels;
+	chunked(n, [&](size_t begin, size_t end) { k->transform4(m, in, out, begin, end); });
+}
+
+void transform(const mat4& m, const vec3* in, vec3* out, size_t n, GLfloat w)
+{
+	const BatchKernels* k = kernels;
+	chunked(n, [&](size_t begin, size_t end) { k->transform3(m, in, out, begin, end, w); });
+}
+
+void transform(const mat4& m, const GLfloat* x, const GLfloat* y, const GLfloat* z,
+			   GLfloat* outX, GLfloat* outY, GLfloat* outZ, size_t n, GLfloat w)
+{
+	const BatchKernels* k = kernels;
+	chunked(n, [&](size_t begin, size_t end) { k->transformSoA(m, x, y, z, outX, outY, outZ, begin, end, w); });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void advance(vec4* pos, const vec4* dir, GLfloat s, size_t n)
+{
+	const BatchKernels* k = kernels;
+	chunked(n, [&](size_t begin, size_t end) { k->advance(pos, dir, s, begin, end); });
+}
+
+void advanceRotatedY(vec4* pos, const vec4* dir, const GLfloat* angle,
+					 const GLfloat* speed, size_t n)
+{
+	const BatchKernels* k = kernels;
+	chunked(n, [&](size_t begin, size_t end) { k->advanceRotatedY(pos, dir, angle, speed, begin, end); });
+}
+
+void advanceGrowing(vec4* pos, const vec4* vel, GLfloat* size, unsigned char* outside, size_t n, GLfloat extent)
+{
+	const BatchKernels* k = kernels;
+	chunked(n, [&](size_t begin, size_t end) { k->advanceGrowing(pos, vel, size, outside, begin, end, extent); });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the tests are short (one pass over a few hundred points), so they stay
+// on the calling thread
+
+size_t countWithin(const vec4* points, size_t n, const vec4& centre, GLfloat distance)
+{
+	return kernels->countWithin(points, 0, n, centre, distance);
+}
+
+void insideSquare(const vec4* points, size_t n, GLfloat extent, unsigned char* inside)
+{
+	kernels->insideSquare(points, 0, n, extent, inside);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// The eye is where projView's clip x, y and w are all 0, where the rows
+// 0, 1 and 3 cross as planes (solved in double, by Cramer's rule; row 2,
+// with near and far in it, is left out of it). An orthographic projView
+// has none, w = 0
+vec4 eyePoint(const mat4& projView)
+{
+	double m[3][4];
+	const int rows[3] = { 0, 1, 3 };
+	for (int r = 0; r < 3; r++)
+	{
+		for (int c = 0; c < 4; c++)
+			m[r][c] = projView[rows[r]][c];
+	}
+
+	// the determinant with column 'c' swapped for the right hand side
+	double det[4];
+	for (int c = 0; c < 4; c++)
+	{
+		double a[3][3];
+		for (int r = 0; r < 3; r++)
+		{
+			for (int k = 0; k < 3; k++)
+				a[r][k] = k == c ? -m[r][3] : m[r][k];
+		}
+		det[c] = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+			- a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+			+ a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+	}
+	double scale = fabs(m[0][0]) + fabs(m[1][1]) + fabs(m[2][2]);
+	if (fabs(det[3]) <= 1e-9 * scale * scale * scale)
+		return vec4(0, 0, 0, 0);
+	return vec4((float)(det[0] / det[3]), (float)(det[1] / det[3]), (float)(det[2] / det[3]), 1);
+}
+
+}
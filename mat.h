@@ -10,7 +10,12 @@
 
 */
 
+#include <stddef.h>
+
+#include <type_traits>
+
 #include "gl_include.h"
+#include "isa.h"
 
 
 namespace djv {
@@ -34,28 +39,21 @@ class mat2 {
     //  --- Constructors and Destructors ---
     //
 
-    mat2( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
-	{ _m[0].x = d;  _m[1].y = d;   }
+    constexpr mat2( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
+	: _m{ vec2( d, 0 ), vec2( 0, d ) } {}
 
-    mat2( const vec2& a, const vec2& b )
-	{ _m[0] = a;  _m[1] = b;  }
+    constexpr mat2( const vec2& a, const vec2& b )
+	: _m{ a, b } {}
 
-    mat2( GLfloat m00, GLfloat m10, GLfloat m01, GLfloat m11 )
-	{ _m[0] = vec2( m00, m01 ); _m[1] = vec2( m10, m11 ); }
-
-    mat2( const mat2& m ) {
-	if ( *this != m ) {
-	    _m[0] = m._m[0];
-	    _m[1] = m._m[1];
-	} 
-    }
+    constexpr mat2( GLfloat m00, GLfloat m10, GLfloat m01, GLfloat m11 )
+	: _m{ vec2( m00, m01 ), vec2( m10, m11 ) } {}
 
     //
     //  --- Indexing Operator ---
     //
 
     vec2& operator [] ( int i ) { return _m[i]; }
-    const vec2& operator [] ( int i ) const { return _m[i]; }
+    constexpr const vec2& operator [] ( int i ) const { return _m[i]; }
 
     //
     //  --- (non-modifying) Arithmatic Operators ---
@@ -206,36 +204,25 @@ class mat3 {
     //  --- Constructors and Destructors ---
     //
 
-    mat3( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
-	{ _m[0].x = d;  _m[1].y = d;  _m[2].z = d;   }
+    constexpr mat3( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
+	: _m{ vec3( d, 0, 0 ), vec3( 0, d, 0 ), vec3( 0, 0, d ) } {}
 
-    mat3( const vec3& a, const vec3& b, const vec3& c )
-	{ _m[0] = a;  _m[1] = b;  _m[2] = c;  }
+    constexpr mat3( const vec3& a, const vec3& b, const vec3& c )
+	: _m{ a, b, c } {}
 
-    mat3( GLfloat m00, GLfloat m01, GLfloat m02,
+    constexpr mat3( GLfloat m00, GLfloat m01, GLfloat m02,
 	  GLfloat m10, GLfloat m11, GLfloat m12,
 	  GLfloat m20, GLfloat m21, GLfloat m22 ) 
-	{
-	    _m[0] = vec3( m00, m01, m02 );
-	    _m[1] = vec3( m10, m11, m12 );
-	    _m[2] = vec3( m20, m21, m22 );
-	}
-
-    mat3( const mat3& m )
-	{
-	    if ( *this != m ) {
-		_m[0] = m._m[0];
-		_m[1] = m._m[1];
-		_m[2] = m._m[2];
-	    } 
-	}
+	: _m{ vec3( m00, m01, m02 ),
+	      vec3( m10, m11, m12 ),
+	      vec3( m20, m21, m22 ) } {}
 
     //
     //  --- Indexing Operator ---
     //
 
     vec3& operator [] ( int i ) { return _m[i]; }
-    const vec3& operator [] ( int i ) const { return _m[i]; }
+    constexpr const vec3& operator [] ( int i ) const { return _m[i]; }
 
     //
     //  --- (non-modifying) Arithmatic Operators ---
@@ -388,6 +375,15 @@ mat3 transpose( const mat3& A ) {
 //  mat4.h - 4D square matrix
 //
 
+class mat4;
+
+// the plain C++ products, what the SSE versions are checked against
+// (and usable in constant expressions, which the SSE ones are not)
+namespace scalar {
+constexpr mat4 multiply( const mat4& a, const mat4& b );
+constexpr vec4 multiply( const mat4& m, const vec4& v );
+}
+
 class mat4 {
 
     vec4  _m[4];
@@ -397,23 +393,16 @@ class mat4 {
     //  --- Constructors and Destructors ---
     //
 
-    mat4( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
-	{ 
-		_m[0].x = d;  
-		_m[1].y = d;  
-		_m[2].z = d;  
-		_m[3].w = d; 
-	}
+    constexpr mat4( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
+	: _m{ vec4( d, 0, 0, 0 ),
+	      vec4( 0, d, 0, 0 ),
+	      vec4( 0, 0, d, 0 ),
+	      vec4( 0, 0, 0, d ) } {}
 
 	// construct matrix using vectors for each *row*
 	// (textbook did this by *column*)
-    mat4( const vec4& r1, const vec4& r2, const vec4& r3, const vec4& r4 )
-	{ 
-		_m[0] = r1;  
-		_m[1] = r2;  
-		_m[2] = r3;  
-		_m[3] = r4; 
-	}
+    constexpr mat4( const vec4& r1, const vec4& r2, const vec4& r3, const vec4& r4 )
+	: _m{ r1, r2, r3, r4 } {}
 
 	/*
 	I switched odd ordering used by textbook code ...
@@ -423,33 +412,21 @@ class mat4 {
 	  GLfloat m03, GLfloat m13, GLfloat m23, GLfloat m33 )
 	  */
 
-    mat4( GLfloat m00, GLfloat m01, GLfloat m02, GLfloat m03,
+    constexpr mat4( GLfloat m00, GLfloat m01, GLfloat m02, GLfloat m03,
 	  GLfloat m10, GLfloat m11, GLfloat m12, GLfloat m13,
 	  GLfloat m20, GLfloat m21, GLfloat m22, GLfloat m23,
 	  GLfloat m30, GLfloat m31, GLfloat m32, GLfloat m33 )
-	{
-	    _m[0] = vec4( m00, m01, m02, m03 );
-	    _m[1] = vec4( m10, m11, m12, m13 );
-	    _m[2] = vec4( m20, m21, m22, m23 );
-	    _m[3] = vec4( m30, m31, m32, m33 );
-	}
-
-    mat4( const mat4& m )
-	{
-	    if ( *this != m ) {
-		_m[0] = m._m[0];
-		_m[1] = m._m[1];
-		_m[2] = m._m[2];
-		_m[3] = m._m[3];
-	    } 
-	}
+	: _m{ vec4( m00, m01, m02, m03 ),
+	      vec4( m10, m11, m12, m13 ),
+	      vec4( m20, m21, m22, m23 ),
+	      vec4( m30, m31, m32, m33 ) } {}
 
     //
     //  --- Indexing Operator ---
     //
 
     vec4& operator [] ( int i ) { return _m[i]; }
-    const vec4& operator [] ( int i ) const { return _m[i]; }
+    constexpr const vec4& operator [] ( int i ) const { return _m[i]; }
 
     //
     //  --- (non-modifying) Arithematic Operators ---
@@ -482,18 +459,41 @@ class mat4 {
     friend mat4 operator * ( const GLfloat s, const mat4& m )
 	{ return m * s; }
 	
+    // row i of the product is the rows of m weighted by row i of this one,
+    // summed in the same order as the scalar loop (so to the same bits)
     mat4 operator * ( const mat4& m ) const {
-	mat4  a( 0.0 );
-
+#if defined(DJV_SIMD_AVX)
+	// two rows at a time, each 128 bit half broadcasts within itself
+	mat4  a;
+	__m256 b0 = _mm256_broadcast_ps( (const __m128*)&m._m[0].x );
+	__m256 b1 = _mm256_broadcast_ps( (const __m128*)&m._m[1].x );
+	__m256 b2 = _mm256_broadcast_ps( (const __m128*)&m._m[2].x );
+	__m256 b3 = _mm256_broadcast_ps( (const __m128*)&m._m[3].x );
+	for ( int i = 0; i < 4; i += 2 ) {
+	    __m256 r = _mm256_loadu_ps( &_m[i].x );
+	    __m256 s = _mm256_mul_ps( _mm256_permute_ps(r, 0x00), b0 );
+	    s = _mm256_add_ps( s, _mm256_mul_ps(_mm256_permute_ps(r, 0x55), b1) );
+	    s = _mm256_add_ps( s, _mm256_mul_ps(_mm256_permute_ps(r, 0xaa), b2) );
+	    s = _mm256_add_ps( s, _mm256_mul_ps(_mm256_permute_ps(r, 0xff), b3) );
+	    _mm256_storeu_ps( &a._m[i].x, s );
+	}
+	return a;
+#elif defined(DJV_SIMD_SSE)
+	mat4  a;
+	__m128 b0 = simdLoad( m._m[0] ), b1 = simdLoad( m._m[1] );
+	__m128 b2 = simdLoad( m._m[2] ), b3 = simdLoad( m._m[3] );
 	for ( int i = 0; i < 4; ++i ) {
-	    for ( int j = 0; j < 4; ++j ) {
-		for ( int k = 0; k < 4; ++k ) {
-		    a[i][j] += _m[i][k] * m[k][j];
-		}
-	    }
+	    __m128 r = simdLoad( _m[i] );
+	    __m128 s = _mm_mul_ps( _mm_shuffle_ps(r, r, 0x00), b0 );
+	    s = _mm_add_ps( s, _mm_mul_ps(_mm_shuffle_ps(r, r, 0x55), b1) );
+	    s = _mm_add_ps( s, _mm_mul_ps(_mm_shuffle_ps(r, r, 0xaa), b2) );
+	    s = _mm_add_ps( s, _mm_mul_ps(_mm_shuffle_ps(r, r, 0xff), b3) );
+	    _mm_store_ps( &a._m[i].x, s );
 	}
-
 	return a;
+#else
+	return scalar::multiply( *this, m );
+#endif
     }
 
     //
@@ -516,17 +516,7 @@ class mat4 {
     }
 
     mat4& operator *= ( const mat4& m ) {
-	mat4  a( 0.0 );
-
-	for ( int i = 0; i < 4; ++i ) {
-	    for ( int j = 0; j < 4; ++j ) {
-		for ( int k = 0; k < 4; ++k ) {
-		    a[i][j] += _m[i][k] * m[k][j];
-		}
-	    }
-	}
-
-	return *this = a;
+	return *this = *this * m;
     }
 
     mat4& operator /= ( const GLfloat s ) {
@@ -547,11 +537,20 @@ class mat4 {
     //
 
     vec4 operator * ( const vec4& v ) const {  // m * v
-	return vec4( _m[0][0]*v.x + _m[0][1]*v.y + _m[0][2]*v.z + _m[0][3]*v.w,
-		     _m[1][0]*v.x + _m[1][1]*v.y + _m[1][2]*v.z + _m[1][3]*v.w,
-		     _m[2][0]*v.x + _m[2][1]*v.y + _m[2][2]*v.z + _m[2][3]*v.w,
-		     _m[3][0]*v.x + _m[3][1]*v.y + _m[3][2]*v.z + _m[3][3]*v.w
-	    );
+#ifdef DJV_SIMD_SSE
+	// the columns weighted by v, summed in the scalar order
+	__m128 c0 = simdLoad( _m[0] ), c1 = simdLoad( _m[1] );
+	__m128 c2 = simdLoad( _m[2] ), c3 = simdLoad( _m[3] );
+	_MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+	__m128 x = simdLoad( v );
+	__m128 s = _mm_mul_ps( c0, _mm_shuffle_ps(x, x, 0x00) );
+	s = _mm_add_ps( s, _mm_mul_ps(c1, _mm_shuffle_ps(x, x, 0x55)) );
+	s = _mm_add_ps( s, _mm_mul_ps(c2, _mm_shuffle_ps(x, x, 0xaa)) );
+	s = _mm_add_ps( s, _mm_mul_ps(c3, _mm_shuffle_ps(x, x, 0xff)) );
+	return simdStore( s );
+#else
+	return scalar::multiply( *this, v );
+#endif
     }
 	
     //
@@ -593,12 +592,49 @@ mat4 matrixCompMult( const mat4& A, const mat4& B ) {
 	A[3][0]*B[3][0], A[3][1]*B[3][1], A[3][2]*B[3][2], A[3][3]*B[3][3] );
 }
 
+namespace scalar {
+
+// one row of a product: the rows of b weighted by the row r of a, added
+// in the order of the textbook loop (k = 0..3)
+constexpr
+vec4 multiplyRow( const vec4& r, const mat4& b ) {
+    return b[0]*r.x + b[1]*r.y + b[2]*r.z + b[3]*r.w;
+}
+
+constexpr
+mat4 multiply( const mat4& a, const mat4& b ) {
+    return mat4( multiplyRow( a[0], b ), multiplyRow( a[1], b ),
+		 multiplyRow( a[2], b ), multiplyRow( a[3], b ) );
+}
+
+constexpr
+vec4 multiply( const mat4& m, const vec4& v ) {
+    return vec4( m[0].x*v.x + m[0].y*v.y + m[0].z*v.z + m[0].w*v.w,
+		 m[1].x*v.x + m[1].y*v.y + m[1].z*v.z + m[1].w*v.w,
+		 m[2].x*v.x + m[2].y*v.y + m[2].z*v.z + m[2].w*v.w,
+		 m[3].x*v.x + m[3].y*v.y + m[3].z*v.z + m[3].w*v.w );
+}
+
+constexpr
+mat4 transpose( const mat4& A ) {
+    return mat4( A[0].x, A[1].x, A[2].x, A[3].x,
+		 A[0].y, A[1].y, A[2].y, A[3].y,
+		 A[0].z, A[1].z, A[2].z, A[3].z,
+		 A[0].w, A[1].w, A[2].w, A[3].w );
+}
+
+}
+
 inline
 mat4 transpose( const mat4& A ) {
-    return mat4( A[0][0], A[1][0], A[2][0], A[3][0],
-		 A[0][1], A[1][1], A[2][1], A[3][1],
-		 A[0][2], A[1][2], A[2][2], A[3][2],
-		 A[0][3], A[1][3], A[2][3], A[3][3] );
+#ifdef DJV_SIMD_SSE
+    __m128 r0 = simdLoad( A[0] ), r1 = simdLoad( A[1] );
+    __m128 r2 = simdLoad( A[2] ), r3 = simdLoad( A[3] );
+    _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+    return mat4( simdStore(r0), simdStore(r1), simdStore(r2), simdStore(r3) );
+#else
+    return scalar::transpose( A );
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -670,30 +706,29 @@ mat4 RotateZ( const GLfloat theta )
 //  Translation matrix generators
 //
 
-inline
+constexpr
 mat4 Translate( const GLfloat x, const GLfloat y, const GLfloat z )
 {
-    mat4 c;
-    c[0][3] = x;
-    c[1][3] = y;
-    c[2][3] = z;
-    return c;
+    return mat4( 1, 0, 0, x,
+		 0, 1, 0, y,
+		 0, 0, 1, z,
+		 0, 0, 0, 1 );
 }
 
-inline
+constexpr
 mat4 Translate( const vec3& v )
 {
     return Translate( v.x, v.y, v.z );
 }
 
-inline
+constexpr
 mat4 Translate( const vec4& v )
 {
     return Translate( v.x, v.y, v.z );
 }
 
 
-inline
+constexpr
 mat4 Translate( const vec2& v )
 {
     return Translate( v.x, v.y, 0 );
@@ -704,29 +739,28 @@ mat4 Translate( const vec2& v )
 //  Scale matrix generators
 //
 
-inline
+constexpr
 mat4 Scale( const GLfloat x, const GLfloat y, const GLfloat z )
 {
-    mat4 c;
-    c[0][0] = x;
-    c[1][1] = y;
-    c[2][2] = z;
-    return c;
+    return mat4( x, 0, 0, 0,
+		 0, y, 0, 0,
+		 0, 0, z, 0,
+		 0, 0, 0, 1 );
 }
 
-inline
+constexpr
 mat4 Scale( const vec3& v )
 {
     return Scale( v.x, v.y, v.z );
 }
 
-inline
+constexpr
 mat4 Scale( const vec2& v )
 {
     return Scale( v.x, v.y, 1.0 );
 }
 
-inline
+constexpr
 mat4 Scale( float s )
 {
     return Scale( s, s, s );
@@ -740,43 +774,34 @@ mat4 Scale( float s )
 //          order to avoid any name conflicts, we use the variable names
 //          "zNear" to represent "near", and "zFar" to reprsent "far".
 //
-inline
+constexpr
 mat4 Ortho( const GLfloat left, const GLfloat right,
 	    const GLfloat bottom, const GLfloat top,
 	    const GLfloat zNear, const GLfloat zFar )
 {
-    mat4 c;
-    c[0][0] = (GLfloat)2.0/(right - left);
-    c[1][1] = (GLfloat)2.0/(top - bottom);
-    c[2][2] = (GLfloat)2.0/(zNear - zFar);
-    c[3][3] = (GLfloat)1.0;
-    c[0][3] = -(right + left)/(right - left);
-    c[1][3] = -(top + bottom)/(top - bottom);
-    c[2][3] = -(zFar + zNear)/(zFar - zNear);
-    return c;
+    return mat4( (GLfloat)2.0/(right - left), 0, 0, -(right + left)/(right - left),
+		 0, (GLfloat)2.0/(top - bottom), 0, -(top + bottom)/(top - bottom),
+		 0, 0, (GLfloat)2.0/(zNear - zFar), -(zFar + zNear)/(zFar - zNear),
+		 0, 0, 0, (GLfloat)1.0 );
 }
 
-inline
+constexpr
 mat4 Ortho2D( const GLfloat left, const GLfloat right,
 	      const GLfloat bottom, const GLfloat top )
 {
     return Ortho( left, right, bottom, top, -1.0, 1.0 );
 }
 
-inline
+// (like Perspective, keeps the 1 of the identity in [3][3])
+constexpr
 mat4 Frustum( const GLfloat left, const GLfloat right,
 	      const GLfloat bottom, const GLfloat top,
 	      const GLfloat zNear, const GLfloat zFar )
 {
-    mat4 c;
-    c[0][0] = (GLfloat)2.0*zNear/(right - left);
-    c[0][2] = (right + left)/(right - left);
-    c[1][1] = (GLfloat)2.0*zNear/(top - bottom);
-    c[1][2] = (top + bottom)/(top - bottom);
-    c[2][2] = -(zFar + zNear)/(zFar - zNear);
-    c[2][3] = (GLfloat)-2.0*zFar*zNear/(zFar - zNear);
-    c[3][2] = (GLfloat)-1.0;
-    return c;
+    return mat4( (GLfloat)2.0*zNear/(right - left), 0, (right + left)/(right - left), 0,
+		 0, (GLfloat)2.0*zNear/(top - bottom), (top + bottom)/(top - bottom), 0,
+		 0, 0, -(zFar + zNear)/(zFar - zNear), (GLfloat)-2.0*zFar*zNear/(zFar - zNear),
+		 0, 0, (GLfloat)-1.0, 1 );
 }
 
 inline
@@ -846,91 +871,257 @@ mat4 identity()
     return c;
 }
 
-inline          
-mat4 affineInverse(mat4 const & m)
+//----------------------------------------------------------------------------
+//
+//  Inverses
+//
+
+namespace scalar {
+
+// the inverse through the 2x2 sub-determinants of the top and bottom
+// row pairs (Laplace expansion)
+inline
+mat4 inverse( const mat4& m, GLfloat* determinant = NULL )
 {
-	mat4 Result(m);
-	Result[0][3] = 0;
-	Result[1][3] = 0;
-	Result[2][3] = 0;
-	Result[3][3] = 1;
-	Result = transpose(Result);
-	vec4 Translation = vec4(-m[0][3], -m[1][3], -m[2][3], m[3][3]);
+    GLfloat s0 = m[0][0]*m[1][1] - m[1][0]*m[0][1];
+    GLfloat s1 = m[0][0]*m[1][2] - m[1][0]*m[0][2];
+    GLfloat s2 = m[0][0]*m[1][3] - m[1][0]*m[0][3];
+    GLfloat s3 = m[0][1]*m[1][2] - m[1][1]*m[0][2];
+    GLfloat s4 = m[0][1]*m[1][3] - m[1][1]*m[0][3];
+    GLfloat s5 = m[0][2]*m[1][3] - m[1][2]*m[0][3];
+
+    GLfloat c5 = m[2][2]*m[3][3] - m[3][2]*m[2][3];
+    GLfloat c4 = m[2][1]*m[3][3] - m[3][1]*m[2][3];
+    GLfloat c3 = m[2][1]*m[3][2] - m[3][1]*m[2][2];
+    GLfloat c2 = m[2][0]*m[3][3] - m[3][0]*m[2][3];
+    GLfloat c1 = m[2][0]*m[3][2] - m[3][0]*m[2][2];
+    GLfloat c0 = m[2][0]*m[3][1] - m[3][0]*m[2][1];
+
+    GLfloat det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+    if ( determinant )
+	*determinant = det;
+    GLfloat r = GLfloat(1.0) / det;
+
+    return mat4(
+	( m[1][1]*c5 - m[1][2]*c4 + m[1][3]*c3) * r,
+	(-m[0][1]*c5 + m[0][2]*c4 - m[0][3]*c3) * r,
+	( m[3][1]*s5 - m[3][2]*s4 + m[3][3]*s3) * r,
+	(-m[2][1]*s5 + m[2][2]*s4 - m[2][3]*s3) * r,
+
+	(-m[1][0]*c5 + m[1][2]*c2 - m[1][3]*c1) * r,
+	( m[0][0]*c5 - m[0][2]*c2 + m[0][3]*c1) * r,
+	(-m[3][0]*s5 + m[3][2]*s2 - m[3][3]*s1) * r,
+	( m[2][0]*s5 - m[2][2]*s2 + m[2][3]*s1) * r,
+
+	( m[1][0]*c4 - m[1][1]*c2 + m[1][3]*c0) * r,
+	(-m[0][0]*c4 + m[0][1]*c2 - m[0][3]*c0) * r,
+	( m[3][0]*s4 - m[3][1]*s2 + m[3][3]*s0) * r,
+	(-m[2][0]*s4 + m[2][1]*s2 - m[2][3]*s0) * r,
+
+	(-m[1][0]*c3 + m[1][1]*c1 - m[1][2]*c0) * r,
+	( m[0][0]*c3 - m[0][1]*c1 + m[0][2]*c0) * r,
+	(-m[3][0]*s3 + m[3][1]*s1 - m[3][2]*s0) * r,
+	( m[2][0]*s3 - m[2][1]*s1 + m[2][2]*s0) * r );
+}
 
-	Result[0][3] = Translation.x;
-	Result[1][3] = Translation.y;
-	Result[2][3] = Translation.z;
-	Result[3][3] = Translation.w;
-	return Result;
 }
 
+#ifdef DJV_SIMD_SSE
+// 2x2 blocks held row by row in one register (a b c d = | a b ; c d |)
+#define DJV_SHUFFLE( u, v, x, y, z, w )  _mm_shuffle_ps( u, v, _MM_SHUFFLE(w, z, y, x) )
+#define DJV_SWIZZLE( u, x, y, z, w )     DJV_SHUFFLE( u, u, x, y, z, w )
 
-/*
-not working
-inline 
-mat4 inverse(const mat4& m)
+// A * B
+inline __m128 simdMul2( __m128 a, __m128 b ) {
+    return _mm_add_ps( _mm_mul_ps(a, DJV_SWIZZLE(b, 0,3,0,3)),
+		       _mm_mul_ps(DJV_SWIZZLE(a, 1,0,3,2), DJV_SWIZZLE(b, 2,1,2,1)) );
+}
+
+// adjugate(A) * B
+inline __m128 simdAdjMul2( __m128 a, __m128 b ) {
+    return _mm_sub_ps( _mm_mul_ps(DJV_SWIZZLE(a, 3,3,0,0), b),
+		       _mm_mul_ps(DJV_SWIZZLE(a, 1,1,2,2), DJV_SWIZZLE(b, 2,3,0,1)) );
+}
+
+// A * adjugate(B)
+inline __m128 simdMulAdj2( __m128 a, __m128 b ) {
+    return _mm_sub_ps( _mm_mul_ps(a, DJV_SWIZZLE(b, 3,0,3,0)),
+		       _mm_mul_ps(DJV_SWIZZLE(a, 1,0,3,2), DJV_SWIZZLE(b, 2,1,2,1)) );
+}
+#endif
+
+// the general inverse; a singular m gives infinities (and a warning
+// in DEBUG builds), 'determinant' receives det(m) when given
+inline
+mat4 inverse( const mat4& m, GLfloat* determinant = NULL )
 {
-        GLfloat Coef00 = m[2][2] * m[3][3] - m[2][3] * m[3][2];
-        GLfloat Coef02 = m[2][1] * m[3][3] - m[2][3] * m[3][1];
-        GLfloat Coef03 = m[2][1] * m[3][2] - m[2][2] * m[3][1];
+#ifdef DJV_SIMD_SSE
+    // block inverse of | A B ; C D |, through the adjugates of the 2x2 blocks
+    __m128 r0 = simdLoad( m[0] ), r1 = simdLoad( m[1] );
+    __m128 r2 = simdLoad( m[2] ), r3 = simdLoad( m[3] );
+    __m128 A = _mm_movelh_ps( r0, r1 ), B = _mm_movehl_ps( r1, r0 );
+    __m128 C = _mm_movelh_ps( r2, r3 ), D = _mm_movehl_ps( r3, r2 );
+
+    // |A| |B| |C| |D|
+    __m128 dets = _mm_sub_ps( _mm_mul_ps(DJV_SHUFFLE(r0, r2, 0,2,0,2), DJV_SHUFFLE(r1, r3, 1,3,1,3)),
+			      _mm_mul_ps(DJV_SHUFFLE(r0, r2, 1,3,1,3), DJV_SHUFFLE(r1, r3, 0,2,0,2)) );
+    __m128 detA = DJV_SWIZZLE( dets, 0,0,0,0 ), detB = DJV_SWIZZLE( dets, 1,1,1,1 );
+    __m128 detC = DJV_SWIZZLE( dets, 2,2,2,2 ), detD = DJV_SWIZZLE( dets, 3,3,3,3 );
+
+    __m128 DC = simdAdjMul2( D, C );
+    __m128 AB = simdAdjMul2( A, B );
+    __m128 X = _mm_sub_ps( _mm_mul_ps(detD, A), simdMul2(B, DC) );
+    __m128 W = _mm_sub_ps( _mm_mul_ps(detA, D), simdMul2(C, AB) );
+    __m128 Y = _mm_sub_ps( _mm_mul_ps(detB, C), simdMulAdj2(D, AB) );
+    __m128 Z = _mm_sub_ps( _mm_mul_ps(detC, B), simdMulAdj2(A, DC) );
+
+    // |M| = |A||D| + |B||C| - trace(adj(A) B adj(D) C)
+    __m128 tr = _mm_mul_ps( AB, DJV_SWIZZLE(DC, 0,2,1,3) );
+    tr = _mm_add_ps( tr, DJV_SWIZZLE(tr, 2,3,0,1) );
+    tr = _mm_add_ps( tr, DJV_SWIZZLE(tr, 1,0,3,2) );
+    __m128 det = _mm_sub_ps( _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr );
+    if ( determinant )
+	*determinant = _mm_cvtss_f32( det );
+#ifdef DEBUG
+    if ( std::fabs(_mm_cvtss_f32(det)) < DivideByZeroTolerance )
+	Error( "inverse of a singular matrix" );
+#endif // DEBUG
 
-        GLfloat Coef04 = m[1][2] * m[3][3] - m[1][3] * m[3][2];
-        GLfloat Coef06 = m[1][1] * m[3][3] - m[1][3] * m[3][1];
-        GLfloat Coef07 = m[1][1] * m[3][2] - m[1][2] * m[3][1];
+    // the adjugates of X Y Z W, with the signs and 1/|M| applied
+    __m128 r = _mm_div_ps( _mm_setr_ps(1, -1, -1, 1), det );
+    X = _mm_mul_ps( X, r );  Y = _mm_mul_ps( Y, r );
+    Z = _mm_mul_ps( Z, r );  W = _mm_mul_ps( W, r );
+    return mat4( simdStore(DJV_SHUFFLE(X, Y, 3,1,3,1)), simdStore(DJV_SHUFFLE(X, Y, 2,0,2,0)),
+		 simdStore(DJV_SHUFFLE(Z, W, 3,1,3,1)), simdStore(DJV_SHUFFLE(Z, W, 2,0,2,0)) );
+#else
+    GLfloat det;
+    mat4 inv = scalar::inverse( m, &det );
+    if ( determinant )
+	*determinant = det;
+#ifdef DEBUG
+    if ( std::fabs(det) < DivideByZeroTolerance )
+	Error( "inverse of a singular matrix" );
+#endif // DEBUG
+    return inv;
+#endif
+}
+
+#ifdef DJV_SIMD_SSE
+#undef DJV_SHUFFLE
+#undef DJV_SWIZZLE
+#endif
+
+// m without projection (bottom row 0 0 0 1): the upper 3x3 inverted
+// through the cross products of its rows, then the translation undone
+inline
+mat4 affineInverse( const mat4& m )
+{
+    // the cross products of the rows, which are the columns of the inverse
+    GLfloat bc0 = m[1].y * m[2].z - m[1].z * m[2].y, bc1 = m[1].z * m[2].x - m[1].x * m[2].z, bc2 = m[1].x * m[2].y - m[1].y * m[2].x;
+    GLfloat ca0 = m[2].y * m[0].z - m[2].z * m[0].y, ca1 = m[2].z * m[0].x - m[2].x * m[0].z, ca2 = m[2].x * m[0].y - m[2].y * m[0].x;
+    GLfloat ab0 = m[0].y * m[1].z - m[0].z * m[1].y, ab1 = m[0].z * m[1].x - m[0].x * m[1].z, ab2 = m[0].x * m[1].y - m[0].y * m[1].x;
+    GLfloat r = GLfloat(1.0) / ( m[0].x * bc0 + m[0].y * bc1 + m[0].z * bc2 );
+    bc0 *= r; bc1 *= r; bc2 *= r;
+    ca0 *= r; ca1 *= r; ca2 *= r;
+    ab0 *= r; ab1 *= r; ab2 *= r;
+
+    // built whole, not transposed and patched an entry at a time
+    GLfloat x = m[0].w, y = m[1].w, z = m[2].w;
+    return mat4( bc0, ca0, ab0, -(bc0 * x + ca0 * y + ab0 * z),
+		 bc1, ca1, ab1, -(bc1 * x + ca1 * y + ab1 * z),
+		 bc2, ca2, ab2, -(bc2 * x + ca2 * y + ab2 * z),
+		 0, 0, 0, 1 );
+}
+
+// m only rotates and translates: the rotation transposed, the translation
+// rotated back
+inline
+mat4 rigidInverse( const mat4& m )
+{
+    GLfloat x = m[0].w, y = m[1].w, z = m[2].w;
+    return mat4( m[0].x, m[1].x, m[2].x, -(m[0].x * x + m[1].x * y + m[2].x * z),
+		 m[0].y, m[1].y, m[2].y, -(m[0].y * x + m[1].y * y + m[2].y * z),
+		 m[0].z, m[1].z, m[2].z, -(m[0].z * x + m[1].z * y + m[2].z * z),
+		 0, 0, 0, 1 );
+}
 
-        GLfloat Coef08 = m[1][2] * m[2][3] - m[1][3] * m[2][2];
-        GLfloat Coef10 = m[1][1] * m[2][3] - m[1][3] * m[2][1];
-        GLfloat Coef11 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+// the inverse transpose of the upper 3x3 of a modelView, which takes
+// normals to view space: the cross products of its rows over det
+inline
+mat3 normalMatrix( const mat4& m )
+{
+    GLfloat bc0 = m[1].y * m[2].z - m[1].z * m[2].y, bc1 = m[1].z * m[2].x - m[1].x * m[2].z, bc2 = m[1].x * m[2].y - m[1].y * m[2].x;
+    GLfloat ca0 = m[2].y * m[0].z - m[2].z * m[0].y, ca1 = m[2].z * m[0].x - m[2].x * m[0].z, ca2 = m[2].x * m[0].y - m[2].y * m[0].x;
+    GLfloat ab0 = m[0].y * m[1].z - m[0].z * m[1].y, ab1 = m[0].z * m[1].x - m[0].x * m[1].z, ab2 = m[0].x * m[1].y - m[0].y * m[1].x;
+    GLfloat r = GLfloat(1.0) / ( m[0].x * bc0 + m[0].y * bc1 + m[0].z * bc2 );
+    return mat3( bc0 * r, bc1 * r, bc2 * r,
+		 ca0 * r, ca1 * r, ca2 * r,
+		 ab0 * r, ab1 * r, ab2 * r );
+}
+
+// the point a perspective projView looks from, w = 1, or w = 0 when
+// there is none (an orthographic one); solved in double (mat.cpp)
+vec4 eyePoint( const mat4& projView );
 
-        GLfloat Coef12 = m[0][2] * m[3][3] - m[0][3] * m[3][2];
-        GLfloat Coef14 = m[0][1] * m[3][3] - m[0][3] * m[3][1];
-        GLfloat Coef15 = m[0][1] * m[3][2] - m[0][2] * m[3][1];
 
-        GLfloat Coef16 = m[0][2] * m[2][3] - m[0][3] * m[2][2];
-        GLfloat Coef18 = m[0][1] * m[2][3] - m[0][3] * m[2][1];
-        GLfloat Coef19 = m[0][1] * m[2][2] - m[0][2] * m[2][1];
 
-        GLfloat Coef20 = m[0][2] * m[1][3] - m[0][3] * m[1][2];
-        GLfloat Coef22 = m[0][1] * m[1][3] - m[0][3] * m[1][1];
-        GLfloat Coef23 = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+//----------------------------------------------------------------------------
+//
+//  Batched transforms and tests (mat.cpp)
+//
+//    Whole arrays at once, each element to the same bits as the one at a
+//    time expression in its comment. 'in' and 'out' may be the same array.
+//    Arrays longer than the batch threshold are split over threads.
+//
+
+// out[i] = m * in[i]
+void transform( const mat4& m, const vec4* in, vec4* out, size_t n );
 
-        vec4 const SignA(+1, -1, +1, -1);
-        vec4 const SignB(-1, +1, -1, +1);
+// out[i] = m * vec4( in[i], w ), dropping w: points (w = 1) or directions (w = 0)
+void transform( const mat4& m, const vec3* in, vec3* out, size_t n, GLfloat w = 1 );
 
-        vec4 Fac0(Coef00, Coef00, Coef02, Coef03);
-        vec4 Fac1(Coef04, Coef04, Coef06, Coef07);
-        vec4 Fac2(Coef08, Coef08, Coef10, Coef11);
-        vec4 Fac3(Coef12, Coef12, Coef14, Coef15);
-        vec4 Fac4(Coef16, Coef16, Coef18, Coef19);
-        vec4 Fac5(Coef20, Coef20, Coef22, Coef23);
+// the same with x, y and z in arrays of their own (structure of arrays)
+void transform( const mat4& m, const GLfloat* x, const GLfloat* y, const GLfloat* z,
+		GLfloat* outX, GLfloat* outY, GLfloat* outZ, size_t n, GLfloat w = 1 );
 
-        vec4 Vec0(m[0][1], m[0][0], m[0][0], m[0][0]);
-        vec4 Vec1(m[1][1], m[1][0], m[1][0], m[1][0]);
-        vec4 Vec2(m[1][2], m[2][0], m[2][0], m[2][0]);
-        vec4 Vec3(m[1][3], m[3][0], m[3][0], m[3][0]);
+// pos[i] = pos[i] + dir[i] * s
+void advance( vec4* pos, const vec4* dir, GLfloat s, size_t n );
 
-        vec4 Inv0 = SignA * (Vec1 * Fac0 - Vec2 * Fac1 + Vec3 * Fac2);
-        vec4 Inv1 = SignB * (Vec0 * Fac0 - Vec2 * Fac3 + Vec3 * Fac4);
-        vec4 Inv2 = SignA * (Vec0 * Fac1 - Vec1 * Fac3 + Vec3 * Fac5);
-        vec4 Inv3 = SignB * (Vec0 * Fac2 - Vec1 * Fac4 + Vec2 * Fac5);
+// pos[i] = pos[i] + RotateY( angle[i] ) * speed[i] * dir[i]
+void advanceRotatedY( vec4* pos, const vec4* dir, const GLfloat* angle,
+		      const GLfloat* speed, size_t n );
 
-        mat4 Inverse(Inv0.x, Inv1.x, Inv2.x, Inv3.x, 
-					 Inv0.y, Inv1.y, Inv2.y, Inv3.y,
-					 Inv0.z, Inv1.z, Inv2.z, Inv3.z,
-					 Inv0.w, Inv1.w, Inv2.w, Inv3.w );
+// pos[i] = pos[i] + vel[i]; size[i] += 0.1 (in double) where size[i] > 1;
+// outside[i] = 1 if the moved pos[i] has x or z beyond +-extent, else 0
+// (the asteroids' whole integrate step)
+void advanceGrowing( vec4* pos, const vec4* vel, GLfloat* size, unsigned char* outside,
+		     size_t n, GLfloat extent );
 
+// the number of points with sqrt( dx*dx + dy*dy + dz*dz ) < distance from
+// centre, the test detect_collision makes
+size_t countWithin( const vec4* points, size_t n, const vec4& centre, GLfloat distance );
 
-        vec4 Row0(Inverse[0][0], Inverse[0][1], Inverse[0][2], Inverse[0][3]);
+// inside[i] = 0 if points[i] has x or z beyond +-extent, else 1
+void insideSquare( const vec4* points, size_t n, GLfloat extent, unsigned char* inside );
 
-        GLfloat Determinant = dot(vec4(m[0][0], m[1][0], m[2][0], m[3][0]), Row0);
+// batches longer than 'threshold' elements are split into 'threads' jobs
+// on the shared job pool (1 keeps everything on the calling thread); by
+// default as many as the machine has cores, above 64K elements
+void setBatchThreads( unsigned int threads, size_t threshold );
 
-        Inverse /= Determinant;
-            
-        return Inverse;
-}
-*/
+// the instruction set the batch functions run with (isa.h), requestedIsa()
+// from startup on; setBatchIsa clamps to detectIsa() and returns the level
+IsaLevel setBatchIsa( IsaLevel level );
+IsaLevel batchIsa();
 
+//----------------------------------------------------------------------------
+//
+//  The matrices copy as plain memory too
+//
 
+static_assert( std::is_trivially_copyable< mat2 >::value, "mat2 must stay trivially copyable" );
+static_assert( std::is_trivially_copyable< mat3 >::value, "mat3 must stay trivially copyable" );
+static_assert( std::is_trivially_copyable< mat4 >::value, "mat4 must stay trivially copyable" );
 
 } 
 
@@ -0,0 +1,395 @@
+#include "memory_tracker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+ResourceTracker::ResourceTracker()
+	: bytes(0), frame(0)
+{
+}
+
+void ResourceTracker::created(unsigned int id, const char* owner)
+{
+	Resource r = { owner, 0, frame };
+	std::map< unsigned int, Resource >::iterator it = resources.find(id);
+	if (it != resources.end())
+		bytes -= it->second.bytes;
+	resources[id] = r;
+}
+
+void ResourceTracker::resized(unsigned int id, size_t size)
+{
+	std::map< unsigned int, Resource >::iterator it = resources.find(id);
+	if (it == resources.end())
+	{
+		// made without an owner (plain glGenBuffers), still count it
+		Resource r = { "untagged", 0, frame };
+		it = resources.insert(std::make_pair(id, r)).first;
+	}
+	bytes += size - it->second.bytes;
+	it->second.bytes = size;
+}
+
+void ResourceTracker::destroyed(unsigned int id)
+{
+	std::map< unsigned int, Resource >::iterator it = resources.find(id);
+	if (it != resources.end())
+	{
+		bytes -= it->second.bytes;
+		resources.erase(it);
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ResourceTracker::report(std::ostream& os) const
+{
+	struct Owner
+	{
+		int count;
+		size_t bytes;
+		unsigned int oldest, newest;
+	};
+	std::map< std::string, Owner > owners;
+
+	for (std::map< unsigned int, Resource >::const_iterator it = resources.begin(); it != resources.end(); ++it)
+	{
+		const Resource& r = it->second;
+		Owner& o = owners[r.owner];
+		if (o.count == 0)
+			o.oldest = o.newest = r.frame;
+		o.count++;
+		o.bytes += r.bytes;
+		o.oldest = std::min(o.oldest, r.frame);
+		o.newest = std::max(o.newest, r.frame);
+	}
+
+	os << liveCount() << " buffers, " << liveBytes() << " bytes (frame " << frame << ")\n";
+	for (std::map< std::string, Owner >::const_iterator it = owners.begin(); it != owners.end(); ++it)
+	{
+		const Owner& o = it->second;
+		os << "  " << it->first << ": " << o.count << " buffers, " << o.bytes
+		   << " bytes, created in frames " << o.oldest << " - " << o.newest << "\n";
+	}
+}
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+// Heap accounting
+
+// every block carries a header with its size and the tag it was made under,
+// 16 bytes so the block itself keeps malloc's alignment
+struct BlockHeader
+{
+	size_t size;
+	int tag;
+};
+
+static const size_t headerSize = 16;
+
+struct HeapCounters
+{
+	std::atomic< unsigned long long > allocations;
+	std::atomic< unsigned long long > frees;
+	std::atomic< long long > liveBytes;
+	std::atomic< long long > peakBytes;
+};
+
+static const int maxHeapTags = 32;
+
+// zero initialized before any constructor runs, so operator new works from the start
+static HeapCounters heapTotal;
+static HeapCounters heapTags[maxHeapTags];
+static const char* heapTagNames[maxHeapTags];
+static std::atomic< int > heapTagCount;
+static std::mutex heapTagMutex;
+
+static thread_local int currentHeapTag = -1;
+
+// the same counts for the current thread alone
+static thread_local unsigned long long threadAllocations;
+static thread_local unsigned long long threadTagAllocations[maxHeapTags];
+
+static void countAllocation(HeapCounters& c, size_t size)
+{
+	c.allocations.fetch_add(1, std::memory_order_relaxed);
+	long long live = c.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	long long peak = c.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		;
+}
+
+static void countFree(HeapCounters& c, size_t size)
+{
+	c.frees.fetch_add(1, std::memory_order_relaxed);
+	c.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+static void* trackedAlloc(size_t size)
+{
+	char* p = (char*)malloc(size + headerSize);
+	if (!p)
+		return NULL;
+
+	BlockHeader* h = (BlockHeader*)p;
+	h->size = size;
+	h->tag = currentHeapTag;
+
+	countAllocation(heapTotal, size);
+	threadAllocations++;
+	if (h->tag >= 0)
+	{
+		countAllocation(heapTags[h->tag], size);
+		threadTagAllocations[h->tag]++;
+	}
+	return p + headerSize;
+}
+
+static void trackedFree(void* block)
+{
+	if (!block)
+		return;
+
+	char* p = (char*)block - headerSize;
+	BlockHeader* h = (BlockHeader*)p;
+
+	countFree(heapTotal, h->size);
+	if (h->tag >= 0)
+		countFree(heapTags[h->tag], h->size);
+	free(p);
+}
+
+static HeapStats snapshot(const HeapCounters& c)
+{
+	HeapStats s;
+	s.allocations = c.allocations.load(std::memory_order_relaxed);
+	s.frees = c.frees.load(std::memory_order_relaxed);
+	s.liveBytes = c.liveBytes.load(std::memory_order_relaxed);
+	s.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+	return s;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+HeapStats heapStats()
+{
+	return snapshot(heapTotal);
+}
+
+static int findHeapTag(const char* tag)
+{
+	int n = heapTagCount.load(std::memory_order_acquire);
+	for (int i = 0; i < n; i++)
+		if (heapTagNames[i] == tag || strcmp(heapTagNames[i], tag) == 0)
+			return i;
+	return -1;
+}
+
+HeapStats heapStats(const char* tag)
+{
+	int i = findHeapTag(tag);
+	if (i < 0)
+	{
+		HeapStats none = { 0, 0, 0, 0 };
+		return none;
+	}
+	return snapshot(heapTags[i]);
+}
+
+HeapScope::HeapScope(const char* tag)
+	: previous(currentHeapTag)
+{
+	int i = findHeapTag(tag);
+	if (i < 0)
+	{
+		std::lock_guard< std::mutex > lock(heapTagMutex);
+		i = findHeapTag(tag);
+		int n = heapTagCount.load(std::memory_order_relaxed);
+		if (i < 0 && n < maxHeapTags)
+		{
+			heapTagNames[n] = tag;
+			heapTagCount.store(n + 1, std::memory_order_release);
+			i = n;
+		}
+	}
+	currentHeapTag = i;
+}
+
+HeapScope::~HeapScope()
+{
+	currentHeapTag = previous;
+}
+
+AllocationCounter::AllocationCounter(const char* excludedTag, bool thisThreadOnly)
+	: excluded(excludedTag), threadOnly(thisThreadOnly), start(allocations()),
+	  startExcluded(excludedAllocations())
+{
+}
+
+unsigned long long AllocationCounter::allocations() const
+{
+	return threadOnly ? threadAllocations : heapStats().allocations;
+}
+
+unsigned long long AllocationCounter::excludedAllocations() const
+{
+	if (!excluded)
+		return 0;
+	if (!threadOnly)
+		return heapStats(excluded).allocations;
+	int i = findHeapTag(excluded);
+	return i < 0 ? 0 : threadTagAllocations[i];
+}
+
+unsigned long long AllocationCounter::count() const
+{
+	return (allocations() - start) - (excludedAllocations() - startExcluded);
+}
+
+void reportHeap(std::ostream& os)
+{
+	HeapStats t = heapStats();
+	os << "heap: " << t.liveBytes << " bytes live (peak " << t.peakBytes << "), "
+	   << t.allocations << " allocations, " << t.frees << " frees\n";
+
+	int n = heapTagCount.load(std::memory_order_acquire);
+	for (int i = 0; i < n; i++)
+	{
+		HeapStats s = snapshot(heapTags[i]);
+		os << "  " << heapTagNames[i] << ": " << s.allocations << " allocations, "
+		   << s.liveBytes << " bytes live (peak " << s.peakBytes << ")\n";
+	}
+}
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+
+GrowthWatch::GrowthWatch(unsigned int warmup, double tolerance)
+	: used(0), bucketSize(1), inBucket(0), warmup(warmup), tolerance(tolerance), count(0)
+{
+}
+
+void GrowthWatch::sample(double value)
+{
+	if (count++ < warmup)
+		return;
+
+	if (inBucket == 0)
+	{
+		if (used == maxBuckets)
+		{
+			// keep the maximum of each pair, every bucket now covers twice as many samples
+			for (int i = 0; i < maxBuckets / 2; i++)
+				buckets[i] = std::max(buckets[2 * i], buckets[2 * i + 1]);
+			used = maxBuckets / 2;
+			bucketSize *= 2;
+		}
+		buckets[used++] = value;
+	}
+	else
+	{
+		buckets[used - 1] = std::max(buckets[used - 1], value);
+	}
+
+	if (++inBucket == bucketSize)
+		inBucket = 0;
+}
+
+bool GrowthWatch::growing() const
+{
+	if (used < 8)
+		return false;
+
+	// the highest value of each quarter, a leak raises every one of them
+	double quarter[4];
+	for (int q = 0; q < 4; q++)
+	{
+		int begin = used * q / 4, end = used * (q + 1) / 4;
+		quarter[q] = buckets[begin];
+		for (int i = begin + 1; i < end; i++)
+			quarter[q] = std::max(quarter[q], buckets[i]);
+	}
+
+	for (int q = 1; q < 4; q++)
+		if (quarter[q] <= quarter[q - 1])
+			return false;
+	return quarter[3] - quarter[0] > tolerance;
+}
+
+double GrowthWatch::slope() const
+{
+	if (used < 2)
+		return 0;
+
+	double mx = 0, my = 0;
+	for (int i = 0; i < used; i++)
+	{
+		mx += i;
+		my += buckets[i];
+	}
+	mx /= used;
+	my /= used;
+
+	double sxy = 0, sxx = 0;
+	for (int i = 0; i < used; i++)
+	{
+		sxy += (i - mx) * (buckets[i] - my);
+		sxx += (i - mx) * (i - mx);
+	}
+	return sxy / sxx / bucketSize;
+}
+
+}
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+// every new and delete in the program goes through the accounting above
+
+void* operator new(size_t size)
+{
+	void* p = djv::trackedAlloc(size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	return djv::trackedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+	return djv::trackedAlloc(size);
+}
+
+void operator delete(void* p) throw()
+{
+	djv::trackedFree(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	djv::trackedFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+	djv::trackedFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+	djv::trackedFree(p);
+}
@@ -0,0 +1,150 @@
+#ifndef DJV_MEMORY_TRACKER_H_
+#define DJV_MEMORY_TRACKER_H_
+/*
+	Memory accounting
+
+	ResourceTracker keeps every live resource (GL buffers, through the
+	tracked* helpers in gl_utilities) with its size, an owner tag and
+	the frame it was created in, and reports them grouped by owner.
+
+	The heap is accounted by replacing the global operator new/delete
+	(memory_tracker.cpp): totals for the whole program, plus per tag
+	totals for the code running inside a HeapScope, so hot paths can be
+	checked for allocations. AllocationCounter counts them over a stretch
+	of code, to check that it does not touch the heap at all.
+
+	GrowthWatch follows a value (live bytes) frame by frame and flags it
+	when it keeps rising after a warm-up, which is what a leak looks like.
+*/
+
+#include <stddef.h>
+
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class ResourceTracker
+{
+public:
+	ResourceTracker();
+
+	void created(unsigned int id, const char* owner);
+	void resized(unsigned int id, size_t bytes);
+	void destroyed(unsigned int id);
+
+	// the frame number stamped on new resources
+	void advanceFrame() { frame++; }
+	unsigned int currentFrame() const { return frame; }
+
+	size_t liveBytes() const { return bytes; }
+	int liveCount() const { return (int)resources.size(); }
+
+	// one line per owner: count, bytes and the oldest and newest creation frame
+	void report(std::ostream& os) const;
+
+private:
+	struct Resource
+	{
+		const char* owner; // a string literal, never freed
+		size_t bytes;
+		unsigned int frame;
+	};
+
+	std::map< unsigned int, Resource > resources;
+	size_t bytes;
+	unsigned int frame;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+struct HeapStats
+{
+	unsigned long long allocations;
+	unsigned long long frees;
+	long long liveBytes;
+	long long peakBytes;
+};
+
+// totals for the whole program
+HeapStats heapStats();
+
+// totals for the allocations made inside HeapScopes with this tag
+HeapStats heapStats(const char* tag);
+
+// attributes the heap use of the current thread to a tag while it exists,
+// scopes nest (the innermost tag counts); tags must be string literals
+class HeapScope
+{
+public:
+	HeapScope(const char* tag);
+	~HeapScope();
+
+private:
+	int previous;
+};
+
+// allocations per tag, one line each
+void reportHeap(std::ostream& os);
+
+// counts the heap allocations made (by any thread, or with thisThreadOnly
+// by the thread that made it, which then has to be the one asking) since
+// it was created, leaving out those made inside HeapScopes with the
+// excluded tag
+class AllocationCounter
+{
+public:
+	explicit AllocationCounter(const char* excludedTag = NULL, bool thisThreadOnly = false);
+
+	unsigned long long count() const;
+
+private:
+	unsigned long long allocations() const;
+	unsigned long long excludedAllocations() const;
+
+	const char* excluded;
+	bool threadOnly;
+	unsigned long long start;
+	unsigned long long startExcluded;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class GrowthWatch
+{
+public:
+	// samples before 'warmup' are ignored, growth under 'tolerance' is noise
+	GrowthWatch(unsigned int warmup, double tolerance);
+
+	void sample(double value);
+
+	// true when the value rose in each quarter of the samples since the
+	// warm-up and ended more than the tolerance above where it started
+	bool growing() const;
+
+	// least squares slope over the samples since the warm-up, per sample
+	double slope() const;
+
+	unsigned int samples() const { return count; }
+
+private:
+	// the samples since the warm-up, as the maximum of each run of
+	// bucketSize samples; when the buckets fill up neighbours are merged,
+	// so a soak of any length uses the same (fixed) memory
+	static const int maxBuckets = 256;
+	double buckets[maxBuckets];
+	int used;
+	unsigned int bucketSize;
+	unsigned int inBucket;
+
+	unsigned int warmup;
+	double tolerance;
+	unsigned int count;
+};
+
+}
+
+#endif
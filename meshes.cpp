@@ -1,5 +1,7 @@
 #include "meshes.h"
 
+#include <algorithm>
+
 #include "gl_utilities.h"
 
 namespace djv {
@@ -28,6 +30,8 @@ GLint Mesh::in_position_loc = -1;
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 Mesh::Mesh(void)
+	: vertex_bufferId(0), index_bufferId(0), wireIndex_bufferId(0), wireIndexNum(0),
+	  drawNum(0), stride(0)
 {
 }
 
@@ -35,6 +39,12 @@ Mesh::Mesh(void)
 
 Mesh::~Mesh(void)
 {
+	if (vertex_bufferId)
+		trackedDeleteBuffer(vertex_bufferId);
+	if (index_bufferId)
+		trackedDeleteBuffer(index_bufferId);
+	if (wireIndex_bufferId)
+		trackedDeleteBuffer(wireIndex_bufferId);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -43,59 +53,39 @@ void Mesh::init()
 {
 }
 
-// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
-
-
-GridMesh::GridMesh(int numX, int numY, float sizeSquare)
-{
-	this->numX = numX;
-	this->numY = numY;
-	this->sizeSquare = sizeSquare;
-}
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-void GridMesh::init()
+void Mesh::triangles(std::vector< vec4 >& vertices, std::vector< GLuint >& indices) const
 {
-	std::vector< vec2 > vertices;
-
-	float width = numX * sizeSquare;
-	float height = numY * sizeSquare;
+	// positions are 2, 3 or 4 floats, packed
+	GLint bytes = 0;
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
+	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &bytes);
+	int components = stride / sizeof(GLfloat);
+	std::vector< GLfloat > floats(bytes / sizeof(GLfloat));
+	glGetBufferSubData(GL_ARRAY_BUFFER, 0, floats.size() * sizeof(GLfloat), &floats[0]);
 
-	// draw vertical lines
-	for (int i = -numX; i <= numX; i++)
+	vertices.resize(floats.size() / components);
+	for (size_t i = 0; i < vertices.size(); i++)
 	{
-		float x = i * sizeSquare;
-		vertices.push_back(vec2(x, -height));
-		vertices.push_back(vec2(x, height));
+		const GLfloat* f = &floats[i * components];
+		vertices[i] = vec4(f[0], f[1], components > 2 ? f[2] : 0, 1);
 	}
 
-	// draw horizontal lines
-	for (int i = -numY; i <= numY; i++)
+	// the filled indices are shorts; without any, the vertices are in order
+	indices.resize(drawNum);
+	if (index_bufferId)
 	{
-		float y = i  * sizeSquare;
-		vertices.push_back(vec2(-width, y));
-		vertices.push_back(vec2(width, y));
+		std::vector< GLushort > shorts(drawNum);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_bufferId);
+		glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, shorts.size() * sizeof(GLushort), &shorts[0]);
+		std::copy(shorts.begin(), shorts.end(), indices.begin());
+	}
+	else
+	{
+		for (int i = 0; i < drawNum; i++)
+			indices[i] = i;
 	}
-
-	drawNum = vertices.size();
-	stride = sizeof(vertices[0]);
-
-	// Create vertex buffer
-	glGenBuffers(1, &vertex_bufferId);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glBufferData(GL_ARRAY_BUFFER, stride * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
-
-	// describe how the shader attributes appear in the array buffer
-	//glVertexAttribPointer(Mesh::in_position_loc, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
-
-
-}
-
-void GridMesh::draw(bool filled)
-{
-	//glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glVertexAttribPointer(Mesh::in_position_loc, 2, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
-	glDrawArrays(GL_LINES, 0, drawNum);
 }
 
 // = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
@@ -176,19 +166,19 @@ void CubeMesh::init()
 	wireIndexNum = 24;
 
 	// Create vertex buffer
-	glGenBuffers(1, &vertex_bufferId);
+	vertex_bufferId = trackedGenBuffer("CubeMesh");
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	trackedBufferData(GL_ARRAY_BUFFER, vertex_bufferId, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
 	// Create index buffer
-	glGenBuffers(1, &index_bufferId);
+	index_bufferId = trackedGenBuffer("CubeMesh");
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_bufferId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	trackedBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bufferId, sizeof(indices), indices, GL_STATIC_DRAW);
 
 	// Create index buffer
-	glGenBuffers(1, &wireIndex_bufferId);
+	wireIndex_bufferId = trackedGenBuffer("CubeMesh");
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wireIndex_bufferId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(wireIndices), wireIndices, GL_STATIC_DRAW);
+	trackedBufferData(GL_ELEMENT_ARRAY_BUFFER, wireIndex_bufferId, sizeof(wireIndices), wireIndices, GL_STATIC_DRAW);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -253,9 +243,9 @@ void CylinderMesh::init(int facets, int segments)
 	//cylinder.numVertices = vertices.size();
 
 	// create the vertex buffer
-	glGenBuffers(1, &vertex_bufferId);
+	vertex_bufferId = trackedGenBuffer("CylinderMesh");
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
+	trackedBufferData(GL_ARRAY_BUFFER, vertex_bufferId, sizeof(vertices[0]) * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
 	stride = sizeof(vertices[0]);
 
 	// create indices for filled cylinder
@@ -314,9 +304,9 @@ void CylinderMesh::init(int facets, int segments)
 
 	// load into buffer
 	drawNum = indices.size();
-	glGenBuffers(1, &index_bufferId);
+	index_bufferId = trackedGenBuffer("CylinderMesh");
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_bufferId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices.front(), GL_STATIC_DRAW);
+	trackedBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bufferId, sizeof(indices[0]) * indices.size(), &indices.front(), GL_STATIC_DRAW);
 
 	// create indices for wire cylinder
 	std::vector< GLushort > wireIndices;
@@ -334,9 +324,9 @@ void CylinderMesh::init(int facets, int segments)
 
 	// load into buffer
 	wireIndexNum = wireIndices.size();
-	glGenBuffers(1, &wireIndex_bufferId);
+	wireIndex_bufferId = trackedGenBuffer("CylinderMesh");
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wireIndex_bufferId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(wireIndices[0]) * wireIndices.size(), &wireIndices.front(), GL_STATIC_DRAW);
+	trackedBufferData(GL_ELEMENT_ARRAY_BUFFER, wireIndex_bufferId, sizeof(wireIndices[0]) * wireIndices.size(), &wireIndices.front(), GL_STATIC_DRAW);
 
 }
 
@@ -364,7 +354,9 @@ void CylinderMesh::draw(bool filled)
 
 void SphereMesh::init(int n)
 {
-	std::vector< vec4 > vertices;
+	// 4 faces, each split into 4^n triangles; only needed until the upload
+	ArenaVector< vec4 >::type vertices(frameArena());
+	vertices.reserve(4 * 3 << (2 * n));
 
 	// 4 points on a tetrahedron
 	vec4 v[4]= {	vec4(0.0, 0.0, 1.0, 1.0), 
@@ -373,20 +365,15 @@ void SphereMesh::init(int n)
 					vec4(0.816497, -0.471405, -0.333333, 1.0) 	};
 
 	// recursive subdivision, add to vertex list
-	std::vector< vec4 > t;
-	t =	divide_triangle(v[0], v[1], v[2] , n);
-	vertices.insert( vertices.end(), t.begin(), t.end() );
-	t = divide_triangle(v[3], v[2], v[1], n );
-	vertices.insert( vertices.end(), t.begin(), t.end() );
-	t = divide_triangle(v[0], v[3], v[1], n );
-	vertices.insert( vertices.end(), t.begin(), t.end() );
-	t = divide_triangle(v[0], v[2], v[3], n );
-	vertices.insert( vertices.end(), t.begin(), t.end() );
+	divide_triangle(v[0], v[1], v[2], n, vertices);
+	divide_triangle(v[3], v[2], v[1], n, vertices);
+	divide_triangle(v[0], v[3], v[1], n, vertices);
+	divide_triangle(v[0], v[2], v[3], n, vertices);
 
 	// put sphere vertices in buffer
-	glGenBuffers(1, &vertex_bufferId);
+	vertex_bufferId = trackedGenBuffer("SphereMesh");
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
+	trackedBufferData(GL_ARRAY_BUFFER, vertex_bufferId, sizeof(vertices[0]) * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
 	stride = sizeof(vertices[0]);
 	drawNum = vertices.size();
 
@@ -395,9 +382,8 @@ void SphereMesh::init(int n)
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-std::vector< vec4 > SphereMesh::divide_triangle(vec4 a, vec4 b, vec4 c, int n)
+void SphereMesh::divide_triangle(vec4 a, vec4 b, vec4 c, int n, ArenaVector< vec4 >::type& vertices)
 {
-	std::vector< vec4 > vertices;
 	vec4 v1, v2, v3;
 	// recurse
 	if(n > 0)
@@ -406,28 +392,18 @@ std::vector< vec4 > SphereMesh::divide_triangle(vec4 a, vec4 b, vec4 c, int n)
 		v2 = unit(a + c);
 		v3 = unit(b + c);   
 
-		std::vector< vec4 > t;
-		t =	divide_triangle(a ,v2, v1, n-1) ;
-		vertices.insert( vertices.end(), t.begin(), t.end() );
-		t = divide_triangle(c ,v3, v2, n-1);
-		vertices.insert( vertices.end(), t.begin(), t.end() );
-		t = divide_triangle(b ,v1, v3, n-1);
-		vertices.insert( vertices.end(), t.begin(), t.end() );
-		t = divide_triangle(v1 ,v2, v3, n-1);
-		vertices.insert( vertices.end(), t.begin(), t.end() );
-		return vertices;
+		divide_triangle(a ,v2, v1, n-1, vertices);
+		divide_triangle(c ,v3, v2, n-1, vertices);
+		divide_triangle(b ,v1, v3, n-1, vertices);
+		divide_triangle(v1 ,v2, v3, n-1, vertices);
 	}
 	// end recursion
 	else 
 	{
-		// just create a triangle and return it
-		std::vector< vec4 > t;
-		t.push_back(a);
-		t.push_back(b);
-		t.push_back(c);
-
-		vertices.insert( vertices.end(), t.begin() , t.end());
-		return vertices;
+		// just add the triangle
+		vertices.push_back(a);
+		vertices.push_back(b);
+		vertices.push_back(c);
 	}
 }
 
@@ -463,45 +439,22 @@ void SphereMesh::draw(bool filled)
 	glDrawArrays(GL_TRIANGLES, 0, drawNum);
 }
 
-void Stars::init()
+#ifdef GL_COMPUTE_SHADER
+void SphereMesh::drawInstanced(GLint position_loc, GLsizei instances)
 {
-	std::vector< vec3 > vertices;
-
-	for(int i =0; i < 4000; i++)
-	{	
-		vertices.push_back(vec3(randRange(-130,130),randRange(-130,130),randRange(-130,130)));
-
-	}
-	
-	
-
-	drawNum = vertices.size();
-	stride = sizeof(vertices[0]);
-
-	// Create vertex buffer
-	glGenBuffers(1, &vertex_bufferId);
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glBufferData(GL_ARRAY_BUFFER, stride * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
+	glVertexAttribPointer(position_loc, 4, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
+	glDrawArraysInstanced(GL_TRIANGLES, 0, drawNum, instances);
 }
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-
-
-
-void Stars::draw(bool filled)
-{
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glPointSize(1.2f);
-	glVertexAttribPointer(Mesh::in_position_loc, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
-	glDrawArrays(GL_POINTS, 0, drawNum);
-	
-}
-
+#endif
 
 // START PARTICLES
+// calling init() again scatters the particles anew in the same buffer
 void shipParticles::init()
 {
-	std::vector< vec3 > vertices;
+	// called every frame, the vertices only live until they are uploaded
+	ArenaVector< vec3 >::type vertices(frameArena());
+	vertices.reserve(12);
 
 	for(int f = 0; f < 12; f++)
 	{
@@ -517,10 +470,16 @@ void shipParticles::init()
 	drawNum = vertices.size();
 	stride = sizeof(vertices[0]);
 
-	// Create vertex buffer
-	glGenBuffers(1, &vertex_bufferId);
+	// Create vertex buffer the first time, refill it after that
+	if (vertex_bufferId)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
+		trackedBufferSubData(GL_ARRAY_BUFFER, 0, stride * vertices.size(), &vertices.front());
+		return;
+	}
+	vertex_bufferId = trackedGenBuffer("shipParticles");
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glBufferData(GL_ARRAY_BUFFER, stride * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
+	trackedBufferData(GL_ARRAY_BUFFER, vertex_bufferId, stride * vertices.size(), &vertices.front(), GL_DYNAMIC_DRAW);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -616,9 +575,9 @@ void Ship::init()
 	stride = sizeof(vertices[0]);
 
 	// Create vertex buffer
-	glGenBuffers(1, &vertex_bufferId);
+	vertex_bufferId = trackedGenBuffer("Ship");
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_bufferId);
-	glBufferData(GL_ARRAY_BUFFER, stride * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
+	trackedBufferData(GL_ARRAY_BUFFER, vertex_bufferId, stride * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
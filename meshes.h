@@ -6,6 +6,7 @@
 #include "gl_include.h"
 
 #include "vec.h"
+#include "arena.h"
 
 
 namespace djv {
@@ -13,12 +14,12 @@ namespace djv {
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 
-// abstract Mesh class
+// abstract Mesh class, owns its buffers (so meshes can not be copied)
 class Mesh
 {
 public:
 	Mesh(void);
-	~Mesh(void);
+	virtual ~Mesh(void);
 
 	virtual void init() = 0;
 	virtual void draw(bool filled) = 0;
@@ -26,29 +27,24 @@ public:
 	// the shader attribute location for vertex position
 	static GLint in_position_loc;
 
+	// the filled triangles read back from the mesh's buffers, every vertex
+	// with w = 1 (only for meshes filled with triangles: sphere, cube,
+	// cylinder; for sharing one geometry buffer between them)
+	void triangles(std::vector< vec4 >& vertices, std::vector< GLuint >& indices) const;
+
 protected:
 	GLuint generateBufferId();
 	GLuint vertex_bufferId;
 	GLuint index_bufferId;
+	GLuint wireIndex_bufferId;
+	int wireIndexNum;
 
 	int drawNum;
 	int stride;
 
-};
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-
-class GridMesh : public Mesh
-{
-public:
-	GridMesh(int numX, int numY, float sizeSquare);
-	void init();
-	void draw(bool filled = true);
-protected:
-	int numX;
-	int numY;
-	float sizeSquare;
-
+private:
+	Mesh(const Mesh&);
+	Mesh& operator=(const Mesh&);
 };
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -59,10 +55,6 @@ public:
 	void init();
 	void draw(bool filled = true);
 
-protected:
-	GLuint wireIndex_bufferId;
-	int wireIndexNum;
-
 };
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -75,8 +67,15 @@ public:
 	void init(int n);
 	void draw(bool filled = true);
 
+#ifdef GL_COMPUTE_SHADER
+	// one draw of 'instances' spheres, the vertices fed to position_loc
+	// (the shader places each one by gl_InstanceID; the GPU asteroids)
+	void drawInstanced(GLint position_loc, GLsizei instances);
+#endif
+
 private:
-	std::vector< vec4 > divide_triangle(vec4 a, vec4 b, vec4 c, int n);
+	// appends the triangles of one face subdivided n times
+	void divide_triangle(vec4 a, vec4 b, vec4 c, int n, ArenaVector< vec4 >::type& vertices);
 	vec4 unit(const vec4 &p);
 
 };
@@ -91,21 +90,6 @@ public:
 	void init(int facets, int segments);
 	void draw(bool filled = true);
 
-protected:
-	GLuint wireIndex_bufferId;
-	int wireIndexNum;
-
-};
-
-class Stars : public Mesh
-{
-public:
-	void init();
-	void draw(bool filled = true);
-protected:
-	GLuint wireIndex_bufferId;
-	int wireIndexNum;
-
 };
 
 class shipParticles : public Mesh
@@ -113,10 +97,6 @@ class shipParticles : public Mesh
 public:
 	void init();
 	void draw(bool filled = true);
-protected:
-	GLuint wireIndex_bufferId;
-	int wireIndexNum;
-
 };
 
 
@@ -125,10 +105,6 @@ class Ship : public Mesh
 public:
 	void init();
 	void draw(bool filled = true);
-protected:
-	GLuint wireIndex_bufferId;
-	int wireIndexNum;
-
 };
 
 
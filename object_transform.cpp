@@ -0,0 +1,36 @@
+#include "object_transform.h"
+
+#include <string.h>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+ObjectTransform::ObjectTransform()
+	: dirty(false)
+{
+}
+
+void ObjectTransform::setModel(const mat4& m)
+{
+	if (memcmp(&m, &model, sizeof(mat4)) != 0)
+	{
+		model = m;
+		dirty = true;
+	}
+}
+
+const mat3& ObjectTransform::getNormalMatrix()
+{
+	if (dirty)
+	{
+		normal = normalMatrix(model);
+		dirty = false;
+		recomputeCount++;
+	}
+	return normal;
+}
+
+unsigned int ObjectTransform::recomputeCount;
+
+}
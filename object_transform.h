@@ -0,0 +1,59 @@
+#ifndef DJV_OBJECT_TRANSFORM_H_
+#define DJV_OBJECT_TRANSFORM_H_
+/*
+	An object's model transform and its cached normal matrix
+
+	The cache itself needs no GL context (object_transform.cpp, built with
+	the world, so the bench checks it); sending the uniforms is with the
+	lights and materials in lighting.cpp.
+*/
+
+#include "vec.h"
+#include "mat.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// where an object is, with the normal matrix of its model transform
+// (the inverse transpose), which is only recomputed after the model
+// transform has changed
+class ObjectTransform
+{
+public:
+	ObjectTransform();
+
+	// initialize the modelView and normalMatrix uniform locations
+	// (lighting.cpp, with the other uniforms)
+	static void initUniformLocations(GLuint program);
+
+	// setting the same transform again keeps the normal matrix
+	void setModel(const mat4& m);
+	const mat4& getModel() const { return model; }
+
+	const mat3& getNormalMatrix();
+
+	// send modelView = View * model and its normal matrix; viewNormal is
+	// normalMatrix(View), worked out once per frame by the caller
+	// (lighting.cpp)
+	void sendUniforms(const mat4& View, const mat3& viewNormal);
+
+	// normal matrices computed by all objects, to check the cache works
+	static unsigned int recomputed() { return recomputeCount; }
+
+private:
+
+	mat4 model;
+	mat3 normal;
+	bool dirty;
+
+	static unsigned int recomputeCount;
+
+	// shader uniform ids
+	static GLint id_modelView;
+	static GLint id_normalMatrix;
+};
+
+}
+
+#endif
@@ -0,0 +1,233 @@
+#include "perf_overlay.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "gl_utilities.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// panel layout, in normalized device coordinates
+static const float panelLeft = 0.30f, panelRight = 0.97f;
+static const float panelBottom = 0.10f, panelTop = 0.84f;
+static const float graphLeft = 0.34f, graphRight = 0.94f;
+static const float graphBottom = 0.42f, graphTop = 0.80f;
+static const float graphMs = 33.3f; // frame time at the top of the graph
+
+static const float digitWidth = 0.018f, digitHeight = 0.045f, digitAdvance = 0.028f;
+
+// colours of the parts of a frame (the readouts use the same ones)
+static const vec4 backColour(0.0f, 0.0f, 0.0f, 0.6f);
+static const vec4 frameColour(0.5f, 0.5f, 0.5f, 0.9f);
+static const vec4 simColour(0.2f, 0.9f, 0.3f, 0.9f);
+static const vec4 renderColour(0.3f, 0.5f, 1.0f, 0.9f);
+static const vec4 targetColour(1.0f, 1.0f, 0.2f, 0.9f);
+static const vec4 asteroidColour(1.0f, 0.6f, 0.1f, 1.0f);
+static const vec4 drawColour(1.0f, 0.3f, 0.3f, 1.0f);
+static const vec4 memoryColour(0.9f, 0.3f, 1.0f, 1.0f);
+
+// segments of the digits 0-9, bit 0 = top, then clockwise, bit 6 = middle
+static const unsigned char digitSegments[10] = {
+	0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+PerfOverlay::PerfOverlay()
+	: program(0), buffer(0), positionLoc(-1), colourLoc(-1), visible(false)
+{
+}
+
+PerfOverlay::~PerfOverlay()
+{
+	release();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void PerfOverlay::init()
+{
+	release();
+	program = loadAndInitializeShaders("vshader_overlay.glsl", "fshader2.glsl");
+	positionLoc = glGetAttribLocation(program, "in_Position");
+	colourLoc = glGetAttribLocation(program, "in_Colour");
+	buffer = trackedGenBuffer("PerfOverlay");
+
+	// enough for the graph and the readouts, so the vectors never grow
+	triangles.reserve(6 * (3 * FrameHistory::capacity + 16));
+	lines.reserve(2 * 7 * 64 + 16);
+}
+
+void PerfOverlay::release()
+{
+	if (buffer)
+		trackedDeleteBuffer(buffer);
+	buffer = 0;
+	if (program)
+		glDeleteProgram(program);
+	program = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void PerfOverlay::quad(float x0, float y0, float x1, float y1, const vec4& c)
+{
+	Vertex v[4] = {
+		{ x0, y0, c.x, c.y, c.z, c.w },
+		{ x1, y0, c.x, c.y, c.z, c.w },
+		{ x1, y1, c.x, c.y, c.z, c.w },
+		{ x0, y1, c.x, c.y, c.z, c.w }
+	};
+	triangles.push_back(v[0]);
+	triangles.push_back(v[1]);
+	triangles.push_back(v[2]);
+	triangles.push_back(v[0]);
+	triangles.push_back(v[2]);
+	triangles.push_back(v[3]);
+}
+
+void PerfOverlay::line(float x0, float y0, float x1, float y1, const vec4& c)
+{
+	Vertex a = { x0, y0, c.x, c.y, c.z, c.w };
+	Vertex b = { x1, y1, c.x, c.y, c.z, c.w };
+	lines.push_back(a);
+	lines.push_back(b);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+float PerfOverlay::text(float x, float y, const char* s, const vec4& c)
+{
+	const float w = digitWidth, h = digitHeight, m = digitHeight / 2;
+
+	for (; *s; s++)
+	{
+		if (*s == '.')
+		{
+			line(x, y, x + w / 4, y, c);
+			x += digitAdvance / 2;
+			continue;
+		}
+
+		unsigned char segments = 0;
+		if (*s >= '0' && *s <= '9')
+			segments = digitSegments[*s - '0'];
+		else if (*s == '-')
+			segments = 0x40;
+
+		if (segments & 0x01) line(x, y + h, x + w, y + h, c);         // top
+		if (segments & 0x02) line(x + w, y + h, x + w, y + m, c);     // top right
+		if (segments & 0x04) line(x + w, y + m, x + w, y, c);         // bottom right
+		if (segments & 0x08) line(x, y, x + w, y, c);                 // bottom
+		if (segments & 0x10) line(x, y, x, y + m, c);                 // bottom left
+		if (segments & 0x20) line(x, y + m, x, y + h, c);             // top left
+		if (segments & 0x40) line(x, y + m, x + w, y + m, c);         // middle
+		x += digitAdvance;
+	}
+	return x;
+}
+
+// a colour swatch (the key) followed by the value
+void PerfOverlay::readout(float x, float y, const char* value, const vec4& c)
+{
+	quad(x, y + digitHeight * 0.25f, x + 0.02f, y + digitHeight * 0.75f, c);
+	text(x + 0.035f, y, value, c);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void PerfOverlay::draw(const FrameHistory& history)
+{
+	if (!visible || history.size() == 0)
+		return;
+
+	triangles.clear();
+	lines.clear();
+
+	quad(panelLeft, panelBottom, panelRight, panelTop, backColour);
+
+	// one stacked bar per frame: simulation, rendering, then the rest of the frame
+	const float barWidth = (graphRight - graphLeft) / FrameHistory::capacity;
+	const float msHeight = (graphTop - graphBottom) / graphMs;
+	float x = graphRight - barWidth * history.size();
+	for (int i = 0; i < history.size(); i++, x += barWidth)
+	{
+		const FrameSample& s = history[i];
+		float sim = graphBottom + s.simMs * msHeight;
+		float render = sim + s.renderMs * msHeight;
+		float frame = graphBottom + s.frameMs * msHeight;
+
+		sim = std::min(sim, graphTop);
+		render = std::min(render, graphTop);
+		frame = std::min(std::max(frame, render), graphTop);
+
+		quad(x, graphBottom, x + barWidth, sim, simColour);
+		quad(x, sim, x + barWidth, render, renderColour);
+		quad(x, render, x + barWidth, frame, frameColour);
+	}
+
+	// the 60 Hz frame budget
+	float target = graphBottom + 16.7f * msHeight;
+	line(graphLeft, target, graphRight, target, targetColour);
+	line(graphLeft, graphBottom, graphRight, graphBottom, frameColour);
+
+	// readouts: average times on the first row, counts of the latest frame below
+	FrameSample mean = history.average();
+	const FrameSample& last = history.latest();
+	char value[32];
+
+	snprintf(value, sizeof(value), "%.1f", mean.frameMs);
+	readout(0.34f, 0.30f, value, frameColour);
+	snprintf(value, sizeof(value), "%.2f", mean.simMs);
+	readout(0.55f, 0.30f, value, simColour);
+	snprintf(value, sizeof(value), "%.2f", mean.renderMs);
+	readout(0.76f, 0.30f, value, renderColour);
+
+	snprintf(value, sizeof(value), "%d", last.asteroids);
+	readout(0.34f, 0.16f, value, asteroidColour);
+	snprintf(value, sizeof(value), "%d", last.drawCalls);
+	readout(0.55f, 0.16f, value, drawColour);
+	snprintf(value, sizeof(value), "%d", (int)(last.bufferBytes / 1024));
+	readout(0.76f, 0.16f, value, memoryColour);
+
+	// upload both batches into the one buffer, re-specifying it each frame
+	// lets the driver hand out fresh memory instead of waiting on the GPU
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(program);
+
+	GLsizeiptr triangleBytes = triangles.size() * sizeof(Vertex);
+	GLsizeiptr lineBytes = lines.size() * sizeof(Vertex);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	trackedBufferData(GL_ARRAY_BUFFER, buffer, triangleBytes + lineBytes, NULL, GL_STREAM_DRAW);
+	trackedBufferSubData(GL_ARRAY_BUFFER, 0, triangleBytes, &triangles.front());
+	if (lineBytes > 0)
+		trackedBufferSubData(GL_ARRAY_BUFFER, triangleBytes, lineBytes, &lines.front());
+
+	// the main program keeps its position attribute enabled, leave it that way
+	GLint colourWasEnabled = 0, positionWasEnabled = 0;
+	glGetVertexAttribiv(colourLoc, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &colourWasEnabled);
+	glGetVertexAttribiv(positionLoc, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &positionWasEnabled);
+
+	glEnableVertexAttribArray(positionLoc);
+	glEnableVertexAttribArray(colourLoc);
+	glVertexAttribPointer(positionLoc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(0));
+	glVertexAttribPointer(colourLoc, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(2 * sizeof(GLfloat)));
+
+	glDisable(GL_DEPTH_TEST);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)triangles.size());
+	glDrawArrays(GL_LINES, (GLint)triangles.size(), (GLsizei)lines.size());
+	glEnable(GL_DEPTH_TEST);
+
+	if (!colourWasEnabled)
+		glDisableVertexAttribArray(colourLoc);
+	if (!positionWasEnabled)
+		glDisableVertexAttribArray(positionLoc);
+
+	glUseProgram(previous);
+}
+
+}
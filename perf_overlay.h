@@ -0,0 +1,69 @@
+#ifndef DJV_PERF_OVERLAY_H_
+#define DJV_PERF_OVERLAY_H_
+/*
+	In-game performance overlay
+
+	A panel over the top right of the screen (toggled with 'p') with a
+	graph of the recent frame times, split into simulation, rendering
+	and everything else, and seven segment readouts of the averages,
+	asteroids, draw calls and GL buffer memory. The whole panel is built
+	on the CPU into one stream buffer and drawn with two draw calls
+	(triangles, then lines), so it barely shows up in its own numbers.
+*/
+
+#include <vector>
+
+#include "gl_include.h"
+#include "vec.h"
+#include "frame_stats.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class PerfOverlay
+{
+public:
+	PerfOverlay();
+	~PerfOverlay();
+
+	// load the overlay shaders and create the buffer (needs a GL context)
+	void init();
+	void release();
+
+	bool toggle() { return visible = !visible; }
+	bool isVisible() const { return visible; }
+
+	// draw calls the overlay itself issues
+	int drawCalls() const { return visible ? 2 : 0; }
+
+	// draw over the frame, leaves the current program as it was
+	void draw(const FrameHistory& history);
+
+private:
+	// position in normalized device coordinates, colour per vertex
+	struct Vertex
+	{
+		GLfloat x, y;
+		GLfloat r, g, b, a;
+	};
+
+	void quad(float x0, float y0, float x1, float y1, const vec4& colour);
+	void line(float x0, float y0, float x1, float y1, const vec4& colour);
+	// digits, '.' and '-' as seven segment characters, returns the x after the text
+	float text(float x, float y, const char* s, const vec4& colour);
+	void readout(float x, float y, const char* value, const vec4& colour);
+
+	std::vector< Vertex > triangles;
+	std::vector< Vertex > lines;
+
+	GLuint program;
+	GLuint buffer;
+	GLint positionLoc;
+	GLint colourLoc;
+	bool visible;
+};
+
+}
+
+#endif
@@ -82,25 +82,12 @@ quat::quat(const double *d)
     s    = (float) d[3];
 }
 
-quat::quat(const quat &q)
-{
-    v = q.v;
-    s = q.s;
-}
-
 void quat::set(const vec3 &_v, const float _s)
 {
     v = _v;
     s = _s;
 }
 
-quat &quat::operator=(const quat &q)
-{ 
-    v = q.v;  
-    s = q.s; 
-    return *this; 
-}
-
 /******** quat friends ************/
 
 quat operator + (const quat &a, const quat &b)
@@ -153,6 +140,63 @@ mat4 quat::to_mat4() const
     return matrix;
 }
 
+/******************************************** length(), normalize() ***/
+
+float quat::length2() const
+{
+    return dot(v,v) + s*s;
+}
+
+float quat::length() const
+{
+    return (float) sqrt( length2() );
+}
+
+quat &quat::normalize()
+{
+    float l = length();
+    v = v / l;
+    s = s / l;
+    return *this;
+}
+
+/************************************************ quat::to_affine() ***/
+/* The transpose of to_mat4 with the translation in the last column,   */
+/* so the rows come out in the order mat4 * vec4 uses                  */
+
+affine quat::to_affine(const vec4 &translation) const
+{
+    float xs, ys, zs, wx, wy, wz, xx, xy, xz, yy, yz, zz;
+
+    float t  = 2.0f / (dot(v,v) + s*s);
+
+    xs = v[0]*t;   ys = v[1]*t;   zs = v[2]*t;
+    wx = s*xs;      wy = s*ys;      wz = s*zs;
+    xx = v[0]*xs;  xy = v[0]*ys;  xz = v[0]*zs;
+    yy = v[1]*ys;  yz = v[1]*zs;  zz = v[2]*zs;
+
+    return affine(
+           vec4( 1.0f-(yy+zz), xy-wz,        xz+wy,        translation.x ),
+           vec4( xy+wz,        1.0f-(xx+zz), yz-wx,        translation.y ),
+           vec4( xz-wy,        yz+wx,        1.0f-(xx+yy), translation.z ) );
+}
+
+/************************************************** quat::xform() *****/
+/* Rotates v by a unit quat                                            */
+
+vec3 quat::xform(const vec3 &p) const
+{
+    vec3 t = 2.0f * cross(v, p);
+    return p + s * t + cross(v, t);
+}
+
+/********************************************** quat::conjugate() *****/
+
+quat quat::conjugate() const
+{
+    return quat( -v, s );
+}
+
 /************************************************* quat_identity() *****/
 /* Returns quaternion identity element                                 */
 
@@ -170,7 +214,7 @@ quat quat_slerp(const quat &from, const quat &to, float t)
     float omega, cosom, sinom, scale0, scale1;
 
     /* calculate cosine */
-    cosom = dot(from.v,to.v) + from.s + to.s;
+    cosom = dot(from.v,to.v) + from.s * to.s;
 
     /* Adjust signs (if necessary) */
     if ( cosom < 0.0 ) 
@@ -202,6 +246,29 @@ quat quat_slerp(const quat &from, const quat &to, float t)
     return scale0 * from + scale1 * to1;
 }
 
+/********************************************** quat_axis_angle() ****/
+/* Rotation by 'degrees' about a unit axis, as RotateX/Y/Z do for the  */
+/* coordinate axes                                                     */
+
+quat quat_axis_angle(const vec3 &axis, float degrees)
+{
+    float half = DegreesToRadians * degrees * 0.5f;
+    return quat( axis * (float) sin( half ), (float) cos( half ) );
+}
+
+/****************************************** quat_slerp() (batch) *****/
+/* Interpolates n pairs by the same t, renormalizing so repeated       */
+/* easing (bank, camera) stays on the unit sphere                      */
+
+void quat_slerp(const quat *from, const quat *to, float t, quat *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        quat q = quat_slerp( from[i], to[i], t );
+        out[i] = q.normalize();
+    }
+}
+
 /********************************************** set_angle() ************/
 /* set rot angle (degrees)                                             */
 
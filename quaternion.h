@@ -30,9 +30,11 @@
 #define GLUI_QUATERNION_H
 
 #include <cstdio>
+#include <cstddef>
 
 #include "vec.h"
 #include "mat.h"
+#include "affine.h"
 
 namespace djv {
 
@@ -63,11 +65,9 @@ public:
   quat(float   s, const vec3 &v);
   quat(const float  *d);     /* copy from four-element float array  */
   quat(const double *f);     /* copy from four-element double array */
-  quat(const quat   &q);     /* copy from other quat                */
 
   /* Assignment operators */
 
-  quat  &operator  = (const quat &v);      /* assignment of a quat            */
   quat  &operator += (const quat &v);      /* incrementation by a quat        */
   quat  &operator -= (const quat &v);      /* decrementation by a quat        */
   quat  &operator *= (float d);      /* multiplication by a constant    */
@@ -79,8 +79,13 @@ public:
   float  length2() const;                  /* squared length of a quat        */
   quat  &normalize();                      /* normalize a quat                */
   quat  &apply(V_FCT_PTR fct);             /* apply a func. to each component */
-  vec3   xform(const vec3 &v );            /* q*v*q-1                         */
-  mat4   to_mat4() const;
+  vec3   xform(const vec3 &v ) const;      /* q*v*q-1                         */
+  quat   conjugate() const;                /* the inverse of a unit quat      */
+  mat4   to_mat4() const;                  /* transposed: the inverse rotation
+                                              for mat4 * vec4                 */
+  affine to_affine(const vec4 &translation = vec4(0,0,0,0)) const;
+                                           /* Translate(t) * rotation, for
+                                              mat4 * vec4                     */
   void   set_angle(float f);               /* set rot angle (degrees)         */
   void   scale_angle(float f);             /* scale rot angle (degrees)       */
   float  get_angle() const;                /* set rot angle (degrees)         */
@@ -115,6 +120,12 @@ public:
 
 quat quat_identity();        /* Returns quaternion identity element */
 quat quat_slerp(const quat &from, const quat &to, float t);
+quat quat_axis_angle(const vec3 &axis, float degrees); /* unit axis          */
+
+/* out[i] = quat_slerp(from[i], to[i], t), normalized; out may be from or to */
+void quat_slerp(const quat *from, const quat *to, float t, quat *out, size_t n);
+
+static_assert(std::is_trivially_copyable< quat >::value, "quat must stay trivially copyable");
 
 
 }
@@ -0,0 +1,493 @@
+#include "replay.h"
+
+#include <string.h>
+
+#include <fstream>
+#include <type_traits>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// appends plain values to a byte buffer
+class ByteWriter
+{
+public:
+	ByteWriter(std::vector< char >& out) : out(out) {}
+
+	void bytes(const void* p, size_t n)
+	{
+		const char* c = (const char*)p;
+		out.insert(out.end(), c, c + n);
+	}
+
+	// numbers, vectors and matrices are all plain bytes (and vec4 and
+	// mat4 have no padding, so the file layout is just their floats)
+	template < class T >
+	void put(const T& v)
+	{
+		static_assert(std::is_trivially_copyable< T >::value, "only plain data is written as bytes");
+		bytes(&v, sizeof(v));
+	}
+
+	template < class T >
+	void put(const std::vector< T >& v)
+	{
+		static_assert(std::is_trivially_copyable< T >::value, "only plain data is written as bytes");
+		put((unsigned int)v.size());
+		if (!v.empty())
+			bytes(&v[0], v.size() * sizeof(T));
+	}
+
+private:
+	std::vector< char >& out;
+};
+
+// reads them back in the same order
+class ByteReader
+{
+public:
+	ByteReader(const std::vector< char >& in) : in(in), pos(0), ok(true) {}
+
+	void bytes(void* p, size_t n)
+	{
+		if (pos + n > in.size())
+		{
+			ok = false;
+			return;
+		}
+		if (n > 0)
+			memcpy(p, &in[pos], n);
+		pos += n;
+	}
+
+	template < class T >
+	void get(T& v) { bytes(&v, sizeof(v)); }
+
+	template < class T >
+	void get(std::vector< T >& v)
+	{
+		v.resize(size());
+		if (!v.empty())
+			bytes(&v[0], v.size() * sizeof(T));
+	}
+
+	bool good() const { return ok && pos == in.size(); }
+
+private:
+	// element count, guarded against reading garbage sizes
+	unsigned int size()
+	{
+		unsigned int n = 0;
+		get(n);
+		if (!ok || n > in.size())
+		{
+			ok = false;
+			return 0;
+		}
+		return n;
+	}
+
+	const std::vector< char >& in;
+	size_t pos;
+	bool ok;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// both directions list the fields in the same order,
+// add new World fields to both (effectsRandom is left out on purpose, only
+// drawing advances it and a replay may never draw)
+
+void saveWorld(const World& w, std::vector< char >& out)
+{
+	out.clear();
+	ByteWriter b(out);
+
+	b.put(w.asteroidRandom);
+	b.put(w.pickupRandom);
+
+	b.put(w.player);
+
+	b.put(w.speed);
+	b.put(w.max_speed);
+	b.put(w.current_dir);
+	b.put(w.current_pos);
+	b.put(w.heading);
+	b.put(w.bank);
+	b.put(w.camera);
+
+	b.put(w.bullet_fired);
+	b.put(w.bullet_positions);
+	b.put(w.bullet_directions);
+
+	b.put(w.spheres);
+	b.put(w.sphere_vels);
+	b.put(w.sphere_size);
+	b.put(w.num_spheres);
+	b.put(w.killed_since_death);
+
+	b.put(w.particle_dens);
+
+	b.put(w.missileA_dir);
+	b.put(w.missileA_pos);
+	b.put(w.collisionA_pos);
+	b.put(w.collisionB_pos);
+	b.put(w.missileB_dir);
+	b.put(w.missileB_pos);
+	b.put(w.missileA_turn);
+	b.put(w.missileB_turn);
+	b.put(w.missileA_fired);
+	b.put(w.missileB_fired);
+	b.put(w.missileA_speed);
+	b.put(w.missileB_speed);
+	b.put(w.explosion_scale_factA);
+	b.put(w.explosion_scale_factB);
+
+	b.put(w.missile_pos);
+	b.put(w.ammo_box);
+}
+
+bool loadWorld(World& w, const std::vector< char >& in)
+{
+	ByteReader b(in);
+
+	b.get(w.asteroidRandom);
+	b.get(w.pickupRandom);
+
+	b.get(w.player);
+
+	b.get(w.speed);
+	b.get(w.max_speed);
+	b.get(w.current_dir);
+	b.get(w.current_pos);
+	b.get(w.heading);
+	b.get(w.bank);
+	b.get(w.camera);
+
+	b.get(w.bullet_fired);
+	b.get(w.bullet_positions);
+	b.get(w.bullet_directions);
+
+	b.get(w.spheres);
+	b.get(w.sphere_vels);
+	b.get(w.sphere_size);
+	b.get(w.num_spheres);
+	b.get(w.killed_since_death);
+
+	b.get(w.particle_dens);
+
+	b.get(w.missileA_dir);
+	b.get(w.missileA_pos);
+	b.get(w.collisionA_pos);
+	b.get(w.collisionB_pos);
+	b.get(w.missileB_dir);
+	b.get(w.missileB_pos);
+	b.get(w.missileA_turn);
+	b.get(w.missileB_turn);
+	b.get(w.missileA_fired);
+	b.get(w.missileB_fired);
+	b.get(w.missileA_speed);
+	b.get(w.missileB_speed);
+	b.get(w.explosion_scale_factA);
+	b.get(w.explosion_scale_factB);
+
+	b.get(w.missile_pos);
+	b.get(w.ammo_box);
+
+	return b.good();
+}
+
+unsigned long long hashWorld(const World& world)
+{
+	std::vector< char > state;
+	saveWorld(world, state);
+
+	unsigned long long h = 14695981039346656037ULL;
+	for (unsigned int i = 0; i < state.size(); i++)
+	{
+		h ^= (unsigned char)state[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+
+static const char recordingMagic[4] = { 'A', 'R', 'E', 'C' };
+static const unsigned int recordingVersion = 4;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void applyInput(World& world, const InputEvent& e)
+{
+	switch (e.kind)
+	{
+		case INPUT_KEY:
+			world.keyboard((unsigned char)e.key);
+			break;
+
+		case INPUT_SPECIAL:
+			world.specialKeyboard(e.key);
+			break;
+
+		case INPUT_COMMAND:
+			if (e.key == COMMAND_REFILL_BULLETS && world.player.bullets_remaining < 60)
+				world.player.bullets_remaining = 60;
+			else if (e.key == COMMAND_REARM_MISSILES)
+				world.rearmMissiles();
+			break;
+	}
+}
+
+Recording::Recording()
+	: seed(1), num_spheres(60), ticks(0), keyframeInterval(300)
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+bool Recording::save(const std::string& file) const
+{
+	std::vector< char > data;
+	ByteWriter b(data);
+
+	b.bytes(recordingMagic, sizeof(recordingMagic));
+	b.put(recordingVersion);
+	b.put(seed);
+	b.put(num_spheres);
+	b.put(ticks);
+	b.put(keyframeInterval);
+
+	b.put((unsigned int)events.size());
+	for (unsigned int i = 0; i < events.size(); i++)
+	{
+		b.put(events[i].tick);
+		b.put(events[i].kind);
+		b.put(events[i].key);
+	}
+
+	b.put((unsigned int)keyframes.size());
+	for (unsigned int i = 0; i < keyframes.size(); i++)
+	{
+		b.put(keyframes[i].tick);
+		b.put((unsigned int)keyframes[i].state.size());
+		if (!keyframes[i].state.empty())
+			b.bytes(&keyframes[i].state[0], keyframes[i].state.size());
+	}
+
+	std::ofstream out(file.c_str(), std::ios::binary);
+	out.write(&data[0], data.size());
+	return out.good();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+bool Recording::load(const std::string& file)
+{
+	std::ifstream in(file.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+	std::vector< char > data((std::istreambuf_iterator< char >(in)), std::istreambuf_iterator< char >());
+
+	ByteReader b(data);
+
+	char magic[4] = { 0 };
+	unsigned int version = 0;
+	b.bytes(magic, sizeof(magic));
+	b.get(version);
+	if (memcmp(magic, recordingMagic, sizeof(magic)) != 0 || version != recordingVersion)
+		return false;
+
+	b.get(seed);
+	b.get(num_spheres);
+	b.get(ticks);
+	b.get(keyframeInterval);
+
+	unsigned int n = 0;
+	b.get(n);
+	if (n > data.size())
+		return false;
+	events.resize(n);
+	for (unsigned int i = 0; i < n; i++)
+	{
+		b.get(events[i].tick);
+		b.get(events[i].kind);
+		b.get(events[i].key);
+	}
+
+	b.get(n);
+	if (n > data.size())
+		return false;
+	keyframes.resize(n);
+	for (unsigned int i = 0; i < n; i++)
+	{
+		unsigned int size = 0;
+		b.get(keyframes[i].tick);
+		b.get(size);
+		if (size > data.size())
+			return false;
+		keyframes[i].state.resize(size);
+		if (size > 0)
+			b.bytes(&keyframes[i].state[0], size);
+	}
+
+	return b.good();
+}
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+
+Recorder::Recorder()
+	: recording(false)
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Recorder::start(World& world, unsigned int seed, unsigned int keyframeInterval)
+{
+	int num_spheres = world.num_spheres;
+	world.reset(seed);
+	world.num_spheres = num_spheres;
+
+	rec = Recording();
+	rec.seed = seed;
+	rec.num_spheres = num_spheres;
+	rec.keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+	recording = true;
+
+	// always keep the start, so seeking never has to reset
+	Snapshot first;
+	first.tick = 0;
+	saveWorld(world, first.state);
+	rec.keyframes.push_back(first);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Recorder::input(World& world, int kind, int key)
+{
+	InputEvent e = { rec.ticks, kind, key };
+	if (recording)
+		rec.events.push_back(e);
+	applyInput(world, e);
+}
+
+void Recorder::keyboard(World& world, unsigned char key)
+{
+	input(world, INPUT_KEY, key);
+}
+
+void Recorder::specialKeyboard(World& world, int key)
+{
+	input(world, INPUT_SPECIAL, key);
+}
+
+void Recorder::command(World& world, InputCommand c)
+{
+	input(world, INPUT_COMMAND, c);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Recorder::tick(const World& world)
+{
+	if (!recording)
+		return;
+
+	rec.ticks++;
+	if (rec.ticks % rec.keyframeInterval == 0)
+	{
+		Snapshot s;
+		s.tick = rec.ticks;
+		saveWorld(world, s.state);
+		rec.keyframes.push_back(s);
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+const Recording& Recorder::stop()
+{
+	recording = false;
+	return rec;
+}
+
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+
+Replayer::Replayer(const Recording& recording)
+	: rec(recording), current(0), nextEvent(0)
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Replayer::start(World& world)
+{
+	world.reset(rec.seed);
+	world.num_spheres = rec.num_spheres;
+	current = 0;
+	nextEvent = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Replayer::applyInput(World& world)
+{
+	while (nextEvent < rec.events.size() && rec.events[nextEvent].tick <= current)
+	{
+		djv::applyInput(world, rec.events[nextEvent++]);
+	}
+}
+
+void Replayer::tick(World& world)
+{
+	applyInput(world);
+	world.tick();
+	advance();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Replayer::seek(World& world, unsigned int tick)
+{
+	// the latest keyframe at or before the tick
+	const Snapshot* key = NULL;
+	for (unsigned int i = 0; i < rec.keyframes.size() && rec.keyframes[i].tick <= tick; i++)
+		key = &rec.keyframes[i];
+
+	if (key && (tick < current || key->tick > current) && loadWorld(world, key->state))
+	{
+		current = key->tick;
+	}
+	else if (tick < current)
+	{
+		start(world);
+	}
+
+	// skip the events before the new position
+	nextEvent = 0;
+	while (nextEvent < rec.events.size() && rec.events[nextEvent].tick < current)
+		nextEvent++;
+
+	while (current < tick)
+		this->tick(world);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+bool Replayer::verify(const World& world) const
+{
+	for (unsigned int i = 0; i < rec.keyframes.size(); i++)
+	{
+		if (rec.keyframes[i].tick == current)
+		{
+			std::vector< char > state;
+			saveWorld(world, state);
+			return state == rec.keyframes[i].state;
+		}
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,153 @@
+#ifndef DJV_REPLAY_H_
+#define DJV_REPLAY_H_
+/*
+	Input recording and replay
+
+	A recording is the seed a game started from plus every key event,
+	stamped with the tick (frame) it arrived before. Since the world only
+	depends on its seed and its input, feeding the same events back plays
+	out the same game, bit for bit. Every few ticks a compact snapshot of
+	the world is kept as a keyframe, to seek without replaying from the
+	start and to check a replay still matches the original.
+*/
+
+#include <vector>
+#include <string>
+
+#include "world.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// what an input event feeds the world
+enum InputKind
+{
+	INPUT_KEY,     // keyboard()
+	INPUT_SPECIAL, // specialKeyboard()
+	INPUT_COMMAND  // one of the InputCommands below
+};
+
+// actions that are not keys (the benchmark scenarios use these)
+enum InputCommand
+{
+	COMMAND_REFILL_BULLETS, // top up to at least 60 bullets
+	COMMAND_REARM_MISSILES  // same as picking up the missile supply
+};
+
+// one input event, applied before tick 'tick' runs
+struct InputEvent
+{
+	unsigned int tick;
+	int kind; // InputKind
+	int key;  // key or InputCommand
+};
+
+// feed one event to the world
+void applyInput(World& world, const InputEvent& e);
+
+// the complete world state at the start of tick 'tick'
+struct Snapshot
+{
+	unsigned int tick;
+	std::vector< char > state;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// serialize everything that decides how a game plays out
+void saveWorld(const World& world, std::vector< char >& out);
+bool loadWorld(World& world, const std::vector< char >& in);
+
+// FNV-1a hash of the serialized world, for quick comparisons
+unsigned long long hashWorld(const World& world);
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class Recording
+{
+public:
+	Recording();
+
+	unsigned int seed;
+	int num_spheres;        // asteroids kept in play
+	unsigned int ticks;     // length of the recording
+	unsigned int keyframeInterval;
+
+	std::vector< InputEvent > events;  // in tick order
+	std::vector< Snapshot > keyframes; // in tick order
+
+	bool save(const std::string& file) const;
+	bool load(const std::string& file);
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// captures a game as it is played
+//
+//   recorder.start(world, seed);   (resets the world)
+//   recorder.keyboard(key);        (from the input callbacks)
+//   world.tick(); recorder.tick(world);
+class Recorder
+{
+public:
+	Recorder();
+
+	void start(World& world, unsigned int seed, unsigned int keyframeInterval = 300);
+	bool isRecording() const { return recording; }
+
+	// apply a key to the world and record it
+	void keyboard(World& world, unsigned char key);
+	void specialKeyboard(World& world, int key);
+	void command(World& world, InputCommand c);
+
+	// call after every world.tick()
+	void tick(const World& world);
+
+	// stop and return what was recorded
+	const Recording& stop();
+
+private:
+	void input(World& world, int kind, int key);
+
+	bool recording;
+	Recording rec;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// plays a recording back into a world
+class Replayer
+{
+public:
+	Replayer(const Recording& recording);
+
+	// reset the world to the start of the recording
+	void start(World& world);
+
+	// feed the events due before the next tick, then run it
+	// (callers that time phases separately can use applyInput and
+	//  then run the phases themselves, followed by advance())
+	void tick(World& world);
+	void applyInput(World& world);
+	void advance() { current++; }
+
+	// jump to any tick, restoring the nearest keyframe before it
+	void seek(World& world, unsigned int tick);
+
+	// compare the world with the keyframe for the current tick (if any)
+	// returns false on a mismatch
+	bool verify(const World& world) const;
+
+	unsigned int currentTick() const { return current; }
+	bool finished() const { return current >= rec.ticks; }
+
+private:
+	const Recording& rec;
+	unsigned int current;
+	unsigned int nextEvent;
+};
+
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "rng.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// splitmix64, spreads similar seeds (1, 2, 3 ...) over the whole state
+static unsigned long long splitmix64(unsigned long long& x)
+{
+	unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Rng::seed(unsigned long long seed, unsigned int stream)
+{
+	unsigned long long key = stream;
+	unsigned long long x = seed ^ splitmix64(key);
+
+	unsigned long long a = splitmix64(x);
+	unsigned long long b = splitmix64(x);
+	s[0] = (unsigned int)a;
+	s[1] = (unsigned int)(a >> 32);
+	s[2] = (unsigned int)b;
+	s[3] = (unsigned int)(b >> 32);
+
+	// the all zero state never leaves zero
+	if ((s[0] | s[1] | s[2] | s[3]) == 0)
+		s[0] = 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// eight xoshiro128+ generators side by side, one array per state word
+struct Lanes
+{
+	static const int count = 8;
+	unsigned int a[count], b[count], c[count], d[count];
+};
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+// n / 8 numbers from every lane, four lanes per SSE2 register
+static void run(Lanes& s, float* out, size_t n, float min, float scale)
+{
+	__m128i a[2], b[2], c[2], d[2];
+	for (int h = 0; h < 2; h++)
+	{
+		a[h] = _mm_loadu_si128((const __m128i*)(s.a + 4 * h));
+		b[h] = _mm_loadu_si128((const __m128i*)(s.b + 4 * h));
+		c[h] = _mm_loadu_si128((const __m128i*)(s.c + 4 * h));
+		d[h] = _mm_loadu_si128((const __m128i*)(s.d + 4 * h));
+	}
+	const __m128 vmin = _mm_set1_ps(min);
+	const __m128 vscale = _mm_set1_ps(scale);
+
+	for (size_t i = 0; i + Lanes::count <= n; i += Lanes::count)
+	{
+		for (int h = 0; h < 2; h++)
+		{
+			__m128i r = _mm_add_epi32(a[h], d[h]);
+			__m128i t = _mm_slli_epi32(b[h], 9);
+			c[h] = _mm_xor_si128(c[h], a[h]);
+			d[h] = _mm_xor_si128(d[h], b[h]);
+			b[h] = _mm_xor_si128(b[h], c[h]);
+			a[h] = _mm_xor_si128(a[h], d[h]);
+			c[h] = _mm_xor_si128(c[h], t);
+			d[h] = _mm_or_si128(_mm_slli_epi32(d[h], 11), _mm_srli_epi32(d[h], 21));
+			__m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(r, 8));
+			_mm_storeu_ps(out + i + 4 * h, _mm_add_ps(vmin, _mm_mul_ps(f, vscale)));
+		}
+	}
+
+	for (int h = 0; h < 2; h++)
+	{
+		_mm_storeu_si128((__m128i*)(s.a + 4 * h), a[h]);
+		_mm_storeu_si128((__m128i*)(s.b + 4 * h), b[h]);
+		_mm_storeu_si128((__m128i*)(s.c + 4 * h), c[h]);
+		_mm_storeu_si128((__m128i*)(s.d + 4 * h), d[h]);
+	}
+}
+
+#else
+
+// the same numbers without SSE2
+static void run(Lanes& s, float* out, size_t n, float min, float scale)
+{
+	for (size_t i = 0; i + Lanes::count <= n; i += Lanes::count)
+	{
+		for (int l = 0; l < Lanes::count; l++)
+		{
+			unsigned int r = s.a[l] + s.d[l];
+			unsigned int t = s.b[l] << 9;
+			s.c[l] ^= s.a[l];
+			s.d[l] ^= s.b[l];
+			s.b[l] ^= s.c[l];
+			s.a[l] ^= s.d[l];
+			s.c[l] ^= t;
+			s.d[l] = (s.d[l] << 11) | (s.d[l] >> 21);
+			out[i + l] = min + (float)(int)(r >> 8) * scale;
+		}
+	}
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Rng::fill(float* out, size_t n, float min, float max)
+{
+	const float scale = (max - min) * (1.0f / 16777216.0f);
+
+	size_t i = 0;
+
+	// seeding the lanes costs a few dozen numbers, only worth it for larger fills
+	if (n >= 4 * Lanes::count)
+	{
+		Lanes lanes;
+		for (int l = 0; l < Lanes::count; l++)
+		{
+			unsigned long long x = ((unsigned long long)next() << 32) | next();
+			unsigned long long p = splitmix64(x);
+			unsigned long long q = splitmix64(x);
+			lanes.a[l] = (unsigned int)p;
+			lanes.b[l] = (unsigned int)(p >> 32);
+			lanes.c[l] = (unsigned int)q;
+			lanes.d[l] = (unsigned int)(q >> 32) | 1;
+		}
+
+		// the low bits of xoshiro128+ are weak, only the top 24 are used
+		run(lanes, out, n, min, scale);
+		i = n - n % Lanes::count;
+	}
+
+	for (; i < n; i++)
+		out[i] = min + (float)(next() >> 8) * scale;
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef DJV_RNG_H_
+#define DJV_RNG_H_
+/*
+	Seedable random number streams
+
+	xoshiro128** (Blackman & Vigna): 128 bits of state, a few shifts and
+	xors per number, and no shared state, so every subsystem (and every
+	worker thread) can own a generator and get the same numbers from the
+	same seed regardless of what anything else draws. Use a different
+	stream number for each, streams seeded from the same seed are
+	independent.
+
+	fill() produces many uniform floats at once for batched work; it runs
+	eight xoshiro128+ lanes side by side, two SSE2 registers of four
+	written out with intrinsics, and a plain loop over the lanes where
+	there is no SSE2. Both give the same numbers.
+*/
+
+#include <stddef.h>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// stream numbers of the subsystems, worker threads use RNG_WORKERS + index
+enum RngStream
+{
+	RNG_ASTEROIDS, // asteroid spawns
+	RNG_PICKUPS,   // ammo box and missile supply placement
+	RNG_EFFECTS,   // cosmetic only (particle colours), never changes the game
+	RNG_MESHES,    // randRange() (star field, particle meshes)
+	RNG_WORKERS
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class Rng
+{
+public:
+	Rng(unsigned long long seed = 1, unsigned int stream = 0) { this->seed(seed, stream); }
+
+	void seed(unsigned long long seed, unsigned int stream = 0);
+
+	// 32 random bits
+	unsigned int next()
+	{
+		unsigned int result = rotl(s[1] * 5, 7) * 9;
+		unsigned int t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 11);
+		return result;
+	}
+
+	// uniform float in [0, 1)
+	float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); }
+
+	// uniform float in [min, max)
+	float range(float min, float max) { return min + (max - min) * uniform(); }
+
+	// uniform integer in 0 .. n-1
+	int below(int n) { return (int)(((unsigned long long)next() * (unsigned int)n) >> 32); }
+
+	// n uniform floats in [min, max)
+	void fill(float* out, size_t n, float min = 0, float max = 1);
+
+	// the whole state, plain data so it can be copied and saved as is
+	unsigned int s[4];
+
+private:
+	static unsigned int rotl(unsigned int x, int k) { return (x << k) | (x >> (32 - k)); }
+};
+
+}
+
+#endif
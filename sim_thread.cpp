@@ -0,0 +1,200 @@
+#include "sim_thread.h"
+
+#include <algorithm>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+WorldPose poseOf(const World& world)
+{
+	WorldPose pose;
+	pose.current_pos = world.current_pos;
+	pose.missileA_pos = world.missileA_pos;
+	pose.missileB_pos = world.missileB_pos;
+	pose.heading = world.heading;
+	pose.bank = world.bank;
+	pose.camera = world.camera;
+	return pose;
+}
+
+// further than this in one tick is a jump (a respawn, a rearmed missile)
+// rather than motion, and is shown where it landed
+static const float maxStep = 10;
+
+static vec4 blend(const vec4& from, const vec4& to, float alpha)
+{
+	vec4 step = to - from;
+	if (step.x * step.x + step.z * step.z > maxStep * maxStep)
+		return to;
+	return from + step * alpha;
+}
+
+void interpolateSnapshot(const WorldSnapshot& snapshot, float alpha, World& out)
+{
+	const World& world = snapshot.world;
+	const WorldPose& before = snapshot.before;
+	out = world;
+
+	out.current_pos = blend(before.current_pos, world.current_pos, alpha);
+	out.missileA_pos = blend(before.missileA_pos, world.missileA_pos, alpha);
+	out.missileB_pos = blend(before.missileB_pos, world.missileB_pos, alpha);
+
+	quat from[3] = { before.heading, before.bank, before.camera };
+	quat to[3] = { world.heading, world.bank, world.camera };
+	quat_slerp(from, to, alpha, from, 3);
+	out.heading = from[0];
+	out.bank = from[1];
+	out.camera = from[2];
+
+	// everything else moved by its velocity during the tick
+	float back = alpha - 1;
+	advance(out.bullet_positions.data(), out.bullet_directions.data(), World::bullet_speed * back, out.bullet_positions.size());
+	advance(out.spheres.data(), out.sphere_vels.data(), back, out.spheres.size());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static float milliseconds(SimThread::Clock::duration d)
+{
+	return std::chrono::duration< float, std::milli >(d).count();
+}
+
+SimThread::SimThread(World& world, const StepFunction& step, const InputFunction& input, double ticksPerSecond)
+	: world(world)
+	, step(step)
+	, input(input)
+	, period(std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(1.0 / ticksPerSecond)))
+	, ticks(0)
+	, running(false)
+	, numQueued(0)
+{
+}
+
+SimThread::~SimThread()
+{
+	stop();
+}
+
+void SimThread::start()
+{
+	if (isRunning())
+		return;
+
+	stats = SimTimings();
+
+	// copying a world only grows the copy's vectors to the sizes copied, so
+	// every slot gets the world's room up front instead of growing later
+	int asteroids = std::max(world.num_spheres, (int)world.spheres.capacity());
+	for (int i = 0; i < 3; i++)
+		mailbox.slot(i).world.reserve(asteroids);
+	publish(poseOf(world), 0, 0);
+	running.store(true, std::memory_order_release);
+	thread = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop()
+{
+	running.store(false, std::memory_order_release);
+	if (thread.joinable())
+		thread.join();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void SimThread::keyboard(unsigned char key)
+{
+	queueInput(INPUT_KEY, key);
+}
+
+void SimThread::specialKeyboard(int key)
+{
+	queueInput(INPUT_SPECIAL, key);
+}
+
+void SimThread::queueInput(int kind, int key)
+{
+	std::lock_guard< std::mutex > hold(inputLock);
+	if (numQueued == maxQueued)
+		return;
+
+	InputEvent& e = queued[numQueued++];
+	e.tick = 0;
+	e.kind = kind;
+	e.key = key;
+}
+
+void SimThread::applyQueuedInput()
+{
+	InputEvent events[maxQueued];
+	int count;
+	{
+		std::lock_guard< std::mutex > hold(inputLock);
+		count = numQueued;
+		std::copy(queued, queued + count, events);
+		numQueued = 0;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (input)
+			input(world, events[i]);
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void SimThread::publish(const WorldPose& before, float tickMs, float lateMs)
+{
+	WorldSnapshot& snapshot = mailbox.writeSlot();
+	snapshot.world = world;
+	snapshot.before = before;
+	snapshot.tick = ticks;
+	snapshot.published = Clock::now();
+	snapshot.tickMs = tickMs;
+	snapshot.lateMs = lateMs;
+	mailbox.publish();
+}
+
+float SimThread::alpha(Clock::time_point now) const
+{
+	float a = milliseconds(now - snapshot().published) / milliseconds(period);
+	return std::min(1.0f, std::max(0.0f, a));
+}
+
+void SimThread::run()
+{
+	Clock::time_point next = Clock::now();
+	while (running.load(std::memory_order_acquire))
+	{
+		Clock::time_point start = Clock::now();
+		float lateMs = std::max(0.0f, milliseconds(start - next));
+
+		applyQueuedInput();
+		WorldPose before = poseOf(world);
+		step(world);
+		ticks++;
+
+		Clock::time_point end = Clock::now();
+		float tickMs = milliseconds(end - start);
+		publish(before, tickMs, lateMs);
+
+		stats.ticks++;
+		stats.tickSum += tickMs;
+		stats.tickMax = std::max(stats.tickMax, (double)tickMs);
+		stats.lateSum += lateMs;
+		stats.lateMax = std::max(stats.lateMax, (double)lateMs);
+
+		// more than a few ticks behind, let the schedule go instead of
+		// running ticks back to back to catch up
+		next += period;
+		if (end - next > 4 * period)
+		{
+			stats.skipped += (unsigned int)((end - next) / period);
+			next = end;
+		}
+		std::this_thread::sleep_until(next);
+	}
+}
+
+}
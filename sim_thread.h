@@ -0,0 +1,151 @@
+#ifndef DJV_SIM_THREAD_H_
+#define DJV_SIM_THREAD_H_
+/*
+	Simulation thread
+
+	Runs a world's ticks on a thread of its own at a fixed rate, so a slow
+	tick no longer holds up the frame being drawn and a slow frame no
+	longer slows the game down. After every tick the world is copied into
+	a snapshot and handed to the render thread through a triple buffer
+	(triple_buffer.h). The renderer draws the newest snapshot it has,
+	interpolated from the tick before it by how far the clock has got
+	towards the next one, so motion stays smooth at any frame rate.
+	Input from the render thread is queued and applied before the next
+	tick starts.
+
+		SimThread sim(world, step, input);
+		sim.start();
+		...                                 (each frame)
+		sim.acquire();
+		interpolateSnapshot(sim.snapshot(), sim.alpha(Clock::now()), view);
+		view.buildDraws(draws, projView, projection);
+
+	The world belongs to the thread between start() and stop().
+*/
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "world.h"
+#include "replay.h"
+#include "triple_buffer.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the parts of the world that are interpolated between two ticks
+struct WorldPose
+{
+	vec4 current_pos;
+	vec4 missileA_pos;
+	vec4 missileB_pos;
+	quat heading;
+	quat bank;
+	quat camera;
+};
+
+WorldPose poseOf(const World& world);
+
+// one finished tick, as the render thread gets it
+struct WorldSnapshot
+{
+	WorldSnapshot() : tick(0), tickMs(0), lateMs(0) {}
+
+	World world;       // the state after the tick
+	WorldPose before;  // the pose before it
+	unsigned int tick; // ticks run so far
+	std::chrono::steady_clock::time_point published;
+
+	float tickMs; // how long the tick took
+	float lateMs; // how long after its scheduled time it started
+};
+
+// the snapshot's world 'alpha' (0 to 1) of the way from the tick before:
+// the pose is blended from 'before', bullets and asteroids are stepped
+// back along their velocities
+void interpolateSnapshot(const WorldSnapshot& snapshot, float alpha, World& out);
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// tick times and lateness over a run, in milliseconds
+struct SimTimings
+{
+	SimTimings() : ticks(0), tickSum(0), tickMax(0), lateSum(0), lateMax(0), skipped(0) {}
+
+	unsigned int ticks;
+	double tickSum, tickMax;
+	double lateSum, lateMax;
+	unsigned int skipped; // ticks dropped after falling too far behind
+};
+
+class SimThread
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// runs one tick (input already applied)
+	typedef std::function< void(World& world) > StepFunction;
+	// applies one queued key (the tick field is unused)
+	typedef std::function< void(World& world, const InputEvent& e) > InputFunction;
+
+	SimThread(World& world, const StepFunction& step, const InputFunction& input, double ticksPerSecond = 60);
+	~SimThread();
+
+	// publishes the world as it is, then starts ticking it; the snapshots
+	// are reserved as World::reserve() does, so should the render thread's
+	// copy it interpolates into be
+	void start();
+	// finishes the tick in progress and joins the thread
+	void stop();
+	bool isRunning() const { return thread.joinable(); }
+
+	// queue input for the next tick, from any thread; keys beyond
+	// maxQueued per tick are dropped
+	void keyboard(unsigned char key);
+	void specialKeyboard(int key);
+
+	// render thread: moves on to the newest snapshot, false if there is
+	// no new one
+	bool acquire() { return mailbox.acquire(); }
+	const WorldSnapshot& snapshot() const { return mailbox.readSlot(); }
+
+	// how far 'now' is from the current snapshot's tick to the next (0 to 1)
+	float alpha(Clock::time_point now) const;
+
+	// the timings since start(), complete once stop() returned
+	const SimTimings& timings() const { return stats; }
+
+private:
+	SimThread(const SimThread&);
+	SimThread& operator=(const SimThread&);
+
+	void run();
+	void queueInput(int kind, int key);
+	void applyQueuedInput();
+	void publish(const WorldPose& before, float tickMs, float lateMs);
+
+	World& world;
+	StepFunction step;
+	InputFunction input;
+	Clock::duration period;
+	unsigned int ticks;
+
+	std::thread thread;
+	std::atomic< bool > running;
+
+	static const int maxQueued = 64;
+	std::mutex inputLock;
+	InputEvent queued[maxQueued];
+	int numQueued;
+
+	TripleBuffer< WorldSnapshot > mailbox;
+	SimTimings stats;
+};
+
+}
+
+#endif
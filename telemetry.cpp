@@ -0,0 +1,166 @@
+#include "telemetry.h"
+
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define DJV_TELEMETRY_SHM 1
+#endif
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+const char* defaultTelemetryName = "/asteroids-telemetry";
+
+static const char telemetryMagic[4] = { 'A', 'T', 'E', 'L' };
+static const unsigned int telemetryVersion = 1;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+Telemetry::Telemetry()
+	: count(0), segment(0)
+{
+	segmentName[0] = 0;
+}
+
+Telemetry::~Telemetry()
+{
+	close();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+bool Telemetry::open(const char* name)
+{
+	close();
+
+#ifdef DJV_TELEMETRY_SHM
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+		return false;
+
+	void* p = MAP_FAILED;
+	if (ftruncate(fd, sizeof(TelemetrySegment)) == 0)
+		p = mmap(0, sizeof(TelemetrySegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+	{
+		shm_unlink(name);
+		return false;
+	}
+
+	segment = (TelemetrySegment*)p;
+	strncpy(segmentName, name, sizeof(segmentName) - 1);
+	segmentName[sizeof(segmentName) - 1] = 0;
+
+	// a left over segment may have any sequence, make it even (idle)
+	unsigned int s = segment->sequence.load(std::memory_order_relaxed);
+	segment->sequence.store((s + 1) & ~1u, std::memory_order_relaxed);
+	memcpy(segment->magic, telemetryMagic, sizeof(telemetryMagic));
+	segment->version = telemetryVersion;
+	segment->frame = 0;
+	publish();
+	return true;
+#else
+	(void)name;
+	return false;
+#endif
+}
+
+void Telemetry::close()
+{
+#ifdef DJV_TELEMETRY_SHM
+	if (segment)
+	{
+		munmap(segment, sizeof(TelemetrySegment));
+		shm_unlink(segmentName);
+	}
+#endif
+	segment = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+int Telemetry::add(const char* name, TelemetryKind kind)
+{
+	for (int i = 0; i < count; i++)
+		if (strncmp(entries[i].name, name, sizeof(entries[i].name)) == 0)
+			return i;
+
+	if (count == TelemetrySegment::maxEntries)
+		return -1;
+
+	TelemetryEntry& e = entries[count];
+	memset(&e, 0, sizeof(e));
+	strncpy(e.name, name, sizeof(e.name) - 1);
+	e.kind = kind;
+	values[count] = 0;
+	return count++;
+}
+
+int Telemetry::counter(const char* name)
+{
+	return add(name, TELEMETRY_COUNTER);
+}
+
+int Telemetry::gauge(const char* name)
+{
+	return add(name, TELEMETRY_GAUGE);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void Telemetry::publish()
+{
+	if (!segment)
+		return;
+
+	// odd: readers will throw away whatever they copy meanwhile
+	unsigned int s = segment->sequence.load(std::memory_order_relaxed);
+	segment->sequence.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (int i = 0; i < count; i++)
+	{
+		entries[i].value = values[i];
+		segment->entries[i] = entries[i];
+	}
+	segment->count = count;
+	segment->frame++;
+
+	// even again, and everything above is visible before it
+	segment->sequence.store(s + 2, std::memory_order_release);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+bool readTelemetry(const TelemetrySegment& segment, TelemetrySegment& copy)
+{
+	for (int tries = 0; tries < 1000; tries++)
+	{
+		unsigned int before = segment.sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+
+		memcpy(copy.magic, segment.magic, sizeof(copy.magic));
+		copy.version = segment.version;
+		copy.count = segment.count;
+		copy.frame = segment.frame;
+		if (copy.count > (unsigned int)TelemetrySegment::maxEntries)
+			copy.count = TelemetrySegment::maxEntries;
+		memcpy(copy.entries, segment.entries, copy.count * sizeof(TelemetryEntry));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (segment.sequence.load(std::memory_order_relaxed) == before)
+		{
+			copy.sequence.store(before, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+}
@@ -0,0 +1,101 @@
+#ifndef DJV_TELEMETRY_H_
+#define DJV_TELEMETRY_H_
+/*
+	Shared memory telemetry
+
+	A registry of named counters (totals that only grow) and gauges
+	(current values). The game updates them as it runs and publishes
+	them once per frame into a POSIX shared memory segment, where a
+	monitor such as telemetry_tail can read them at any time without
+	stopping or slowing the game.
+
+	The segment is guarded by a sequence lock: the writer makes the
+	sequence odd while it copies and even when it is done, a reader
+	copies the entries and keeps them only if the sequence was the same
+	even number before and after. The writer never waits for readers.
+
+	On platforms without POSIX shared memory open() fails and publish()
+	does nothing, the counters still work locally.
+*/
+
+#include <atomic>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+enum TelemetryKind
+{
+	TELEMETRY_COUNTER,
+	TELEMETRY_GAUGE
+};
+
+struct TelemetryEntry
+{
+	char name[32];
+	int kind;     // TelemetryKind
+	int reserved;
+	long long value;
+};
+
+// the layout of the shared segment, the same for writer and readers
+struct TelemetrySegment
+{
+	static const int maxEntries = 64;
+
+	char magic[4];  // "ATEL"
+	unsigned int version;
+	std::atomic< unsigned int > sequence; // odd while an update is being written
+	unsigned int count;
+	unsigned long long frame;  // publish() calls so far
+	TelemetryEntry entries[maxEntries];
+};
+
+// the segment the game publishes to unless told otherwise
+extern const char* defaultTelemetryName;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class Telemetry
+{
+public:
+	Telemetry();
+	~Telemetry(); // removes the segment
+
+	// create (or take over) the shared segment, false if that is not possible
+	bool open(const char* name = defaultTelemetryName);
+	void close();
+	bool isOpen() const { return segment != 0; }
+
+	// register a name and get its id, registering a name again returns the
+	// same id; -1 once all the entries are used
+	int counter(const char* name);
+	int gauge(const char* name);
+
+	void add(int id, long long amount = 1) { if (id >= 0) values[id] += amount; }
+	void set(int id, long long value) { if (id >= 0) values[id] = value; }
+	long long get(int id) const { return id >= 0 ? values[id] : 0; }
+
+	// copy every value into the shared segment, once per frame
+	void publish();
+
+private:
+	int add(const char* name, TelemetryKind kind);
+
+	TelemetryEntry entries[TelemetrySegment::maxEntries];
+	long long values[TelemetrySegment::maxEntries];
+	int count;
+
+	TelemetrySegment* segment;
+	char segmentName[64];
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// take a consistent copy of a segment someone else is writing,
+// false if the writer kept it busy for every try
+bool readTelemetry(const TelemetrySegment& segment, TelemetrySegment& copy);
+
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+	Telemetry monitor
+
+	Follows the counters and gauges a running game (or bench) publishes,
+	redrawing a table every interval: gauges with their current value,
+	counters with their total and rate per second.
+
+	telemetry_tail [--name /asteroids-telemetry] [--interval MS] [--once]
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "telemetry.h"
+
+using namespace djv;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static const TelemetrySegment* attach(const std::string& name)
+{
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+
+	void* p = mmap(0, sizeof(TelemetrySegment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return p == MAP_FAILED ? NULL : (const TelemetrySegment*)p;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: telemetry_tail [options]\n"
+		"  --name NAME     shared memory segment (default: %s)\n"
+		"  --interval MS   time between updates (default: 1000)\n"
+		"  --once          print one update and exit\n", defaultTelemetryName);
+}
+
+int main(int argc, char** argv)
+{
+	std::string name = defaultTelemetryName;
+	int interval = 1000;
+	bool once = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--name" && i + 1 < argc) name = argv[++i];
+		else if (arg == "--interval" && i + 1 < argc) interval = std::max(10, atoi(argv[++i]));
+		else if (arg == "--once") once = true;
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	const TelemetrySegment* segment = attach(name);
+	if (!segment)
+	{
+		fprintf(stderr, "no telemetry at '%s' (is the game running?)\n", name.c_str());
+		return 1;
+	}
+
+	static TelemetrySegment current, previous;
+	bool havePrevious = false;
+	bool redraw = !once && isatty(STDOUT_FILENO);
+	std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		if (!readTelemetry(*segment, current))
+		{
+			fprintf(stderr, "telemetry busy, skipped an update\n");
+		}
+		else if (memcmp(current.magic, "ATEL", 4) != 0)
+		{
+			fprintf(stderr, "'%s' is not a telemetry segment\n", name.c_str());
+			return 1;
+		}
+		else
+		{
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration< double >(now - last).count();
+			last = now;
+
+			if (redraw)
+				printf("\033[H\033[J");
+			printf("%s  frame %llu\n", name.c_str(), current.frame);
+
+			for (unsigned int i = 0; i < current.count; i++)
+			{
+				const TelemetryEntry& e = current.entries[i];
+				if (e.kind == TELEMETRY_GAUGE)
+				{
+					printf("  %-24s %16lld\n", e.name, e.value);
+					continue;
+				}
+
+				printf("  %-24s %16lld", e.name, e.value);
+				// entries keep their index, so the previous copy lines up
+				if (havePrevious && i < previous.count && seconds > 0)
+					printf("  %14.1f/s", (e.value - previous.entries[i].value) / seconds);
+				printf("\n");
+			}
+			fflush(stdout);
+
+			memcpy(previous.entries, current.entries, sizeof(current.entries));
+			previous.count = current.count;
+			havePrevious = true;
+		}
+
+		if (once)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+	}
+
+	return 0;
+}
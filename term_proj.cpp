@@ -1,7 +1,9 @@
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 #include <stdlib.h>
+#include <assert.h>
 
+#include <chrono>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -23,11 +25,20 @@
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-#include "Player.h"
+#include "world.h"
+#include "replay.h"
+#include "sim_thread.h"
+#include "perf_overlay.h"
+#include "telemetry.h"
+#include "arena.h"
+#include "gpu_asteroids.h"
+#include "gpu_scene.h"
+#include "background.h"
+#include "hud.h"
 
 // set-up some adjustable variables for
 // interactive demonstrations
-#include "Adjustable.h"
+#include "adjustable.h"
 
 djv::Adjustable adjustable;
 
@@ -65,14 +76,20 @@ GLint uniformId_modelView;
 #include "meshes.h"
 
 CubeMesh cube; 
-GridMesh grid(100, 100, 1.0f);
 CylinderMesh cylinder;
-Stars star;
+
+// the stars (and with --grid 1, the grid), drawn per pixel; with
+// --background-cache SCALE through a texture at that fraction of the
+// window's resolution, drawn again only as the camera moves (0 for none)
+Background background;
+float backgroundCacheScale = 0;
+
+// the lives and bullets left, one draw call from a buffer rebuilt only
+// when they change
+Hud hud;
 
 SphereMesh sphere;	
 Ship ship;
-shipParticles particles;
-Player playerA;
 
 
 class Camera {
@@ -238,11 +255,12 @@ void initGeometry( void )
 	// set in_position_loc for all meshes using static variable
 	Mesh::in_position_loc = in_position_loc;
 	
-	grid.init();
 	cube.init();
 	sphere.init(4);
 	cylinder.init();
-	star.init();
+	background.init();
+	background.useCache(backgroundCacheScale);
+	hud.init();
 	ship.init();
 	
 
@@ -282,566 +300,434 @@ void displayWireSphere(vec4 colour)
 	sphere.draw(true);
 }
 
-void displayStars(vec4 colour)
+void displayStars(const mat4& projView, vec4 colour)
 {
-	glUniform4fv(uniformId_colour, 1, colour);
-	glEnable(GL_POLYGON_OFFSET_FILL);
-	glPolygonOffset(5,5); 
-	star.draw(true);
-	
+	background.draw(projView, colour);
 }
 
 
 
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
-// The following are all the fields managed in the game
-
-// Ship Fields
-float speed = 0.0; // Current speed of the ship
-float max_speed = speed;   // Maximum speed of the ship
-vec4 current_dir(1,0,1,0); // Current direction of the ship
-vec4 current_pos(0,0,0,0); // Current position of the ship
-vec4 initial_dir(1,0,1,0); // Initial direction of the ship
-float angle_rot = 0; // Angle to rotate the ship
-float turn_rot = 0; // Rotate the direction vector for potential acceleration (up-key)
-
-// Bullet fields
-bool bullet_fired = false; // Boolean to check whether or not a bullet has been fired (space-key)
-vec4 dir_vec(1,0,1,0); // Initial direction vevtor
-std::vector< vec4 > bullet_positions; // Vector list of the positions of all bullets
-std::vector< vec4 > bullet_directions; // Vector list of all the directions of the bullets
-
-// Asteroids Fields
-std::vector< vec4 > spheres; // Asteroids positions
-std::vector< vec4 > sphere_dirs; // Asteroids directions
-std::vector< float > sphere_angs; // Angular rotation of asteroid direction
-std::vector< float > sphere_speed; // Asteroid speeds
-std::vector< float > sphere_size; // Asteroid sizes (larger if shot)
-int num_spheres = 60; // Number of spheres in the game at once
-float radius = 20; // Radius of the explosion of an asteroid (from a missile)
-float asteroid_speed = 0.01; // Asteroid speed
-float ast_max_speed = 0.1; // Maximum speed of an asteroid
-int killed_since_death = 0; // Number of orbs destroyed since either beginning or spawning (cannot die before killing one asteroid)
-
-// Vector lists for particle fields
-std::vector< mat4 > particle_dens;	// Matrix form translation of the particle fields
-std::vector< shipParticles > particle_fields; // The actual particle fields (object of class shipParticles )
-
-// missile fields
-vec4 missileA_dir; // Direction of missile A
-vec4 missileA_pos; // Position of missile A
-vec4 collisionA_pos = vec4(0,0,0,0); // Position of collision between missile A and an asteroid
-vec4 collisionB_pos = vec4(0,0,0,0); // Position of collision between missile B and an asteroid
-vec4 missileB_dir; // Direction of missile B
-vec4 missileB_pos; // Position of missile B
-int missileA_fired = 0; // Boolean variable to check whether missile A has been fired
-int missileB_fired = 0; // Boolean variable to check whether missile B has been fired
-float missileA_speed = 0; // Speed of missile A
-float missileB_speed = 0; // Speed of missile B
-float explosion_scale_factA = 0; // Scale factor to simulate the explosion (scale explosion by this value)
-float explosion_scale_factB = 0; // Scale factor to simulate the explosion (scale explosion by this value)
-
-// The ammo box and the missiles are placed (to give user more ammunition)
-vec4 missile_pos = vec4(randRange(-100,100),0,randRange(-100,100),1); // Random position of the missile supply 
-vec4 ammo_box(randRange(-50,50),0,randRange(-50,50),0); // Random position of the ammo box
-
-// END - FIELDS
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+// The game itself (all the fields and rules) lives in the world,
+// this file only renders it and forwards input
 
+World world;
 
+// Record the input of a game (--record FILE) or play one back (--replay FILE)
+Recorder recorder;
+Recording recording;
+Replayer replayer(recording);
+bool replaying = false;
+std::string recordFile;
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
-// Helper Functions
-
-// Returns the length of a vector
-float vec_length(vec4 vec)
+// One tick of the game, on the simulation thread
+void stepWorld(World& w)
 {
-	return sqrt(vec.x*vec.x + vec.z*vec.z);
-}
-
-// Detect a collision given two positions and a distance between the two
-bool detect_collision(vec4 pos_A, vec4 pos_B, float distance)
-{
-	float v_x = pos_A.x - pos_B.x;
-	float v_y = pos_A.y - pos_B.y;
-	float v_z = pos_A.z - pos_B.z;
-	if(sqrt(v_x*v_x + v_y*v_y + v_z*v_z) < distance)
-		return true;
+	HeapScope scope("tick");
+	if(replaying)
+	{
+		// hold the last frame once the recording ends
+		if(!replayer.finished())
+			replayer.tick(w);
+	}
 	else
-		return false;
-}
-
-// Coordinates the rotation of the ship so the ship "rebalances itself"
-float coordinateShipTurn(float turn_rot)
-{
-	turn_rot = fmodf(turn_rot,360);
-
-	if((turn_rot > 0 && turn_rot < 90) || (turn_rot > 180 && turn_rot < 270))
-		turn_rot -= 0.5;
-
-	else if((turn_rot > 270 && turn_rot < 360) || (turn_rot > 90 && turn_rot < 180))
-		turn_rot += 0.5;
-
-	else if((turn_rot < 0 && turn_rot > -90) || (turn_rot > -270 && turn_rot < -180))
-		turn_rot += 0.5;
-
-	else if((turn_rot < -360 && turn_rot > -270) || (turn_rot < -90 && turn_rot > -180))
-		turn_rot -= 0.5;
-
-	return turn_rot;
-}
-
-
-// END - Helper Functions
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
-
-
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
-// Display Functions - The following methods are responsible
-// for calculatting and displaying..
-// i. The bullets remaining (on the GUI)
-// ii. The lives remaining (also on the GUI)
-// iii. Coordinating the movement and displaying of the asteroids
-// iv. Displaying the particle trail behind the ship
-// v. Displaying the missiles
-// vi. Displaying the bullets
-
-// i. Display the amount of bullets remaining along the top of the screen
-void display_bullets_rem(float uniformId_modelView, mat4 Projection)
-{
-	// Display simple wire cubes along the top of the screen for each bullet
-	float offset = 0;
-	for(int i = 0; i < playerA.bullets_remaining ; i++)
 	{
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, Translate(-0.9 + offset,0.9, 0) * Scale(0.002,0.01,0.0) * Projection);
-		displayWireCube(vec4(1,0,0,1));
-
-		offset += 0.03;
+		w.tick();
+		HeapScope record("record");
+		recorder.tick(w);
 	}
 }
 
-// ii. Display the amount of lives remaining along the top of the screen
-void display_lives_rem(float uniformId_modelView, mat4 Projection)
+// A key from the GLUT callbacks, on the simulation thread before the next tick
+void applyKey(World& w, const InputEvent& e)
 {
-	float temp = 0;
-	for(int i = 0; i < playerA.lives_remaining ; i++)
-	{
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, Translate(-0.9 + temp,-0.9,0) * Scale(0.003,0.01,0.0) * Projection);
-		displayWireCube(vec4(1,0,0,1));
-
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, Translate(-0.9 + temp,-0.9,0) * RotateZ(90) * Scale(0.003,0.01,0.0) * Projection);
-		displayWireCube(vec4(1,0,0,1));
-
-		temp += 0.1;
-	}
-
+	HeapScope record("record");
+	if(e.kind == INPUT_KEY)
+		recorder.keyboard(w, (unsigned char)e.key);
+	else
+		recorder.specialKeyboard(w, e.key);
 }
 
-// iii. Display the asteroids in the game
-void display_asteroids(float uniformId_modelView, mat4 projView)
+// The world ticks at 60 Hz on its own thread; the frames draw the newest
+// tick it finished, interpolated into 'view', whatever their own rate
+SimThread simThread(world, stepWorld, applyKey, 60);
+World view;
+unsigned int ticksSeen = 0;
+
+// The draws for the current frame, with room for a busy one up front,
+// and the buffers the jobs record them into
+DrawList draws;
+DrawRecorder drawRecorder;
+const int maxDraws = 1024;
+
+// Frame timings for the performance overlay ('p')
+typedef std::chrono::steady_clock Clock;
+FrameHistory frameHistory;
+PerfOverlay perfOverlay;
+Clock::time_point lastFrameStart = Clock::now();
+
+static float milliseconds(Clock::time_point a, Clock::time_point b)
 {
-	// Randomly generate asteroids on different sides of the game
-	int rand_asteroid = 0;
-
-	// If the sphere size has decreased, draw more spheres
-	if(spheres.size() != num_spheres)
-	{
-		// Draw as many spheres as needed to maintain a constant "num_spheres" in play
-		for(int i = spheres.size(); i < num_spheres; i++)
-		{
-			rand_asteroid = rand() % 4;
+	return std::chrono::duration< float, std::milli >(b - a).count();
+}
 
-			if(rand_asteroid == 0)
-			{
-				sphere_size.push_back(1);
-				sphere_speed.push_back(randRange(0.05,0.15));
-				sphere_angs.push_back(randRange(-50,50));
-				sphere_dirs.push_back(vec4(-1,0,0,0));
-				spheres.push_back(vec4(100,-1,randRange(-130,130),0));
-			}
-			else if(rand_asteroid == 1)
-			{
-				sphere_size.push_back(1);
-				sphere_speed.push_back(randRange(0.05,0.15));
-				sphere_angs.push_back(randRange(-50,50));
-				sphere_dirs.push_back(vec4(1,0,0,0));
-				spheres.push_back(vec4(-100,-1,randRange(-130,130),0));
-			}
-			else if(rand_asteroid == 2)
-			{
-				sphere_size.push_back(1);
-				sphere_speed.push_back(randRange(0.05,0.15));
-				sphere_angs.push_back(randRange(-50,50));
-				sphere_dirs.push_back(vec4(0,0,-1,0));
-				spheres.push_back(vec4(randRange(-130,130),-1,100,0));
-			}
-			else if(rand_asteroid == 3)
-			{
-				sphere_size.push_back(1);
-				sphere_speed.push_back(randRange(0.05,0.15));
-				sphere_angs.push_back(randRange(-50,50));
-				sphere_dirs.push_back(vec4(0,0,1,0));
-				spheres.push_back(vec4(randRange(-130,130),-1,-100,0));
-			}
-			
-		}
-	}
-	
-	// For all of the spheres in the game..
-	for(int i = 0; i < spheres.size() ; i++)
-	{
-		// If there is a collision between the ship and a sphere..
-		if(detect_collision(current_pos, spheres[i], 2))
+// Counters published for external monitors (telemetry_tail)
+Telemetry telemetry;
+int telemetryFrames, telemetryFrameUs, telemetryAsteroids, telemetryBullets;
+int telemetryCollisionTests, telemetryDraws, telemetryBytesStreamed;
+int telemetryBuffers, telemetryBufferBytes;
+int telemetrySimTickUs, telemetrySimLateUs;
+
+// An extra field of asteroids simulated and drawn on the GPU
+// (--gpu-asteroids N, needs GL 4.3): the world's bullets and explosions
+// hit them, the ship flies through them. Where the context allows, the
+// GPU also culls them and draws them with one indirect draw (gpuScene),
+// the ones past --impostor-distance as ray cast impostors (0 for none)
+GpuAsteroids gpuAsteroids;
+GpuScene gpuScene;
+GLuint gpuSceneSphere;
+float impostorDistance = 50;
+GpuAsteroidReport gpuReport;
+Rng gpuAsteroidRandom(1, RNG_EFFECTS);
+int gpuAsteroidCount = 0;
+int telemetryGpuAsteroids, telemetryGpuHits;
+
+// new asteroids from the edges, as many as the field has room for
+void spawnGpuAsteroids(size_t n)
+{
+	const size_t batch = 256;
+	float u[4 * batch];
+	vec4 positions[batch], velocities[batch];
+	while(n > 0)
+	{
+		size_t k = std::min(n, batch);
+		gpuAsteroidRandom.fill(u, 4 * k);
+		for(size_t i = 0; i < k; i++)
 		{
-			// Decrement the lives remaining (if killed any orbs) and reposition the user
-			current_pos = vec4(0,0,0,0);
-			if(killed_since_death > 0)
-			{
-				killed_since_death = 0;
-				playerA.lives_remaining--;
-			}				
+			asteroidSpawn(u + 4 * i, positions[i], velocities[i]);
 		}
-			
-		// Reposition each orb according to its rotatation, speed and direction
-		spheres[i] = spheres[i] + RotateY(sphere_angs[i]) * sphere_speed[i] *sphere_dirs[i];
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, projView * Translate( spheres[i] ) * Scale(sphere_size[i], 0.5 * sphere_size[i], sphere_size[i]));
-		displayWireSphere(vec4(0.545f,0.275f,0.08f,1));
-
-		// If the sphere is growing (meaning it has been shot) continue to increment its size
-		if(sphere_size[i] > 1)
+		if(gpuAsteroids.spawn(positions, velocities, k) < k)
 		{
-			sphere_size[i] += 0.1;
-		}
-
-		// If a sphere leaves the grid, erase it and all of its fields
-		if( (spheres[i].x > 100) || (spheres[i].z > 100) || (spheres[i].x < -100) || (spheres[i].z < -100) || sphere_size[i] > 2)
-		{
-			sphere_size.erase(sphere_size.begin()+i);
-			sphere_speed.erase(sphere_speed.begin()+i);
-			spheres.erase(spheres.begin()+i);
-			sphere_angs.erase(sphere_angs.begin()+i);
-			sphere_dirs.erase(sphere_dirs.begin()+i);
+			break;
 		}
-		
+		n -= k;
 	}
-
 }
 
-
-// iv. Display the particle trail
-void display_particles(float uniformId_modelView, mat4 matProj)
+void initGpuAsteroids()
 {
-	// Draw the cylinder which seemingly "emits" the trail
-	glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * Translate(current_pos) * Translate(0,-2,0) * RotateZ(90) * RotateX(-45) * Scale(0.3,0.3,0.3) * RotateX(angle_rot));
-	displayWireCylinder(vec4(1,1,1, 0.7f));
-
-	// If their are less than 30 particle fields, continue to add them
-	if(particle_fields.size() < 30)
+	if(gpuAsteroidCount <= 0)
 	{
-		shipParticles temp;
-		temp.init();
-
-		particle_fields.push_back(temp);
-		particle_dens.push_back(Translate(current_pos + vec4(0,-2,0,0)) * RotateZ(90) * RotateX(-45) * RotateX(angle_rot));
+		return;
 	}
-	// If there is more than 30, add and erase a new field
-	else
+	if(!GpuAsteroids::supported())
 	{
-		shipParticles temp;
-		temp.init();
-		particle_fields.push_back(temp);
-		particle_fields.erase(particle_fields.begin());
-
-		particle_dens.push_back(Translate(current_pos + vec4(0,-2,0,0)) * RotateZ(90) * RotateX(-45) * RotateX(angle_rot));
-		particle_dens.erase(particle_dens.begin());
+		std::cerr << "--gpu-asteroids needs OpenGL 4.3, leaving them out" << std::endl;
+		gpuAsteroidCount = 0;
+		return;
 	}
 
-	// Draw all of the particle fields, either red or range (depending on random integer -> (0,1))
-	for(int i = 0; i < particle_fields.size() ; i++)
+	gpuAsteroids.init(gpuAsteroidCount);
+	gpuReport.hits.reserve(GpuAsteroids::maxHits);
+	gpuReport.despawns.reserve(gpuAsteroidCount);
+	spawnGpuAsteroids(gpuAsteroidCount);
+
+	if(GpuScene::supported())
 	{
-		int colour_rand = rand() % 2;
-		if(colour_rand == 0)
+		gpuSceneSphere = gpuScene.addMesh(sphere);
+		gpuScene.init(gpuAsteroidCount);
+		if(impostorDistance > 0)
 		{
-			glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * particle_dens[i]);
-			glUniform4fv(uniformId_colour, 1, vec4(1,0.5,0, 0.7f));
-			particle_fields[i].draw(true);
-		}
-		else
-		{
-			glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * particle_dens[i]);
-			glUniform4fv(uniformId_colour, 1, vec4(1,0.2,0, 0.7f));
-			particle_fields[i].draw(true);
+			gpuScene.setImpostors(gpuSceneSphere, impostorDistance);
 		}
 	}
 }
 
-
-// v. Display the missiles
-void display_missiles(float uniformId_modelView, mat4 matProj)
+// One GPU tick for each of the world's new ticks (a few at most), with
+// its bullets and explosions; the reports that came back refill the field
+void tickGpuAsteroids(const World& w, unsigned int newTicks)
 {
-	// If there is a collision for missile A
-	if(abs(collisionA_pos.x) > 0.1 && abs(collisionA_pos.z) > 0.1 && explosion_scale_factA > 0 && explosion_scale_factA < 10)
+	if(gpuAsteroids.capacity() == 0)
 	{
-		// Draw the explosion and increase its size for the next iteration
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * Translate(collisionA_pos) * Scale(explosion_scale_factA));
-		explosion_scale_factA += 0.5;
-		displayWireSphere(vec4(0.8,0.2,0, 0.7f));
-	}
-	// If there is a collison for missile B
-	if(abs(collisionB_pos.x) > 0.1 && abs(collisionB_pos.z) > 0.1 && explosion_scale_factB > 0 && explosion_scale_factB < 10)
-	{
-		// Draw the explosion and increase its size for the next iteration
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * Translate(collisionB_pos) * Scale(explosion_scale_factB));
-		explosion_scale_factB += 0.5;
-		displayWireSphere(vec4(0.8,0.2,0, 0.3f));
+		return;
 	}
 
-	// - - - - - - - - - - - - - - - - - - - - 
-	// Draw missile A
-	mat4 missileA_loc;
-	// If the missile has no speed, then it is simply a part of the ship
-	if(missileA_speed == 0)
+	vec4 explosions[2];
+	size_t numExplosions = 0;
+	if(abs(w.collisionA_pos.x) > 0.1 && abs(w.collisionA_pos.z) > 0.1)
 	{
-		missileA_loc = Translate(current_pos) * Translate(0,-2,0) * Scale(0.3,0.3,0.3) * RotateY(angle_rot-45) * RotateX(turn_rot) * RotateZ(90) ;
+		explosions[numExplosions++] = w.collisionA_pos;
 	}
-	// If it does have speed..
-	else
+	if(abs(w.collisionB_pos.x) > 0.1 && abs(w.collisionB_pos.z) > 0.1)
 	{
-		// Calculate its position, and check to see if it collides with any asteroids
-		missileA_pos = missileA_pos + missileA_speed*missileA_dir;
-		missileA_loc = Translate(missileA_pos) * Translate(0,-2,0) * Scale(0.3,0.3,0.3) * RotateY(angle_rot-45) * RotateX(turn_rot) * RotateZ(90) ;
-		for(int i = 0; i < spheres.size() ; i++)
-		{
-			// If the missile does collide with an asteroid, increment the kill counter and update positions
-			if(detect_collision(missileA_pos, spheres[i], 2) && missileA_fired == 0)
-			{
-				killed_since_death++;
-				explosion_scale_factA += 0.3;
-				collisionA_pos = missileA_pos;
-				missileA_fired = 1;
-			}
-		}
+		explosions[numExplosions++] = w.collisionB_pos;
 	}
-	// If the distance between the missile and the current position  is less than 250 (AKA in the grid)
-	if(vec_length(missileA_pos - current_pos) < 250 && missileA_fired == 0)
+	for(unsigned int i = 0; i < std::min(newTicks, 4u); i++)
 	{
-		// Draw the cylinder for the missile
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * missileA_loc * Translate(vec4(0,0,2,1)) * Scale(0.5,1.0,0.5));
-		glUniform4fv(uniformId_colour, 1, vec4(1,1,1, 0.7f));
-		displayWireCylinder(vec4(0.3,0.3,0.3,1));
-
-		// Draw the sphere for the missile
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * missileA_loc * Translate(vec4(0,-0.5,2,1))  * Scale(0.25,0.25,0.25));
-		glUniform4fv(uniformId_colour, 1, vec4(1,1,1, 0.7f));
-		displayWireSphere(vec4(0.3,0.3,0.3,1));
+		gpuAsteroids.tick(w.bullet_positions.data(), w.bullet_positions.size(), explosions, numExplosions);
 	}
-	// If it exceeds the distance, then set the boolean variable to 1 to indicate it has been fired
-	else 
-	{
-		missileA_fired = 1;
-	}
-	// If there is a collision position..
-	if(abs(collisionA_pos.x) > 0.1 && abs(collisionA_pos.z) > 0.1)
+
+	while(gpuAsteroids.poll(gpuReport))
 	{
-		// Find all of the spheres within range of the explosion 
-		for(int i =0; i < spheres.size(); i++)
-		{
-			if(vec_length(spheres[i] - collisionA_pos) < 15)
-			{
-				sphere_size[i] += 0.1;
-			}
-		}
+		telemetry.add(telemetryGpuHits, gpuReport.hits.size() + gpuReport.droppedHits);
+		spawnGpuAsteroids(gpuReport.despawns.size());
 	}
-	// END - missile A - - - - - - - - - - - -
-
+	telemetry.set(telemetryGpuAsteroids, gpuAsteroids.live());
+}
 
-	// - - - - - - - - - - - - - - - - - - - - 
-	// Draw missile B
-	mat4 missileB_loc;
-	// If the missile has no speed, then it is simply a part of the ship
-	if(missileB_speed == 0)
+// the field where it is by 'alpha' of a tick, culled on the GPU if it can
+void drawGpuAsteroids(const mat4& projView, float alpha)
+{
+	if(gpuAsteroids.capacity() == 0)
 	{
-		missileB_loc = Translate(current_pos) * Translate(0,-2,0) * Scale(0.3,0.3,0.3) * RotateY(angle_rot-45) * RotateX(turn_rot) * RotateZ(90) ;
+		return;
 	}
-	// If it does have speed..
-	else
+
+	vec4 colour(0.545f,0.275f,0.08f,1);
+	if(gpuScene.capacity() == 0)
 	{
-		// Calculate its position, and check to see if it collides with any asteroids
-		missileB_pos = missileB_pos + missileB_speed*missileB_dir;
-		missileB_loc = Translate(missileB_pos) * Translate(0,-2,0) * Scale(0.3,0.3,0.3) * RotateY(angle_rot-45) * RotateX(turn_rot) * RotateZ(90) ;
-		for(int i = 0; i < spheres.size() ; i++)
-		{
-			// If the missile does collide with an asteroid, increment the kill counter and update positions
-			if(detect_collision(missileB_pos, spheres[i], 2) && missileB_fired == 0)
-			{
-				killed_since_death++;
-				explosion_scale_factB += 0.3;
-				collisionB_pos = missileB_pos;
-				missileB_fired = 1;
-			}
-		}
+		gpuAsteroids.draw(sphere, projView, colour, alpha);
+		return;
 	}
-	// If the distance between the missile and the current position  is less than 250 (AKA in the grid)
-	if(vec_length(missileB_pos - current_pos) < 140  && missileB_fired == 0)
-	{
-		// missile 1
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * missileB_loc * Translate(vec4(0,0,-2,1)) * Scale(0.5,1.0,0.5));
-		glUniform4fv(uniformId_colour, 1, vec4(1,1,1, 0.7f));
-		displayWireCylinder(vec4(0.3,0.3,0.3,1));
 
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * missileB_loc * Translate(vec4(0,-0.5,-2,1))  * Scale(0.25,0.25,0.25));
-		glUniform4fv(uniformId_colour, 1, vec4(1,1,1, 0.7f));
-		displayWireSphere(vec4(0.3,0.3,0.3,1));
+	gpuScene.setObjects(0, gpuAsteroids, gpuSceneSphere, colour, alpha);
+	gpuScene.cull(projView);
 
-	}
-	// If it exceeds the distance, then set the boolean variable to 1 to indicate it has been fired
-	else
-	{
-		missileB_fired = 1;
-	}
-	// If there is a collision position..
-	if(abs(collisionB_pos.x) > 0.1 && abs(collisionB_pos.z) > 0.1)
-	{
-		// Find all of the spheres within range of the explosion 
-		for(int i =0; i < spheres.size(); i++)
-		{
-			if(vec_length(spheres[i] - collisionB_pos) < 15)
-			{
-				sphere_size[i] += 0.1;
-			}
-		}
-	}
-	// END - missile B - - - - - - - - - - - -
-
-	// Draw the randomly placed missile which when touched refulls the missiles
-	glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj  * Translate(missile_pos) * Translate(vec4(0,0,2,1)) * Scale(0.5,1.0,0.5));
-	glUniform4fv(uniformId_colour, 1, vec4(1,1,1, 0.7f));
-	displayWireCylinder(vec4(0.3,0.3,0.3,1));
-	glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj  * Translate(missile_pos) * Translate(vec4(0,-0.5,2,1))  * Scale(0.25,0.25,0.25));
-	glUniform4fv(uniformId_colour, 1, vec4(1,1,1, 0.7f));
-	displayWireSphere(vec4(0.3,0.3,0.3,1));
-	
-	// If the user finds the random missile, reset the missile information and replace the missile
-	if(detect_collision(current_pos, missile_pos, 1.5))
-	{
-		missileA_speed = 0;
-		missileA_dir = vec4(0,0,0,0);
-		missileA_pos = vec4(0,0,0,0);
-		missileA_fired = 0;
-		missileB_speed = 0;
-		missileB_dir = vec4(0,0,0,0);
-		missileB_pos = vec4(0,0,0,0);
-		missileB_fired = 0;
-		collisionA_pos = vec4(0,0,0,0);
-		collisionB_pos = vec4(0,0,0,0);
-		explosion_scale_factA = 0;
-		explosion_scale_factB = 0;
-		
-		missile_pos = vec4(randRange(-100,100),-2,randRange(-100,100),1);
-	}
-	
+	// as displayWireSphere draws the game's own
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(5,5);
+	gpuScene.draw(projView);
+}
+
+void initTelemetry()
+{
+	telemetryFrames = telemetry.counter("frames");
+	telemetryFrameUs = telemetry.gauge("frame_us");
+	telemetryAsteroids = telemetry.gauge("asteroids_live");
+	telemetryBullets = telemetry.gauge("bullets_live");
+	telemetryCollisionTests = telemetry.counter("collision_tests");
+	telemetryDraws = telemetry.gauge("draw_calls");
+	telemetryBytesStreamed = telemetry.counter("bytes_streamed");
+	telemetryBuffers = telemetry.gauge("gl_buffers_alive");
+	telemetryBufferBytes = telemetry.gauge("gl_buffer_bytes");
+	telemetrySimTickUs = telemetry.gauge("sim_tick_us");
+	telemetrySimLateUs = telemetry.gauge("sim_late_us");
+	telemetryGpuAsteroids = telemetry.gauge("gpu_asteroids_live");
+	telemetryGpuHits = telemetry.counter("gpu_asteroid_hits");
+
+	if(!telemetry.open())
+		std::cerr << "telemetry not available" << std::endl;
+}
+
+void publishTelemetry(const FrameSample& sample)
+{
+	telemetry.add(telemetryFrames);
+	telemetry.set(telemetryFrameUs, (long long)(sample.frameMs * 1000));
+	telemetry.set(telemetryAsteroids, sample.asteroids);
+	telemetry.set(telemetryBullets, sample.bullets);
+	telemetry.add(telemetryCollisionTests, sample.collisionTests);
+	telemetry.set(telemetryDraws, sample.drawCalls);
+	telemetry.set(telemetryBytesStreamed, trackedBytesUploaded());
+	telemetry.set(telemetryBuffers, trackedBufferCount());
+	telemetry.set(telemetryBufferBytes, sample.bufferBytes);
+	telemetry.set(telemetrySimTickUs, (long long)(sample.simMs * 1000));
+	telemetry.set(telemetrySimLateUs, (long long)(sample.simLateMs * 1000));
+	telemetry.publish();
 }
 
-// vi. Display the bullets
-void display_bullets(float uniformId_modelView, mat4 matProj)
+// Watch the GL buffer memory for leaks: after a few seconds of warm-up it
+// should stay flat, warn (once) if it keeps climbing. 'm' prints a report.
+GrowthWatch bufferWatch(300, 64 * 1024);
+bool bufferLeakReported = false;
+
+void reportMemory()
 {
-	// If a bullet is fired, and the player has bullets remaining
-	if(bullet_fired && playerA.bullets_remaining > 0)
+	std::cout << "GL ";
+	glBuffers().report(std::cout);
+	reportHeap(std::cout);
+	std::cout << "frame arena: " << frameArena().peak() << " bytes peak, "
+			  << frameArena().capacity() << " capacity, grown " << frameArena().growths() << " times\n";
+	std::cout << std::flush;
+}
+
+void watchMemory()
+{
+	glBuffers().advanceFrame();
+	bufferWatch.sample(trackedBufferBytes());
+
+	if(!bufferLeakReported && bufferWatch.samples() % 600 == 0 && bufferWatch.growing())
 	{
-		// Reverse the boolean, and add the current position and direction of the bullet
-		bullet_fired = !bullet_fired;
-		bullet_positions.push_back(current_pos + vec4(0,-1,0,0));
-		bullet_directions.push_back( RotateY(angle_rot) * vec4(1,0,1,0));
-		playerA.bullets_remaining--;
+		std::cerr << "warning: GL buffer memory keeps growing ("
+				  << bufferWatch.slope() << " bytes/frame)" << std::endl;
+		reportMemory();
+		bufferLeakReported = true;
 	}
+}
 
-	// Draw the random box to allow the player to gain ammunition
-	glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * Translate(ammo_box) * Translate(0,-1,0) );
-	displayWireCube(vec4(0.1,0.8,0.1,1));
+// The actual particle fields (object of class shipParticles ), 
+// a ring with one for each transform in view.particle_dens
+shipParticles particle_fields[World::max_particle_fields];
+int newest_particle_field = -1;
 
-	// If the user touches the ammo box, replace the ammo box randomly and give the player more ammunition
-	if(detect_collision(current_pos, ammo_box, 0.9))
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
+// Keep one particle field for every transform in the trail: each frame
+// the oldest field is scattered anew (in its own buffer) as the newest
+void update_particle_fields()
+{
+	newest_particle_field = (newest_particle_field + 1) % World::max_particle_fields;
+	particle_fields[newest_particle_field].init();
+}
+
+// The field drawn for view.particle_dens[i] (the last one is the newest)
+shipParticles& particle_field(int i)
+{
+	int age = view.particle_dens.size() - 1 - i;
+	return particle_fields[(newest_particle_field - age + World::max_particle_fields) % World::max_particle_fields];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
+
+// Send every draw in the list to OpenGL
+void display_draws(const DrawList& draws)
+{
+	for(int i = 0; i < draws.size(); i++)
 	{
-		ammo_box = vec4(randRange(-50,50),0,randRange(-50,50),0);
-		if(playerA.bullets_remaining < 46)
+		const DrawCommand& d = draws[i];
+		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, d.transform);
+
+		switch(d.mesh)
 		{
-			playerA.bullets_remaining += 15;			
+			case DRAW_SHIP:
+				glUniform4fv(uniformId_colour, 1, d.colour);
+				ship.draw();
+				break;
+
+			case DRAW_CUBE:
+				displayWireCube(d.colour);
+				break;
+
+			case DRAW_CYLINDER:
+				displayWireCylinder(d.colour);
+				break;
+
+			case DRAW_SPHERE:
+				displayWireSphere(d.colour);
+				break;
+
+			case DRAW_STARS:
+				displayStars(d.transform, d.colour);
+				break;
+
+			case DRAW_PARTICLES:
+				glUniform4fv(uniformId_colour, 1, d.colour);
+				particle_field(d.index).draw(true);
+				break;
+
+			case DRAW_HUD:
+				hud.draw(d.transform, hudLives(d.index), hudBullets(d.index), d.colour);
+				break;
 		}
 	}
+}
 
-	// For all of the bullets fired and within range..
-	for(int i = 0 ; i < bullet_positions.size() ; i++)
+// After the warm-up a frame must not touch the heap: its transient data
+// goes in the frame arena, everything else is allocated up front. Debug
+// builds stop at the first frame that allocates (the recorder is left out,
+// it keeps the input and keyframes on purpose). Only this thread's
+// allocations count, the simulation thread's and the workers' are theirs.
+const int steadyStateFrame = 300;
+int framesDrawn = 0;
+
+void checkSteadyState(const AllocationCounter& allocations)
+{
+#ifndef NDEBUG
+	if(++framesDrawn <= steadyStateFrame)
 	{
-		// Translate the bullet position and draw the bullet
-		glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, matProj * Translate(bullet_positions[i] + bullet_directions[i]) * Scale(0.05,0.05,0.05) );
-		bullet_positions[i] = bullet_positions[i] + bullet_directions[i]*2.5;
-		displayWireSphere(vec4(1.0f,0.0f,0.0f,1));
+		return;
+	}
 
-		for(int m = 0; m < spheres.size(); m++)
-		{
-			// If the bullet collides with an asteroid, increase its scale value (size)
-			if(detect_collision(spheres[m] , bullet_positions[i], 1.8f))
-			{
-				sphere_size[m] += 0.05;
-			}
-		}
-		
-		// If the bullet moves too far away, erase it
-		if(bullet_positions[i].x > 140 || bullet_positions[i].z > 140 || bullet_positions[i].x < -140 || bullet_positions[i].z < -140)
-		{
-			bullet_positions.erase(bullet_positions.begin()+i);
-			bullet_directions.erase(bullet_directions.begin()+i);
-		}
+	unsigned long long n = allocations.count();
+	if(n != 0)
+	{
+		std::cerr << "display() made " << n << " heap allocations in frame " << framesDrawn << std::endl;
+		reportHeap(std::cerr);
 	}
+	assert(n == 0 && "display() allocated after the warm-up");
+#else
+	(void)allocations;
+#endif
 }
 
 // Display method 
 void display( void )
 {
+	AllocationCounter allocations("record", true);
+	Clock::time_point frameStart = Clock::now();
+
 	 // clear the window
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Calculate the project and view matrices
-	mat4 Projection  = myCamera.getProjection();
-	mat4 View = myCamera.getView() * RotateY(-angle_rot) * Translate(-current_pos);
-
+	// Take the newest tick the simulation finished, with a new particle
+	// field for every tick since the last frame
+	bool newTick = simThread.acquire();
+	const WorldSnapshot& snapshot = simThread.snapshot();
+	unsigned int newTicks = std::min(snapshot.tick - ticksSeen, (unsigned int)World::max_particle_fields);
+	for(unsigned int i = 0; i < newTicks; i++)
+	{
+		update_particle_fields();
+	}
+	ticksSeen = snapshot.tick;
 
-	// Draw the ship
-	glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, Projection * View * Translate(current_pos) * Translate(0,-2,0) * Scale(0.3,0.3,0.3) * RotateY(angle_rot-45) * RotateX(turn_rot));
-	glUniform4fv(uniformId_colour, 1, vec4(1,1,1, 0.7f));
-	ship.draw();
+	// and move it on by how far the clock is towards the next tick
+	{
+		HeapScope scope("interpolate");
+		interpolateSnapshot(snapshot, simThread.alpha(frameStart), view);
+	}
 
+	// Calculate the project and view matrices
+	mat4 Projection  = myCamera.getProjection();
+	mat4 View = myCamera.getView() * view.cameraView();
 
-	// Display the missiles
-	display_missiles(uniformId_modelView, Projection * View);
+	// Draw the ship, missiles, particle trail, bullets, asteroids, stars
+	// and the amount of bullets and lives remaining
+	{
+		HeapScope scope("build_draws");
+		draws.clear();
+		view.recordDraws(drawRecorder, draws, Projection * View, Projection);
+	}
+	{
+		HeapScope scope("render");
+		display_draws(draws);
+		tickGpuAsteroids(snapshot.world, newTicks);
+		drawGpuAsteroids(Projection * View, simThread.alpha(frameStart));
+	}
 
-	// Display the particle trail
-	display_particles(uniformId_modelView, Projection * View);
-	
-	// Update the current position
-	current_pos = current_pos + current_dir * speed;
-	turn_rot = coordinateShipTurn(turn_rot);
-	if(speed < max_speed)
-		speed += 0.002;
-
-	// Display the bullets
-	display_bullets(uniformId_modelView, Projection * View);
-	
-	// Display the asteroids
-	display_asteroids(uniformId_modelView, Projection * View);
+	Clock::time_point renderEnd = Clock::now();
 
-	// Display the stars
-	glUniformMatrix4fv(uniformId_modelView, 1, GL_TRUE, Projection * View	);
-	displayStars(vec4(1,1,1,1));
+	FrameSample sample;
+	sample.frameMs = milliseconds(lastFrameStart, frameStart);
+	sample.simMs = snapshot.tickMs;
+	sample.simLateMs = snapshot.lateMs;
+	sample.renderMs = milliseconds(frameStart, renderEnd);
+	sample.asteroids = view.spheres.size() + gpuAsteroids.live();
+	sample.bullets = view.bullet_positions.size();
+	sample.collisionTests = newTick ? snapshot.world.collision_tests : 0;
+	sample.drawCalls = draws.size() + perfOverlay.drawCalls();
+	sample.bufferBytes = trackedBufferBytes();
+	frameHistory.push(sample);
+	watchMemory();
+	publishTelemetry(sample);
+	lastFrameStart = frameStart;
 
-	// Display the amount of bullets and lives remaining
-	display_lives_rem(uniformId_modelView, Projection);
-	display_bullets_rem(uniformId_modelView, Projection);
+	perfOverlay.draw(frameHistory);
 
 	// swap buffers and display
 	glutSwapBuffers();
+
+	frameArena().reset();
+	checkSteadyState(allocations);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -876,38 +762,23 @@ void keyboard( unsigned char key, int x, int y )
 			exit( EXIT_SUCCESS );
 			break;
 
-		case ' ':
-
-			bullet_fired = ! bullet_fired;
-			break;
-
 		case '.':
 			myCamera.toggleTopView();
 			break;
 
-		case 'a':
-			speed += 0.03;
-			break;
-		case 'A':
-			speed += 0.03;
+		case 'p':
+		case 'P':
+			perfOverlay.toggle();
 			break;
-		case 's':
-				speed -= 0.03;
-			break;
-		case 'S':
-				speed -= 0.03;
-			break;
-		case 'z':
-			
-			missileA_pos = current_pos;
-			missileA_dir = RotateY(angle_rot) * vec4(1,0,1,0);
-			missileA_speed = 0.8;
+
+		case 'm':
+		case 'M':
+			reportMemory();
 			break;
-		case 'x':
-			
-			missileB_pos = current_pos;
-			missileB_dir = RotateY(angle_rot) * vec4(1,0,1,0);
-			missileB_speed = 0.8;
+
+		default:
+			if(!replaying)
+				simThread.keyboard(key);
 			break;
 	}
 
@@ -925,30 +796,9 @@ void specialKeyboard(int key, int x, int y)
 
 	updateCamera();
 
-	switch ( key )
-	{
-		// Esc key
-		case GLUT_KEY_UP:
-			current_dir = initial_dir;
-			break;
-
-		case GLUT_KEY_DOWN:
-			break;
-
-		case GLUT_KEY_LEFT:
-			turn_rot -= 3;
-			angle_rot += 3;
-			dir_vec = RotateY(3) * dir_vec;
-			initial_dir = RotateY(3) * initial_dir;
-			break;
-
-		case GLUT_KEY_RIGHT:
-			turn_rot += 3;
-			angle_rot -= 3;
-			dir_vec = RotateY(-3) * dir_vec;
-			initial_dir = RotateY(-3) * initial_dir;
-			break;
-	}
+	// the arrow keys steer the ship
+	if(!replaying)
+		simThread.specialKeyboard(key);
 	glutPostRedisplay();
 }
 
@@ -976,18 +826,83 @@ void timerFunction(int value)
 }
 
 
+// write out the recording when the game closes
+void saveRecording()
+{
+	simThread.stop();
+	if(recorder.isRecording())
+	{
+		if(recorder.stop().save(recordFile))
+			std::cout << "saved recording '" << recordFile << "'" << std::endl;
+		else
+			std::cerr << "could not save recording '" << recordFile << "'" << std::endl;
+	}
+}
+
 // application entry point
 int	main( int argc, char **argv )
 {
 	// initialize glut
 	glutInit( &argc, argv );
+
+	// glut has taken its own arguments out
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string arg = argv[i];
+		if(arg == "--record")
+		{
+			recordFile = argv[i + 1];
+			recorder.start(world, 1);
+			atexit(saveRecording);
+		}
+		else if(arg == "--replay")
+		{
+			if(!recording.load(argv[i + 1]))
+			{
+				std::cerr << "could not load recording '" << argv[i + 1] << "'" << std::endl;
+				return 1;
+			}
+			replayer.start(world);
+			replaying = true;
+		}
+		else if(arg == "--gpu-asteroids")
+		{
+			gpuAsteroidCount = atoi(argv[i + 1]);
+		}
+		else if(arg == "--impostor-distance")
+		{
+			impostorDistance = (float)atof(argv[i + 1]);
+		}
+		else if(arg == "--grid")
+		{
+			background.showGrid = atoi(argv[i + 1]) != 0;
+		}
+		else if(arg == "--background-cache")
+		{
+			backgroundCacheScale = (float)atof(argv[i + 1]);
+		}
+	}
 	glutInitDisplayMode( GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA );
 	glutInitWindowSize( 512, 512 );
 
 	#ifndef __APPLE__
 	// If you are using freeglut extensions, ask for an OpenGL
-	// version context
-    glutInitContextVersion( 2, 1 );
+	// version context (the GPU asteroids need compute shaders, and the
+	// compatibility profile keeps everything else working as it is)
+	if(gpuAsteroidCount > 0)
+	{
+		glutInitContextVersion( 4, 3 );
+		glutInitContextProfile( GLUT_COMPATIBILITY_PROFILE );
+	}
+	else if(backgroundCacheScale > 0)
+	{
+		// the background's cache draws into a framebuffer object
+		glutInitContextVersion( 3, 0 );
+	}
+	else
+	{
+		glutInitContextVersion( 2, 1 );
+	}
 	// this seems to force the most recent version, but would be nice
 	// to call since it forces modern OpenGL calls
 	//glutInitContextFlags (GLUT_FORWARD_COMPATIBLE );
@@ -1027,6 +942,12 @@ int	main( int argc, char **argv )
 
 	// create geometry and put it into the GPU
 	initGeometry();
+	draws.reserve(maxDraws);
+
+	perfOverlay.init();
+
+	initTelemetry();
+	initGpuAsteroids();
 
 
 	// set event callback functions
@@ -1038,11 +959,11 @@ int	main( int argc, char **argv )
 
 	updateCamera();
 
-	playerA.bullets_remaining = 60;
-	playerA.lives_remaining = 4;
-
 	std::cout << "initializing done" << std::endl;
 
+	view.reserve(world.num_spheres);
+	simThread.start();
+
 
 	glutTimerFunc(17, timerFunction, 0);
 	// enter the main loop
@@ -0,0 +1,75 @@
+#ifndef DJV_TRIPLE_BUFFER_H_
+#define DJV_TRIPLE_BUFFER_H_
+/*
+	Triple buffer
+
+	Hands the newest of a stream of values from one writer thread to one
+	reader thread without locks, and without either one ever waiting for
+	the other. Of the three slots the writer owns one, the reader owns one
+	and the third is the mailbox between them: publish() swaps the filled
+	slot into the mailbox, acquire() swaps the mailbox with the reader's
+	slot when something new is in it. Values the reader did not get to in
+	time are written over, it always gets the latest.
+
+		writer:  fill(buffer.writeSlot()); buffer.publish();
+		reader:  if (buffer.acquire()) use(buffer.readSlot());
+
+	The slots are reused, so values that own memory (vectors) keep it
+	from one round to the next.
+*/
+
+#include <atomic>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template < class T >
+class TripleBuffer
+{
+public:
+	TripleBuffer() : back(0), front(1), middle(2) {}
+
+	// the writer's slot, filled in before publish()
+	T& writeSlot() { return slots[back]; }
+
+	// makes the writer's slot the newest value and takes the mailbox's
+	// (whichever value the reader did not take) to write into next
+	void publish()
+	{
+		back = middle.exchange(back | fresh, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// moves the reader on to the newest value, false if nothing was
+	// published since the last call
+	bool acquire()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & fresh))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+		return true;
+	}
+
+	// the reader's slot, the newest value acquired (left alone by the writer)
+	T& readSlot() { return slots[front]; }
+	const T& readSlot() const { return slots[front]; }
+
+	// any of the three, to set them up before the threads share them
+	T& slot(int i) { return slots[i]; }
+
+private:
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+	static const unsigned int indexMask = 3;
+	static const unsigned int fresh = 4; // the mailbox holds an unread value
+
+	T slots[3];
+	alignas(64) unsigned int back;  // the writer's only
+	alignas(64) unsigned int front; // the reader's only
+	alignas(64) std::atomic< unsigned int > middle;
+};
+
+}
+
+#endif
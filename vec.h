@@ -13,9 +13,24 @@
 #include <iostream>
 #include <sstream>
 #include <complex>
+#include <type_traits>
 
 #include "gl_include.h"
 
+// vec4 and mat4 use SSE for dot, normalize, cross, the matrix products and
+// transpose (and AVX for mat4 * mat4 when it is enabled), chosen when
+// compiling; DJV_NO_SIMD keeps the plain C++. The plain versions are always
+// there in namespace scalar, to check the others against.
+#if !defined(DJV_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define DJV_SIMD_SSE 1
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#define DJV_SIMD_AVX 1
+#include <immintrin.h>
+#endif
+#endif
+
 
 
 namespace djv {
@@ -34,15 +49,12 @@ struct vec2 {
     //  --- Constructors and Destructors ---
     //
 
-    vec2( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec2( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s) {}
 
-    vec2( GLfloat x, GLfloat y ) :
+    constexpr vec2( GLfloat x, GLfloat y ) :
 	x(x), y(y) {}
 
-    vec2( const vec2& v )
-	{ x = v.x;  y = v.y;  }
-
     //
     //  --- Indexing Operator ---
     //
@@ -54,22 +66,22 @@ struct vec2 {
     //  --- (non-modifying) Arithematic Operators ---
     //
 
-    vec2 operator - () const // unary minus operator
+    constexpr vec2 operator - () const // unary minus operator
 	{ return vec2( -x, -y ); }
 
-    vec2 operator + ( const vec2& v ) const
+    constexpr vec2 operator + ( const vec2& v ) const
 	{ return vec2( x + v.x, y + v.y ); }
 
-    vec2 operator - ( const vec2& v ) const
+    constexpr vec2 operator - ( const vec2& v ) const
 	{ return vec2( x - v.x, y - v.y ); }
 
-    vec2 operator * ( const GLfloat s ) const
+    constexpr vec2 operator * ( const GLfloat s ) const
 	{ return vec2( s*x, s*y ); }
 
-    vec2 operator * ( const vec2& v ) const
+    constexpr vec2 operator * ( const vec2& v ) const
 	{ return vec2( x*v.x, y*v.y ); }
 
-    friend vec2 operator * ( const GLfloat s, const vec2& v )
+    friend constexpr vec2 operator * ( const GLfloat s, const vec2& v )
 	{ return v * s; }
 
     vec2 operator / ( const GLfloat s ) const {
@@ -183,15 +195,14 @@ struct vec3 {
     //  --- Constructors and Destructors ---
     //
 
-    vec3( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec3( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s), z(s) {}
 
-    vec3( GLfloat x, GLfloat y, GLfloat z ) :
+    constexpr vec3( GLfloat x, GLfloat y, GLfloat z ) :
 	x(x), y(y), z(z) {}
 
-    vec3( const vec3& v ) { x = v.x;  y = v.y;  z = v.z; }
-
-    vec3( const vec2& v, const float f ) { x = v.x;  y = v.y;  z = f; }
+    constexpr vec3( const vec2& v, const float f ) :
+	x(v.x), y(v.y), z(f) {}
 
     //
     //  --- Indexing Operator ---
@@ -204,22 +215,22 @@ struct vec3 {
     //  --- (non-modifying) Arithematic Operators ---
     //
 
-    vec3 operator - () const  // unary minus operator
+    constexpr vec3 operator - () const  // unary minus operator
 	{ return vec3( -x, -y, -z ); }
 
-    vec3 operator + ( const vec3& v ) const
+    constexpr vec3 operator + ( const vec3& v ) const
 	{ return vec3( x + v.x, y + v.y, z + v.z ); }
 
-    vec3 operator - ( const vec3& v ) const
+    constexpr vec3 operator - ( const vec3& v ) const
 	{ return vec3( x - v.x, y - v.y, z - v.z ); }
 
-    vec3 operator * ( const GLfloat s ) const
+    constexpr vec3 operator * ( const GLfloat s ) const
 	{ return vec3( s*x, s*y, s*z ); }
 
-    vec3 operator * ( const vec3& v ) const
+    constexpr vec3 operator * ( const vec3& v ) const
 	{ return vec3( x*v.x, y*v.y, z*v.z ); }
 
-    friend vec3 operator * ( const GLfloat s, const vec3& v )
+    friend constexpr vec3 operator * ( const GLfloat s, const vec3& v )
 	{ return v * s; }
 
     vec3 operator / ( const GLfloat s ) const {
@@ -327,7 +338,8 @@ vec3 cross(const vec3& a, const vec3& b )
 //
 //////////////////////////////////////////////////////////////////////////////
 
-struct vec4 {
+// 16 byte aligned, so it loads into one SSE register
+struct alignas(16) vec4 {
 
     GLfloat  x;
     GLfloat  y;
@@ -338,19 +350,17 @@ struct vec4 {
     //  --- Constructors and Destructors ---
     //
 
-    vec4( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec4( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s), z(s), w(s) {}
 
-    vec4( GLfloat x, GLfloat y, GLfloat z, GLfloat w ) :
+    constexpr vec4( GLfloat x, GLfloat y, GLfloat z, GLfloat w ) :
 	x(x), y(y), z(z), w(w) {}
 
-    vec4( const vec4& v ) { x = v.x;  y = v.y;  z = v.z;  w = v.w; }
-
-    vec4( const vec3& v, const float w = 1.0 ) : w(w)
-	{ x = v.x;  y = v.y;  z = v.z; }
+    constexpr vec4( const vec3& v, const float w = 1.0 ) :
+	x(v.x), y(v.y), z(v.z), w(w) {}
 
-    vec4( const vec2& v, const float z, const float w ) : z(z), w(w)
-	{ x = v.x;  y = v.y; }
+    constexpr vec4( const vec2& v, const float z, const float w ) :
+	x(v.x), y(v.y), z(z), w(w) {}
 
     //
     //  --- Indexing Operator ---
@@ -363,22 +373,22 @@ struct vec4 {
     //  --- (non-modifying) Arithematic Operators ---
     //
 
-    vec4 operator - () const  // unary minus operator
+    constexpr vec4 operator - () const  // unary minus operator
 	{ return vec4( -x, -y, -z, -w ); }
 
-    vec4 operator + ( const vec4& v ) const
+    constexpr vec4 operator + ( const vec4& v ) const
 	{ return vec4( x + v.x, y + v.y, z + v.z, w + v.w ); }
 
-    vec4 operator - ( const vec4& v ) const
+    constexpr vec4 operator - ( const vec4& v ) const
 	{ return vec4( x - v.x, y - v.y, z - v.z, w - v.w ); }
 
-    vec4 operator * ( const GLfloat s ) const
+    constexpr vec4 operator * ( const GLfloat s ) const
 	{ return vec4( s*x, s*y, s*z, s*w ); }
 
-    vec4 operator * ( const vec4& v ) const
+    constexpr vec4 operator * ( const vec4& v ) const
 	{ return vec4( x*v.x, y*v.y, z*v.z, w*v.z ); }
 
-    friend vec4 operator * ( const GLfloat s, const vec4& v )
+    friend constexpr vec4 operator * ( const GLfloat s, const vec4& v )
 	{ return v * s; }
 
     vec4 operator / ( const GLfloat s ) const {
@@ -447,14 +457,57 @@ struct vec4 {
 	{ return static_cast<GLfloat*>( &x ); }
 };
 
+#ifdef DJV_SIMD_SSE
+inline
+__m128 simdLoad( const vec4& v ) { return _mm_load_ps( &v.x ); }
+
+inline
+vec4 simdStore( __m128 r ) {
+    vec4 v;
+    _mm_store_ps( &v.x, r );
+    return v;
+}
+#endif
+
 //----------------------------------------------------------------------------
 //
 //  Non-class vec4 Methods
 //
 
+namespace scalar {
+
 inline
 GLfloat dot( const vec4& u, const vec4& v ) {
-    return u.x*v.x + u.y*v.y + u.z*v.z + u.w+v.w;
+    return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
+}
+
+inline
+vec4 normalize( const vec4& v ) {
+    return v / std::sqrt( dot(v,v) );
+}
+
+inline
+vec4 cross(const vec4& a, const vec4& b )
+{
+    return vec4( a.y * b.z - a.z * b.y,
+		 a.z * b.x - a.x * b.z,
+		 a.x * b.y - a.y * b.x,
+		 0);
+}
+
+}
+
+inline
+GLfloat dot( const vec4& u, const vec4& v ) {
+#ifdef DJV_SIMD_SSE
+    // (x + z) + (y + w), may differ from the scalar sum in the last bit
+    __m128 p = _mm_mul_ps( simdLoad(u), simdLoad(v) );
+    __m128 s = _mm_add_ps( p, _mm_movehl_ps(p, p) );
+    s = _mm_add_ss( s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1,1,1,1)) );
+    return _mm_cvtss_f32( s );
+#else
+    return scalar::dot( u, v );
+#endif
 }
 
 inline
@@ -469,20 +522,40 @@ GLfloat lengthSqr( const vec4& v ) {
 
 inline
 vec4 normalize( const vec4& v ) {
-    return v / length(v);
+#ifdef DJV_SIMD_SSE
+    // the squared length in every lane, then one division
+    __m128 a = simdLoad( v );
+    __m128 p = _mm_mul_ps( a, a );
+    p = _mm_add_ps( p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2,3,0,1)) );
+    p = _mm_add_ps( p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1,0,3,2)) );
+    return simdStore( _mm_div_ps(a, _mm_sqrt_ps(p)) );
+#else
+    return scalar::normalize( v );
+#endif
 }
 
 inline
 vec4 cross(const vec4& a, const vec4& b )
 {
-    return vec4( a.y * b.z - a.z * b.y,
-		 a.z * b.x - a.x * b.z,
-		 a.x * b.y - a.y * b.x,
-		 0);
+#ifdef DJV_SIMD_SSE
+    // a * b.yzxw - a.yzxw * b is the cross product in zxy order (w: 0),
+    // every lane is the same product and difference as the scalar one
+    __m128 u = simdLoad( a ), v = simdLoad( b );
+    __m128 c = _mm_sub_ps( _mm_mul_ps(u, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,0,2,1))),
+			   _mm_mul_ps(_mm_shuffle_ps(u, u, _MM_SHUFFLE(3,0,2,1)), v) );
+    return simdStore( _mm_shuffle_ps(c, c, _MM_SHUFFLE(3,0,2,1)) );
+#else
+    return scalar::cross( a, b );
+#endif
 }
 
 //----------------------------------------------------------------------------
 
+// no copy constructors of their own, copies are plain memory copies
+static_assert( std::is_trivially_copyable< vec2 >::value, "vec2 must stay trivially copyable" );
+static_assert( std::is_trivially_copyable< vec3 >::value, "vec3 must stay trivially copyable" );
+static_assert( std::is_trivially_copyable< vec4 >::value, "vec4 must stay trivially copyable" );
+
 }  
 
 #endif
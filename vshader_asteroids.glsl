@@ -0,0 +1,24 @@
+#version 330
+
+// The GPU asteroids (gpu_asteroids.h), one instance per slot: the sphere
+// scaled like World's asteroids and moved back by 'back' ticks. Empty
+// slots have size 0 and collapse to a point.
+
+uniform mat4 projView;
+uniform vec4 in_Colour;
+uniform float back; // alpha - 1
+
+in vec4 in_Position; // sphere vertex
+in vec4 in_Centre;   // per instance, straight from the simulation's buffers
+in vec4 in_Velocity;
+in float in_Size;
+
+out vec4 v_Colour;
+
+void main()
+{
+	vec3 centre = in_Centre.xyz + in_Velocity.xyz * back;
+	vec3 p = centre + in_Position.xyz * vec3(in_Size, 0.5 * in_Size, in_Size);
+	gl_Position = projView * vec4(p, 1.0);
+	v_Colour = in_Colour;
+}
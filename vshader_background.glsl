@@ -0,0 +1,19 @@
+#version 120
+
+// The background (background.h): one triangle over the screen at the far
+// plane. Each corner carries the near and far ends of its view ray in
+// homogeneous world coordinates, which interpolate across the screen
+// exactly, so every pixel gets its own ray.
+
+uniform mat4 inverseProjView;
+attribute vec2 in_Position; // clip x and y
+
+varying vec4 v_Near;
+varying vec4 v_Far;
+
+void main()
+{
+	v_Near = inverseProjView * vec4(in_Position, -1.0, 1.0);
+	v_Far = inverseProjView * vec4(in_Position, 1.0, 1.0);
+	gl_Position = vec4(in_Position, 0.99999, 1.0);
+}
@@ -0,0 +1,51 @@
+#version 430
+
+// The scene's impostors (gpu_scene.h): for each far object of the unit
+// sphere mesh, a quad facing the eye through the object's centre, big
+// enough for the sphere its model's longest axis makes. The fragments get
+// the ray from the eye in the object's own space, where the ellipsoid is
+// the unit sphere again
+
+struct SceneObject
+{
+	mat4 model;
+	vec4 colour;
+	uint mesh;
+};
+
+layout(std430, row_major, binding = 3) readonly buffer Objects { SceneObject objects[]; };
+
+uniform mat4 projView;
+uniform vec3 eye;
+
+layout(location = 0) in vec4 in_Position; // quad corner, x and y in -1..1
+layout(location = 1) in uint in_Object;   // per instance, from the cull pass's list
+
+out vec3 v_World;          // on the quad
+out vec3 v_Direction;      // eye to v_World, in object space
+flat out vec3 v_Origin;    // the eye in object space
+flat out vec4 v_Colour;
+
+void main()
+{
+	SceneObject o = objects[in_Object];
+	vec3 centre = o.model[3].xyz;
+	float radius = max(length(o.model[0].xyz), max(length(o.model[1].xyz), length(o.model[2].xyz)));
+
+	// the cone from the eye round the sphere meets the quad's plane
+	// radius * d / sqrt(d^2 - radius^2) from the centre
+	vec3 toEye = eye - centre;
+	float d = length(toEye);
+	float r = radius * d / sqrt(max(d * d - radius * radius, 1e-6 * d * d));
+	vec3 forward = toEye / d;
+	vec3 right = normalize(cross(abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), forward));
+	vec3 up = cross(forward, right);
+	vec3 world = centre + (in_Position.x * right + in_Position.y * up) * r;
+
+	mat4 toObject = inverse(o.model);
+	v_World = world;
+	v_Direction = (toObject * vec4(world - eye, 0.0)).xyz;
+	v_Origin = (toObject * vec4(eye, 1.0)).xyz;
+	v_Colour = o.colour;
+	gl_Position = projView * vec4(world, 1.0);
+}
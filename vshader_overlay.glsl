@@ -0,0 +1,11 @@
+#version 120
+
+attribute vec2 in_Position; // already in normalized device coordinates
+attribute vec4 in_Colour;
+varying vec4 v_Colour;
+
+void main()
+{
+		gl_Position = vec4(in_Position, 0.0, 1.0);
+		v_Colour = in_Colour;
+}
@@ -0,0 +1,28 @@
+#version 430
+
+// The scene's objects (gpu_scene.h), drawn by the commands the cull pass
+// wrote: each instance is an object's index, its transform and colour
+// are read from the object buffer
+
+struct SceneObject
+{
+	mat4 model;
+	vec4 colour;
+	uint mesh;
+};
+
+layout(std430, row_major, binding = 3) readonly buffer Objects { SceneObject objects[]; };
+
+uniform mat4 projView;
+
+layout(location = 0) in vec4 in_Position; // shared geometry
+layout(location = 1) in uint in_Object;   // per instance, from the cull pass's list
+
+out vec4 v_Colour;
+
+void main()
+{
+	SceneObject o = objects[in_Object];
+	gl_Position = projView * (o.model * vec4(in_Position.xyz, 1.0));
+	v_Colour = o.colour;
+}
@@ -0,0 +1,744 @@
+#include "world.h"
+#include "jobs.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Helper Functions
+
+// Returns the length of a vector
+float vec_length(vec4 vec)
+{
+	return sqrt(vec.x*vec.x + vec.z*vec.z);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The constant parts of the transforms, made once instead of every frame
+
+static const affine missileTurn = affine::rotationZ(90);
+
+// The orientations the ship is steered by; the ship mesh faces 45 degrees
+// off its heading and the trail is stood up across it
+static const quat turnLeft = quat_axis_angle(vec3(0,1,0), 3);
+static const quat turnRight = quat_axis_angle(vec3(0,1,0), -3);
+static const quat bankLeft = quat_axis_angle(vec3(1,0,0), -3);
+static const quat bankRight = quat_axis_angle(vec3(1,0,0), 3);
+static const quat shipTurn = quat_axis_angle(vec3(0,1,0), -45);
+static const quat trailTurn = quat_axis_angle(vec3(0,0,1), 90) * quat_axis_angle(vec3(1,0,0), -45);
+
+// How far the bank and the camera ease each tick
+static const float easing = 0.1f;
+
+// Asteroids per job when collide() and recordDraws() split their loops
+static const size_t collideGrain = 1024;
+static const size_t drawGrain = 4096;
+
+// Detect a collision given two positions and a distance between the two
+bool detect_collision(vec4 pos_A, vec4 pos_B, float distance)
+{
+	float v_x = pos_A.x - pos_B.x;
+	float v_y = pos_A.y - pos_B.y;
+	float v_z = pos_A.z - pos_B.z;
+	if(sqrt(v_x*v_x + v_y*v_y + v_z*v_z) < distance)
+		return true;
+	else
+		return false;
+}
+
+// END - Helper Functions
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+World::World()
+{
+	reset();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::reset(unsigned int seed)
+{
+	asteroidRandom.seed(seed, RNG_ASTEROIDS);
+	pickupRandom.seed(seed, RNG_PICKUPS);
+	effectsRandom.seed(seed, RNG_EFFECTS);
+
+	player.current_wave = 0;
+	player.wave_size = 0;
+	player.speed = 0;
+	player.bullets_remaining = 60;
+	player.lives_remaining = 4;
+
+	speed = 0.0;
+	max_speed = speed;
+	current_dir = vec4(1,0,1,0);
+	current_pos = vec4(0,0,0,0);
+	heading = quat_identity();
+	bank = quat_identity();
+	camera = quat_identity();
+
+	bullet_fired = false;
+	bullet_positions.clear();
+	bullet_directions.clear();
+	bullet_positions.reserve(bulletCapacity);
+	bullet_directions.reserve(bulletCapacity);
+
+	spheres.clear();
+	sphere_vels.clear();
+	sphere_size.clear();
+	num_spheres = 60;
+	killed_since_death = 0;
+
+	particle_dens.clear();
+	particle_dens.reserve(max_particle_fields + 1);
+
+	collision_tests = 0;
+
+	rearmMissiles();
+
+	missile_pos = randomPosition(100, 0, 1);
+	ammo_box = randomPosition(50, 0, 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// a random point in the x-z square of half size 'extent'
+// (x is drawn before z, so the sequence does not depend on the compiler)
+vec4 World::randomPosition(float extent, float y, float w)
+{
+	float x = pickupRandom.range(-extent,extent);
+	float z = pickupRandom.range(-extent,extent);
+	return vec4(x,y,z,w);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::keyboard(unsigned char key)
+{
+	switch ( key )
+	{
+		case ' ':
+			bullet_fired = ! bullet_fired;
+			break;
+
+		case 'a':
+		case 'A':
+			speed += 0.03;
+			break;
+
+		case 's':
+		case 'S':
+			speed -= 0.03;
+			break;
+
+		case 'z':
+			missileA_pos = current_pos;
+			missileA_dir = headingDirection();
+			missileA_turn = shipOrientation();
+			missileA_speed = 0.8;
+			break;
+
+		case 'x':
+			missileB_pos = current_pos;
+			missileB_dir = headingDirection();
+			missileB_turn = shipOrientation();
+			missileB_speed = 0.8;
+			break;
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::specialKeyboard(int key)
+{
+	switch ( key )
+	{
+		case KEY_UP:
+			current_dir = headingDirection();
+			break;
+
+		case KEY_DOWN:
+			break;
+
+		case KEY_LEFT:
+			heading = (turnLeft * heading).normalize();
+			bank = (bank * bankLeft).normalize();
+			break;
+
+		case KEY_RIGHT:
+			heading = (turnRight * heading).normalize();
+			bank = (bank * bankRight).normalize();
+			break;
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::rearmMissiles()
+{
+	missileA_speed = 0;
+	missileA_dir = vec4(0,0,0,0);
+	missileA_pos = vec4(0,0,0,0);
+	missileA_turn = quat_identity();
+	missileA_fired = 0;
+	missileB_speed = 0;
+	missileB_dir = vec4(0,0,0,0);
+	missileB_pos = vec4(0,0,0,0);
+	missileB_turn = quat_identity();
+	missileB_fired = 0;
+	collisionA_pos = vec4(0,0,0,0);
+	collisionB_pos = vec4(0,0,0,0);
+	explosion_scale_factA = 0;
+	explosion_scale_factB = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::reserve(int asteroids)
+{
+	bullet_positions.reserve(bulletCapacity);
+	bullet_directions.reserve(bulletCapacity);
+	particle_dens.reserve(max_particle_fields + 1);
+	spheres.reserve(asteroids);
+	sphere_vels.reserve(asteroids);
+	sphere_size.reserve(asteroids);
+	sphere_outside.reserve(asteroids);
+	cull_inside.reserve(bulletCapacity);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::tick()
+{
+	spawn();
+	integrate();
+	collide();
+	cull();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Randomly generate an asteroid on one of the four sides of the game
+void asteroidSpawn(const float* u, vec4& pos, vec4& vel)
+{
+	int rand_asteroid = (int)(u[0] * 4);
+	float along = -130 + 260 * u[3]; // where along the edge it comes in
+
+	float speed = 0.05f + 0.1f * u[1];
+	float angle = -50 + 100 * u[2]; // how far off straight across it heads
+	vec4 dir;
+
+	if(rand_asteroid == 0)
+	{
+		dir = vec4(-1,0,0,0);
+		pos = vec4(100,-1,along,0);
+	}
+	else if(rand_asteroid == 1)
+	{
+		dir = vec4(1,0,0,0);
+		pos = vec4(-100,-1,along,0);
+	}
+	else if(rand_asteroid == 2)
+	{
+		dir = vec4(0,0,-1,0);
+		pos = vec4(along,-1,100,0);
+	}
+	else
+	{
+		dir = vec4(0,0,1,0);
+		pos = vec4(along,-1,-100,0);
+	}
+
+	// the heading never changes, so the step is worked out once
+	vel = RotateY(angle) * speed * dir;
+}
+
+void World::spawnAsteroid(const float* u)
+{
+	vec4 pos, vel;
+	asteroidSpawn(u, pos, vel);
+	sphere_size.push_back(1);
+	spheres.push_back(pos);
+	sphere_vels.push_back(vel);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::spawn()
+{
+	// If a bullet is fired, and the player has bullets remaining
+	if(bullet_fired && player.bullets_remaining > 0)
+	{
+		// Reverse the boolean, and add the current position and direction of the bullet
+		bullet_fired = !bullet_fired;
+		bullet_positions.push_back(current_pos + vec4(0,-1,0,0));
+		bullet_directions.push_back(headingDirection());
+		player.bullets_remaining--;
+	}
+
+	// Draw as many spheres as needed to maintain a constant "num_spheres" in play,
+	// the random numbers for a batch of them are drawn in one go; room for
+	// all of them is made first, so topping up never reallocates
+	if(spheres.capacity() < (size_t)num_spheres)
+	{
+		reserve(num_spheres);
+	}
+	float u[4 * spawnBatch];
+	for(int i = spheres.size(); i < num_spheres; i += spawnBatch)
+	{
+		int n = num_spheres - i;
+		if(n > spawnBatch)
+		{
+			n = spawnBatch;
+		}
+		asteroidRandom.fill(u, 4 * n);
+		for(int k = 0; k < n; k++)
+		{
+			spawnAsteroid(u + 4 * k);
+		}
+	}
+
+	// Extend the particle trail, dropping the oldest field past the maximum
+	particle_dens.push_back((heading * trailTurn).to_affine(current_pos + vec4(0,-2,0,0)).toMat4());
+	if(particle_dens.size() > max_particle_fields)
+	{
+		particle_dens.erase(particle_dens.begin());
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::integrate()
+{
+	// missiles without speed are still attached to the ship
+	if(missileA_speed != 0)
+	{
+		missileA_pos = missileA_pos + missileA_speed*missileA_dir;
+	}
+	if(missileB_speed != 0)
+	{
+		missileB_pos = missileB_pos + missileB_speed*missileB_dir;
+	}
+
+	// Grow the explosions
+	if(explosionVisible(collisionA_pos, explosion_scale_factA))
+	{
+		explosion_scale_factA += 0.5;
+	}
+	if(explosionVisible(collisionB_pos, explosion_scale_factB))
+	{
+		explosion_scale_factB += 0.5;
+	}
+
+	// Update the current position
+	current_pos = current_pos + current_dir * speed;
+
+	// Level the ship out and bring the camera round behind it, one batch
+	quat from[2] = { bank, camera };
+	quat to[2] = { quat_identity(), heading };
+	quat_slerp(from, to, easing, from, 2);
+	bank = from[0];
+	camera = from[1];
+
+	if(speed < max_speed)
+		speed += 0.002;
+
+	// Move the bullets
+	advance(bullet_positions.data(), bullet_directions.data(), bullet_speed, bullet_positions.size());
+
+	// Move each orb by its velocity, keep growing the ones that have been shot,
+	// and note the ones that left the grid for cull()
+	sphere_outside.resize(spheres.size());
+	advanceGrowing(spheres.data(), sphere_vels.data(), sphere_size.data(), sphere_outside.data(), spheres.size(), 100);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::collide()
+{
+	// count the distance tests for the statistics, the two pickups always
+	collision_tests = 2;
+
+	// The two missiles are tested against the asteroids at the same time,
+	// A as a job while this thread does B
+	size_t hitsA = 0, hitsB = 0;
+	JobCounter missileTests;
+	if(missileA_speed != 0)
+	{
+		collision_tests += spheres.size();
+		if(missileA_fired == 0)
+		{
+			jobs().run([&] { hitsA = countWithin(spheres.data(), spheres.size(), missileA_pos, 2); }, missileTests);
+		}
+	}
+	if(missileB_speed != 0)
+	{
+		collision_tests += spheres.size();
+		if(missileB_fired == 0)
+		{
+			hitsB = countWithin(spheres.data(), spheres.size(), missileB_pos, 2);
+		}
+	}
+	jobs().wait(missileTests);
+
+	// If the missile does collide with an asteroid, increment the kill counter and update positions
+	if(hitsA > 0)
+	{
+		killed_since_death++;
+		explosion_scale_factA += 0.3;
+		collisionA_pos = missileA_pos;
+		missileA_fired = 1;
+	}
+	if(hitsB > 0)
+	{
+		killed_since_death++;
+		explosion_scale_factB += 0.3;
+		collisionB_pos = missileB_pos;
+		missileB_fired = 1;
+	}
+
+	// Grow the spheres within range of the explosions, and once for every
+	// bullet that hit them; each asteroid gets its additions in that order
+	// whichever job it falls in
+	bool explosionA = abs(collisionA_pos.x) > 0.1 && abs(collisionA_pos.z) > 0.1;
+	bool explosionB = abs(collisionB_pos.x) > 0.1 && abs(collisionB_pos.z) > 0.1;
+	if(explosionA)
+	{
+		collision_tests += spheres.size();
+	}
+	if(explosionB)
+	{
+		collision_tests += spheres.size();
+	}
+	collision_tests += bullet_positions.size() * spheres.size();
+	if(explosionA || explosionB || !bullet_positions.empty())
+	{
+		jobs().parallelFor(spheres.size(), collideGrain, [&](size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; i++)
+			{
+				if(explosionA && vec_length(spheres[i] - collisionA_pos) < 15)
+				{
+					sphere_size[i] += 0.1;
+				}
+				if(explosionB && vec_length(spheres[i] - collisionB_pos) < 15)
+				{
+					sphere_size[i] += 0.1;
+				}
+				if(!bullet_positions.empty())
+				{
+					size_t hits = countWithin(bullet_positions.data(), bullet_positions.size(), spheres[i], 1.8f);
+					for(size_t k = 0; k < hits; k++)
+					{
+						sphere_size[i] += 0.05;
+					}
+				}
+			}
+		});
+	}
+
+	// If there is a collision between the ship and a sphere..
+	collision_tests += spheres.size();
+	for(int i = 0; i < spheres.size() ; i++)
+	{
+		if(detect_collision(current_pos, spheres[i], 2))
+		{
+			// Decrement the lives remaining (if killed any orbs) and reposition the user
+			current_pos = vec4(0,0,0,0);
+			if(killed_since_death > 0)
+			{
+				killed_since_death = 0;
+				player.lives_remaining--;
+			}
+		}
+	}
+
+	// If the user touches the ammo box, replace the ammo box randomly and give the player more ammunition
+	if(detect_collision(current_pos, ammo_box, 0.9))
+	{
+		ammo_box = randomPosition(50, 0, 0);
+		if(player.bullets_remaining < 46)
+		{
+			player.bullets_remaining += 15;
+		}
+	}
+
+	// If the user finds the random missile, reset the missile information and replace the missile
+	if(detect_collision(current_pos, missile_pos, 1.5))
+	{
+		rearmMissiles();
+		missile_pos = randomPosition(100, -2, 1);
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::cull()
+{
+	// Once a missile leaves the grid, it counts as fired
+	if(vec_length(missileA_pos - current_pos) >= 250)
+	{
+		missileA_fired = 1;
+	}
+	if(vec_length(missileB_pos - current_pos) >= 140)
+	{
+		missileB_fired = 1;
+	}
+
+	// If the bullet moves too far away, erase it
+	cull_inside.resize(bullet_positions.size());
+	insideSquare(bullet_positions.data(), bullet_positions.size(), 140, cull_inside.data());
+	int live = 0;
+	for(int i = 0 ; i < bullet_positions.size() ; i++)
+	{
+		if(!cull_inside[i])
+			continue;
+
+		bullet_positions[live] = bullet_positions[i];
+		bullet_directions[live] = bullet_directions[i];
+		live++;
+	}
+	bullet_positions.resize(live);
+	bullet_directions.resize(live);
+
+	// If a sphere leaves the grid (or blew up), erase it and all of its fields
+	// (compacted in place so the survivors keep their order)
+	// (integrate() found which left, collide() may have grown them since)
+	live = 0;
+	for(int i = 0; i < spheres.size() ; i++)
+	{
+		if(sphere_outside[i] || sphere_size[i] > 2)
+			continue;
+
+		spheres[live] = spheres[i];
+		sphere_vels[live] = sphere_vels[i];
+		sphere_size[live] = sphere_size[i];
+		live++;
+	}
+	spheres.resize(live);
+	sphere_vels.resize(live);
+	sphere_size.resize(live);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// The way the ship faces, in the x-z plane (bullets, missiles and thrust)
+vec4 World::headingDirection() const
+{
+	return vec4(heading.xform(vec3(1,0,1)), 0);
+}
+
+// The heading with the mesh's own turn and the bank
+quat World::shipOrientation() const
+{
+	return heading * shipTurn * bank;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// If the missile has no speed, then it is simply a part of the ship
+affine World::missileLocation(float missile_speed, const vec4& missile_pos, const quat& missile_turn) const
+{
+	if(missile_speed == 0)
+	{
+		return shipOrientation().to_affine(current_pos + vec4(0,-2,0,0)).scaled(0.3) * missileTurn;
+	}
+	return missile_turn.to_affine(missile_pos + vec4(0,-2,0,0)).scaled(0.3) * missileTurn;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+affine World::cameraView() const
+{
+	return camera.conjugate().to_affine().translated(-current_pos);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+bool World::explosionVisible(const vec4& collision_pos, float scale) const
+{
+	return abs(collision_pos.x) > 0.1 && abs(collision_pos.z) > 0.1 && scale > 0 && scale < 10;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void World::buildDraws(DrawList& draws, const mat4& projView, const mat4& projection)
+{
+	drawScene(draws, projView);
+	drawBullets(draws, projView, 0, bullet_positions.size());
+	drawAsteroids(draws, projView, 0, spheres.size());
+	drawHud(draws, projView, projection);
+}
+
+void DrawRecorder::resize(size_t count)
+{
+	if(buffers.size() < count)
+	{
+		buffers.resize(count);
+	}
+	// a job records at most drawGrain draws, so once reserved no buffer
+	// grows on a worker thread
+	for(size_t i = 0; i < count; i++)
+	{
+		buffers[i].clear();
+		buffers[i].reserve(drawGrain);
+	}
+	used = count;
+}
+
+void DrawRecorder::merge(DrawList& draws)
+{
+	offsets.resize(used);
+	size_t total = draws.size();
+	for(size_t i = 0; i < used; i++)
+	{
+		offsets[i] = total;
+		total += buffers[i].size();
+	}
+
+	draws.resize(total, DrawCommand(DRAW_STARS, mat4(), vec4()));
+	jobs().parallelFor(used, 1, [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; i++)
+		{
+			std::copy(buffers[i].begin(), buffers[i].end(), draws.begin() + offsets[i]);
+		}
+	});
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// The draws split into jobs: the scene and the HUD one job each, the
+// bullets and asteroids one job per drawGrain of them
+void World::recordDraws(DrawRecorder& recorder, DrawList& draws, const mat4& projView, const mat4& projection)
+{
+	// with no workers to share them, or too few draws to fill one job, the
+	// buffers would only add a copy
+	if(jobs().workerCount() == 0 || bullet_positions.size() + spheres.size() <= drawGrain)
+	{
+		buildDraws(draws, projView, projection);
+		return;
+	}
+
+	size_t bulletJobs = (bullet_positions.size() + drawGrain - 1) / drawGrain;
+	size_t asteroidJobs = (spheres.size() + drawGrain - 1) / drawGrain;
+	recorder.resize(2 + bulletJobs + asteroidJobs);
+
+	JobCounter recorded;
+	jobs().run([this, &recorder, &projView] { drawScene(recorder.buffer(0), projView); }, recorded);
+	for(size_t j = 0; j < bulletJobs; j++)
+	{
+		jobs().run([this, &recorder, &projView, j]
+		{
+			size_t begin = j * drawGrain;
+			drawBullets(recorder.buffer(1 + j), projView, begin, std::min(begin + drawGrain, bullet_positions.size()));
+		}, recorded);
+	}
+	for(size_t j = 0; j < asteroidJobs; j++)
+	{
+		jobs().run([this, &recorder, &projView, j, bulletJobs]
+		{
+			size_t begin = j * drawGrain;
+			drawAsteroids(recorder.buffer(1 + bulletJobs + j), projView, begin, std::min(begin + drawGrain, spheres.size()));
+		}, recorded);
+	}
+	drawHud(recorder.buffer(1 + bulletJobs + asteroidJobs), projView, projection);
+	jobs().wait(recorded);
+
+	recorder.merge(draws);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// The ship, explosions, missiles, trail and pickups
+void World::drawScene(DrawList& draws, const mat4& projView)
+{
+	// Draw the ship
+	draws.push_back(DrawCommand(DRAW_SHIP,
+		projView * shipOrientation().to_affine(current_pos + vec4(0,-2,0,0)).scaled(0.3),
+		vec4(1,1,1, 0.7f)));
+
+	// The explosions
+	if(explosionVisible(collisionA_pos, explosion_scale_factA))
+	{
+		draws.push_back(DrawCommand(DRAW_SPHERE, projView * affine::translation(collisionA_pos).scaled(explosion_scale_factA), vec4(0.8,0.2,0, 0.7f)));
+	}
+	if(explosionVisible(collisionB_pos, explosion_scale_factB))
+	{
+		draws.push_back(DrawCommand(DRAW_SPHERE, projView * affine::translation(collisionB_pos).scaled(explosion_scale_factB), vec4(0.8,0.2,0, 0.3f)));
+	}
+
+	// The missiles, while still in flight
+	if(missileA_fired == 0)
+	{
+		affine missileA_loc = missileLocation(missileA_speed, missileA_pos, missileA_turn);
+		draws.push_back(DrawCommand(DRAW_CYLINDER, projView * missileA_loc.translated(0,0,2).scaled(0.5,1.0,0.5), vec4(0.3,0.3,0.3,1)));
+		draws.push_back(DrawCommand(DRAW_SPHERE, projView * missileA_loc.translated(0,-0.5,2).scaled(0.25), vec4(0.3,0.3,0.3,1)));
+	}
+	if(missileB_fired == 0)
+	{
+		affine missileB_loc = missileLocation(missileB_speed, missileB_pos, missileB_turn);
+		draws.push_back(DrawCommand(DRAW_CYLINDER, projView * missileB_loc.translated(0,0,-2).scaled(0.5,1.0,0.5), vec4(0.3,0.3,0.3,1)));
+		draws.push_back(DrawCommand(DRAW_SPHERE, projView * missileB_loc.translated(0,-0.5,-2).scaled(0.25), vec4(0.3,0.3,0.3,1)));
+	}
+
+	// Draw the randomly placed missile which when touched refulls the missiles
+	affine supply_loc = affine::translation(missile_pos);
+	draws.push_back(DrawCommand(DRAW_CYLINDER, projView * supply_loc.translated(0,0,2).scaled(0.5,1.0,0.5), vec4(0.3,0.3,0.3,1)));
+	draws.push_back(DrawCommand(DRAW_SPHERE, projView * supply_loc.translated(0,-0.5,2).scaled(0.25), vec4(0.3,0.3,0.3,1)));
+
+	// Draw the cylinder which seemingly "emits" the trail
+	draws.push_back(DrawCommand(DRAW_CYLINDER,
+		projView * (heading * trailTurn).to_affine(current_pos + vec4(0,-2,0,0)).scaled(0.3),
+		vec4(1,1,1, 0.7f)));
+
+	// Draw all of the particle fields, either red or range (depending on random integer -> (0,1))
+	for(int i = 0; i < particle_dens.size() ; i++)
+	{
+		int colour_rand = effectsRandom.below(2);
+		vec4 colour = (colour_rand == 0) ? vec4(1,0.5,0, 0.7f) : vec4(1,0.2,0, 0.7f);
+		draws.push_back(DrawCommand(DRAW_PARTICLES, projView * particle_dens[i], colour, i));
+	}
+
+	// Draw the random box to allow the player to gain ammunition
+	draws.push_back(DrawCommand(DRAW_CUBE, projView * affine::translation(ammo_box).translated(0,-1,0), vec4(0.1,0.8,0.1,1)));
+}
+
+// Draw the bullets from begin to end
+void World::drawBullets(DrawList& draws, const mat4& projView, size_t begin, size_t end) const
+{
+	for(size_t i = begin; i < end; i++)
+	{
+		draws.push_back(DrawCommand(DRAW_SPHERE, projView * affine::translation(bullet_positions[i]).scaled(0.05), vec4(1.0f,0.0f,0.0f,1)));
+	}
+
+}
+
+// Draw the asteroids from begin to end
+void World::drawAsteroids(DrawList& draws, const mat4& projView, size_t begin, size_t end) const
+{
+	for(size_t i = begin; i < end; i++)
+	{
+		draws.push_back(DrawCommand(DRAW_SPHERE,
+			projView * affine::translation(spheres[i]).scaled(sphere_size[i], 0.5 * sphere_size[i], sphere_size[i]),
+			vec4(0.545f,0.275f,0.08f,1)));
+	}
+}
+
+// The stars, then the lives and bullets remaining
+void World::drawHud(DrawList& draws, const mat4& projView, const mat4& projection) const
+{
+	// Display the stars
+	draws.push_back(DrawCommand(DRAW_STARS, projView, vec4(1,1,1,1)));
+
+	// The lives remaining along the bottom of the screen and a bar for each
+	// bullet along the top, all in one draw
+	int lives = std::max(0, std::min(player.lives_remaining, 0x7FFF));
+	int bullets = std::max(0, std::min(player.bullets_remaining, 0xFFFF));
+	draws.push_back(DrawCommand(DRAW_HUD, projection, vec4(1,0,0,1), hudIndex(lives, bullets)));
+}
+
+}
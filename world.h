@@ -0,0 +1,232 @@
+#ifndef DJV_WORLD_H_
+#define DJV_WORLD_H_
+/*
+	Asteroids game world
+
+	All of the game state and rules from term_proj.cpp, kept free of
+	OpenGL calls so the simulation can also run headless (benchmarks,
+	replays). The renderer turns the DrawList into GL calls.
+*/
+
+#include <vector>
+
+#include "vec.h"
+#include "mat.h"
+#include "affine.h"
+#include "quaternion.h"
+#include "Player.h"
+#include "rng.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// special (non ASCII) keys the game reacts to, values match GLUT_KEY_*
+enum SpecialKey
+{
+	KEY_LEFT  = 0x0064,
+	KEY_UP    = 0x0065,
+	KEY_RIGHT = 0x0066,
+	KEY_DOWN  = 0x0067
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// the meshes the renderer knows how to draw
+enum DrawMesh
+{
+	DRAW_SHIP,
+	DRAW_CUBE,
+	DRAW_CYLINDER,
+	DRAW_SPHERE,
+	DRAW_STARS,
+	DRAW_PARTICLES,
+	DRAW_HUD
+};
+
+// one mesh draw with its final transform (ready for the modelView uniform)
+struct DrawCommand
+{
+	DrawCommand(DrawMesh m, const mat4& t, const vec4& c, int i = 0)
+		: mesh(m), index(i), transform(t), colour(c) {}
+
+	DrawMesh mesh;
+	int index; // particle field for DRAW_PARTICLES, hudIndex() for DRAW_HUD
+	mat4 transform;
+	vec4 colour;
+};
+
+// DRAW_HUD's index: the lives and bullets left, the transform is the
+// projection they are laid out with (hud.h)
+inline int hudIndex(int lives, int bullets) { return (lives << 16) | (bullets & 0xFFFF); }
+inline int hudLives(int index) { return index >> 16; }
+inline int hudBullets(int index) { return index & 0xFFFF; }
+
+typedef std::vector< DrawCommand > DrawList;
+
+// Draw lists recorded by several jobs at once: each job appends to a
+// buffer of its own and merge() joins them in order, so the list is the
+// same as if they had been recorded one after the other. Kept from frame
+// to frame, so the buffers keep their memory.
+class DrawRecorder
+{
+public:
+	DrawRecorder() : used(0) {}
+
+	// 'count' empty buffers
+	void resize(size_t count);
+	DrawList& buffer(size_t i) { return buffers[i]; }
+
+	// appends the buffers to 'draws' in order, each copied by a job
+	void merge(DrawList& draws);
+
+private:
+	std::vector< DrawList > buffers;
+	std::vector< size_t > offsets;
+	size_t used;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Returns the length of a vector (in the x-z plane)
+float vec_length(vec4 vec);
+
+// Detect a collision given two positions and a distance between the two
+bool detect_collision(vec4 pos_A, vec4 pos_B, float distance);
+
+// An asteroid made from 4 uniform numbers u: where on one of the grid's
+// edges it comes in, and the step it moves by every tick
+void asteroidSpawn(const float* u, vec4& pos, vec4& vel);
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class World
+{
+public:
+	World();
+
+	// put everything back to the start of a game,
+	// the same seed and input always play out the same game
+	void reset(unsigned int seed = 1);
+
+	// input, same keys as the GLUT callbacks
+	void keyboard(unsigned char key);
+	void specialKeyboard(int key);
+
+	// refill both missiles (same as picking up the missile supply)
+	void rearmMissiles();
+
+	// make room for 'asteroids' asteroids, the bullets and the particle
+	// fields up front (spawn() does when num_spheres outgrows them); copies
+	// of a world reserved the same take it without allocating
+	void reserve(int asteroids);
+
+	// advance the game by one frame, runs all the phases below in order
+	void tick();
+
+	// the phases of a tick, public so they can be timed separately
+	void spawn();     // fire bullets, top up asteroids, extend the particle trail
+	void integrate(); // move everything
+	void collide();   // bullets, missiles and the ship against asteroids and pickups
+	void cull();      // drop whatever left the play area or blew up
+
+	// append every draw for the current state
+	// (projView for the scene, projection for the HUD)
+	void buildDraws(DrawList& draws, const mat4& projView, const mat4& projection);
+
+	// the same draws, recorded by jobs (jobs.h) into the recorder's buffers
+	// and merged onto 'draws'
+	void recordDraws(DrawRecorder& recorder, DrawList& draws, const mat4& projView, const mat4& projection);
+
+	// the view from behind the ship, the camera offset goes in front of it
+	affine cameraView() const;
+
+	// the way the ship faces, where the up key sends it
+	vec4 headingDirection() const;
+
+	// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+	// The following are all the fields managed in the game
+
+	Player player;
+
+	// the game's own random streams, all seeded by reset(), so nothing else
+	// (like the renderer) changes how a game plays out
+	Rng asteroidRandom; // asteroid spawns
+	Rng pickupRandom;   // ammo box and missile supply
+	Rng effectsRandom;  // cosmetic only, left out of snapshots
+
+	// Ship Fields
+	float speed; // Current speed of the ship
+	float max_speed; // Maximum speed of the ship
+	vec4 current_dir; // Current direction of the ship
+	vec4 current_pos; // Current position of the ship
+	quat heading; // Which way the ship faces (about the y axis), the up-key accelerates that way
+	quat bank; // Roll of the ship while turning, eased back to level every tick
+	quat camera; // Orientation of the camera, eased round to the heading every tick
+
+	// Bullet fields
+	bool bullet_fired; // Boolean to check whether or not a bullet has been fired (space-key)
+	std::vector< vec4 > bullet_positions; // Vector list of the positions of all bullets
+	std::vector< vec4 > bullet_directions; // Vector list of all the directions of the bullets
+	static constexpr float bullet_speed = 2.5f; // How far the bullets move along their directions per tick
+
+	// Asteroids Fields
+	std::vector< vec4 > spheres; // Asteroids positions
+	std::vector< vec4 > sphere_vels; // Asteroids velocities (direction, turned and times the speed)
+	std::vector< float > sphere_size; // Asteroid sizes (larger if shot)
+	int num_spheres; // Number of spheres in the game at once
+	int killed_since_death; // Number of orbs destroyed since either beginning or spawning (cannot die before killing one asteroid)
+
+	// Particle trail, the renderer keeps one particle field per transform
+	std::vector< mat4 > particle_dens; // Matrix form translation of the particle fields
+	static const int max_particle_fields = 30;
+
+	// missile fields
+	vec4 missileA_dir; // Direction of missile A
+	vec4 missileA_pos; // Position of missile A
+	vec4 collisionA_pos; // Position of collision between missile A and an asteroid
+	vec4 collisionB_pos; // Position of collision between missile B and an asteroid
+	vec4 missileB_dir; // Direction of missile B
+	vec4 missileB_pos; // Position of missile B
+	quat missileA_turn; // Orientation of missile A once fired
+	quat missileB_turn; // Orientation of missile B once fired
+	int missileA_fired; // Boolean variable to check whether missile A has been fired
+	int missileB_fired; // Boolean variable to check whether missile B has been fired
+	float missileA_speed; // Speed of missile A
+	float missileB_speed; // Speed of missile B
+	float explosion_scale_factA; // Scale factor to simulate the explosion (scale explosion by this value)
+	float explosion_scale_factB; // Scale factor to simulate the explosion (scale explosion by this value)
+
+	// The ammo box and the missiles are placed (to give user more ammunition)
+	vec4 missile_pos; // Random position of the missile supply
+	vec4 ammo_box; // Random position of the ammo box
+
+	// Statistics (not game state, left out of snapshots)
+	unsigned int collision_tests; // distance tests made by the last collide()
+
+	// END - FIELDS
+	// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+private:
+	vec4 randomPosition(float extent, float y, float w);
+
+	// u holds the 4 uniform numbers the asteroid is made from
+	void spawnAsteroid(const float* u);
+	static const int spawnBatch = 64;
+	static const int bulletCapacity = 128; // bullets in flight before their lists grow
+	std::vector< unsigned char > cull_inside; // cull()'s scratch, which bullets stay in the grid
+	std::vector< unsigned char > sphere_outside; // which asteroids integrate() moved off the grid
+	quat shipOrientation() const;
+	affine missileLocation(float missile_speed, const vec4& missile_pos, const quat& missile_turn) const;
+	bool explosionVisible(const vec4& collision_pos, float scale) const;
+
+	// the sections of buildDraws(), in the order they are drawn
+	void drawScene(DrawList& draws, const mat4& projView);
+	void drawBullets(DrawList& draws, const mat4& projView, size_t begin, size_t end) const;
+	void drawAsteroids(DrawList& draws, const mat4& projView, size_t begin, size_t end) const;
+	void drawHud(DrawList& draws, const mat4& projView, const mat4& projection) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "world_batch.h"
+#include "jobs.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// worlds ticked by one job
+static const size_t worldsPerJob = 8;
+
+// a seed of its own for every world and episode (splitmix64's mixing)
+static unsigned long long mix(unsigned long long z)
+{
+	z += 0x9e3779b97f4a7c15ull;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static unsigned int episodeSeed(unsigned int seed, size_t world, unsigned int episode)
+{
+	return (unsigned int)mix(mix(mix(seed) + world) + episode);
+}
+
+static vec4 relative(const vec4& p, const vec4& ship)
+{
+	return vec4(p.x - ship.x, p.y - ship.y, p.z - ship.z, 0);
+}
+
+void observe(const World& world, Observation& observation)
+{
+	const vec4& ship = world.current_pos;
+
+	observation.lives = world.player.lives_remaining;
+	observation.bullets = world.player.bullets_remaining;
+	observation.kills = world.killed_since_death;
+	observation.missileA = world.missileA_speed == 0 && world.missileA_fired == 0;
+	observation.missileB = world.missileB_speed == 0 && world.missileB_fired == 0;
+
+	observation.position = ship;
+	observation.facing = world.headingDirection();
+	observation.velocity = world.current_dir * world.speed;
+	observation.ammoBox = relative(world.ammo_box, ship);
+	observation.missileSupply = relative(world.missile_pos, ship);
+
+	// keep the closest few in order, by their distance in the x-z plane
+	float distance[Observation::nearestAsteroids];
+	int found = 0;
+	for (size_t i = 0; i < world.spheres.size(); i++)
+	{
+		vec4 offset = relative(world.spheres[i], ship);
+		float d = offset.x * offset.x + offset.z * offset.z;
+		if (found == Observation::nearestAsteroids && d >= distance[found - 1])
+			continue;
+
+		int k = (found < Observation::nearestAsteroids) ? found++ : found - 1;
+		for (; k > 0 && distance[k - 1] > d; k--)
+		{
+			distance[k] = distance[k - 1];
+			observation.asteroids[k] = observation.asteroids[k - 1];
+		}
+		distance[k] = d;
+		observation.asteroids[k] = vec4(offset.x, 0, offset.z, world.sphere_size[i]);
+	}
+	for (int k = found; k < Observation::nearestAsteroids; k++)
+		observation.asteroids[k] = vec4(0, 0, 0, 0);
+	observation.numAsteroids = found;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+WorldBatch::WorldBatch(size_t worlds, int asteroids, unsigned int seed, unsigned int episodeTicks)
+	: slots(worlds)
+	, asteroids(asteroids)
+	, seed(seed)
+	, episodeTicks(episodeTicks)
+{
+	for (size_t i = 0; i < slots.size(); i++)
+		slots[i].world.reserve(asteroids);
+	reset();
+}
+
+void WorldBatch::reset()
+{
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		slots[i].episode = 0;
+		startEpisode(i);
+	}
+	stepCount = 0;
+	episodeCount = 0;
+}
+
+void WorldBatch::startEpisode(size_t i)
+{
+	Slot& slot = slots[i];
+	slot.world.reset(episodeSeed(seed, i, slot.episode));
+	slot.world.num_spheres = asteroids;
+	slot.tick = 0;
+	slot.done = false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void WorldBatch::stepWorld(size_t i, const Action& action, Observation& observation)
+{
+	Slot& slot = slots[i];
+	if (slot.done)
+	{
+		slot.episode++;
+		startEpisode(i);
+	}
+
+	World& world = slot.world;
+	if (action.turn < 0)
+		world.specialKeyboard(KEY_LEFT);
+	else if (action.turn > 0)
+		world.specialKeyboard(KEY_RIGHT);
+	if (action.thrust)
+		world.specialKeyboard(KEY_UP);
+	if (action.accelerate > 0)
+		world.keyboard('a');
+	else if (action.accelerate < 0)
+		world.keyboard('s');
+	if (action.fire && !world.bullet_fired)
+		world.keyboard(' ');
+	if (action.missileA)
+		world.keyboard('z');
+	if (action.missileB)
+		world.keyboard('x');
+
+	world.tick();
+	slot.tick++;
+	slot.done = world.player.lives_remaining <= 0 || (episodeTicks > 0 && slot.tick >= episodeTicks);
+
+	observe(world, observation);
+	observation.episode = slot.episode;
+	observation.tick = slot.tick;
+	observation.done = slot.done;
+}
+
+void WorldBatch::step(const Action* actions, Observation* observations)
+{
+	jobs().parallelFor(slots.size(), worldsPerJob, [this, actions, observations](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			stepWorld(i, actions[i], observations[i]);
+	});
+
+	stepCount += slots.size();
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (slots[i].done)
+			episodeCount++;
+	}
+}
+
+}
@@ -0,0 +1,128 @@
+#ifndef DJV_WORLD_BATCH_H_
+#define DJV_WORLD_BATCH_H_
+/*
+	Batch of independent games
+
+	Hosts many worlds in one process for automated agents: step() takes
+	one action per world, ticks them all (split over the job system,
+	jobs.h) and writes one observation per world. The worlds share
+	nothing, so a batch gives the same games on any number of threads.
+
+		WorldBatch batch(1024);
+		std::vector< Action > actions(batch.size());
+		std::vector< Observation > observations(batch.size());
+		for (;;)
+		{
+			...                          (fill in the actions)
+			batch.step(&actions[0], &observations[0]);
+		}
+
+	An episode ends when the ship is out of lives or after episodeTicks
+	ticks; its last observation says done, and the world starts the next
+	episode (with a seed of its own) at its next step. Every world's
+	memory is reserved up front and reused from episode to episode, so
+	stepping does not allocate.
+*/
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "world.h"
+
+namespace djv {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// what an agent does in one tick, the same as the game's keys
+struct Action
+{
+	Action() : turn(0), accelerate(0), thrust(false), fire(false), missileA(false), missileB(false) {}
+
+	int turn;       // -1 left, 1 right, 3 degrees a tick (arrow keys)
+	int accelerate; // 1 faster, -1 slower ('a', 's')
+	bool thrust;    // head the way the ship faces (up key)
+	bool fire;      // a bullet (space)
+	bool missileA;  // 'z'
+	bool missileB;  // 'x'
+};
+
+// what an agent sees after a tick; positions are relative to the ship
+struct Observation
+{
+	static const int nearestAsteroids = 8;
+
+	unsigned int episode; // episodes this world finished before this one
+	unsigned int tick;    // ticks into the episode
+	bool done;            // the episode ended with this tick
+
+	int lives;
+	int bullets;
+	int kills; // asteroids destroyed since the last death
+	bool missileA; // still to be fired
+	bool missileB;
+
+	vec4 position; // of the ship, in the world
+	vec4 facing;   // which way the ship faces
+	vec4 velocity; // how far it moves per tick
+
+	vec4 ammoBox;
+	vec4 missileSupply;
+
+	// the closest asteroids first, x and z relative to the ship and their
+	// size in w; unused entries are all zero
+	vec4 asteroids[nearestAsteroids];
+	int numAsteroids;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+class WorldBatch
+{
+public:
+	// 'worlds' games of 'asteroids' asteroids each, world i's episodes
+	// seeded from 'seed' and i; episodeTicks 0 only ends them on death
+	WorldBatch(size_t worlds, int asteroids = 60, unsigned int seed = 1, unsigned int episodeTicks = 3600);
+
+	size_t size() const { return slots.size(); }
+
+	// starts every world on its first episode again
+	void reset();
+
+	// applies actions[i] to world i and ticks it, for all of them, then
+	// fills in observations[i]
+	void step(const Action* actions, Observation* observations);
+
+	// the state of one world, between steps
+	const World& world(size_t i) const { return slots[i].world; }
+
+	// world ticks run and episodes finished, over all worlds since reset()
+	unsigned long long steps() const { return stepCount; }
+	unsigned long long episodes() const { return episodeCount; }
+
+private:
+	struct Slot
+	{
+		World world;
+		unsigned int episode;
+		unsigned int tick;
+		bool done;
+	};
+
+	void startEpisode(size_t i);
+	void stepWorld(size_t i, const Action& action, Observation& observation);
+
+	std::vector< Slot > slots;
+	int asteroids;
+	unsigned int seed;
+	unsigned int episodeTicks;
+	unsigned long long stepCount;
+	unsigned long long episodeCount;
+};
+
+// fills in an observation from a world, all but the episode fields
+void observe(const World& world, Observation& observation);
+
+}
+
+#endif